@@ -0,0 +1,242 @@
+#!/usr/bin/env python3
+# A scripted stand-in for an LDAP server, for testing auth/ldap without slapd.
+#
+# It understands just enough of the protocol for what auth/ldap sends:
+# simple binds, equality searches and unbinds.  Every request is logged to
+# standard output, one line each, so a test can check what happened.
+#
+#   ldapstub.py [-p port] [-u dn:password]... [-s dn]... [-d n]
+#
+#   -u dn:password  an entry, which simple binds as dn with password
+#                   succeed for; a search for attr=value finds the entries
+#                   whose first RDN is attr=value
+#   -s dn           never answer binds as dn, to make the client time out
+#   -d n            close the connection instead of answering the nth
+#                   request received (counting from 1, over all
+#                   connections), once, to make the client reconnect
+#
+# Example, for an ldap {} block with base "ou=people,dc=example" and
+# attribute "uid":
+#
+#   ldapstub.py -p 3890 -u uid=alice,ou=people,dc=example:secret
+
+import getopt
+import selectors
+import socket
+import sys
+
+SUCCESS = 0
+OPERATIONS_ERROR = 1
+INVALID_CREDENTIALS = 49
+
+entries = {}
+stalled = set()
+drop_at = 0
+received = 0
+
+
+def ber_length(data, pos):
+    n = data[pos]
+    pos += 1
+    if n < 0x80:
+        return n, pos
+    n &= 0x7f
+    return int.from_bytes(data[pos:pos + n], 'big'), pos + n
+
+
+def ber_read(data, pos):
+    """returns (tag, value, next position) of the element at pos"""
+    tag = data[pos]
+    length, pos = ber_length(data, pos + 1)
+    return tag, data[pos:pos + length], pos + length
+
+
+def ber_items(data):
+    pos = 0
+    while pos < len(data):
+        tag, value, pos = ber_read(data, pos)
+        yield tag, value
+
+
+def ber_encode(tag, value):
+    n = len(value)
+    if n < 0x80:
+        return bytes([tag, n]) + value
+    size = n.to_bytes((n.bit_length() + 7) // 8, 'big')
+    return bytes([tag, 0x80 | len(size)]) + size + value
+
+
+def ber_int(tag, n):
+    return ber_encode(tag, n.to_bytes(n.bit_length() // 8 + 1, 'big', signed=True))
+
+
+def ldap_result(tag, code):
+    return ber_encode(tag, ber_int(0x0a, code) + ber_encode(0x04, b'') + ber_encode(0x04, b''))
+
+
+def ldap_message(msgid, op):
+    return ber_encode(0x30, ber_int(0x02, msgid) + op)
+
+
+def message_complete(buf):
+    """returns the length of the first whole message in buf, or 0"""
+    if len(buf) < 2:
+        return 0
+    if buf[1] & 0x80 and len(buf) < 2 + (buf[1] & 0x7f):
+        return 0
+    length, pos = ber_length(buf, 1)
+    return pos + length if len(buf) >= pos + length else 0
+
+
+class Conn:
+    count = 0
+
+    def __init__(self, sock):
+        Conn.count += 1
+        self.id = Conn.count
+        self.sock = sock
+        self.buf = b''
+
+    def log(self, text):
+        print('conn %d: %s' % (self.id, text), flush=True)
+
+    def request(self, msgid, tag, op):
+        """returns the reply to send, or None to close the connection"""
+        global received
+
+        if tag == 0x42:
+            self.log('unbind')
+            return None
+
+        if tag == 0x50:
+            self.log('abandon')
+            return b''
+
+        received += 1
+        if received == drop_at:
+            self.log('request %d dropped' % received)
+            return None
+
+        if tag == 0x60:
+            items = list(ber_items(op))
+            dn = items[1][1].decode()
+            password = items[2][1].decode() if items[2][0] == 0x80 else None
+
+            if dn in stalled:
+                self.log('bind %s stalled' % dn)
+                return b''
+
+            if dn == '' or (dn in entries and entries[dn] == password):
+                code = SUCCESS
+            else:
+                code = INVALID_CREDENTIALS
+            self.log('bind %s -> %d' % (dn or '(anonymous)', code))
+            return ldap_message(msgid, ldap_result(0x61, code))
+
+        if tag == 0x63:
+            items = list(ber_items(op))
+            base = items[0][1].decode()
+            ftag, fvalue = items[6][0], items[6][1]
+            if ftag != 0xa3:
+                self.log('search %s with an unsupported filter' % base)
+                return ldap_message(msgid, ldap_result(0x65, OPERATIONS_ERROR))
+
+            (_, attr), (_, value) = ber_items(fvalue)
+            rdn = '%s=%s' % (attr.decode(), value.decode())
+            found = [dn for dn in entries
+                     if dn.split(',')[0] == rdn and dn.endswith(base)]
+
+            reply = b''
+            for dn in found:
+                entry = ber_encode(0x04, dn.encode()) + ber_encode(0x30, b'')
+                reply += ldap_message(msgid, ber_encode(0x64, entry))
+            self.log('search %s for %s -> %d entries' % (base, rdn, len(found)))
+            return reply + ldap_message(msgid, ldap_result(0x65, SUCCESS))
+
+        self.log('unsupported request 0x%02x' % tag)
+        return None
+
+    def readable(self, sel):
+        data = self.sock.recv(65536)
+        if not data:
+            self.log('closed by client')
+            self.close(sel)
+            return
+
+        self.buf += data
+        while True:
+            n = message_complete(self.buf)
+            if n == 0:
+                break
+
+            message, self.buf = self.buf[:n], self.buf[n:]
+            _, body, _ = ber_read(message, 0)
+            items = ber_items(body)
+            _, msgid = next(items)
+            tag, op = next(items)
+
+            reply = self.request(int.from_bytes(msgid, 'big'), tag, op)
+            if reply is None:
+                self.close(sel)
+                return
+            self.sock.sendall(reply)
+
+    def close(self, sel):
+        sel.unregister(self.sock)
+        self.sock.close()
+
+
+def usage():
+    print('usage: %s [-p port] [-u dn:password]... [-s dn]... [-d n]' % sys.argv[0], file=sys.stderr)
+    sys.exit(1)
+
+
+def main():
+    global drop_at
+    port = 3890
+
+    try:
+        opts, args = getopt.getopt(sys.argv[1:], 'p:u:s:d:')
+    except getopt.GetoptError:
+        usage()
+    if args:
+        usage()
+
+    for opt, arg in opts:
+        if opt == '-p':
+            port = int(arg)
+        elif opt == '-u':
+            dn, sep, password = arg.rpartition(':')
+            if not sep:
+                usage()
+            entries[dn] = password
+        elif opt == '-s':
+            stalled.add(arg)
+        elif opt == '-d':
+            drop_at = int(arg)
+
+    listener = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    listener.bind(('127.0.0.1', port))
+    listener.listen(16)
+
+    sel = selectors.DefaultSelector()
+    sel.register(listener, selectors.EVENT_READ)
+    print('listening on 127.0.0.1:%d' % port, flush=True)
+
+    while True:
+        for key, _ in sel.select():
+            if key.fileobj is listener:
+                sock, _ = listener.accept()
+                conn = Conn(sock)
+                sel.register(sock, selectors.EVENT_READ, conn)
+                conn.log('accepted')
+            else:
+                key.data.readable(sel)
+
+
+if __name__ == '__main__':
+    try:
+        main()
+    except KeyboardInterrupt:
+        pass
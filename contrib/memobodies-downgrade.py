@@ -0,0 +1,46 @@
+#!/usr/bin/env python3
+# Converts an opensex database written with schema version 13 or later
+# back to version 12, for going back to an older version of services.
+#
+# Version 13 stores the text of a mass memo once, as
+#   MB <id> <text>
+# and each copy as
+#   MR <account> <sender> <sent> <status> <id>
+# which older versions do not know.  This writes every copy as an
+# ordinary ME row again.  Nothing else changed in version 13.
+#
+#   memobodies-downgrade.py < services.db > services.db.12
+#
+# Stop services before converting, and move the result into place.
+
+import sys
+
+
+def main():
+    if len(sys.argv) != 1:
+        print('usage: %s < services.db > services.db.12' % sys.argv[0], file=sys.stderr)
+        sys.exit(1)
+
+    bodies = {}
+    out = sys.stdout.buffer
+
+    for line in sys.stdin.buffer:
+        row = line.rstrip(b'\n')
+        words = row.split(b' ')
+
+        if words[0] == b'DBV' and len(words) > 1 and int(words[1]) > 12:
+            out.write(b'DBV 12\n')
+        elif words[0] == b'MB' and len(words) > 2:
+            bodies[words[1]] = row.split(b' ', 2)[2]
+        elif words[0] == b'MR' and len(words) == 6:
+            if words[5] not in bodies:
+                print('skipping memo for %s: unknown body %s' % (words[1].decode(errors='replace'),
+                      words[5].decode(errors='replace')), file=sys.stderr)
+                continue
+            out.write(b' '.join([b'ME'] + words[1:5] + [bodies[words[5]]]) + b'\n')
+        else:
+            out.write(line)
+
+
+if __name__ == '__main__':
+    main()
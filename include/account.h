@@ -67,6 +67,12 @@ struct svsignore_ {
   time_t settime;
   char *setby;
   char *reason;
+
+  /* lookup index, see svsignore.c */
+  match_mask_t *compiled;
+  unsigned int serial;
+  mowgli_list_t *bucket;
+  mowgli_node_t bucketnode;
 };
 
 /* services accounts */
@@ -98,6 +104,11 @@ struct myuser_
   language_t *language;
 
   mowgli_list_t cert_fingerprints;
+
+  /* positions in the account indexes, see myuser_index_update() */
+  skiplist_node_t *registered_node;
+  skiplist_node_t *lastlogin_node;
+  skiplist_node_t *email_node;
 };
 
 /* Keep this synchronized with mu_flags in libathemecore/flags.c */
@@ -279,7 +290,8 @@ struct chanacs_
 /* struct for account memos */
 struct mymemo_ {
 	char	 sender[NICKLEN];
-	char 	 text[MEMOLEN];
+	stringref text;		/* shared by all copies of a mass memo */
+	unsigned int batch;	/* same for all copies of a mass memo, else 0 */
 	time_t	 sent;
 	unsigned int status;
 };
@@ -436,6 +448,10 @@ E void myuser_delete(myuser_t *mu);
 //inline myuser_t *myuser_find(const char *name);
 E void myuser_rename(myuser_t *mu, const char *name);
 E void myuser_set_email(myuser_t *mu, const char *newemail);
+E void myuser_index_update(myuser_t *mu);
+E void myuser_foreach_registered_before(time_t ts, void (*cb)(myuser_t *mu, void *privdata), void *privdata);
+E void myuser_foreach_lastlogin_before(time_t ts, void (*cb)(myuser_t *mu, void *privdata), void *privdata);
+E bool myuser_foreach_email_match(const char *mask, void (*cb)(myuser_t *mu, void *privdata), void *privdata);
 E myuser_t *myuser_find_ext(const char *name);
 E void myuser_notice(const char *from, myuser_t *target, const char *fmt, ...) PRINTFLIKE(3, 4);
 
@@ -444,6 +460,8 @@ E bool myuser_access_add(myuser_t *mu, const char *mask);
 E char *myuser_access_find(myuser_t *mu, const char *mask);
 E void myuser_access_delete(myuser_t *mu, const char *mask);
 
+E unsigned int mymemo_batch_new(void);
+
 E mynick_t *mynick_add(myuser_t *mu, const char *name);
 E void mynick_delete(mynick_t *mn);
 //inline mynick_t *mynick_find(const char *name);
@@ -507,6 +525,7 @@ E mowgli_list_t svs_ignore_list;
 E svsignore_t *svsignore_find(user_t *user);
 E svsignore_t *svsignore_add(const char *mask, const char *reason);
 E void svsignore_delete(svsignore_t *svsignore);
+E void svsignore_invalidate(user_t *user);
 
 #include "entity-validation.h"
 
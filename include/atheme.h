@@ -36,6 +36,7 @@
 #include "sasl.h"
 #include "match.h"
 #include "sysconf.h"
+#include "skiplist.h"
 #include "account.h"
 #include "auth.h"
 #include "tools.h"
@@ -43,6 +44,7 @@
 #include "global.h"
 #include "flags.h"
 #include "phandler.h"
+#include "histogram.h"
 #include "commandtree.h"
 #include "servtree.h"
 #include "services.h"
@@ -52,6 +54,11 @@
 #include "database_backend.h"
 #include "entity.h"
 #include "uid.h"
+#include "trigram.h"
+#include "msgring.h"
+#include "mailqueue.h"
+#include "watchdog.h"
+#include "memstat.h"
 
 #include "inline/account.h"
 #include "inline/channels.h"
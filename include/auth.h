@@ -9,11 +9,16 @@
 #ifndef AUTH_H
 #define AUTH_H
 
+/* called exactly once with the outcome of verify_password_async() */
+typedef void (*verify_password_cb_t)(myuser_t *mu, bool verified, void *privdata);
+
 E void set_password(myuser_t *mu, const char *newpassword);
 E bool verify_password(myuser_t *mu, const char *password);
+E void verify_password_async(myuser_t *mu, const char *password, verify_password_cb_t cb, void *privdata);
 
 E bool auth_module_loaded;
 E bool (*auth_user_custom)(myuser_t *mu, const char *password);
+E void (*auth_user_custom_async)(myuser_t *mu, const char *password, verify_password_cb_t cb, void *privdata);
 
 #endif
 
@@ -51,6 +51,7 @@ struct chanuser_
   unsigned int modes;
   mowgli_node_t unode;
   mowgli_node_t cnode;
+  mowgli_node_t *burstnode; /* pending deferred channel_join hooks */
 };
 
 struct chanban_
@@ -11,6 +11,14 @@
 
 typedef struct commandentry_ command_t;
 
+/* execution times, by service and command; never freed, so that they
+ * survive reloading the modules which provide the commands */
+typedef struct {
+	char *service;
+	char *name;
+	histogram_t latency;
+} command_stats_t;
+
 struct commandentry_ {
 	const char *name;
 	const char *desc;
@@ -21,9 +29,18 @@ struct commandentry_ {
 		const char *path;
 		void (*func)(sourceinfo_t *, const char *subcmd);
 	} help;
+
+	/* statistics for the service and parent command it last ran
+	 * under; managed by command_add() and command_exec() */
+	command_stats_t *stats;
+	const service_t *stats_svs;
+	const command_t *stats_parent;
 };
 
 /* commandtree.c */
+E mowgli_patricia_t *command_stats;
+
+E void commandtree_init(void);
 E void command_add(command_t *cmd, mowgli_patricia_t *commandtree);
 E void command_delete(command_t *cmd, mowgli_patricia_t *commandtree);
 E command_t *command_find(mowgli_patricia_t *commandtree, const char *command);
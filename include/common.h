@@ -53,7 +53,7 @@ typedef enum {
 #define GECOSLEN		51
 #define KEYLEN			24
 #define EMAILLEN		120
-#define MEMOLEN			300
+#define MEMOLEN			300		/* READ sends a memo as one line */
 
 #define MAXMSIGNORES		40
 
@@ -167,6 +167,8 @@ void strshare_init(void);
 stringref strshare_get(const char *str);
 stringref strshare_ref(stringref str);
 void strshare_unref(stringref str);
+void strshare_stats(size_t *count, size_t *bytes);
+void strshare_memstats(size_t *large, size_t *large_bytes, size_t *table_bytes);
 
 #endif
 
@@ -92,4 +92,13 @@ E void db_process(database_handle_t *db, const char *type);
 E void db_init(void);
 E database_module_t *db_mod;
 
+/* main loop time taken by database saves */
+typedef struct {
+	unsigned int saves;
+	unsigned int last_ms;
+	unsigned long total_ms;
+} db_save_stats_t;
+
+E db_save_stats_t db_save_stats;
+
 #endif
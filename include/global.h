@@ -28,6 +28,7 @@ struct me
   char *adminname;              /* SRA's name (for ADMIN)             */
   char *adminemail;             /* SRA's email (for ADMIN             */
   char *mta;                    /* path to mta program                */
+  bool mta_smtp;                /* talk SMTP to one "mta -bs" process */
   char *numeric;		/* server numeric		      */
 
   int maxfd;                    /* how many fds do we have?           */
@@ -122,6 +123,14 @@ struct ConfOption
   unsigned int immune_level;	/* what flag is required for kick immunity */
 
   bool send_sasl_quit;	/* Whether SaslServ sends a /quit before a shutdown or restart. */
+
+  bool burst_defer_hooks;	/* postpone deferrable user_add/channel_join hooks during burst */
+
+  unsigned int command_latency_log;	/* log commands slower than this, in ms */
+
+  unsigned int stall_threshold;	/* report event loop stalls longer than this, in seconds */
+
+  char *uplink_capture;		/* record lines from the uplink to this file */
 };
 
 E struct ConfOption config_options;
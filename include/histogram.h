@@ -0,0 +1,55 @@
+/*
+ * ChatServices: A collection of minimalist IRC services
+ * histogram.h: Log-linear latency histograms.
+ *
+ * Copyright (c) 2018 ChatLounge IRC Network Development Team
+ *     (http://www.chatlounge.net)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ATHEME_HISTOGRAM_H
+#define ATHEME_HISTOGRAM_H
+
+/*
+ * Values are in microseconds.  Below 8 each value has its own bucket;
+ * above that there are eight buckets per power of two, so a bucket is
+ * never wider than 1/8 of its lower bound.  Values of 2^29 us (about
+ * nine minutes) and more all land in the last bucket.
+ */
+#define HISTOGRAM_SUBBITS	3
+#define HISTOGRAM_MAXEXP	28
+#define HISTOGRAM_BUCKETS	((HISTOGRAM_MAXEXP - HISTOGRAM_SUBBITS + 2) << HISTOGRAM_SUBBITS)
+
+typedef struct {
+	unsigned long count;
+	uint64_t total;
+	unsigned int max;
+	unsigned int buckets[HISTOGRAM_BUCKETS];
+} histogram_t;
+
+E void histogram_add(histogram_t *h, unsigned int value);
+E unsigned int histogram_bucket_upper(unsigned int bucket);
+E unsigned int histogram_percentile(const histogram_t *h, unsigned int pct);
+
+#endif
+
+/* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
+ * vim:ts=8
+ * vim:sw=8
+ * vim:noexpandtab
+ */
@@ -11,21 +11,42 @@
 typedef struct hook_ hook_t;
 typedef void (*hookfn_t)(void *data);
 
+/* what a handler has cost while hook_profiling was set */
+typedef struct {
+	stringref owner;	/* module which added the handler, or "core" */
+	unsigned long calls;
+	uint64_t cpu;		/* microseconds, including hooks it raised */
+	unsigned int max;
+} hook_profile_t;
+
+typedef void (*hook_profile_cb_t)(hook_t *hook, unsigned int position, const hook_profile_t *prof, void *privdata);
+
 struct hook_ {
 	stringref name;
 	mowgli_list_t hooks;
+	unsigned int deferrable; /* number of handlers which may be deferred */
+	unsigned long calls;	 /* times the event was raised */
 };
 
+E mowgli_patricia_t *hooks;
+
 E hook_t *hook_add_event(const char *);
 E void hook_del_event(const char *);
 E void hook_del_hook(const char *, hookfn_t);
 E void hook_add_hook(const char *, hookfn_t);
 E void hook_add_hook_first(const char *, hookfn_t);
+E void hook_add_hook_deferrable(const char *, hookfn_t);
 E void hook_call_event(const char *, void *);
+E bool hook_call_event_nondeferred(const char *, void *);
+E void hook_call_event_deferred(const char *, void *);
 
 E void hook_stop(void);
 E void hook_continue(void *newptr);
 
+E bool hook_profiling;
+E void hook_profile_foreach(hook_profile_cb_t cb, void *privdata);
+E void hook_profile_reset(void);
+
 #endif
 
 /* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
@@ -15,6 +15,7 @@ struct path_handler_
 {
 	const char *path;
 	void (*handler)(connection_t *, void *);
+	void (*get_handler)(connection_t *);	/* NULL if only POST is taken */
 };
 
 struct httpddata
@@ -29,8 +30,18 @@ struct httpddata
 	bool correct_content_type;
 	bool expect_100_continue;
 	bool sent_reply;
+	path_handler_t *handler;	/* handler for the current request's path */
+	int file_fd;			/* static file being sent, or -1 */
+	off_t file_offset;
+	off_t file_left;
 };
 
+/* exported by misc/httpd as httpd_path_funcs */
+typedef struct {
+	void (*path_add)(path_handler_t *ph);
+	void (*path_delete)(path_handler_t *ph);
+} httpd_path_func_t;
+
 #endif
 
 /* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs ts=8 sw=8 noexpandtab
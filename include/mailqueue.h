@@ -0,0 +1,46 @@
+/*
+ * ChatServices: A collection of minimalist IRC services
+ * mailqueue.h: Persistent outgoing mail queue.
+ *
+ * Copyright (c) 2018 ChatLounge IRC Network Development Team
+ *     (http://www.chatlounge.net)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ATHEME_MAILQUEUE_H
+#define ATHEME_MAILQUEUE_H
+
+typedef struct {
+	unsigned int depth;	/* messages waiting to be sent */
+	unsigned int sent;
+	unsigned int deferred;	/* temporary failures, will be retried */
+	unsigned int failed;	/* permanent failures and expired messages */
+} mailqueue_stats_t;
+
+E mailqueue_stats_t mailqueue_stats;
+
+E void mailqueue_init(void);
+E bool mailqueue_submit(const char *rcpt, const char *text);
+
+#endif
+
+/* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
+ * vim:ts=8
+ * vim:sw=8
+ * vim:noexpandtab
+ */
@@ -55,6 +55,12 @@ E void noopcanon(char *);
 E int match(const char *, const char *);
 E char *collapse(char *);
 
+typedef struct match_mask_ match_mask_t;
+
+E match_mask_t *match_compile(const char *mask);
+E int match_compiled(const match_mask_t *mm, const char *name);
+E void match_mask_free(match_mask_t *mm);
+
 /* regex_create() flags */
 #define AREGEX_ICASE	1 /* case insensitive */
 #define AREGEX_PCRE	2 /* use libpcre engine */
@@ -0,0 +1,61 @@
+/*
+ * ChatServices: A collection of minimalist IRC services
+ * memstat.h: Measured memory usage.
+ *
+ * Copyright (c) 2018 ChatLounge IRC Network Development Team
+ *     (http://www.chatlounge.net)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ATHEME_MEMSTAT_H
+#define ATHEME_MEMSTAT_H
+
+/*
+ * All sizes are in bytes.  Figures the platform cannot provide are 0:
+ * the /proc ones need Linux (PSS needs 4.14 or later) and the malloc
+ * ones need mallinfo().
+ */
+typedef struct {
+	size_t rss;		/* resident now */
+	size_t rss_peak;	/* resident at most, since startup */
+	size_t rss_anon;	/* resident and not backed by a file */
+	size_t pss;		/* resident, with shared pages split between sharers */
+
+	size_t malloc_used;	/* handed out by malloc(), including mmap()ed */
+	size_t malloc_free;	/* held by malloc() for reuse */
+	size_t malloc_mmap;	/* in large mmap()ed allocations */
+
+	unsigned long heap_objects;	/* live objects in the shared heaps */
+	size_t heap_used;	/* their size */
+	size_t heap_reserved;	/* the whole blocks holding them, at least */
+
+	size_t strings_large;		/* shared strings too long for the heaps */
+	size_t strings_large_bytes;
+	size_t strings_table;		/* the shared string hash table */
+} memstat_t;
+
+E void memstat_get(memstat_t *ms);
+E size_t memstat_heap_reserved(const sharedheap_t *sh);
+
+#endif
+
+/* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
+ * vim:ts=8
+ * vim:sw=8
+ * vim:noexpandtab
+ */
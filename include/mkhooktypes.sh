@@ -44,6 +44,7 @@ while read hook type; do
 		echo "#define hook_call_$hook(x) hook_call_event(\"$hook\", ENSURE_TYPE(x, $type))"
 		echo "#define hook_add_$hook(f) hook_add_hook(\"$hook\", (void (*)(void *))ENSURE_TYPE(f, void (*)($type)))"
 		echo "#define hook_add_first_$hook(f) hook_add_hook_first(\"$hook\", (void (*)(void *))ENSURE_TYPE(f, void (*)($type)))"
+		echo "#define hook_add_deferrable_$hook(f) hook_add_hook_deferrable(\"$hook\", (void (*)(void *))ENSURE_TYPE(f, void (*)($type)))"
 		echo "#define hook_del_$hook(f) hook_del_hook(\"$hook\", (void (*)(void *))ENSURE_TYPE(f, void (*)($type)))"
 		;;
 	esac
@@ -107,6 +107,7 @@ E void module_load_dir_match(const char *dirspec, const char *pattern);
 E void *module_locate_symbol(const char *modname, const char *sym);
 E void module_unload(module_t *m, module_unload_intent_t intent);
 E module_t *module_find(const char *name);
+E module_t *modtarget;
 E module_t *module_find_published(const char *name);
 E bool module_request(const char *name);
 
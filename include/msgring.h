@@ -0,0 +1,57 @@
+/*
+ * ChatServices: A collection of minimalist IRC services
+ * msgring.h: Fixed-size rings of recent messages, for flood detection.
+ *
+ * Copyright (c) 2018 ChatLounge IRC Network Development Team
+ *     (http://www.chatlounge.net)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ATHEME_MSGRING_H
+#define ATHEME_MSGRING_H
+
+/* most messages a ring can hold */
+#define MSGRING_SIZE		16
+
+typedef struct {
+	time_t time;
+	uint64_t hash;		/* msgring_hash() of the text */
+	stringref source;
+} msgring_entry_t;
+
+typedef struct {
+	unsigned int head;	/* oldest entry */
+	unsigned int count;
+	msgring_entry_t entries[MSGRING_SIZE];
+} msgring_t;
+
+#define MSGRING_OLDEST(ring)	(&(ring)->entries[(ring)->head])
+#define MSGRING_NEWEST(ring)	(&(ring)->entries[((ring)->head + (ring)->count - 1) % MSGRING_SIZE])
+
+E uint64_t msgring_hash(const char *text);
+E void msgring_add(msgring_t *ring, unsigned int max, stringref source, const char *text, time_t ts);
+E void msgring_clear(msgring_t *ring);
+E void msgring_match_newest(const msgring_t *ring, size_t *text_matches, size_t *source_matches, time_t *source_first_seen);
+
+#endif
+
+/* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
+ * vim:ts=8
+ * vim:sw=8
+ * vim:noexpandtab
+ */
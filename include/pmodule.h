@@ -17,6 +17,7 @@ struct pcommand_ {
 	void	(*handler)(sourceinfo_t *si, int parc, char *parv[]);
 	int	minparc;
 	int	sourcetype;
+	unsigned long calls;	/* lines dispatched, for misc/metrics */
 };
 
 /* values for sourcetype */
@@ -27,7 +28,7 @@ struct pcommand_ {
 #define MAXPARC		35 /* max # params to protocol command */
 
 /* pmodule.c */
-E mowgli_heap_t *pcommand_heap;
+E sharedheap_t *pcommand_heap;
 E mowgli_heap_t *messagetree_heap;
 E mowgli_patricia_t *pcommands;
 
@@ -24,11 +24,14 @@ typedef struct {
 typedef struct {
   char *h_name;
   nsaddr_t addr;
+  time_t ttl; /* of the answer record, in seconds */
 } dns_reply_t;
 
 typedef struct {
   void *ptr; /* pointer used by callback to identify request */
   void (*callback)(void *vptr, dns_reply_t *reply); /* callback to call */
+  bool nxdomain; /* with a NULL reply: the name does not exist, as opposed
+                    to a timeout or a server error */
 } dns_query_t;
 
 extern nsaddr_t irc_nsaddr_list[];
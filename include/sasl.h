@@ -59,14 +59,17 @@ typedef struct {
 typedef struct {
 	void (*mech_register) (struct sasl_mechanism_ *mech);
 	void (*mech_unregister) (struct sasl_mechanism_ *mech);
+	void (*mech_complete) (struct sasl_session_ *sptr, int result);
 } sasl_mech_register_func_t;
 
 #define ASASL_FAIL 0 /* client supplied invalid credentials / screwed up their formatting */
 #define ASASL_MORE 1 /* everything looks good so far, but we're not done yet */
 #define ASASL_DONE 2 /* client successfully authenticated */
+#define ASASL_WAIT 3 /* the result will be passed to mech_complete() later */
 
 #define ASASL_MARKED_FOR_DELETION   1 /* see delete_stale() in saslserv/main.c */
 #define ASASL_NEED_LOG              2 /* user auth success needs to be logged still */
+#define ASASL_WAITING               4 /* a mechanism returned ASASL_WAIT */
 
 #endif
 
@@ -34,6 +34,8 @@ struct service_ {
 	bool botonly;
 
 	struct service_ *logtarget;
+
+	unsigned long commands_run;	/* commands executed, for misc/metrics */
 };
 
 static inline const char *service_get_log_target(const service_t *svs)
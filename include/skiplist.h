@@ -0,0 +1,57 @@
+/*
+ * ChatServices: A collection of minimalist IRC services
+ * skiplist.h: Ordered skip lists.
+ *
+ * Copyright (c) 2018 ChatLounge IRC Network Development Team
+ *     (http://www.chatlounge.net)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ATHEME_SKIPLIST_H
+#define ATHEME_SKIPLIST_H
+
+typedef struct skiplist_ skiplist_t;
+typedef struct skiplist_node_ skiplist_node_t;
+
+/* orders two keys, like strcmp() */
+typedef int (*skiplist_comparator_t)(const void *key1, const void *key2);
+
+struct skiplist_node_ {
+	void *data;
+	void *key;
+	unsigned int level;
+	skiplist_node_t *next[];
+};
+
+#define SKIPLIST_FOREACH(n, sl) for (n = skiplist_first(sl); n != NULL; n = n->next[0])
+
+E skiplist_t *skiplist_create(size_t keysize, skiplist_comparator_t cmp);
+E void skiplist_destroy(skiplist_t *sl);
+E skiplist_node_t *skiplist_insert(skiplist_t *sl, const void *key, void *data);
+E void skiplist_delete(skiplist_t *sl, skiplist_node_t *n);
+E skiplist_node_t *skiplist_first(skiplist_t *sl);
+E skiplist_node_t *skiplist_seek(skiplist_t *sl, const void *key);
+E size_t skiplist_size(skiplist_t *sl);
+
+#endif
+
+/* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
+ * vim:ts=8
+ * vim:sw=8
+ * vim:noexpandtab
+ */
@@ -167,6 +167,9 @@ E void s_time(struct timeval *sttime);
 E void e_time(struct timeval sttime, struct timeval *ttime);
 E int tv2ms(struct timeval *tv);
 #endif
+E uint64_t mono_usec(void);
+E double mono_usec_double(void);
+E uint64_t cpu_usec(void);
 
 E void build_criteriastr(char *buf, int parc, char *parv[]);
 
@@ -196,8 +199,45 @@ E unsigned int base64touint(const char *buf);
 E void decode_p10_ip(const char *b64, char ipstring[HOSTIPLEN]);
 
 /* sharedheap.c */
+typedef struct sharedheap_ sharedheap_t;
+
+/*
+ * A named handle on the block heap for objects of one size, which is
+ * shared with any other types of the same size.  The counts are what
+ * OperServ MEMORY and friends report.
+ */
+struct sharedheap_ {
+	const char *name;		/* type kept in it, e.g. "user_t" */
+	size_t size;			/* element size, after rounding */
+	size_t block;			/* elements per block */
+	mowgli_heap_t *heap;
+	unsigned long live;		/* elements allocated and not freed */
+	unsigned long peak;
+	unsigned int refcount;
+	mowgli_node_t node;
+};
+
+E mowgli_list_t sharedheap_list;
+
 E mowgli_heap_t *sharedheap_get(size_t size);
 E void sharedheap_unref(mowgli_heap_t *heap);
+E sharedheap_t *sharedheap_get_named(size_t size, const char *name);
+E void sharedheap_unref_named(sharedheap_t *sh);
+
+static inline void *sharedheap_alloc(sharedheap_t *sh)
+{
+	if (++sh->live > sh->peak)
+		sh->peak = sh->live;
+
+	return mowgli_heap_alloc(sh->heap);
+}
+
+static inline void sharedheap_free(sharedheap_t *sh, void *ptr)
+{
+	sh->live--;
+	mowgli_heap_free(sh->heap, ptr);
+}
+
 E char *combine_path(const char *parent, const char *child);
 
 #if !HAVE_VSNPRINTF
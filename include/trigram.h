@@ -0,0 +1,46 @@
+/*
+ * ChatServices: A collection of minimalist IRC services
+ * trigram.h: Trigram indexes for wildcard searches.
+ *
+ * Copyright (c) 2018 ChatLounge IRC Network Development Team
+ *     (http://www.chatlounge.net)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ATHEME_TRIGRAM_H
+#define ATHEME_TRIGRAM_H
+
+typedef struct trigram_index_ trigram_index_t;
+
+/* called once per candidate; must not modify the index */
+typedef void (*trigram_search_cb_t)(const char *key, void *obj, void *privdata);
+
+E trigram_index_t *trigram_index_create(void);
+E void trigram_index_destroy(trigram_index_t *ti);
+E void trigram_index_add(trigram_index_t *ti, const char *key, void *obj, const char *text);
+E void trigram_index_delete(trigram_index_t *ti, const char *key);
+E unsigned int trigram_index_size(trigram_index_t *ti);
+E bool trigram_index_search(trigram_index_t *ti, const char *mask, trigram_search_cb_t cb, void *privdata);
+
+#endif
+
+/* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
+ * vim:ts=8
+ * vim:sw=8
+ * vim:noexpandtab
+ */
@@ -49,6 +49,16 @@ E struct timeval burstime;
 
 E void (*parse)(char *line);
 E void irc_handle_connect(connection_t *cptr);
+E void irc_capture_close(void);
+
+/*
+ * An uplink capture file is UPLINK_CAPTURE_MAGIC followed by a record
+ * per line: the microseconds since the previous line (or since the link
+ * came up, for the first) and the length of the line, both as unsigned
+ * LEB128 varints, then the line itself without its CR LF.
+ */
+#define UPLINK_CAPTURE_MAGIC	"ATHCAP1\n"
+#define UPLINK_CAPTURE_MAGICLEN	8
 
 /* send.c */
 E int sts(const char *fmt, ...) PRINTFLIKE(1, 2);
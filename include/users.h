@@ -40,6 +40,11 @@ struct user_
 	mowgli_node_t snode; /* for server_t.userlist */
 
 	char *certfp; /* client certificate fingerprint */
+
+	mowgli_node_t *burstnode; /* pending deferred user_add hooks, see burst.c */
+
+	svsignore_t *svsignore; /* cached svsignore_find() result */
+	unsigned int svsignoregen; /* ignore list generation of the above, 0 if stale */
 };
 
 #define FLOOD_MSGS_FACTOR 256
@@ -138,6 +143,13 @@ E const char *user_get_umodestr(user_t *u);
 E bool user_is_channel_banned(user_t *u, char ban_type);
 E void user_show_all_logins(myuser_t *mu, user_t *source, user_t *target);
 
+/* burst.c */
+E void init_burst(void);
+E bool burst_is_deferring(server_t *s);
+E void burst_user_add(hook_user_nick_t *hdata);
+E void burst_channel_join(hook_channel_joinpart_t *hdata);
+E void burst_cancel(mowgli_node_t **burstnode);
+
 /* uid.c */
 E void init_uid(void);
 E const char *uid_get(void);
@@ -0,0 +1,57 @@
+/*
+ * ChatServices: A collection of minimalist IRC services
+ * watchdog.h: Event loop stall detection.
+ *
+ * Copyright (c) 2018 ChatLounge IRC Network Development Team
+ *     (http://www.chatlounge.net)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ATHEME_WATCHDOG_H
+#define ATHEME_WATCHDOG_H
+
+/*
+ * What the main thread is running right now.  Each field is set around
+ * the call it describes and restored afterwards, so nested commands and
+ * hooks unwind correctly.  Only the main thread uses this; call
+ * watchdog_publish() after a change to pass copies of the names on to
+ * the watchdog thread.
+ */
+typedef struct {
+	command_stats_t *command;
+	hook_t *hook;
+	const char *hook_owner;
+} loop_activity_t;
+
+E loop_activity_t loop_activity;
+
+/* event loop iterations which took longer than general::stall_threshold */
+E histogram_t loop_stalls;
+
+E void watchdog_init(void);
+E void watchdog_publish(void);
+E void watchdog_loop_start(void);
+E void watchdog_loop_end(void);
+
+#endif
+
+/* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
+ * vim:ts=8
+ * vim:sw=8
+ * vim:noexpandtab
+ */
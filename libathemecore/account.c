@@ -36,12 +36,17 @@ mowgli_patricia_t *oldnameslist;
 mowgli_patricia_t *mclist;
 mowgli_patricia_t *certfplist;
 
-mowgli_heap_t *myuser_heap;   /* HEAP_USER */
-mowgli_heap_t *mynick_heap;   /* HEAP_USER */
-mowgli_heap_t *mycertfp_heap; /* HEAP_USER */
-mowgli_heap_t *myuser_name_heap;	/* HEAP_USER / 2 */
-mowgli_heap_t *mychan_heap;	/* HEAP_CHANNEL */
-mowgli_heap_t *chanacs_heap;	/* HEAP_CHANACS */
+/* secondary indexes over accounts, for LIST style queries */
+static skiplist_t *myuser_registered_index;
+static skiplist_t *myuser_lastlogin_index;
+static skiplist_t *myuser_email_index;
+
+sharedheap_t *myuser_heap;   /* HEAP_USER */
+sharedheap_t *mynick_heap;   /* HEAP_USER */
+sharedheap_t *mycertfp_heap; /* HEAP_USER */
+sharedheap_t *myuser_name_heap;	/* HEAP_USER / 2 */
+sharedheap_t *mychan_heap;	/* HEAP_CHANNEL */
+sharedheap_t *chanacs_heap;	/* HEAP_CHANACS */
 
 void (*notify_channel_successor_change)(myuser_t *smu, myuser_t *tmu, mychan_t *mc) = NULL;
 
@@ -51,6 +56,199 @@ typedef struct {
 	unsigned int level;
 } template_iter_t;
 
+static int myuser_index_time_cmp(const void *key1, const void *key2)
+{
+	time_t t1 = *(const time_t *)key1, t2 = *(const time_t *)key2;
+
+	return t1 < t2 ? -1 : t1 > t2;
+}
+
+static int myuser_index_email_cmp(const void *key1, const void *key2)
+{
+	return strcmp(*(char *const *)key1, *(char *const *)key2);
+}
+
+/* the email address reversed and folded the way match() folds */
+static char *myuser_index_email_key(const char *email, size_t len)
+{
+	char *key;
+	size_t i;
+
+	key = smalloc(len + 1);
+	for (i = 0; i < len; i++)
+		key[i] = ToLower((unsigned char)email[len - 1 - i]);
+	key[len] = '\0';
+
+	return key;
+}
+
+static void myuser_index_email(myuser_t *mu)
+{
+	char *key;
+
+	if (mu->email_node != NULL)
+	{
+		/* the skiplist compares keys while unlinking, so free it after */
+		key = *(char **)mu->email_node->key;
+		skiplist_delete(myuser_email_index, mu->email_node);
+		mu->email_node = NULL;
+		free(key);
+	}
+
+	if (mu->email != NULL)
+	{
+		key = myuser_index_email_key(mu->email, strlen(mu->email));
+		mu->email_node = skiplist_insert(myuser_email_index, &key, mu);
+	}
+}
+
+static void myuser_index_time(skiplist_t *sl, skiplist_node_t **node, myuser_t *mu, time_t ts)
+{
+	if (*node != NULL)
+	{
+		if (*(time_t *)(*node)->key == ts)
+			return;
+
+		skiplist_delete(sl, *node);
+	}
+
+	*node = skiplist_insert(sl, &ts, mu);
+}
+
+/*
+ * myuser_index_update(myuser_t *mu)
+ *
+ * Refiles an account in the registration and last login time indexes.
+ * This must be called after changing mu->registered; changes to
+ * mu->lastlogin are picked up by the next lookup if it is not called.
+ */
+void myuser_index_update(myuser_t *mu)
+{
+	return_if_fail(mu != NULL);
+
+	myuser_index_time(myuser_registered_index, &mu->registered_node, mu, mu->registered);
+	myuser_index_time(myuser_lastlogin_index, &mu->lastlogin_node, mu, mu->lastlogin);
+}
+
+static void myuser_index_delete(myuser_t *mu)
+{
+	char *key;
+
+	if (mu->registered_node != NULL)
+		skiplist_delete(myuser_registered_index, mu->registered_node);
+	if (mu->lastlogin_node != NULL)
+		skiplist_delete(myuser_lastlogin_index, mu->lastlogin_node);
+	if (mu->email_node != NULL)
+	{
+		key = *(char **)mu->email_node->key;
+		skiplist_delete(myuser_email_index, mu->email_node);
+		free(key);
+	}
+
+	mu->registered_node = mu->lastlogin_node = mu->email_node = NULL;
+}
+
+/*
+ * myuser_foreach_registered_before(time_t ts, void (*cb)(myuser_t *mu, void *privdata), void *privdata)
+ *
+ * Calls cb, in registration order, for every account registered
+ * before the given time.  cb must not add or remove accounts.
+ */
+void myuser_foreach_registered_before(time_t ts, void (*cb)(myuser_t *mu, void *privdata), void *privdata)
+{
+	skiplist_node_t *n;
+
+	SKIPLIST_FOREACH(n, myuser_registered_index)
+	{
+		if (*(time_t *)n->key >= ts)
+			break;
+
+		cb(n->data, privdata);
+	}
+}
+
+/*
+ * myuser_foreach_lastlogin_before(time_t ts, void (*cb)(myuser_t *mu, void *privdata), void *privdata)
+ *
+ * Calls cb for every account which last logged in before the given
+ * time.  cb must not add or remove accounts.
+ *
+ * mu->lastlogin is set directly in many places and only ever moves
+ * forward, so an account is always filed at or before its real last
+ * login time.  Accounts found to be filed too early are refiled once
+ * the walk is done.
+ */
+void myuser_foreach_lastlogin_before(time_t ts, void (*cb)(myuser_t *mu, void *privdata), void *privdata)
+{
+	skiplist_node_t *n;
+	mowgli_list_t stale = { NULL, NULL, 0 };
+	mowgli_node_t *sn, *tn;
+	myuser_t *mu;
+
+	SKIPLIST_FOREACH(n, myuser_lastlogin_index)
+	{
+		if (*(time_t *)n->key >= ts)
+			break;
+
+		mu = n->data;
+
+		if (mu->lastlogin != *(time_t *)n->key)
+			mowgli_node_add(mu, mowgli_node_create(), &stale);
+
+		if (mu->lastlogin < ts)
+			cb(mu, privdata);
+	}
+
+	MOWGLI_ITER_FOREACH_SAFE(sn, tn, stale.head)
+	{
+		mu = sn->data;
+		myuser_index_time(myuser_lastlogin_index, &mu->lastlogin_node, mu, mu->lastlogin);
+		mowgli_node_delete(sn, &stale);
+		mowgli_node_free(sn);
+	}
+}
+
+/*
+ * myuser_foreach_email_match(const char *mask, void (*cb)(myuser_t *mu, void *privdata), void *privdata)
+ *
+ * Calls cb for every account whose email address ends with the literal
+ * tail of the given match() mask, such as "@example.com" for
+ * "*@example.com".  The addresses still need to be checked with match().
+ * cb must not add, remove or change the email of accounts.
+ *
+ * Returns false without calling cb if the mask ends in a wildcard.
+ */
+bool myuser_foreach_email_match(const char *mask, void (*cb)(myuser_t *mu, void *privdata), void *privdata)
+{
+	skiplist_node_t *n;
+	const char *p;
+	char *prefix;
+	size_t len;
+
+	return_val_if_fail(mask != NULL, false);
+
+	for (p = mask + strlen(mask); p > mask; p--)
+		if (strchr("*?&#%\\", p[-1]) != NULL)
+			break;
+
+	if ((len = strlen(p)) == 0)
+		return false;
+
+	prefix = myuser_index_email_key(p, len);
+
+	for (n = skiplist_seek(myuser_email_index, &prefix); n != NULL; n = n->next[0])
+	{
+		if (strncmp(*(char **)n->key, prefix, len))
+			break;
+
+		cb(n->data, privdata);
+	}
+
+	free(prefix);
+
+	return true;
+}
+
 /*
  * init_accounts()
  *
@@ -67,12 +265,12 @@ typedef struct {
  */
 void init_accounts(void)
 {
-	myuser_heap = sharedheap_get(sizeof(myuser_t));
-	mynick_heap = sharedheap_get(sizeof(myuser_t));
-	myuser_name_heap = sharedheap_get(sizeof(myuser_name_t));
-	mychan_heap = sharedheap_get(sizeof(mychan_t));
-	chanacs_heap = sharedheap_get(sizeof(chanacs_t));
-	mycertfp_heap = sharedheap_get(sizeof(mycertfp_t));
+	myuser_heap = sharedheap_get_named(sizeof(myuser_t), "myuser_t");
+	mynick_heap = sharedheap_get_named(sizeof(mynick_t), "mynick_t");
+	myuser_name_heap = sharedheap_get_named(sizeof(myuser_name_t), "myuser_name_t");
+	mychan_heap = sharedheap_get_named(sizeof(mychan_t), "mychan_t");
+	chanacs_heap = sharedheap_get_named(sizeof(chanacs_t), "chanacs_t");
+	mycertfp_heap = sharedheap_get_named(sizeof(mycertfp_t), "mycertfp_t");
 
 	if (myuser_heap == NULL || mynick_heap == NULL || mychan_heap == NULL
 			|| chanacs_heap == NULL || mycertfp_heap == NULL)
@@ -86,6 +284,10 @@ void init_accounts(void)
 	oldnameslist = mowgli_patricia_create(irccasecanon);
 	mclist = mowgli_patricia_create(irccasecanon);
 	certfplist = mowgli_patricia_create(strcasecanon);
+
+	myuser_registered_index = skiplist_create(sizeof(time_t), myuser_index_time_cmp);
+	myuser_lastlogin_index = skiplist_create(sizeof(time_t), myuser_index_time_cmp);
+	myuser_email_index = skiplist_create(sizeof(char *), myuser_index_email_cmp);
 }
 
 /*
@@ -134,7 +336,7 @@ myuser_t *myuser_add_id(const char *id, const char *name, const char *pass, cons
 	if (!(runflags & RF_STARTING))
 		slog(LG_DEBUG, "myuser_add(): %s -> %s", name, email);
 
-	mu = mowgli_heap_alloc(myuser_heap);
+	mu = sharedheap_alloc(myuser_heap);
 	object_init(object(mu), name, (destructor_t) myuser_delete);
 
 	entity(mu)->type = ENT_USER;
@@ -152,6 +354,8 @@ myuser_t *myuser_add_id(const char *id, const char *name, const char *pass, cons
 		entity(mu)->id[0] = '\0';
 
 	mu->registered = CURRTIME;
+	myuser_index_update(mu);
+	myuser_index_email(mu);
 	mu->flags = flags;
 	if (mu->flags & MU_ENFORCE)
 	{
@@ -306,6 +510,7 @@ void myuser_delete(myuser_t *mu)
 
 		mowgli_node_delete(n, &mu->memos);
 		mowgli_node_free(n);
+		strshare_unref(memo->text);
 		free(memo);
 	}
 
@@ -349,11 +554,13 @@ void myuser_delete(myuser_t *mu)
 	/* entity(mu)->name is the index for this dtree */
 	myentity_del(entity(mu));
 
+	myuser_index_delete(mu);
+
 	strshare_unref(mu->email);
 	strshare_unref(mu->email_canonical);
 	strshare_unref(entity(mu)->name);
 
-	mowgli_heap_free(myuser_heap, mu);
+	sharedheap_free(myuser_heap, mu);
 
 	cnt.myuser--;
 }
@@ -448,6 +655,8 @@ void myuser_set_email(myuser_t *mu, const char *newemail)
 
 	mu->email = strshare_get(newemail);
 	mu->email_canonical = canonicalize_email(newemail);
+
+	myuser_index_email(mu);
 }
 
 /*
@@ -714,7 +923,7 @@ mynick_t *mynick_add(myuser_t *mu, const char *name)
 	if (!(runflags & RF_STARTING))
 		slog(LG_DEBUG, "mynick_add(): %s -> %s", name, entity(mu)->name);
 
-	mn = mowgli_heap_alloc(mynick_heap);
+	mn = sharedheap_alloc(mynick_heap);
 	object_init(object(mn), name, (destructor_t) mynick_delete);
 
 	mowgli_strlcpy(mn->nick, name, NICKLEN);
@@ -757,7 +966,7 @@ void mynick_delete(mynick_t *mn)
 	mowgli_patricia_delete(nicklist, mn->nick);
 	mowgli_node_delete(&mn->node, &mn->owner->nicks);
 
-	mowgli_heap_free(mynick_heap, mn);
+	sharedheap_free(mynick_heap, mn);
 
 	cnt.mynick--;
 }
@@ -792,7 +1001,7 @@ myuser_name_t *myuser_name_add(const char *name)
 	if (!(runflags & RF_STARTING))
 		slog(LG_DEBUG, "myuser_name_add(): %s", name);
 
-	mun = mowgli_heap_alloc(myuser_name_heap);
+	mun = sharedheap_alloc(myuser_name_heap);
 	object_init(object(mun), name, (destructor_t) myuser_name_delete);
 
 	mowgli_strlcpy(mun->name, name, NICKLEN);
@@ -829,7 +1038,7 @@ static void myuser_name_delete(myuser_name_t *mun)
 
 	metadata_delete_all(mun);
 
-	mowgli_heap_free(myuser_name_heap, mun);
+	sharedheap_free(myuser_name_heap, mun);
 
 	cnt.myuser_name--;
 }
@@ -956,7 +1165,7 @@ mycertfp_t *mycertfp_add(myuser_t *mu, const char *certfp)
 	return_val_if_fail(mu != NULL, NULL);
 	return_val_if_fail(certfp != NULL, NULL);
 
-	mcfp = mowgli_heap_alloc(mycertfp_heap);
+	mcfp = sharedheap_alloc(mycertfp_heap);
 	mcfp->mu = mu;
 	mcfp->certfp = sstrdup(certfp);
 
@@ -976,7 +1185,7 @@ void mycertfp_delete(mycertfp_t *mcfp)
 	mowgli_patricia_delete(certfplist, mcfp->certfp);
 
 	free(mcfp->certfp);
-	mowgli_heap_free(mycertfp_heap, mcfp);
+	sharedheap_free(mycertfp_heap, mcfp);
 }
 
 mycertfp_t *mycertfp_find(const char *certfp)
@@ -986,6 +1195,24 @@ mycertfp_t *mycertfp_find(const char *certfp)
 	return mowgli_patricia_retrieve(certfplist, certfp);
 }
 
+/*
+ * mymemo_batch_new(void)
+ *
+ * Returns a new batch number, to be set on every copy of a memo sent to
+ * many accounts at once, so that a database backend can store their text
+ * once.
+ */
+unsigned int mymemo_batch_new(void)
+{
+	static unsigned int batch;
+
+	/* 0 means no batch */
+	if (++batch == 0)
+		++batch;
+
+	return batch;
+}
+
 /***************
  * M Y C H A N *
  ***************/
@@ -1009,11 +1236,13 @@ static void mychan_delete(mychan_t *mc)
 
 	metadata_delete_all(mc);
 
+	hook_call_mychan_delete(mc);
+
 	mowgli_patricia_delete(mclist, mc->name);
 
 	strshare_unref(mc->name);
 
-	mowgli_heap_free(mychan_heap, mc);
+	sharedheap_free(mychan_heap, mc);
 
 	cnt.mychan--;
 }
@@ -1028,7 +1257,7 @@ mychan_t *mychan_add(char *name)
 	if (!(runflags & RF_STARTING))
 		slog(LG_DEBUG, "mychan_add(): %s", name);
 
-	mc = mowgli_heap_alloc(mychan_heap);
+	mc = sharedheap_alloc(mychan_heap);
 
 	object_init(object(mc), name, (destructor_t) mychan_delete);
 	mc->name = strshare_get(name);
@@ -1042,6 +1271,8 @@ mychan_t *mychan_add(char *name)
 
 	cnt.mychan++;
 
+	hook_call_mychan_add(mc);
+
 	return mc;
 }
 
@@ -1416,7 +1647,7 @@ static void chanacs_delete(chanacs_t *ca)
 	if (ca->host != NULL)
 		free(ca->host);
 
-	mowgli_heap_free(chanacs_heap, ca);
+	sharedheap_free(chanacs_heap, ca);
 
 	cnt.chanacs--;
 }
@@ -1453,7 +1684,7 @@ chanacs_t *chanacs_add(mychan_t *mychan, myentity_t *mt, unsigned int level, tim
 	if (!(runflags & RF_STARTING))
 		slog(LG_DEBUG, "chanacs_add(): %s -> %s", mychan->name, mt->name);
 
-	ca = mowgli_heap_alloc(chanacs_heap);
+	ca = sharedheap_alloc(chanacs_heap);
 
 	object_init(object(ca), mt->name, (destructor_t) chanacs_delete);
 	ca->mychan = mychan;
@@ -1507,7 +1738,7 @@ chanacs_t *chanacs_add_host(mychan_t *mychan, const char *host, unsigned int lev
 	if (!(runflags & RF_STARTING))
 		slog(LG_DEBUG, "chanacs_add_host(): %s -> %s", mychan->name, host);
 
-	ca = mowgli_heap_alloc(chanacs_heap);
+	ca = sharedheap_alloc(chanacs_heap);
 
 	object_init(object(ca), host, (destructor_t) chanacs_delete);
 	ca->mychan = mychan;
@@ -2255,6 +2486,9 @@ static int check_myuser_cb(myentity_t *mt, void *unused)
 		}
 	}
 
+	/* the database loaders set the times directly */
+	myuser_index_update(mu);
+
 	return 0;
 }
 
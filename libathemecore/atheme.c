@@ -240,6 +240,7 @@ void atheme_setup(void)
 	init_confprocess();
 	init_newconf();
 	servtree_init();
+	commandtree_init();
 
 	register_email_canonicalizer(canonicalize_email_case, NULL);
 
@@ -437,6 +438,12 @@ int atheme_main(int argc, char *argv[])
 	/* check authcookie expires every ten minutes */
 	mowgli_timer_add(base_eventloop, "authcookie_expire", authcookie_expire, NULL, 600);
 
+	/* pick up email left over from the last run */
+	mailqueue_init();
+
+	/* watch for a stuck event loop */
+	watchdog_init();
+
 	me.connected = false;
 	uplink_connect();
 
@@ -26,6 +26,7 @@
 
 bool auth_module_loaded = false;
 bool (*auth_user_custom)(myuser_t *mu, const char *password);
+void (*auth_user_custom_async)(myuser_t *mu, const char *password, verify_password_cb_t cb, void *privdata);
 
 void set_password(myuser_t *mu, const char *newpassword)
 {
@@ -95,3 +96,25 @@ bool verify_password(myuser_t *mu, const char *password)
 		return (strcmp(mu->pass, password) == 0);
 }
 
+/*
+ * verify_password_async(myuser_t *mu, const char *password, verify_password_cb_t cb, void *privdata)
+ *
+ * Like verify_password(), but lets an auth module which talks to a remote
+ * server answer later instead of blocking.  The callback may run before
+ * this returns.  By the time it runs, the account may have been dropped and
+ * the requesting user may be gone, which the caller has to check for.
+ * Modules implementing auth_user_custom_async copy the password and hold a
+ * reference to mu until the callback has returned.
+ */
+void verify_password_async(myuser_t *mu, const char *password, verify_password_cb_t cb, void *privdata)
+{
+	return_if_fail(cb != NULL);
+
+	if (mu != NULL && password != NULL && auth_module_loaded && auth_user_custom_async)
+	{
+		auth_user_custom_async(mu, password, cb, privdata);
+		return;
+	}
+
+	cb(mu, verify_password(mu, password), privdata);
+}
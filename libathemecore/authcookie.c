@@ -26,11 +26,11 @@
 #include "authcookie.h"
 
 mowgli_list_t authcookie_list;
-mowgli_heap_t *authcookie_heap;
+sharedheap_t *authcookie_heap;
 
 void authcookie_init(void)
 {
-	authcookie_heap = sharedheap_get(sizeof(authcookie_t));
+	authcookie_heap = sharedheap_get_named(sizeof(authcookie_t), "authcookie_t");
 
 	if (!authcookie_heap)
 	{
@@ -53,7 +53,7 @@ void authcookie_init(void)
  */
 authcookie_t *authcookie_create(myuser_t *mu)
 {
-	authcookie_t *au = mowgli_heap_alloc(authcookie_heap);
+	authcookie_t *au = sharedheap_alloc(authcookie_heap);
 
 	au->ticket = random_string(192);
 	au->myuser = mu;
@@ -137,7 +137,7 @@ void authcookie_destroy(authcookie_t * ac)
 
 	mowgli_node_delete(&ac->node, &authcookie_list);
 	free(ac->ticket);
-	mowgli_heap_free(authcookie_heap, ac);
+	sharedheap_free(authcookie_heap, ac);
 }
 
 /*
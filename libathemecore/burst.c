@@ -0,0 +1,222 @@
+/*
+ * ChatServices: A collection of minimalist IRC services
+ * burst.c: Deferred hook processing for clients introduced during a burst.
+ *
+ * Copyright (c) 2018 ChatLounge IRC Network Development Team
+ *     (http://www.chatlounge.net)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * While the uplink is bursting, user_add() and chanuser_add() only run
+ * the handlers which were not registered as deferrable.  The new objects
+ * are put on a FIFO queue instead, and the deferrable handlers are run
+ * once the burst has finished, a time slice at a time, so that the
+ * uplink's socket is read without interruption by DNSBL lookups, clone
+ * checks and the like.
+ *
+ * Queue entries are cancelled by user_delete() and chanuser_delete(), so
+ * a deferred handler never sees an object which no longer exists.
+ */
+
+#include "atheme.h"
+
+/* how long a single drain may run before yielding to the event loop */
+#define BURST_DRAIN_SLICE_MS	50
+
+/* how often to check the time while draining */
+#define BURST_DRAIN_BATCH	64
+
+/* without a usable clock, run this many entries per drain */
+#define BURST_DRAIN_MAX		4096
+
+typedef enum {
+	BURST_USER_ADD,
+	BURST_CHANNEL_JOIN,
+} burst_type_t;
+
+typedef struct {
+	burst_type_t type;
+	union {
+		user_t *u;
+		chanuser_t *cu;
+	} obj;
+	mowgli_node_t node;
+} burst_entry_t;
+
+static sharedheap_t *burst_heap;
+static mowgli_list_t burst_queue;
+static mowgli_eventloop_timer_t *burst_drain_timer;
+
+static void burst_drain(void *unused);
+
+void init_burst(void)
+{
+	burst_heap = sharedheap_get_named(sizeof(burst_entry_t), "burst_entry_t");
+
+	if (burst_heap == NULL)
+	{
+		slog(LG_ERROR, "init_burst(): block allocator failure.");
+		exit(EXIT_FAILURE);
+	}
+}
+
+/*
+ * burst_is_deferring(server_t *s)
+ *
+ * Returns true if deferrable hooks for clients on the given server
+ * should be postponed.  Our own clients are never deferred.
+ */
+bool burst_is_deferring(server_t *s)
+{
+	return config_options.burst_defer_hooks && me.bursting && s != me.me;
+}
+
+static void burst_schedule(unsigned int delay)
+{
+	if (burst_drain_timer != NULL)
+		return;
+
+	burst_drain_timer = mowgli_timer_add_once(base_eventloop, "burst_drain", burst_drain, NULL, delay);
+}
+
+static void burst_enqueue(burst_type_t type, void *obj, mowgli_node_t **burstnode)
+{
+	burst_entry_t *e;
+
+	e = sharedheap_alloc(burst_heap);
+	e->type = type;
+	if (type == BURST_USER_ADD)
+		e->obj.u = obj;
+	else
+		e->obj.cu = obj;
+
+	mowgli_node_add(e, &e->node, &burst_queue);
+	*burstnode = &e->node;
+
+	burst_schedule(1);
+}
+
+void burst_user_add(hook_user_nick_t *hdata)
+{
+	if (hook_call_event_nondeferred("user_add", hdata) && hdata->u != NULL)
+		burst_enqueue(BURST_USER_ADD, hdata->u, &hdata->u->burstnode);
+}
+
+void burst_channel_join(hook_channel_joinpart_t *hdata)
+{
+	if (hook_call_event_nondeferred("channel_join", hdata) && hdata->cu != NULL)
+		burst_enqueue(BURST_CHANNEL_JOIN, hdata->cu, &hdata->cu->burstnode);
+}
+
+/*
+ * burst_cancel(mowgli_node_t **burstnode)
+ *
+ * Drops a pending queue entry; called when the object it refers to is
+ * about to be destroyed.
+ */
+void burst_cancel(mowgli_node_t **burstnode)
+{
+	burst_entry_t *e;
+
+	if (*burstnode == NULL)
+		return;
+
+	e = (*burstnode)->data;
+	mowgli_node_delete(&e->node, &burst_queue);
+	sharedheap_free(burst_heap, e);
+
+	*burstnode = NULL;
+}
+
+static void burst_run_entry(burst_entry_t *e)
+{
+	hook_user_nick_t udata;
+	hook_channel_joinpart_t jdata;
+
+	switch (e->type)
+	{
+	case BURST_USER_ADD:
+		e->obj.u->burstnode = NULL;
+		udata.u = e->obj.u;
+		udata.oldnick = NULL;
+		hook_call_event_deferred("user_add", &udata);
+		break;
+	case BURST_CHANNEL_JOIN:
+		e->obj.cu->burstnode = NULL;
+		jdata.cu = e->obj.cu;
+		hook_call_event_deferred("channel_join", &jdata);
+		break;
+	}
+}
+
+static void burst_drain(void *unused)
+{
+	mowgli_node_t *n;
+	burst_entry_t *e;
+#ifdef HAVE_GETTIMEOFDAY
+	struct timeval start, elapsed;
+#endif
+	unsigned int count = 0;
+
+	burst_drain_timer = NULL;
+
+	/* wait for the end of the burst */
+	if (me.bursting)
+	{
+		burst_schedule(1);
+		return;
+	}
+
+#ifdef HAVE_GETTIMEOFDAY
+	s_time(&start);
+#endif
+
+	/* handlers may cancel other entries, so always take the head */
+	while ((n = burst_queue.head) != NULL)
+	{
+		e = n->data;
+		mowgli_node_delete(&e->node, &burst_queue);
+
+		burst_run_entry(e);
+		sharedheap_free(burst_heap, e);
+
+		if (++count % BURST_DRAIN_BATCH == 0)
+		{
+#ifdef HAVE_GETTIMEOFDAY
+			e_time(start, &elapsed);
+			if (tv2ms(&elapsed) >= BURST_DRAIN_SLICE_MS)
+				break;
+#else
+			if (count >= BURST_DRAIN_MAX)
+				break;
+#endif
+		}
+	}
+
+	slog(LG_DEBUG, "burst_drain(): ran %u deferred hook calls, %zu remaining", count, MOWGLI_LIST_LENGTH(&burst_queue));
+
+	if (MOWGLI_LIST_LENGTH(&burst_queue) > 0)
+		burst_schedule(0);
+}
+
+/* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
+ * vim:ts=8
+ * vim:sw=8
+ * vim:noexpandtab
+ */
@@ -26,9 +26,9 @@
 
 mowgli_patricia_t *chanlist;
 
-mowgli_heap_t *chan_heap;
-mowgli_heap_t *chanuser_heap;
-mowgli_heap_t *chanban_heap;
+sharedheap_t *chan_heap;
+sharedheap_t *chanuser_heap;
+sharedheap_t *chanban_heap;
 
 /*
  * init_channels()
@@ -46,9 +46,9 @@ mowgli_heap_t *chanban_heap;
  */
 void init_channels(void)
 {
-	chan_heap = sharedheap_get(sizeof(channel_t));
-	chanuser_heap = sharedheap_get(sizeof(chanuser_t));
-	chanban_heap = sharedheap_get(sizeof(chanban_t));
+	chan_heap = sharedheap_get_named(sizeof(channel_t), "channel_t");
+	chanuser_heap = sharedheap_get_named(sizeof(chanuser_t), "chanuser_t");
+	chanban_heap = sharedheap_get_named(sizeof(chanban_t), "chanban_t");
 
 	if (chan_heap == NULL || chanuser_heap == NULL || chanban_heap == NULL)
 	{
@@ -102,7 +102,7 @@ channel_t *channel_add(const char *name, time_t ts, server_t *creator)
 
 	slog(LG_DEBUG, "channel_add(): %s by %s", name, creator->name);
 
-	c = mowgli_heap_alloc(chan_heap);
+	c = sharedheap_alloc(chan_heap);
 
 	c->name = sstrdup(name);
 	c->ts = ts;
@@ -171,7 +171,7 @@ void channel_delete(channel_t *c)
 		soft_assert(is_internal_client(cu->user) && !me.connected);
 		mowgli_node_delete(&cu->cnode, &c->members);
 		mowgli_node_delete(&cu->unode, &cu->user->channels);
-		mowgli_heap_free(chanuser_heap, cu);
+		sharedheap_free(chanuser_heap, cu);
 		cnt.chanuser--;
 	}
 	c->nummembers = 0;
@@ -196,7 +196,7 @@ void channel_delete(channel_t *c)
 	if (c->topic_setter != NULL)
 		free(c->topic_setter);
 
-	mowgli_heap_free(chan_heap, c);
+	sharedheap_free(chan_heap, c);
 
 	cnt.chan--;
 }
@@ -242,7 +242,7 @@ chanban_t *chanban_add(channel_t *chan, const char *mask, int type)
 
 	slog(LG_DEBUG, "chanban_add(): %s +%c %s", chan->name, type, mask);
 
-	c = mowgli_heap_alloc(chanban_heap);
+	c = sharedheap_alloc(chanban_heap);
 
 	c->chan = chan;
 	c->mask = sstrdup(mask);
@@ -274,7 +274,7 @@ void chanban_delete(chanban_t * c)
 	mowgli_node_delete(&c->node, &c->chan->bans);
 
 	free(c->mask);
-	mowgli_heap_free(chanban_heap, c);
+	sharedheap_free(chanban_heap, c);
 }
 
 /*
@@ -395,7 +395,7 @@ chanuser_t *chanuser_add(channel_t *chan, const char *nick)
 
 	slog(LG_DEBUG, "chanuser_add(): %s -> %s", chan->name, u->nick);
 
-	cu = mowgli_heap_alloc(chanuser_heap);
+	cu = sharedheap_alloc(chanuser_heap);
 
 	cu->chan = chan;
 	cu->user = u;
@@ -411,7 +411,10 @@ chanuser_t *chanuser_add(channel_t *chan, const char *nick)
 	cnt.chanuser++;
 
 	hdata.cu = cu;
-	hook_call_channel_join(&hdata);
+	if (burst_is_deferring(u->server))
+		burst_channel_join(&hdata);
+	else
+		hook_call_channel_join(&hdata);
 
 	/* Return NULL if a hook function kicked the user out */
 	return hdata.cu;
@@ -453,12 +456,14 @@ void chanuser_delete(channel_t *chan, user_t *user)
 	hdata.cu = cu;
 	hook_call_channel_part(&hdata);
 
+	burst_cancel(&cu->burstnode);
+
 	slog(LG_DEBUG, "chanuser_delete(): %s -> %s (%d)", cu->chan->name, cu->user->nick, cu->chan->nummembers - 1);
 
 	mowgli_node_delete(&cu->cnode, &chan->members);
 	mowgli_node_delete(&cu->unode, &user->channels);
 
-	mowgli_heap_free(chanuser_heap, cu);
+	sharedheap_free(chanuser_heap, cu);
 
 	chan->nummembers--;
 	cnt.chanuser--;
@@ -24,13 +24,59 @@
 #include "atheme.h"
 #include "privs.h"
 
+mowgli_patricia_t *command_stats;
+
 static int text_to_parv(char *text, int maxparc, char **parv);
 
+void commandtree_init(void)
+{
+	command_stats = mowgli_patricia_create(strcasecanon);
+}
+
+/*
+ * Subcommands, such as NickServ SET EMAIL, are named after their parent.
+ * The entry is cached on the command, so the lookup is only done again
+ * when the command runs under another service or parent, e.g. a command
+ * bound to both GameServ and ChanServ.
+ */
+static command_stats_t *command_stats_get(service_t *svs, command_t *parent, command_t *c)
+{
+	char name[BUFSIZE], key[BUFSIZE];
+	command_stats_t *cs;
+
+	if (c->stats != NULL && c->stats_svs == svs && c->stats_parent == parent)
+		return c->stats;
+
+	c->stats_svs = svs;
+	c->stats_parent = parent;
+
+	if (parent != NULL && parent != c)
+		snprintf(name, sizeof name, "%s %s", parent->name, c->name);
+	else
+		mowgli_strlcpy(name, c->name, sizeof name);
+
+	snprintf(key, sizeof key, "%s %s", svs->internal_name, name);
+
+	if ((cs = mowgli_patricia_retrieve(command_stats, key)) == NULL)
+	{
+		cs = smalloc(sizeof *cs);
+		cs->service = sstrdup(svs->internal_name);
+		cs->name = sstrdup(name);
+		mowgli_patricia_add(command_stats, key, cs);
+	}
+
+	return c->stats = cs;
+}
+
 void command_add(command_t *cmd, mowgli_patricia_t *commandtree)
 {
 	return_if_fail(cmd != NULL);
 	return_if_fail(commandtree != NULL);
 
+	/* the service or parent it was cached for may be gone and its
+	 * memory reused by a new one */
+	cmd->stats = NULL;
+
 	mowgli_patricia_add(commandtree, cmd->name, cmd);
 }
 
@@ -102,11 +148,34 @@ void command_exec(service_t *svs, sourceinfo_t *si, command_t *c, int parc, char
 
 	if (command_verify(svs, si, c, cmdaccess))
 	{
+		command_stats_t *cs, *prevcs;
+		uint64_t start;
+		unsigned int elapsed;
+
 		if (si->force_language != NULL)
 			language_set_active(si->force_language);
 
+		/* looked up first: the command may unload its own module */
+		cs = command_stats_get(svs, si->command, c);
+
 		si->command = c;
+		svs->commands_run++;
+
+		prevcs = loop_activity.command;
+		loop_activity.command = cs;
+		watchdog_publish();
+
+		start = mono_usec();
 		c->cmd(si, parc, parv);
+		elapsed = mono_usec() - start;
+
+		loop_activity.command = prevcs;
+		watchdog_publish();
+
+		histogram_add(&cs->latency, elapsed);
+		if (config_options.command_latency_log != 0 && elapsed / 1000 >= config_options.command_latency_log)
+			slog(LG_INFO, "command_exec(): %s %s took %u ms", cs->service, cs->name, elapsed / 1000);
+
 		language_set_active(NULL);
 		return;
 	}
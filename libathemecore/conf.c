@@ -213,6 +213,7 @@ void init_newconf(void)
 	add_dupstr_conf_item("ADMINEMAIL", &conf_si_table, 0, &me.adminemail, NULL);
 	add_dupstr_conf_item("REGISTEREMAIL", &conf_si_table, 0, &me.register_email, NULL);
 	add_dupstr_conf_item("MTA", &conf_si_table, 0, &me.mta, NULL);
+	add_bool_conf_item("MTA_SMTP", &conf_si_table, 0, &me.mta_smtp, false);
 	add_conf_item("LOGLEVEL", &conf_si_table, c_si_loglevel);
 	add_uint_conf_item("MAXLOGINS", &conf_si_table, 0, &me.maxlogins, 3, INT_MAX, 5);
 	add_uint_conf_item("MAXUSERS", &conf_si_table, 0, &me.maxusers, 0, INT_MAX, 0);
@@ -257,6 +258,10 @@ void init_newconf(void)
 	add_conf_item("EXEMPTS", &conf_gi_table, c_gi_exempts);
 	add_conf_item("IMMUNE_LEVEL", &conf_gi_table, c_gi_immune_level);
 	add_bool_conf_item("SEND_SASL_QUIT", &conf_gi_table, 0, &config_options.send_sasl_quit, false);
+	add_bool_conf_item("BURST_DEFER_HOOKS", &conf_gi_table, 0, &config_options.burst_defer_hooks, false);
+	add_uint_conf_item("COMMAND_LATENCY_LOG", &conf_gi_table, 0, &config_options.command_latency_log, 0, INT_MAX, 0);
+	add_uint_conf_item("STALL_THRESHOLD", &conf_gi_table, 0, &config_options.stall_threshold, 0, 3600, 0);
+	add_dupstr_conf_item("UPLINK_CAPTURE", &conf_gi_table, 0, &config_options.uplink_capture, NULL);
 
 	/* language:: stuff */
 	add_dupstr_conf_item("NAME", &conf_la_table, 0, &me.language_name, NULL);
@@ -825,6 +830,7 @@ static void copy_me(struct me *src, struct me *dst)
 	dst->adminemail = sstrdup(src->adminemail);
 	dst->register_email = sstrdup(src->register_email);
 	dst->mta = src->mta ? sstrdup(src->mta) : NULL;
+	dst->mta_smtp = src->mta_smtp;
 	dst->maxlogins = src->maxlogins;
 	dst->maxusers = src->maxusers;
 	dst->emaillimit = src->emaillimit;
@@ -72,7 +72,7 @@ struct ConfTable
 	mowgli_node_t node;
 };
 
-mowgli_heap_t *conftable_heap;
+sharedheap_t *conftable_heap;
 
 mowgli_list_t confblocks;
 bool conf_need_rehash;
@@ -437,7 +437,7 @@ void add_top_conf(const char *name, int (*handler) (mowgli_config_file_entry_t *
 		return;
 	}
 
-	ct = mowgli_heap_alloc(conftable_heap);
+	ct = sharedheap_alloc(conftable_heap);
 
 	ct->name = sstrdup(name);
 	ct->type = CONF_HANDLER;
@@ -461,7 +461,7 @@ void add_subblock_top_conf(const char *name, mowgli_list_t *list)
 		return;
 	}
 
-	ct = mowgli_heap_alloc(conftable_heap);
+	ct = sharedheap_alloc(conftable_heap);
 
 	ct->name = sstrdup(name);
 	ct->type = CONF_SUBBLOCK;
@@ -486,7 +486,7 @@ void add_conf_item(const char *name, mowgli_list_t *conflist, int (*handler) (mo
 		return;
 	}
 
-	ct = mowgli_heap_alloc(conftable_heap);
+	ct = sharedheap_alloc(conftable_heap);
 
 	ct->name = sstrdup(name);
 	ct->type = CONF_HANDLER;
@@ -507,7 +507,7 @@ void add_uint_conf_item(const char *name, mowgli_list_t *conflist, unsigned int
 		return;
 	}
 
-	ct = mowgli_heap_alloc(conftable_heap);
+	ct = sharedheap_alloc(conftable_heap);
 
 	ct->name = sstrdup(name);
 	ct->type = CONF_UINT;
@@ -531,7 +531,7 @@ void add_duration_conf_item(const char *name, mowgli_list_t *conflist, unsigned
 		return;
 	}
 
-	ct = mowgli_heap_alloc(conftable_heap);
+	ct = sharedheap_alloc(conftable_heap);
 
 	ct->name = sstrdup(name);
 	ct->type = CONF_DURATION;
@@ -554,7 +554,7 @@ void add_dupstr_conf_item(const char *name, mowgli_list_t *conflist, unsigned in
 		return;
 	}
 
-	ct = mowgli_heap_alloc(conftable_heap);
+	ct = sharedheap_alloc(conftable_heap);
 
 	ct->name = sstrdup(name);
 	ct->type = CONF_DUPSTR;
@@ -576,7 +576,7 @@ void add_bool_conf_item(const char *name, mowgli_list_t *conflist, unsigned int
 		return;
 	}
 
-	ct = mowgli_heap_alloc(conftable_heap);
+	ct = sharedheap_alloc(conftable_heap);
 
 	ct->name = sstrdup(name);
 	ct->type = CONF_BOOL;
@@ -604,7 +604,7 @@ void del_top_conf(const char *name)
 
 	free(ct->name);
 
-	mowgli_heap_free(conftable_heap, ct);
+	sharedheap_free(conftable_heap, ct);
 }
 
 void del_conf_item(const char *name, mowgli_list_t *conflist)
@@ -629,7 +629,7 @@ void del_conf_item(const char *name, mowgli_list_t *conflist)
 
 	free(ct->name);
 
-	mowgli_heap_free(conftable_heap, ct);
+	sharedheap_free(conftable_heap, ct);
 }
 
 conf_handler_t conftable_get_conf_handler(struct ConfTable *ct)
@@ -661,7 +661,7 @@ int token_to_value(struct Token token_table[], const char *token)
 
 void init_confprocess(void)
 {
-	conftable_heap = sharedheap_get(sizeof(struct ConfTable));
+	conftable_heap = sharedheap_get_named(sizeof(struct ConfTable), "ConfTable");
 
 	if (!conftable_heap)
 	{
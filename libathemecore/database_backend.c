@@ -9,6 +9,7 @@
 
 database_module_t *db_mod = NULL;
 mowgli_patricia_t *db_types = NULL;
+db_save_stats_t db_save_stats;
 
 database_handle_t *
 db_open(const char *filename, database_transaction_t txn)
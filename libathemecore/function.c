@@ -138,6 +138,43 @@ int tv2ms(struct timeval *tv)
 }
 #endif
 
+/* microseconds on a clock which is not stepped by time changes, if we have one */
+uint64_t mono_usec(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+		return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+#ifdef HAVE_GETTIMEOFDAY
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+#else
+	return (uint64_t)time(NULL) * 1000000;
+#endif
+}
+
+/* mono_usec() as a double, for timing code which computes with it */
+double mono_usec_double(void)
+{
+	return (double)mono_usec();
+}
+
+/* microseconds of CPU time used by the calling thread, or wall time */
+uint64_t cpu_usec(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_THREAD_CPUTIME_ID)
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+		return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+	return mono_usec();
+}
+
 /* replaces tabs with a single ASCII 32 */
 void tb2sp(char *line)
 {
@@ -738,18 +775,6 @@ bool has_ctrl_chars(const char *text)
 	return false;
 }
 
-#ifndef MOWGLI_OS_WIN
-static void sendemail_waited(pid_t pid, int status, void *data)
-{
-	char *email;
-
-	email = data;
-	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
-		slog(LG_INFO, "sendemail_waited(): email for %s failed", email);
-	free(email);
-}
-#endif
-
 /* send the specified type of email.
  *
  * u is whoever caused this to be called, the corresponding service
@@ -763,11 +788,10 @@ int sendemail(user_t *u, myuser_t *mu, const char *type, const char *email, cons
 #ifndef MOWGLI_OS_WIN
 	char *date = NULL;
 	char timebuf[BUFSIZE], to[BUFSIZE], from[BUFSIZE], buf[BUFSIZE], pathbuf[BUFSIZE], sourceinfo[BUFSIZE];
-	FILE *in, *out;
+	FILE *in;
+	mowgli_string_t *out;
 	time_t t;
 	struct tm tm;
-	int pipfds[2];
-	pid_t pid;
 	int rc;
 	static time_t period_start = 0, lastwallops = 0;
 	static unsigned int emailcount = 0;
@@ -845,26 +869,7 @@ int sendemail(user_t *u, myuser_t *mu, const char *type, const char *email, cons
 	snprintf(sourceinfo, sizeof sourceinfo, "%s[%s@%s]", u->nick, u->user, u->vhost);
 
 	/* now set up the email */
-	if (pipe(pipfds) < 0)
-	{
-		fclose(in);
-		return 0;
-	}
-	switch (pid = fork())
-	{
-		case -1:
-			fclose(in);
-			return 0;
-		case 0:
-			connection_close_all_fds();
-			close(pipfds[1]);
-			dup2(pipfds[0], 0);
-			execl(me.mta, me.mta, "-t", "-f", me.register_email, NULL);
-			_exit(255);
-	}
-	close(pipfds[0]);
-	childproc_add(pid, "email", sendemail_waited, sstrdup(email));
-	out = fdopen(pipfds[1], "w");
+	out = mowgli_string_create();
 
 	while (fgets(buf, BUFSIZE, in))
 	{
@@ -888,18 +893,18 @@ int sendemail(user_t *u, myuser_t *mu, const char *type, const char *email, cons
 		if ((svs = service_find("operserv")) != NULL)
 			replace(buf, sizeof buf, "&opersvs&", svs->me->nick);
 
-		fprintf(out, "%s\n", buf);
+		out->append(out, buf, strlen(buf));
+		out->append_char(out, '\n');
 	}
 
 	fclose(in);
 
-	rc = 1;
-	if (ferror(out))
-		rc = 0;
-	if (fclose(out) < 0)
-		rc = 0;
+	/* hand it to the mail queue, which takes care of delivery */
+	rc = mailqueue_submit(email, out->str) ? 1 : 0;
 	if (rc == 0)
-		slog(LG_ERROR, "sendemail(): mta failure");
+		slog(LG_ERROR, "sendemail(): cannot queue email for %s", email);
+
+	out->destroy(out);
 	return rc;
 #else
 # warning implement me :(
@@ -0,0 +1,116 @@
+/*
+ * ChatServices: A collection of minimalist IRC services
+ * histogram.c: Log-linear latency histograms.
+ *
+ * Copyright (c) 2018 ChatLounge IRC Network Development Team
+ *     (http://www.chatlounge.net)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "atheme.h"
+
+#define SUB		(1U << HISTOGRAM_SUBBITS)
+
+/* position of the highest set bit */
+static inline unsigned int histogram_log2(unsigned int value)
+{
+#ifdef __GNUC__
+	return 31 - __builtin_clz(value);
+#else
+	unsigned int e = 0;
+
+	while (value >>= 1)
+		e++;
+
+	return e;
+#endif
+}
+
+static inline unsigned int histogram_bucket(unsigned int value)
+{
+	unsigned int e;
+
+	if (value < SUB)
+		return value;
+
+	e = histogram_log2(value);
+	if (e > HISTOGRAM_MAXEXP)
+		return HISTOGRAM_BUCKETS - 1;
+
+	return ((e - HISTOGRAM_SUBBITS + 1) << HISTOGRAM_SUBBITS) + ((value >> (e - HISTOGRAM_SUBBITS)) & (SUB - 1));
+}
+
+void histogram_add(histogram_t *h, unsigned int value)
+{
+	h->buckets[histogram_bucket(value)]++;
+	h->count++;
+	h->total += value;
+	if (value > h->max)
+		h->max = value;
+}
+
+/* the largest value which falls in the given bucket */
+unsigned int histogram_bucket_upper(unsigned int bucket)
+{
+	unsigned int e, sub;
+
+	if (bucket < SUB)
+		return bucket;
+
+	e = (bucket >> HISTOGRAM_SUBBITS) + HISTOGRAM_SUBBITS - 1;
+	sub = bucket & (SUB - 1);
+
+	return ((SUB + sub + 1) << (e - HISTOGRAM_SUBBITS)) - 1;
+}
+
+/*
+ * histogram_percentile(const histogram_t *h, unsigned int pct)
+ *
+ * Returns the upper bound of the bucket holding the pct'th percentile,
+ * which overstates it by at most 1/8; never more than the largest value
+ * seen.
+ */
+unsigned int histogram_percentile(const histogram_t *h, unsigned int pct)
+{
+	unsigned long want, seen = 0;
+	unsigned int i, upper;
+
+	if (h->count == 0)
+		return 0;
+
+	want = (h->count * pct + 99) / 100;
+	if (want == 0)
+		want = 1;
+
+	for (i = 0; i < HISTOGRAM_BUCKETS; i++)
+	{
+		seen += h->buckets[i];
+		if (seen >= want)
+			break;
+	}
+
+	upper = histogram_bucket_upper(i);
+
+	return upper < h->max ? upper : h->max;
+}
+
+/* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
+ * vim:ts=8
+ * vim:sw=8
+ * vim:noexpandtab
+ */
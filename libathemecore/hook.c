@@ -26,30 +26,38 @@
 #include "internal.h"
 
 mowgli_patricia_t *hooks;
-static mowgli_heap_t *hook_heap, *hook_privfn_heap;
+static sharedheap_t *hook_heap, *hook_privfn_heap;
 
 typedef struct {
 	hook_t *hook;
 	void *dptr;
 	mowgli_node_t node;
 	unsigned int flags;
+	void *running;	/* handler being profiled, unless it was deleted */
 } hook_run_ctx_t;
 
 typedef struct {
 	hookfn_t hookfn;
 	mowgli_node_t node;
+	unsigned int flags;
+	hook_profile_t prof;
 } hook_privfn_ctx_t;
 
 #define HF_RUN		0x1
 #define HF_STOP		0x2
 
+/* handler flags */
+#define HPF_DEFERRABLE	0x1	/* may be run later, see burst.c */
+
 static mowgli_list_t hook_run_stack = { NULL, NULL, 0 };
 
+bool hook_profiling = false;
+
 void hooks_init(void)
 {
 	hooks = mowgli_patricia_create(strcasecanon);
-	hook_heap = sharedheap_get(sizeof(hook_t));
-	hook_privfn_heap = sharedheap_get(sizeof(hook_privfn_ctx_t));
+	hook_heap = sharedheap_get_named(sizeof(hook_t), "hook_t");
+	hook_privfn_heap = sharedheap_get_named(sizeof(hook_privfn_ctx_t), "hook_privfn_ctx_t");
 
 	if (hook_heap == NULL || hook_privfn_heap == NULL || hooks == NULL)
 	{
@@ -70,7 +78,7 @@ hook_t *hook_add_event(const char *name)
 	if((nh = hook_find(name)) != NULL)
 		return nh;
 
-	nh = mowgli_heap_alloc(hook_heap);
+	nh = sharedheap_alloc(hook_heap);
 	nh->name = strshare_get(name);
 
 	mowgli_patricia_add(hooks, nh->name, nh);
@@ -80,8 +88,26 @@ hook_t *hook_add_event(const char *name)
 
 static inline void hook_destroy(hook_t *hook, hook_privfn_ctx_t *priv)
 {
+	mowgli_node_t *n;
+
+	if (priv->flags & HPF_DEFERRABLE)
+		hook->deferrable--;
+
+	/* a handler may delete itself; don't profile it afterwards */
+	MOWGLI_ITER_FOREACH(n, hook_run_stack.head)
+	{
+		hook_run_ctx_t *ctx = n->data;
+
+		if (ctx->running == priv)
+			ctx->running = NULL;
+	}
+
+	if (loop_activity.hook_owner == priv->prof.owner)
+		loop_activity.hook_owner = NULL;
+	strshare_unref(priv->prof.owner);
+
 	mowgli_node_delete(&priv->node, &hook->hooks);
-	mowgli_heap_free(hook_privfn_heap, priv);
+	sharedheap_free(hook_privfn_heap, priv);
 }
 
 void hook_del_event(const char *name)
@@ -98,7 +124,7 @@ void hook_del_event(const char *name)
 	mowgli_patricia_delete(hooks, h->name);
 	strshare_unref(h->name);
 
-	mowgli_heap_free(hook_heap, h);
+	sharedheap_free(hook_heap, h);
 }
 
 void hook_del_hook(const char *event, hookfn_t handler)
@@ -131,8 +157,9 @@ static inline hook_privfn_ctx_t *hook_create_and_add(hook_t *hook, hookfn_t hand
 	return_val_if_fail(handler != NULL, NULL);
 	return_val_if_fail(addfn != NULL, NULL);
 
-	priv = mowgli_heap_alloc(hook_privfn_heap);
+	priv = sharedheap_alloc(hook_privfn_heap);
 	priv->hookfn = handler;
+	priv->prof.owner = strshare_get(modtarget != NULL ? modtarget->name : "core");
 
 	addfn(priv, &priv->node, &hook->hooks);
 
@@ -168,20 +195,64 @@ void hook_add_hook_first(const char *event, hookfn_t handler)
 	hook_create_and_add(h, handler, mowgli_node_add_head);
 }
 
-void hook_call_event(const char *event, void *dptr)
+/*
+ * hook_add_hook_deferrable()
+ *
+ * Like hook_add_hook(), but marks the handler as tolerating a delayed
+ * call.  While the uplink is bursting, the core may postpone deferrable
+ * handlers of user_add and channel_join and run them in batches once the
+ * burst is over.  Such handlers must not depend on me.bursting or on the
+ * order in which they run relative to other handlers of the same hook.
+ */
+void hook_add_hook_deferrable(const char *event, hookfn_t handler)
 {
-	hook_run_ctx_t ctx;
-	mowgli_node_t *n, *tn;
-	void (*func)(void *data);
+	hook_t *h;
+	hook_privfn_ctx_t *priv;
 
 	return_if_fail(event != NULL);
+	return_if_fail(handler != NULL);
 
-	ctx.hook = hook_find(event);
-	if (ctx.hook == NULL)
+	h = hook_find(event);
+	if (h == NULL)
+		h = hook_add_event(event);
+
+	priv = hook_create_and_add(h, handler, mowgli_node_add);
+	priv->flags |= HPF_DEFERRABLE;
+	h->deferrable++;
+}
+
+static void hook_call_profiled(hook_run_ctx_t *ctx, hook_privfn_ctx_t *priv)
+{
+	uint64_t start;
+	unsigned int elapsed;
+
+	ctx->running = priv;
+	start = cpu_usec();
+
+	priv->hookfn(ctx->dptr);
+
+	elapsed = cpu_usec() - start;
+	if (ctx->running == NULL)
 		return;
+	ctx->running = NULL;
+
+	priv->prof.calls++;
+	priv->prof.cpu += elapsed;
+	if (elapsed > priv->prof.max)
+		priv->prof.max = elapsed;
+}
 
+static void hook_call_handlers(hook_t *hook, void *dptr, unsigned int mask, unsigned int want)
+{
+	hook_run_ctx_t ctx;
+	mowgli_node_t *n, *tn;
+	hook_t *prevhook = loop_activity.hook;
+	const char *prevowner = loop_activity.hook_owner;
+
+	ctx.hook = hook;
 	ctx.dptr = dptr;
 	ctx.flags = HF_RUN;
+	ctx.running = NULL;
 
 	mowgli_node_add_head(&ctx, &ctx.node, &hook_run_stack);
 
@@ -189,15 +260,80 @@ void hook_call_event(const char *event, void *dptr)
 	{
 		hook_privfn_ctx_t *priv = n->data;
 
-		priv->hookfn(ctx.dptr);
+		if ((priv->flags & mask) != want)
+			continue;
+
+		loop_activity.hook = hook;
+		loop_activity.hook_owner = priv->prof.owner;
+		watchdog_publish();
+
+		if (hook_profiling)
+			hook_call_profiled(&ctx, priv);
+		else
+			priv->hookfn(ctx.dptr);
+
 		if (ctx.flags & HF_STOP)
 			goto out;
 	}
 
 out:
+	loop_activity.hook = prevhook;
+	loop_activity.hook_owner = prevowner;
+	watchdog_publish();
 	mowgli_node_delete(&ctx.node, &hook_run_stack);
 }
 
+void hook_call_event(const char *event, void *dptr)
+{
+	hook_t *hook;
+
+	return_if_fail(event != NULL);
+
+	hook = hook_find(event);
+	if (hook == NULL)
+		return;
+
+	hook->calls++;
+	hook_call_handlers(hook, dptr, 0, 0);
+}
+
+/*
+ * hook_call_event_nondeferred()
+ *
+ * Runs only the handlers which were not added as deferrable.  Returns
+ * true if the hook also has deferrable handlers, which the caller is then
+ * responsible for running later through hook_call_event_deferred().
+ */
+bool hook_call_event_nondeferred(const char *event, void *dptr)
+{
+	hook_t *hook;
+
+	return_val_if_fail(event != NULL, false);
+
+	hook = hook_find(event);
+	if (hook == NULL)
+		return false;
+
+	/* the deferred half is the same event, so is not counted again */
+	hook->calls++;
+	hook_call_handlers(hook, dptr, HPF_DEFERRABLE, 0);
+
+	return hook->deferrable > 0;
+}
+
+void hook_call_event_deferred(const char *event, void *dptr)
+{
+	hook_t *hook;
+
+	return_if_fail(event != NULL);
+
+	hook = hook_find(event);
+	if (hook == NULL || hook->deferrable == 0)
+		return;
+
+	hook_call_handlers(hook, dptr, HPF_DEFERRABLE, HPF_DEFERRABLE);
+}
+
 static inline hook_run_ctx_t *hook_run_stack_highest(void)
 {
 	if (hook_run_stack.head == NULL)
@@ -229,6 +365,50 @@ void hook_continue(void *newptr)
 	ctx->flags &= ~HF_STOP;
 }
 
+/*
+ * hook_profile_foreach(hook_profile_cb_t cb, void *privdata)
+ *
+ * Calls cb for every handler of every hook, with its position in the
+ * hook's list of handlers, counting from 1.
+ */
+void hook_profile_foreach(hook_profile_cb_t cb, void *privdata)
+{
+	mowgli_patricia_iteration_state_t state;
+	mowgli_node_t *n;
+	hook_t *h;
+	unsigned int position;
+
+	MOWGLI_PATRICIA_FOREACH(h, &state, hooks)
+	{
+		position = 0;
+		MOWGLI_ITER_FOREACH(n, h->hooks.head)
+		{
+			hook_privfn_ctx_t *priv = n->data;
+
+			cb(h, ++position, &priv->prof, privdata);
+		}
+	}
+}
+
+void hook_profile_reset(void)
+{
+	mowgli_patricia_iteration_state_t state;
+	mowgli_node_t *n;
+	hook_t *h;
+
+	MOWGLI_PATRICIA_FOREACH(h, &state, hooks)
+	{
+		MOWGLI_ITER_FOREACH(n, h->hooks.head)
+		{
+			hook_privfn_ctx_t *priv = n->data;
+
+			priv->prof.calls = 0;
+			priv->prof.cpu = 0;
+			priv->prof.max = 0;
+		}
+	}
+}
+
 /* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
  * vim:ts=8
  * vim:sw=8
@@ -0,0 +1,792 @@
+/*
+ * ChatServices: A collection of minimalist IRC services
+ * mailqueue.c: Persistent outgoing mail queue.
+ *
+ * Copyright (c) 2018 ChatLounge IRC Network Development Team
+ *     (http://www.chatlounge.net)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Outgoing mail is written to a spool directory and handed to the MTA in
+ * one of two ways:
+ *
+ *  - by default, as before, the MTA is run as "mta -t -f registeremail"
+ *    for each message, which works with any sendmail-compatible program;
+ *  - with serverinfo::mta_smtp, a single long-lived MTA process speaking
+ *    SMTP on its standard input and output (sendmail -bs) is kept around
+ *    instead of forking once per message.  This only reuses the session:
+ *    each message is still a MAIL/RCPT/DATA transaction of its own, one
+ *    command at a time (no PIPELINING).  The helper is told to QUIT once
+ *    the queue has been idle for a while and is started again when a
+ *    message becomes due.
+ *
+ * Temporary failures (4xx replies, the helper going away, or "mta -t"
+ * exiting with EX_TEMPFAIL or on a signal) are retried with an
+ * exponential backoff, permanent failures (5xx replies, or any other
+ * nonzero exit status) drop the message.  Spool files are synced to disk
+ * before they appear under their final name, survive restarts and are
+ * picked up again by mailqueue_init().
+ *
+ * A spool file holds the envelope recipient on its first line and the
+ * message, with \n line endings, after that.
+ */
+
+#include "atheme.h"
+#include "datastream.h"
+
+#ifndef MOWGLI_OS_WIN
+#include <dirent.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sysexits.h>
+#endif
+
+/* first retry delay, doubled on each attempt */
+#define MAILQUEUE_RETRY_MIN	60
+
+/* longest delay between retries */
+#define MAILQUEUE_RETRY_MAX	3600
+
+/* give up on messages which have been queued this long */
+#define MAILQUEUE_MAX_AGE	86400
+
+/* how long to wait for the helper to answer a command */
+#define MAILQUEUE_REPLY_TIMEOUT	60
+
+/* how long an idle helper is kept around */
+#define MAILQUEUE_IDLE_TIMEOUT	30
+
+/* how long to wait before restarting a helper which failed to start */
+#define MAILQUEUE_RESTART_DELAY	30
+
+mailqueue_stats_t mailqueue_stats;
+
+#ifndef MOWGLI_OS_WIN
+
+typedef struct {
+	char *path;		/* spool file, NULL if it could not be written */
+	char *rcpt;
+	char *text;
+	time_t queued;
+	time_t next_try;
+	unsigned int tries;
+	bool sending;		/* handed to the MTA, waiting for the outcome */
+	mowgli_node_t node;
+} mailqueue_msg_t;
+
+typedef enum {
+	MQ_NONE,
+	MQ_GREETING,
+	MQ_HELO,
+	MQ_IDLE,
+	MQ_MAIL,
+	MQ_RCPT,
+	MQ_DATA,
+	MQ_BODY,
+	MQ_RSET,
+	MQ_QUIT,
+} mailqueue_state_t;
+
+static mowgli_list_t mailqueue;
+static char *mailqueue_dir;
+static unsigned int mailqueue_serial;
+
+static connection_t *mq_conn;
+static mailqueue_state_t mq_state;
+static mailqueue_msg_t *mq_current;
+static time_t mq_holdoff;
+
+static mowgli_eventloop_timer_t *mq_run_timer;
+static mowgli_eventloop_timer_t *mq_reply_timer;
+
+static void mailqueue_run(void *unused);
+
+static void mailqueue_schedule(time_t when)
+{
+	if (mq_run_timer != NULL)
+		mowgli_timer_destroy(base_eventloop, mq_run_timer);
+
+	mq_run_timer = mowgli_timer_add_once(base_eventloop, "mailqueue_run", mailqueue_run, NULL,
+			when > CURRTIME ? when - CURRTIME : 0);
+}
+
+static void mailqueue_msg_free(mailqueue_msg_t *msg)
+{
+	mowgli_node_delete(&msg->node, &mailqueue);
+	mailqueue_stats.depth--;
+
+	if (msg->path != NULL)
+	{
+		if (unlink(msg->path) < 0 && errno != ENOENT)
+			slog(LG_ERROR, "mailqueue: cannot remove %s: %s", msg->path, strerror(errno));
+		free(msg->path);
+	}
+
+	free(msg->rcpt);
+	free(msg->text);
+	free(msg);
+}
+
+static mailqueue_msg_t *mailqueue_msg_add(char *path, char *rcpt, char *text, time_t queued)
+{
+	mailqueue_msg_t *msg;
+
+	msg = smalloc(sizeof *msg);
+	msg->path = path;
+	msg->rcpt = rcpt;
+	msg->text = text;
+	msg->queued = queued;
+	msg->next_try = CURRTIME;
+	msg->tries = 0;
+	msg->sending = false;
+
+	mowgli_node_add(msg, &msg->node, &mailqueue);
+	mailqueue_stats.depth++;
+
+	return msg;
+}
+
+static void mailqueue_defer(mailqueue_msg_t *msg, const char *reason)
+{
+	unsigned int delay;
+
+	delay = msg->tries < 6 ? MAILQUEUE_RETRY_MIN << msg->tries : MAILQUEUE_RETRY_MAX;
+	if (delay > MAILQUEUE_RETRY_MAX)
+		delay = MAILQUEUE_RETRY_MAX;
+
+	msg->tries++;
+	msg->next_try = CURRTIME + delay;
+	msg->sending = false;
+	mailqueue_stats.deferred++;
+
+	slog(LG_INFO, "mailqueue: deferred email to %s (%s), retrying in %u seconds", msg->rcpt, reason, delay);
+}
+
+static void mailqueue_fail(mailqueue_msg_t *msg, const char *reason)
+{
+	mailqueue_stats.failed++;
+
+	slog(LG_INFO, "mailqueue: email to %s failed (%s)", msg->rcpt, reason);
+
+	mailqueue_msg_free(msg);
+}
+
+/* pick the next message which is due, dropping any which have expired */
+static mailqueue_msg_t *mailqueue_next(time_t *next_try)
+{
+	mowgli_node_t *n, *tn;
+	mailqueue_msg_t *msg;
+
+	*next_try = 0;
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, mailqueue.head)
+	{
+		msg = n->data;
+
+		if (msg->sending)
+			continue;
+
+		if (CURRTIME - msg->queued > MAILQUEUE_MAX_AGE)
+		{
+			mailqueue_fail(msg, "expired");
+			continue;
+		}
+
+		if (msg->next_try <= CURRTIME)
+			return msg;
+
+		if (*next_try == 0 || msg->next_try < *next_try)
+			*next_try = msg->next_try;
+	}
+
+	return NULL;
+}
+
+static void mailqueue_reply_timeout(void *unused)
+{
+	mq_reply_timer = NULL;
+
+	if (mq_conn == NULL)
+		return;
+
+	if (mq_state == MQ_IDLE)
+	{
+		mq_state = MQ_QUIT;
+		sendq_add(mq_conn, "QUIT\r\n", 6);
+		mq_reply_timer = mowgli_timer_add_once(base_eventloop, "mailqueue_reply_timeout",
+				mailqueue_reply_timeout, NULL, MAILQUEUE_REPLY_TIMEOUT);
+		return;
+	}
+
+	slog(LG_ERROR, "mailqueue: mail submission helper stopped responding");
+	connection_close_soon(mq_conn);
+}
+
+static void mailqueue_set_timer(unsigned int delay)
+{
+	if (mq_reply_timer != NULL)
+		mowgli_timer_destroy(base_eventloop, mq_reply_timer);
+
+	mq_reply_timer = mowgli_timer_add_once(base_eventloop, "mailqueue_reply_timeout",
+			mailqueue_reply_timeout, NULL, delay);
+}
+
+static void mailqueue_send(mailqueue_state_t state, const char *fmt, ...)
+{
+	char buf[BUFSIZE];
+	va_list ap;
+	size_t len;
+
+	va_start(ap, fmt);
+	vsnprintf(buf, sizeof buf - 2, fmt, ap);
+	va_end(ap);
+
+	len = strlen(buf);
+	buf[len++] = '\r';
+	buf[len++] = '\n';
+
+	sendq_add(mq_conn, buf, len);
+
+	mq_state = state;
+	mailqueue_set_timer(MAILQUEUE_REPLY_TIMEOUT);
+}
+
+/* send the message body, with CRLF line endings and leading dots doubled */
+static void mailqueue_send_body(const char *text)
+{
+	char *buf, *p;
+	const char *line, *end;
+	size_t len;
+
+	buf = p = smalloc(strlen(text) * 3 + 8);
+
+	for (line = text; *line != '\0'; line = *end != '\0' ? end + 1 : end)
+	{
+		end = strchr(line, '\n');
+		if (end == NULL)
+			end = line + strlen(line);
+
+		len = end - line;
+		if (len > 0 && line[len - 1] == '\r')
+			len--;
+
+		if (*line == '.')
+			*p++ = '.';
+		memcpy(p, line, len);
+		p += len;
+		*p++ = '\r';
+		*p++ = '\n';
+	}
+
+	memcpy(p, ".\r\n", 3);
+	p += 3;
+
+	sendq_add(mq_conn, buf, p - buf);
+	free(buf);
+
+	mq_state = MQ_BODY;
+	mailqueue_set_timer(MAILQUEUE_REPLY_TIMEOUT);
+}
+
+static void mailqueue_idle(void)
+{
+	mq_state = MQ_IDLE;
+	mailqueue_set_timer(MAILQUEUE_IDLE_TIMEOUT);
+	mailqueue_schedule(CURRTIME);
+}
+
+/* the transaction failed; RSET if the server still expects more of it */
+static void mailqueue_abort(int code, const char *line)
+{
+	if (code >= 500)
+		mailqueue_fail(mq_current, line);
+	else
+		mailqueue_defer(mq_current, line);
+
+	mq_current = NULL;
+
+	if (mq_state == MQ_BODY)
+		mailqueue_idle();
+	else
+		mailqueue_send(MQ_RSET, "RSET");
+}
+
+static void mailqueue_recvq_handler(connection_t *cptr)
+{
+	char line[BUFSIZE + 1];
+	int len, code;
+
+	len = recvq_getline(cptr, line, sizeof line - 1);
+	if (len <= 0)
+		return;
+
+	while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+		len--;
+	line[len] = '\0';
+
+	/* only the last line of a multi-line reply counts */
+	if (len < 3 || line[3] == '-')
+		return;
+
+	code = atoi(line);
+
+	switch (mq_state)
+	{
+	case MQ_GREETING:
+		if (code / 100 != 2)
+			break;
+		mailqueue_send(MQ_HELO, "HELO %s", me.name);
+		return;
+	case MQ_HELO:
+		if (code / 100 != 2)
+			break;
+		mailqueue_idle();
+		return;
+	case MQ_MAIL:
+		if (code / 100 != 2)
+		{
+			mailqueue_abort(code, line);
+			return;
+		}
+		mailqueue_send(MQ_RCPT, "RCPT TO:<%s>", mq_current->rcpt);
+		return;
+	case MQ_RCPT:
+		if (code / 100 != 2)
+		{
+			mailqueue_abort(code, line);
+			return;
+		}
+		mailqueue_send(MQ_DATA, "DATA");
+		return;
+	case MQ_DATA:
+		if (code / 100 != 3)
+		{
+			mailqueue_abort(code, line);
+			return;
+		}
+		mailqueue_send_body(mq_current->text);
+		return;
+	case MQ_BODY:
+		if (code / 100 != 2)
+		{
+			mailqueue_abort(code, line);
+			return;
+		}
+		mailqueue_stats.sent++;
+		slog(LG_DEBUG, "mailqueue: email to %s accepted (%s)", mq_current->rcpt, line);
+		mailqueue_msg_free(mq_current);
+		mq_current = NULL;
+		mailqueue_idle();
+		return;
+	case MQ_RSET:
+		if (code / 100 != 2)
+			break;
+		mailqueue_idle();
+		return;
+	default:
+		/* unsolicited, or an answer to QUIT */
+		return;
+	}
+
+	slog(LG_ERROR, "mailqueue: unexpected reply from mail submission helper: %s", line);
+	connection_close_soon(cptr);
+}
+
+static void mailqueue_close_handler(connection_t *cptr)
+{
+	if (mq_current != NULL)
+	{
+		mailqueue_defer(mq_current, "mail submission helper went away");
+		mq_current = NULL;
+	}
+
+	/* don't restart a helper which never got as far as accepting mail */
+	if (mq_state == MQ_GREETING || mq_state == MQ_HELO)
+	{
+		slog(LG_ERROR, "mailqueue: mail submission helper %s failed to start", me.mta);
+		mq_holdoff = CURRTIME + MAILQUEUE_RESTART_DELAY;
+	}
+
+	if (mq_reply_timer != NULL)
+	{
+		mowgli_timer_destroy(base_eventloop, mq_reply_timer);
+		mq_reply_timer = NULL;
+	}
+
+	mq_conn = NULL;
+	mq_state = MQ_NONE;
+
+	if (MOWGLI_LIST_LENGTH(&mailqueue) > 0)
+		mailqueue_schedule(mq_holdoff);
+}
+
+static void mailqueue_helper_exited(pid_t pid, int status, void *data)
+{
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		slog(LG_INFO, "mailqueue: mail submission helper %d exited abnormally (status %d)", (int)pid, status);
+}
+
+static bool mailqueue_start_helper(void)
+{
+	int fds[2];
+	pid_t pid;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+	{
+		slog(LG_ERROR, "mailqueue: socketpair(): %s", strerror(errno));
+		return false;
+	}
+
+	switch (pid = fork())
+	{
+		case -1:
+			slog(LG_ERROR, "mailqueue: fork(): %s", strerror(errno));
+			close(fds[0]);
+			close(fds[1]);
+			return false;
+		case 0:
+			connection_close_all_fds();
+			close(fds[0]);
+			dup2(fds[1], 0);
+			dup2(fds[1], 1);
+			if (fds[1] > 1)
+				close(fds[1]);
+			execl(me.mta, me.mta, "-bs", NULL);
+			_exit(255);
+	}
+
+	close(fds[1]);
+	childproc_add(pid, "mail submission", mailqueue_helper_exited, NULL);
+
+	mq_conn = connection_add("mail submission", fds[0], 0, recvq_put, NULL);
+	if (mq_conn == NULL)
+	{
+		close(fds[0]);
+		return false;
+	}
+
+	mq_conn->recvq_handler = mailqueue_recvq_handler;
+	mq_conn->close_handler = mailqueue_close_handler;
+
+	mq_state = MQ_GREETING;
+	mailqueue_set_timer(MAILQUEUE_REPLY_TIMEOUT);
+
+	slog(LG_DEBUG, "mailqueue: started mail submission helper %d", (int)pid);
+	return true;
+}
+
+static void mailqueue_pipe_exited(pid_t pid, int status, void *data)
+{
+	mailqueue_msg_t *msg = data;
+	char reason[BUFSIZE];
+
+	if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+	{
+		mailqueue_stats.sent++;
+		slog(LG_DEBUG, "mailqueue: email to %s accepted by %s", msg->rcpt, me.mta);
+		mailqueue_msg_free(msg);
+	}
+	else if (WIFEXITED(status))
+	{
+		snprintf(reason, sizeof reason, "%s exited with status %d", me.mta, WEXITSTATUS(status));
+		if (WEXITSTATUS(status) == EX_TEMPFAIL)
+			mailqueue_defer(msg, reason);
+		else
+			mailqueue_fail(msg, reason);
+	}
+	else
+	{
+		snprintf(reason, sizeof reason, "%s killed by signal %d", me.mta, WTERMSIG(status));
+		mailqueue_defer(msg, reason);
+	}
+
+	mailqueue_schedule(CURRTIME);
+}
+
+/* run "mta -t" for one message, as sendemail() used to */
+static bool mailqueue_pipe(mailqueue_msg_t *msg)
+{
+	int pipfds[2];
+	pid_t pid;
+	FILE *out;
+
+	if (pipe(pipfds) < 0)
+	{
+		slog(LG_ERROR, "mailqueue: pipe(): %s", strerror(errno));
+		return false;
+	}
+
+	switch (pid = fork())
+	{
+		case -1:
+			slog(LG_ERROR, "mailqueue: fork(): %s", strerror(errno));
+			close(pipfds[0]);
+			close(pipfds[1]);
+			return false;
+		case 0:
+			connection_close_all_fds();
+			close(pipfds[1]);
+			dup2(pipfds[0], 0);
+			execl(me.mta, me.mta, "-t", "-f", me.register_email, NULL);
+			_exit(255);
+	}
+
+	close(pipfds[0]);
+	msg->sending = true;
+	childproc_add(pid, "email", mailqueue_pipe_exited, msg);
+
+	/* a short write shows up as a failure exit status of the mta */
+	if ((out = fdopen(pipfds[1], "w")) == NULL)
+	{
+		close(pipfds[1]);
+		return true;
+	}
+
+	fputs(msg->text, out);
+	if (ferror(out) || fclose(out) < 0)
+		slog(LG_ERROR, "mailqueue: cannot write email to %s: %s", msg->rcpt, strerror(errno));
+
+	return true;
+}
+
+static void mailqueue_run(void *unused)
+{
+	mailqueue_msg_t *msg;
+	time_t next_try;
+
+	mq_run_timer = NULL;
+
+	if (me.mta == NULL)
+		return;
+
+	if (!me.mta_smtp)
+	{
+		while ((msg = mailqueue_next(&next_try)) != NULL)
+			if (!mailqueue_pipe(msg))
+				mailqueue_defer(msg, "cannot start the mta");
+
+		if (next_try != 0)
+			mailqueue_schedule(next_try);
+		return;
+	}
+
+	/* busy; we will be called again when the helper is ready */
+	if (mq_conn != NULL && mq_state != MQ_IDLE)
+		return;
+
+	msg = mailqueue_next(&next_try);
+	if (msg == NULL)
+	{
+		if (next_try != 0)
+			mailqueue_schedule(next_try);
+		return;
+	}
+
+	if (mq_conn == NULL)
+	{
+		if (mq_holdoff > CURRTIME)
+		{
+			mailqueue_schedule(mq_holdoff);
+			return;
+		}
+
+		if (!mailqueue_start_helper())
+		{
+			mq_holdoff = CURRTIME + MAILQUEUE_RESTART_DELAY;
+			mailqueue_schedule(mq_holdoff);
+		}
+		return;
+	}
+
+	mq_current = msg;
+	mq_current->sending = true;
+	mailqueue_send(MQ_MAIL, "MAIL FROM:<%s>", me.register_email);
+}
+
+static char *mailqueue_spool(const char *rcpt, const char *text)
+{
+	char path[BUFSIZE], tmppath[BUFSIZE];
+	FILE *f;
+
+	if (mailqueue_dir == NULL)
+		return NULL;
+
+	snprintf(path, sizeof path, "%s/%lu.%lu.%u", mailqueue_dir,
+			(unsigned long)CURRTIME, (unsigned long)getpid(), ++mailqueue_serial);
+	snprintf(tmppath, sizeof tmppath, "%s/tmp-%lu.%lu.%u", mailqueue_dir,
+			(unsigned long)CURRTIME, (unsigned long)getpid(), mailqueue_serial);
+
+	if ((f = fopen(tmppath, "w")) == NULL)
+	{
+		slog(LG_ERROR, "mailqueue: cannot create %s: %s", tmppath, strerror(errno));
+		return NULL;
+	}
+
+	fprintf(f, "%s\n%s", rcpt, text);
+
+	/* the rename must not become visible before the contents */
+	if (fflush(f) < 0 || fsync(fileno(f)) < 0 || ferror(f))
+	{
+		slog(LG_ERROR, "mailqueue: cannot write %s: %s", tmppath, strerror(errno));
+		fclose(f);
+		unlink(tmppath);
+		return NULL;
+	}
+
+	if (fclose(f) < 0 || srename(tmppath, path) < 0)
+	{
+		slog(LG_ERROR, "mailqueue: cannot write %s: %s", path, strerror(errno));
+		unlink(tmppath);
+		return NULL;
+	}
+
+	return sstrdup(path);
+}
+
+static void mailqueue_load(const char *path, time_t queued)
+{
+	FILE *f;
+	char *buf, *text;
+	long size;
+
+	if ((f = fopen(path, "r")) == NULL)
+	{
+		slog(LG_ERROR, "mailqueue: cannot open %s: %s", path, strerror(errno));
+		return;
+	}
+
+	if (fseek(f, 0, SEEK_END) < 0 || (size = ftell(f)) < 0 || fseek(f, 0, SEEK_SET) < 0)
+	{
+		fclose(f);
+		return;
+	}
+
+	buf = smalloc(size + 1);
+	size = fread(buf, 1, size, f);
+	buf[size] = '\0';
+	fclose(f);
+
+	if ((text = strchr(buf, '\n')) != NULL)
+		*text++ = '\0';
+
+	if (text == NULL || !validemail(buf))
+	{
+		slog(LG_ERROR, "mailqueue: discarding malformed spool file %s", path);
+		free(buf);
+		unlink(path);
+		return;
+	}
+
+	mailqueue_msg_add(sstrdup(path), sstrdup(buf), sstrdup(text), queued);
+	free(buf);
+}
+
+/*
+ * mailqueue_submit(const char *rcpt, const char *text)
+ *
+ * Queues a message for delivery to rcpt.  The text is a complete message
+ * including headers, with \n line endings.  Returns false if the message
+ * could not be queued at all; a message which could not be written to
+ * the spool directory is still sent, but will not survive a restart.
+ */
+bool mailqueue_submit(const char *rcpt, const char *text)
+{
+	return_val_if_fail(rcpt != NULL, false);
+	return_val_if_fail(text != NULL, false);
+
+	if (me.mta == NULL)
+		return false;
+
+	mailqueue_msg_add(mailqueue_spool(rcpt, text), sstrdup(rcpt), sstrdup(text), CURRTIME);
+
+	if (!me.mta_smtp || mq_conn == NULL || mq_state == MQ_IDLE)
+		mailqueue_schedule(CURRTIME);
+
+	return true;
+}
+
+void mailqueue_init(void)
+{
+	char path[BUFSIZE];
+	DIR *dir;
+	struct dirent *ent;
+	struct stat st;
+
+	snprintf(path, sizeof path, "%s/mailqueue", datadir);
+	mailqueue_dir = sstrdup(path);
+
+	if (mkdir(mailqueue_dir, 0700) < 0 && errno != EEXIST)
+	{
+		slog(LG_ERROR, "mailqueue_init(): cannot create %s: %s; queued email will not survive a restart",
+				mailqueue_dir, strerror(errno));
+		free(mailqueue_dir);
+		mailqueue_dir = NULL;
+		return;
+	}
+
+	if ((dir = opendir(mailqueue_dir)) == NULL)
+		return;
+
+	while ((ent = readdir(dir)) != NULL)
+	{
+		if (ent->d_name[0] == '.')
+			continue;
+
+		snprintf(path, sizeof path, "%s/%s", mailqueue_dir, ent->d_name);
+
+		/* left over from an interrupted write */
+		if (!strncmp(ent->d_name, "tmp-", 4))
+		{
+			unlink(path);
+			continue;
+		}
+
+		if (stat(path, &st) < 0 || !S_ISREG(st.st_mode))
+			continue;
+
+		mailqueue_load(path, st.st_mtime);
+	}
+
+	closedir(dir);
+
+	if (MOWGLI_LIST_LENGTH(&mailqueue) > 0)
+	{
+		slog(LG_INFO, "mailqueue_init(): %u queued emails found", mailqueue_stats.depth);
+		mailqueue_schedule(CURRTIME);
+	}
+}
+
+#else
+
+void mailqueue_init(void)
+{
+}
+
+bool mailqueue_submit(const char *rcpt, const char *text)
+{
+	return false;
+}
+
+#endif
+
+/* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
+ * vim:ts=8
+ * vim:sw=8
+ * vim:noexpandtab
+ */
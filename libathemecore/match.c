@@ -28,6 +28,9 @@
 #ifdef HAVE_PCRE
 #include <pcre.h>
 #endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #define BadPtr(x) (!(x) || (*(x) == '\0'))
 
@@ -103,26 +106,148 @@ const unsigned char ToUpperTab[] = {
 	0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff
 };
 
+/* case mapping tables for the current match_mapping */
+static const unsigned char *tolower_map = ToLowerTab;
+static const unsigned char *toupper_map = ToUpperTab;
+
+static unsigned char ascii_tolower[256], ascii_toupper[256];
+
+/* the range of bytes which ToUpper() moves down by 0x20 */
+static unsigned char fold_first = 'a', fold_last = '~';
+
 int ToLower(int c)
 {
-	if (match_mapping == MATCH_ASCII)
-		return tolower((unsigned char)c);
-	/* else */
-	return (ToLowerTab[(unsigned char)(c)]);
+	return tolower_map[(unsigned char)c];
 }
 
 int ToUpper(int c)
 {
-	if (match_mapping == MATCH_ASCII)
-		return toupper((unsigned char)c);
-	/* else */
-	return (ToUpperTab[(unsigned char)(c)]);
+	return toupper_map[(unsigned char)c];
 }
 
 void set_match_mapping(int type)
 {
+	unsigned int i;
+
 	match_mapping = type;
+
+	if (type == MATCH_ASCII)
+	{
+		for (i = 0; i < 256; i++)
+		{
+			ascii_tolower[i] = (i >= 'A' && i <= 'Z') ? i + 0x20 : i;
+			ascii_toupper[i] = (i >= 'a' && i <= 'z') ? i - 0x20 : i;
+		}
+
+		tolower_map = ascii_tolower;
+		toupper_map = ascii_toupper;
+		fold_last = 'z';
+	}
+	else
+	{
+		tolower_map = ToLowerTab;
+		toupper_map = ToUpperTab;
+		fold_last = '~';
+	}
+}
+
+#ifdef __SSE2__
+/*
+ * casecmp_mapped()
+ *
+ * Compares at most n bytes of s1 and s2, folding case with the current
+ * mapping, 16 bytes at a time; returns like strncmp().  There is no
+ * length prepass: blocks are loaded as long as neither load crosses a
+ * page boundary, so a load may read past a NUL, but never into a page the
+ * string does not touch.  A block which would cross a page, and the tail,
+ * are compared byte by byte.
+ *
+ * The over-read is harmless, but AddressSanitizer would report it, hence
+ * the attribute.
+ */
+#if defined(__has_feature)
+# if __has_feature(address_sanitizer)
+__attribute__((no_sanitize_address))
+# endif
+#elif defined(__SANITIZE_ADDRESS__)
+__attribute__((no_sanitize_address))
+#endif
+static int casecmp_mapped(const unsigned char *s1, const unsigned char *s2, size_t n)
+{
+	const __m128i lo = _mm_set1_epi8(fold_first - 1);
+	const __m128i hi = _mm_set1_epi8(fold_last + 1);
+	const __m128i bit = _mm_set1_epi8(0x20);
+	const __m128i zero = _mm_setzero_si128();
+	__m128i a, b, fa, fb;
+	size_t room1, room2, blocks, i;
+	int stop, res;
+
+	for (;;)
+	{
+		/* whole blocks before either string reaches its next page */
+		room1 = 4096 - ((uintptr_t)s1 & 4095);
+		room2 = 4096 - ((uintptr_t)s2 & 4095);
+		blocks = (room1 < room2 ? room1 : room2) / 16;
+		if (blocks > n / 16)
+			blocks = n / 16;
+
+		for (; blocks > 0; blocks--)
+		{
+			a = _mm_loadu_si128((const __m128i *)s1);
+			b = _mm_loadu_si128((const __m128i *)s2);
+
+			/* both bounds are below 0x80, so signed compares exclude high bytes */
+			fa = _mm_sub_epi8(a, _mm_and_si128(_mm_and_si128(_mm_cmpgt_epi8(a, lo), _mm_cmplt_epi8(a, hi)), bit));
+			fb = _mm_sub_epi8(b, _mm_and_si128(_mm_and_si128(_mm_cmpgt_epi8(b, lo), _mm_cmplt_epi8(b, hi)), bit));
+
+			/* a byte is zeroed where the folded bytes differ, or s1 ends */
+			stop = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(_mm_cmpeq_epi8(fa, fb), a), zero));
+			if (stop != 0)
+			{
+				i = __builtin_ctz(stop);
+				return toupper_map[s1[i]] - toupper_map[s2[i]];
+			}
+
+			s1 += 16;
+			s2 += 16;
+			n -= 16;
+		}
+
+		/* only NUL folds to NUL, so equal bytes are both NUL or neither */
+		for (i = n < 16 ? n : 16; i > 0; i--)
+		{
+			if ((res = toupper_map[*s1] - toupper_map[*s2]) != 0)
+				return res;
+			if (*s1 == '\0')
+				return 0;
+			s1++;
+			s2++;
+		}
+
+		if (n <= 16)
+			return 0;
+		n -= 16;
+	}
+}
+#else
+static int casecmp_mapped(const unsigned char *s1, const unsigned char *s2, size_t n)
+{
+	int res;
+
+	/* only NUL folds to NUL, so equal bytes are both NUL or neither */
+	for (; n > 0; n--)
+	{
+		if ((res = toupper_map[*s1] - toupper_map[*s2]) != 0)
+			return res;
+		if (*s1 == '\0')
+			return 0;
+		s1++;
+		s2++;
+	}
+
+	return 0;
 }
+#endif
 
 #define MAX_ITERATIONS  512
 /*
@@ -192,7 +317,7 @@ int match(const char *mask, const char *name)
 		else
 			q = 0;
 
-		if ((ToLower(*m) != ToLower(*n)) && (((*m != '?') && !(*m == '&' && IsAlpha(*n)) && !(*m == '#' && IsDigit(*n)) && !(*m == '%' && IsNon(*n))) || q))
+		if ((tolower_map[*m] != tolower_map[*n]) && (((*m != '?') && !(*m == '&' && IsAlpha(*n)) && !(*m == '#' && IsDigit(*n)) && !(*m == '%' && IsNon(*n))) || q))
 		{
 			if (!wild)
 				return 1;
@@ -247,6 +372,260 @@ char *collapse(char *pattern)
 	return pattern;
 }
 
+/*
+ * Precompiled masks.
+ *
+ * A mask consisting only of literal characters, '#' and '*' is split at
+ * the stars into segments which are case folded once, up front.  Matching
+ * is then a prefix check, a suffix check and a substring search for each
+ * segment in between, on a folded copy of the name.  A '#' matches itself
+ * or a digit, so channel masks stay on this path.  Masks using any of the
+ * other wildcards or escapes are simply handed to match(), as are masks
+ * compiled under another case mapping.
+ *
+ * Unlike match(), the literal path has no iteration limit, so very long
+ * names which match() would give up on can still match.
+ */
+struct match_mask_ {
+	char *mask;		/* original mask, for the fallback */
+	bool literal;		/* only literals, '#' and '*' */
+	bool digits;		/* some segment has a '#' */
+	bool anchor_start;	/* mask does not begin with '*' */
+	bool anchor_end;	/* mask does not end with '*' */
+	unsigned int nsegs;
+	size_t minlen;		/* sum of segment lengths */
+	char **segs;		/* folded segments, pointing into buf */
+	size_t *seglens;
+	char *buf;
+	int mapping;		/* match_mapping when folded */
+};
+
+static void match_mask_fold(match_mask_t *mm)
+{
+	const char *p;
+	char *q;
+	unsigned int i = 0;
+
+	q = mm->buf;
+	p = mm->mask;
+	mm->minlen = 0;
+
+	while (*p != '\0')
+	{
+		while (*p == '*')
+			p++;
+		if (*p == '\0')
+			break;
+
+		mm->segs[i] = q;
+		while (*p != '\0' && *p != '*')
+			*q++ = toupper_map[(unsigned char)*p++];
+		mm->seglens[i] = q - mm->segs[i];
+		mm->minlen += mm->seglens[i];
+		*q++ = '\0';
+		i++;
+	}
+
+	mm->mapping = match_mapping;
+}
+
+/* compares len bytes of a folded name with a segment */
+static int match_seg_cmp(const match_mask_t *mm, const char *s, unsigned int seg, size_t len)
+{
+	const char *p = mm->segs[seg];
+	size_t i;
+
+	if (!mm->digits)
+		return memcmp(s, p, len);
+
+	for (i = 0; i < len; i++)
+		if (s[i] != p[i] && !(p[i] == '#' && IsDigit(s[i])))
+			return 1;
+
+	return 0;
+}
+
+/* finds the first occurrence of a segment in the folded name s of length len */
+static const char *match_seg_find(const match_mask_t *mm, const char *s, size_t len, unsigned int seg)
+{
+	if (!mm->digits)
+		return strstr(s, mm->segs[seg]);
+
+	for (; len >= mm->seglens[seg]; s++, len--)
+		if (!match_seg_cmp(mm, s, seg, mm->seglens[seg]))
+			return s;
+
+	return NULL;
+}
+
+/*
+ * match_compile(const char *mask)
+ *
+ * Prepares a mask for repeated use with match_compiled().
+ *
+ * Inputs:
+ *      - a mask as accepted by match()
+ *
+ * Outputs:
+ *      - a compiled mask, to be released with match_mask_free()
+ */
+match_mask_t *match_compile(const char *mask)
+{
+	match_mask_t *mm;
+	const char *p;
+	size_t len;
+
+	return_val_if_fail(mask != NULL, NULL);
+
+	mm = scalloc(sizeof(match_mask_t), 1);
+	mm->mask = sstrdup(mask);
+	mm->literal = true;
+
+	for (p = mask; *p != '\0'; p++)
+	{
+		if (*p == '?' || *p == '&' || *p == '%' || *p == '\\')
+		{
+			mm->literal = false;
+			return mm;
+		}
+		if (*p == '#')
+			mm->digits = true;
+		if (*p == '*' && (p == mask || p[-1] != '*'))
+			mm->nsegs++;
+	}
+
+	len = p - mask;
+
+	/*
+	 * match() lets a star other than the first character, followed by
+	 * nothing but '#'s up to the end of the mask, match any tail once
+	 * the '#'s have matched; leave that quirk to it.
+	 */
+	for (p = mask + len; p > mask && p[-1] == '#'; p--)
+		;
+	if (p < mask + len && p - 1 > mask && p[-1] == '*')
+	{
+		mm->literal = false;
+		return mm;
+	}
+	mm->anchor_start = *mask != '*';
+	mm->anchor_end = len > 0 && mask[len - 1] != '*';
+
+	/* a run of stars separates two segments, plus one at each unstarred end */
+	if (mm->nsegs == 0)
+		mm->nsegs = len > 0 ? 1 : 0;
+	else
+		mm->nsegs += mm->anchor_start + mm->anchor_end - 1;
+
+	mm->segs = scalloc(sizeof(char *), mm->nsegs + 1);
+	mm->seglens = scalloc(sizeof(size_t), mm->nsegs + 1);
+	mm->buf = smalloc(len + 1);
+
+	match_mask_fold(mm);
+
+	return mm;
+}
+
+/*
+ * match_compiled(const match_mask_t *mm, const char *name)
+ *
+ * Matches a name against a compiled mask.
+ *
+ * Inputs:
+ *      - a mask from match_compile()
+ *      - the name to check
+ *
+ * Outputs:
+ *      - 0 on match, 1 otherwise, like match()
+ */
+int match_compiled(const match_mask_t *mm, const char *name)
+{
+	char folded[BUFSIZE];
+	const char *found;
+	size_t len, pos, limit;
+	unsigned int first, last, i;
+
+	if (mm == NULL || name == NULL)
+		return 1;
+
+	if (!mm->literal)
+		return match(mm->mask, name);
+
+	/* the segments were folded under another mapping */
+	if (mm->mapping != match_mapping)
+		return match(mm->mask, name);
+
+	len = strlen(name);
+	if (len >= sizeof folded)
+		return match(mm->mask, name);
+	if (len < mm->minlen)
+		return 1;
+
+	/* the mask was "" or only stars */
+	if (mm->nsegs == 0)
+		return mm->anchor_start && len > 0 ? 1 : 0;
+
+	for (i = 0; i < len; i++)
+		folded[i] = toupper_map[(unsigned char)name[i]];
+	folded[len] = '\0';
+
+	pos = 0;
+	limit = len;
+	first = 0;
+	last = mm->nsegs;
+
+	if (mm->anchor_start)
+	{
+		if (mm->nsegs == 1 && mm->anchor_end)
+			return len == mm->seglens[0] && !match_seg_cmp(mm, folded, 0, len) ? 0 : 1;
+
+		if (match_seg_cmp(mm, folded, 0, mm->seglens[0]))
+			return 1;
+
+		pos = mm->seglens[0];
+		first = 1;
+	}
+
+	if (mm->anchor_end)
+	{
+		last--;
+		limit = len - mm->seglens[last];
+
+		if (limit < pos || match_seg_cmp(mm, folded + limit, last, mm->seglens[last]))
+			return 1;
+
+		/* keep the middle segments out of the suffix */
+		folded[limit] = '\0';
+	}
+
+	for (i = first; i < last; i++)
+	{
+		if ((found = match_seg_find(mm, folded + pos, limit - pos, i)) == NULL)
+			return 1;
+
+		pos = (found - folded) + mm->seglens[i];
+	}
+
+	return 0;
+}
+
+/*
+ * match_mask_free(match_mask_t *mm)
+ *
+ * Releases a compiled mask.
+ */
+void match_mask_free(match_mask_t *mm)
+{
+	if (mm == NULL)
+		return;
+
+	free(mm->segs);
+	free(mm->seglens);
+	free(mm->buf);
+	free(mm->mask);
+	free(mm);
+}
+
 /*
 **  Case insensitive comparison of two null terminated strings.
 **
@@ -256,51 +635,28 @@ char *collapse(char *pattern)
 */
 int irccasecmp(const char *s1, const char *s2)
 {
-	const unsigned char *str1 = (const unsigned char *)s1;
-	const unsigned char *str2 = (const unsigned char *)s2;
-	int res;
-
 	if (!s1 || !s2)
 		return -1;
 
 	if (match_mapping == MATCH_ASCII)
 		return strcasecmp(s1, s2);
 
-	while ((res = ToUpper(*str1) - ToUpper(*str2)) == 0)
-	{
-		if (*str1 == '\0')
-			return 0;
-		str1++;
-		str2++;
-	}
-	return (res);
+	return casecmp_mapped((const unsigned char *)s1, (const unsigned char *)s2, SIZE_MAX);
 }
 
 int ircncasecmp(const char *str1, const char *str2, size_t n)
 {
-	const unsigned char *s1 = (const unsigned char *)str1;
-	const unsigned char *s2 = (const unsigned char *)str2;
-	int res;
-
 	if (match_mapping == MATCH_ASCII)
 		return strncasecmp(str1, str2, n);
 
-	while ((res = ToUpper(*s1) - ToUpper(*s2)) == 0)
-	{
-		s1++;
-		s2++;
-		n--;
-		if (n == 0 || (*s1 == '\0' && *s2 == '\0'))
-			return 0;
-	}
-	return (res);
+	return casecmp_mapped((const unsigned char *)str1, (const unsigned char *)str2, n);
 }
 
 void irccasecanon(char *str)
 {
 	while (*str)
 	{
-		*str = ToUpper(*str);
+		*str = toupper_map[(unsigned char)*str];
 		str++;
 	}
 	return;
@@ -0,0 +1,152 @@
+/*
+ * ChatServices: A collection of minimalist IRC services
+ * memstat.c: Measured memory usage.
+ *
+ * Copyright (c) 2018 ChatLounge IRC Network Development Team
+ *     (http://www.chatlounge.net)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * The process-wide figures come from the kernel and from malloc() itself,
+ * so they include everything: strings, patricia nodes, buffers and what
+ * malloc() loses to headers and fragmentation.  The shared heaps count
+ * their own objects, which says where most of it goes.
+ *
+ * Nothing here is cached; it is all read when asked for.
+ */
+
+#include "atheme.h"
+
+#ifdef HAVE_MALLOC_H
+# include <malloc.h>
+#endif
+
+/* reads "Key:   1234 kB" lines from a /proc file */
+static void memstat_read_proc(const char *path, const char *const *keys, size_t **values, unsigned int nkeys)
+{
+	FILE *f;
+	char line[BUFSIZE];
+	unsigned int i;
+	size_t len;
+
+	if ((f = fopen(path, "r")) == NULL)
+		return;
+
+	while (fgets(line, sizeof line, f) != NULL)
+	{
+		for (i = 0; i < nkeys; i++)
+		{
+			len = strlen(keys[i]);
+			if (!strncmp(line, keys[i], len) && line[len] == ':' && *values[i] == 0)
+				*values[i] = strtoull(line + len + 1, NULL, 10) * 1024;
+		}
+	}
+
+	fclose(f);
+}
+
+static void memstat_malloc(memstat_t *ms)
+{
+#if defined(HAVE_MALLINFO2)
+	struct mallinfo2 mi = mallinfo2();
+
+	ms->malloc_used = mi.uordblks + mi.hblkhd;
+	ms->malloc_free = mi.fordblks;
+	ms->malloc_mmap = mi.hblkhd;
+#elif defined(HAVE_MALLINFO)
+	/* the fields are ints, which wrap past 4GB; at least do not sign-extend */
+	struct mallinfo mi = mallinfo();
+
+	ms->malloc_used = (size_t)(unsigned int)mi.uordblks + (unsigned int)mi.hblkhd;
+	ms->malloc_free = (unsigned int)mi.fordblks;
+	ms->malloc_mmap = (unsigned int)mi.hblkhd;
+#else
+	(void)ms;
+#endif
+}
+
+/*
+ * memstat_heap_reserved()
+ *
+ * The memory taken by the blocks of the heap sh allocates from, shared
+ * with any other types of the same size.  mowgli does not say how many
+ * blocks it holds, so this is the fewest which can hold the objects now
+ * allocated from it.
+ */
+size_t memstat_heap_reserved(const sharedheap_t *sh)
+{
+	mowgli_node_t *n;
+	unsigned long live = 0, blocks;
+
+	MOWGLI_ITER_FOREACH(n, sharedheap_list.head)
+	{
+		const sharedheap_t *other = n->data;
+
+		if (other->heap == sh->heap)
+			live += other->live;
+	}
+
+	blocks = sh->block > 0 ? (live + sh->block - 1) / sh->block : 0;
+
+	return blocks * sh->block * sh->size;
+}
+
+void memstat_get(memstat_t *ms)
+{
+	static const char *const status_keys[] = { "VmRSS", "VmHWM", "RssAnon" };
+	static const char *const smaps_keys[] = { "Pss" };
+	size_t *status_values[] = { &ms->rss, &ms->rss_peak, &ms->rss_anon };
+	size_t *smaps_values[] = { &ms->pss };
+	mowgli_node_t *n, *n2;
+
+	memset(ms, 0, sizeof *ms);
+
+	memstat_read_proc("/proc/self/status", status_keys, status_values, ARRAY_SIZE(status_keys));
+	memstat_read_proc("/proc/self/smaps_rollup", smaps_keys, smaps_values, ARRAY_SIZE(smaps_keys));
+
+	memstat_malloc(ms);
+
+	MOWGLI_ITER_FOREACH(n, sharedheap_list.head)
+	{
+		const sharedheap_t *sh = n->data;
+
+		ms->heap_objects += sh->live;
+		ms->heap_used += sh->live * sh->size;
+
+		/* count each heap once, for the first type using it */
+		MOWGLI_ITER_FOREACH(n2, sharedheap_list.head)
+		{
+			if (n2 == n)
+			{
+				ms->heap_reserved += memstat_heap_reserved(sh);
+				break;
+			}
+			if (((const sharedheap_t *)n2->data)->heap == sh->heap)
+				break;
+		}
+	}
+
+	strshare_memstats(&ms->strings_large, &ms->strings_large_bytes, &ms->strings_table);
+}
+
+/* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
+ * vim:ts=8
+ * vim:sw=8
+ * vim:noexpandtab
+ */
@@ -30,7 +30,7 @@
 # include <dlfcn.h>
 #endif
 
-mowgli_heap_t *module_heap;
+sharedheap_t *module_heap;
 mowgli_list_t modules, modules_inprogress;
 
 module_t *modtarget = NULL;
@@ -39,7 +39,7 @@ static module_t *module_load_internal(const char *pathname, char *errbuf, int er
 
 void modules_init(void)
 {
-	module_heap = sharedheap_get(sizeof(module_t));
+	module_heap = sharedheap_get_named(sizeof(module_t), "module_t");
 
 	if (!module_heap)
 	{
@@ -173,7 +173,7 @@ static module_t *module_load_internal(const char *pathname, char *errbuf, int er
 		return NULL;
 	}
 
-	m = mowgli_heap_alloc(module_heap);
+	m = sharedheap_alloc(module_heap);
 
 	mowgli_strlcpy(m->modpath, pathname, BUFSIZE);
 	mowgli_strlcpy(m->name, h->name, BUFSIZE);
@@ -352,7 +352,7 @@ void module_unload(module_t *m, module_unload_intent_t intent)
 	if (m->handle)
 	{
 		mowgli_module_close(m->handle);
-		mowgli_heap_free(module_heap, m);
+		sharedheap_free(module_heap, m);
 	}
 	else
 	{
@@ -0,0 +1,141 @@
+/*
+ * ChatServices: A collection of minimalist IRC services
+ * msgring.c: Fixed-size rings of recent messages, for flood detection.
+ *
+ * Copyright (c) 2018 ChatLounge IRC Network Development Team
+ *     (http://www.chatlounge.net)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * A message ring remembers the last few messages seen somewhere, by
+ * time, sender and a 64-bit hash of the text, so that repeats and
+ * rates can be checked without copying every message onto the heap.
+ * Rings are plain structures meant to be embedded in a pooled object.
+ */
+
+#include "atheme.h"
+
+/*
+ * msgring_hash(const char *text)
+ *
+ * 64-bit FNV-1a over the text, folded to lower case so that messages
+ * which only differ in case (by strcasecmp()) hash the same.
+ */
+uint64_t msgring_hash(const char *text)
+{
+	const unsigned char *p = (const unsigned char *)text;
+	uint64_t h = 14695981039346656037ULL;
+
+	while (*p != '\0')
+	{
+		h ^= tolower(*p++);
+		h *= 1099511628211ULL;
+	}
+
+	return h;
+}
+
+/*
+ * msgring_add(msgring_t *ring, unsigned int max, stringref source, const char *text, time_t ts)
+ *
+ * Records a message, dropping the oldest one once the ring holds more
+ * than max entries.  A reference to source is taken.
+ */
+void msgring_add(msgring_t *ring, unsigned int max, stringref source, const char *text, time_t ts)
+{
+	msgring_entry_t *e;
+
+	return_if_fail(ring != NULL);
+	return_if_fail(text != NULL);
+
+	if (max >= MSGRING_SIZE)
+		max = MSGRING_SIZE - 1;
+
+	while (ring->count > max)
+	{
+		strshare_unref(ring->entries[ring->head].source);
+		ring->head = (ring->head + 1) % MSGRING_SIZE;
+		ring->count--;
+	}
+
+	e = &ring->entries[(ring->head + ring->count) % MSGRING_SIZE];
+	e->time = ts;
+	e->hash = msgring_hash(text);
+	e->source = strshare_ref(source);
+	ring->count++;
+}
+
+void msgring_clear(msgring_t *ring)
+{
+	return_if_fail(ring != NULL);
+
+	while (ring->count > 0)
+	{
+		strshare_unref(ring->entries[ring->head].source);
+		ring->head = (ring->head + 1) % MSGRING_SIZE;
+		ring->count--;
+	}
+
+	ring->head = 0;
+}
+
+/*
+ * msgring_match_newest(const msgring_t *ring, size_t *text_matches, size_t *source_matches, time_t *source_first_seen)
+ *
+ * Counts the messages with the same text and with the same sender as
+ * the newest one (which counts itself), and finds when that sender's
+ * oldest remembered message was seen.
+ */
+void msgring_match_newest(const msgring_t *ring, size_t *text_matches, size_t *source_matches, time_t *source_first_seen)
+{
+	const msgring_entry_t *newest, *e;
+	unsigned int i;
+
+	*text_matches = *source_matches = 0;
+	*source_first_seen = 0;
+
+	return_if_fail(ring != NULL);
+
+	if (ring->count == 0)
+		return;
+
+	newest = MSGRING_NEWEST(ring);
+
+	for (i = 0; i < ring->count; i++)
+	{
+		e = &ring->entries[(ring->head + i) % MSGRING_SIZE];
+
+		if (e->hash == newest->hash)
+			(*text_matches)++;
+
+		if (e->source == newest->source)
+		{
+			(*source_matches)++;
+
+			if (*source_first_seen == 0)
+				*source_first_seen = e->time;
+		}
+	}
+}
+
+/* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
+ * vim:ts=8
+ * vim:sw=8
+ * vim:noexpandtab
+ */
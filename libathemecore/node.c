@@ -29,9 +29,9 @@ mowgli_list_t klnlist;
 mowgli_list_t xlnlist;
 mowgli_list_t qlnlist;
 
-mowgli_heap_t *kline_heap;	/* 16 */
-mowgli_heap_t *xline_heap;	/* 16 */
-mowgli_heap_t *qline_heap;	/* 16 */
+sharedheap_t *kline_heap;	/* 16 */
+sharedheap_t *xline_heap;	/* 16 */
+sharedheap_t *qline_heap;	/* 16 */
 
 /*************
  * L I S T S *
@@ -39,9 +39,9 @@ mowgli_heap_t *qline_heap;	/* 16 */
 
 void init_nodes(void)
 {
-	kline_heap = sharedheap_get(sizeof(kline_t));
-	xline_heap = sharedheap_get(sizeof(xline_t));
-	qline_heap = sharedheap_get(sizeof(qline_t));
+	kline_heap = sharedheap_get_named(sizeof(kline_t), "kline_t");
+	xline_heap = sharedheap_get_named(sizeof(xline_t), "xline_t");
+	qline_heap = sharedheap_get_named(sizeof(qline_t), "qline_t");
 
 	if (kline_heap == NULL || xline_heap == NULL || qline_heap == NULL)
 	{
@@ -55,6 +55,7 @@ void init_nodes(void)
 	init_accounts();
 	init_entities();
 	init_users();
+	init_burst();
 	init_channels();
 	init_privs();
 }
@@ -126,7 +127,7 @@ kline_t *kline_add_with_id(const char *user, const char *host, const char *reaso
 
 	slog(LG_DEBUG, "kline_add(): %s@%s -> %s (%ld)", user, host, reason, duration);
 
-	k = mowgli_heap_alloc(kline_heap);
+	k = sharedheap_alloc(kline_heap);
 
 	mowgli_node_add(k, n, &klnlist);
 
@@ -184,7 +185,7 @@ void kline_delete(kline_t *k)
 	free(k->reason);
 	free(k->setby);
 
-	mowgli_heap_free(kline_heap, k);
+	sharedheap_free(kline_heap, k);
 
 	cnt.kline--;
 }
@@ -280,7 +281,7 @@ xline_t *xline_add(const char *realname, const char *reason, long duration, cons
 
 	slog(LG_DEBUG, "xline_add(): %s -> %s (%ld)", realname, reason, duration);
 
-	x = mowgli_heap_alloc(xline_heap);
+	x = sharedheap_alloc(xline_heap);
 
 	mowgli_node_add(x, n, &xlnlist);
 
@@ -325,7 +326,7 @@ void xline_delete(const char *realname)
 	free(x->reason);
 	free(x->setby);
 
-	mowgli_heap_free(xline_heap, x);
+	sharedheap_free(xline_heap, x);
 
 	cnt.xline--;
 }
@@ -418,7 +419,7 @@ qline_t *qline_add(const char *mask, const char *reason, long duration, const ch
 
 	slog(LG_DEBUG, "qline_add(): %s -> %s (%ld)", mask, reason, duration);
 
-	q = mowgli_heap_alloc(qline_heap);
+	q = sharedheap_alloc(qline_heap);
 	mowgli_node_add(q, n, &qlnlist);
 
 	q->mask = sstrdup(mask);
@@ -462,7 +463,7 @@ void qline_delete(const char *mask)
 	free(q->reason);
 	free(q->setby);
 
-	mowgli_heap_free(qline_heap, q);
+	sharedheap_free(qline_heap, q);
 
 	cnt.qline--;
 }
@@ -27,11 +27,11 @@
 mowgli_list_t object_list = { NULL, NULL, 0 };
 #endif
 
-mowgli_heap_t *metadata_heap;	/* HEAP_CHANUSER */
+sharedheap_t *metadata_heap;	/* HEAP_CHANUSER */
 
 void init_metadata(void)
 {
-	metadata_heap = sharedheap_get(sizeof(metadata_t));
+	metadata_heap = sharedheap_get_named(sizeof(metadata_t), "metadata_t");
 
 	if (metadata_heap == NULL)
 	{
@@ -232,7 +232,7 @@ metadata_t *metadata_add(void *target, const char *name, const char *value)
 	if (metadata_find(target, name))
 		metadata_delete(target, name);
 
-	md = mowgli_heap_alloc(metadata_heap);
+	md = sharedheap_alloc(metadata_heap);
 
 	md->name = strshare_get(name);
 	md->value = sstrdup(value);
@@ -260,7 +260,7 @@ void metadata_delete(void *target, const char *name)
 	strshare_unref(md->name);
 	free(md->value);
 
-	mowgli_heap_free(metadata_heap, md);
+	sharedheap_free(metadata_heap, md);
 }
 
 metadata_t *metadata_find(void *target, const char *name)
@@ -32,6 +32,106 @@ struct timeval burstime;
 
 mowgli_eventloop_timer_t *ping_uplink_timer = NULL;
 
+/* uplink capture, see general::uplink_capture */
+static FILE *capture_fp = NULL;
+static uint64_t capture_last;
+static time_t capture_flushed;
+
+static void irc_capture_open(void)
+{
+	char path[BUFSIZE];
+	struct tm tm;
+	int fd;
+
+	irc_capture_close();
+
+	if (config_options.uplink_capture == NULL)
+		return;
+
+	tm = *localtime(&CURRTIME);
+	if (strftime(path, sizeof path, config_options.uplink_capture, &tm) == 0)
+	{
+		slog(LG_ERROR, "irc_capture_open(): capture file name %s is empty or too long", config_options.uplink_capture);
+		return;
+	}
+
+	/* captures hold passwords sent to services, so keep them private */
+	if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR)) < 0)
+	{
+		slog(LG_ERROR, "irc_capture_open(): cannot open %s: %s", path, strerror(errno));
+		return;
+	}
+
+	/* O_CREAT's mode does not apply to a file which already existed */
+	if (fchmod(fd, S_IRUSR | S_IWUSR) < 0)
+		slog(LG_ERROR, "irc_capture_open(): cannot chmod %s: %s", path, strerror(errno));
+
+	if ((capture_fp = fdopen(fd, "wb")) == NULL)
+	{
+		slog(LG_ERROR, "irc_capture_open(): cannot open %s: %s", path, strerror(errno));
+		close(fd);
+		return;
+	}
+
+	fwrite(UPLINK_CAPTURE_MAGIC, 1, UPLINK_CAPTURE_MAGICLEN, capture_fp);
+	capture_last = mono_usec();
+	capture_flushed = CURRTIME;
+
+	slog(LG_INFO, "irc_capture_open(): capturing uplink lines to %s", path);
+}
+
+void irc_capture_close(void)
+{
+	if (capture_fp == NULL)
+		return;
+
+	if (fclose(capture_fp) != 0)
+		slog(LG_ERROR, "irc_capture_close(): error writing capture file: %s", strerror(errno));
+	capture_fp = NULL;
+}
+
+static size_t capture_varint(unsigned char *p, uint64_t v)
+{
+	size_t n = 0;
+
+	while (v >= 0x80)
+	{
+		p[n++] = (v & 0x7f) | 0x80;
+		v >>= 7;
+	}
+	p[n++] = v;
+
+	return n;
+}
+
+static void irc_capture_line(const char *line, size_t len)
+{
+	unsigned char hdr[20];
+	uint64_t now;
+	size_t n;
+
+	now = mono_usec();
+	n = capture_varint(hdr, now - capture_last);
+	n += capture_varint(hdr + n, len);
+	capture_last = now;
+
+	fwrite(hdr, 1, n, capture_fp);
+	fwrite(line, 1, len, capture_fp);
+
+	/* stdio buffers the writes; push them out about once a second */
+	if (capture_flushed != CURRTIME)
+	{
+		capture_flushed = CURRTIME;
+		fflush(capture_fp);
+	}
+
+	if (ferror(capture_fp))
+	{
+		slog(LG_ERROR, "irc_capture_line(): error writing capture file, capture stopped");
+		irc_capture_close();
+	}
+}
+
 static void irc_recvq_handler(connection_t *cptr)
 {
 	bool wasnonl;
@@ -52,6 +152,8 @@ static void irc_recvq_handler(connection_t *cptr)
 	if (count > 0 && parsebuf[count - 1] == '\r')
 		count--;
 	parsebuf[count] = '\0';
+	if (capture_fp != NULL)
+		irc_capture_line(parsebuf, count);
 	parse(parsebuf);
 }
 
@@ -94,6 +196,7 @@ void irc_handle_connect(connection_t *cptr)
 		/* no SERVER message received */
 		me.recvsvr = false;
 
+		irc_capture_open();
 
 		server_login();
 
@@ -26,7 +26,7 @@
 
 mowgli_patricia_t *pcommands;
 
-mowgli_heap_t *pcommand_heap;
+sharedheap_t *pcommand_heap;
 mowgli_heap_t *messagetree_heap;
 
 struct cmode_ *mode_list;
@@ -41,7 +41,7 @@ bool backend_loaded = false;
 
 void pcommand_init(void)
 {
-	pcommand_heap = sharedheap_get(sizeof(pcommand_t));
+	pcommand_heap = sharedheap_get_named(sizeof(pcommand_t), "pcommand_t");
 
 	if (!pcommand_heap)
 	{
@@ -62,7 +62,7 @@ void pcommand_add(const char *token, void (*handler) (sourceinfo_t *si, int parc
 		return;
 	}
 
-	pcmd = mowgli_heap_alloc(pcommand_heap);
+	pcmd = sharedheap_alloc(pcommand_heap);
 	pcmd->token = sstrdup(token);
 	pcmd->handler = handler;
 	pcmd->minparc = minparc;
@@ -85,7 +85,7 @@ void pcommand_delete(const char *token)
 
 	free(pcmd->token);
 	pcmd->handler = NULL;
-	mowgli_heap_free(pcommand_heap, pcmd);
+	sharedheap_free(pcommand_heap, pcmd);
 }
 
 pcommand_t *pcommand_find(const char *token)
@@ -27,8 +27,8 @@
 mowgli_list_t operclasslist;
 mowgli_list_t soperlist;
 
-mowgli_heap_t *operclass_heap;
-mowgli_heap_t *soper_heap;
+sharedheap_t *operclass_heap;
+sharedheap_t *soper_heap;
 
 static operclass_t *user_r = NULL;
 static operclass_t *authenticated_r = NULL;
@@ -36,8 +36,8 @@ static operclass_t *ircop_r = NULL;
 
 void init_privs(void)
 {
-	operclass_heap = sharedheap_get(sizeof(operclass_t));
-	soper_heap = sharedheap_get(sizeof(soper_t));
+	operclass_heap = sharedheap_get_named(sizeof(operclass_t), "operclass_t");
+	soper_heap = sharedheap_get_named(sizeof(soper_t), "soper_t");
 
 	if (!operclass_heap || !soper_heap)
 	{
@@ -81,7 +81,7 @@ operclass_t *operclass_add(const char *name, const char *privs, int flags)
 
 	slog(LG_DEBUG, "operclass_add(): create %s [%s]", name, privs);
 
-	operclass = mowgli_heap_alloc(operclass_heap);
+	operclass = sharedheap_alloc(operclass_heap);
 	operclass->name = sstrdup(name);
 	operclass->privs = sstrdup(privs);
 	operclass->flags = flags;
@@ -124,7 +124,7 @@ void operclass_delete(operclass_t *operclass)
 	free(operclass->name);
 	free(operclass->privs);
 
-	mowgli_heap_free(operclass_heap, operclass);
+	sharedheap_free(operclass_heap, operclass);
 	cnt.operclass--;
 }
 
@@ -178,7 +178,7 @@ soper_t *soper_add(const char *name, const char *classname, int flags, const cha
 
 	slog(LG_DEBUG, "soper_add(): %s -> %s", (mu) ? entity(mu)->name : name, operclass ? operclass->name : "<null>");
 
-	soper = mowgli_heap_alloc(soper_heap);
+	soper = sharedheap_alloc(soper_heap);
 	n = mowgli_node_create();
 
 	mowgli_node_add(soper, n, &soperlist);
@@ -231,7 +231,7 @@ void soper_delete(soper_t *soper)
 	free(soper->classname);
 	free(soper->password);
 
-	mowgli_heap_free(soper_heap, soper);
+	sharedheap_free(soper_heap, soper);
 
 	cnt.soper--;
 }
@@ -175,6 +175,7 @@ static time_t timeout_query_list(time_t now)
 		{
 			if (--request->retries <= 0)
 			{
+				request->query->nxdomain = false;
 				(*request->query->callback) (request->query->ptr, NULL);
 				rem_request(request);
 				continue;
@@ -795,8 +796,10 @@ static int res_read_single_reply(connection_t *F)
 
 	if ((header->rcode != NO_ERRORS) || (header->ancount == 0))
 	{
-		if (NXDOMAIN == header->rcode)
+		if (NXDOMAIN == header->rcode || NO_ERRORS == header->rcode)
 		{
+			/* the name does not exist, or has no records of this type */
+			request->query->nxdomain = true;
 			(*request->query->callback) (request->query->ptr, NULL);
 			rem_request(request);
 		}
@@ -806,6 +809,7 @@ static int res_read_single_reply(connection_t *F)
 			 * If a bad error was returned, we stop here and dont send
 			 * send any more (no retries granted).
 			 */
+			request->query->nxdomain = false;
 			(*request->query->callback) (request->query->ptr, NULL);
 			rem_request(request);
 		}
@@ -827,6 +831,7 @@ static int res_read_single_reply(connection_t *F)
 				 * got a PTR response with no name, something bogus is happening
 				 * don't bother trying again, the client address doesn't resolve
 				 */
+				request->query->nxdomain = false;
 				(*request->query->callback) (request->query->ptr, reply);
 				rem_request(request);
 				return 1;
@@ -859,6 +864,7 @@ static int res_read_single_reply(connection_t *F)
 	else
 	{
 		/* couldn't decode, give up -- jilles */
+		request->query->nxdomain = false;
 		(*request->query->callback) (request->query->ptr, NULL);
 		rem_request(request);
 	}
@@ -880,6 +886,7 @@ static dns_reply_t *make_dnsreply(struct reslist *request)
 
 	cp->h_name = request->name;
 	memcpy(&cp->addr, &request->addr, sizeof(cp->addr));
+	cp->ttl = request->ttl;
 	return (cp);
 }
 
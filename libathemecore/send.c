@@ -74,8 +74,10 @@ void io_loop(void)
 	while (!(runflags & (RF_SHUTDOWN | RF_RESTART)))
 	{
 		CURRTIME = mowgli_eventloop_get_time(base_eventloop);
+		watchdog_loop_start();
 		mowgli_eventloop_run_once(base_eventloop);
 		check_signals();
+		watchdog_loop_end();
 	}
 }
 
@@ -28,8 +28,8 @@ mowgli_patricia_t *sidlist;
 mowgli_patricia_t *servlist;
 mowgli_list_t tldlist;
 
-mowgli_heap_t *serv_heap;
-mowgli_heap_t *tld_heap;
+sharedheap_t *serv_heap;
+sharedheap_t *tld_heap;
 
 static void server_delete_serv(server_t *s);
 
@@ -50,8 +50,8 @@ static void server_delete_serv(server_t *s);
  */
 void init_servers(void)
 {
-	serv_heap = sharedheap_get(sizeof(server_t));
-	tld_heap = sharedheap_get(sizeof(tld_t));
+	serv_heap = sharedheap_get_named(sizeof(server_t), "server_t");
+	tld_heap = sharedheap_get_named(sizeof(tld_t), "tld_t");
 
 	if (serv_heap == NULL || tld_heap == NULL)
 	{
@@ -104,7 +104,7 @@ server_t *server_add(const char *name, unsigned int hops, server_t *uplink, cons
 	else
 		slog(LG_DEBUG, "server_add(): %s, root", name);
 
-	s = mowgli_heap_alloc(serv_heap);
+	s = sharedheap_alloc(serv_heap);
 
 	if (id != NULL)
 	{
@@ -253,7 +253,7 @@ static void server_delete_serv(server_t *s)
 	if (s->sid)
 		free(s->sid);
 
-	mowgli_heap_free(serv_heap, s);
+	sharedheap_free(serv_heap, s);
 
 	cnt.server--;
 }
@@ -306,7 +306,7 @@ tld_t *tld_add(const char *name)
 
         slog(LG_DEBUG, "tld_add(): %s", name);
 
-        tld = mowgli_heap_alloc(tld_heap);
+        tld = sharedheap_alloc(tld_heap);
 
         mowgli_node_add(tld, n, &tldlist);
 
@@ -350,7 +350,7 @@ void tld_delete(const char *name)
         mowgli_node_free(n);
 
         free(tld->name);
-        mowgli_heap_free(tld_heap, tld);
+        sharedheap_free(tld_heap, tld);
 
         cnt.tld--;
 }
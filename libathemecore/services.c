@@ -445,7 +445,10 @@ void handle_burstlogin(user_t *u, const char *login, time_t ts)
 		/* we're running without a persistent db, create it */
 		mu = myuser_add(login, "*", "noemail", MU_CRYPTPASS);
 		if (ts != 0)
+		{
 			mu->registered = ts;
+			myuser_index_update(mu);
+		}
 		metadata_add(mu, "fake", "1");
 	}
 	if (u->myuser != NULL)	/* already logged in, hmm */
@@ -530,7 +533,10 @@ void handle_setlogin(sourceinfo_t *si, user_t *u, const char *login, time_t ts)
 		/* we're running without a persistent db, create it */
 		mu = myuser_add(login, "*", "noemail", MU_CRYPTPASS);
 		if (ts != 0)
+		{
 			mu->registered = ts;
+			myuser_index_update(mu);
+		}
 		metadata_add(mu, "fake", "1");
 	}
 	else if (ts != 0 && ts != mu->registered)
@@ -549,6 +555,7 @@ void handle_setlogin(sourceinfo_t *si, user_t *u, const char *login, time_t ts)
 				entity(mu)->name, (unsigned long)mu->registered,
 				(unsigned long)ts);
 		mu->registered = ts;
+		myuser_index_update(mu);
 	}
 	u->myuser = mu;
 	u->flags &= ~UF_SOPER_PASS;
@@ -911,11 +918,11 @@ bool bad_password(sourceinfo_t *si, myuser_t *mu, const char *loginmethod)
 	return false;
 }
 
-mowgli_heap_t *sourceinfo_heap = NULL;
+sharedheap_t *sourceinfo_heap = NULL;
 
 static void sourceinfo_delete(sourceinfo_t *si)
 {
-	mowgli_heap_free(sourceinfo_heap, si);
+	sharedheap_free(sourceinfo_heap, si);
 }
 
 sourceinfo_t *sourceinfo_create(void)
@@ -923,9 +930,9 @@ sourceinfo_t *sourceinfo_create(void)
 	sourceinfo_t *out;
 
 	if (sourceinfo_heap == NULL)
-		sourceinfo_heap = sharedheap_get(sizeof(sourceinfo_t));
+		sourceinfo_heap = sharedheap_get_named(sizeof(sourceinfo_t), "sourceinfo_t");
 
-	out = mowgli_heap_alloc(sourceinfo_heap);
+	out = sharedheap_alloc(sourceinfo_heap);
 	object_init(object(out), "<sourceinfo>", (destructor_t) sourceinfo_delete);
 
 	return out;
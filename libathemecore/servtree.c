@@ -25,7 +25,7 @@
 
 mowgli_patricia_t *services_name;
 mowgli_patricia_t *services_nick;
-mowgli_heap_t *service_heap;
+sharedheap_t *service_heap;
 
 void servtree_update(void *dummy);
 
@@ -67,7 +67,7 @@ static void service_default_handler(sourceinfo_t *si, int parc, char *parv[])
 
 void servtree_init(void)
 {
-	service_heap = sharedheap_get(sizeof(service_t));
+	service_heap = sharedheap_get_named(sizeof(service_t), "service_t");
 	services_name = mowgli_patricia_create(strcasecanon);
 	services_nick = mowgli_patricia_create(strcasecanon);
 
@@ -282,7 +282,7 @@ service_t *service_add(const char *name, void (*handler)(sourceinfo_t *si, int p
 	return_val_if_fail(name != NULL, NULL);
 	return_val_if_fail(service_find(name) == NULL, NULL);
 
-	sptr = mowgli_heap_alloc(service_heap);
+	sptr = sharedheap_alloc(service_heap);
 
 	sptr->internal_name = sstrdup(name);
 	/* default these, to reasonably safe values */
@@ -371,7 +371,7 @@ void service_delete(service_t *sptr)
 	free(sptr->host);
 	free(sptr->real);
 
-	mowgli_heap_free(service_heap, sptr);
+	sharedheap_free(service_heap, sptr);
 }
 
 service_t *service_add_static(const char *name, const char *user, const char *host, const char *real, void (*handler)(sourceinfo_t *si, int parc, char *parv[]), service_t *logtarget)
@@ -23,24 +23,34 @@
 
 #include "atheme.h"
 
+/*
+ * Heaps are pooled by element size, so that types of the same size share
+ * their blocks.  Each user gets its own named handle on a pool, carrying
+ * the counts for the memory reports; handles for the same name and size
+ * are shared too, so reloading a module does not add another one.
+ */
+
 typedef struct {
 	object_t parent;
 
 	size_t size;
+	size_t prealloc;
 	mowgli_heap_t *heap;
 
 	mowgli_node_t node;
-} sharedheap_t;
+} sharedheap_pool_t;
+
+static mowgli_list_t sharedheap_pools;
 
 mowgli_list_t sharedheap_list;
 
-static sharedheap_t *sharedheap_find_by_size(size_t size)
+static sharedheap_pool_t *sharedheap_find_by_size(size_t size)
 {
 	mowgli_node_t *n;
 
-	MOWGLI_ITER_FOREACH(n, sharedheap_list.head)
+	MOWGLI_ITER_FOREACH(n, sharedheap_pools.head)
 	{
-		sharedheap_t *s = n->data;
+		sharedheap_pool_t *s = n->data;
 
 		if (s->size == size)
 			return s;
@@ -49,13 +59,13 @@ static sharedheap_t *sharedheap_find_by_size(size_t size)
 	return NULL;
 }
 
-static sharedheap_t *sharedheap_find_by_heap(mowgli_heap_t *heap)
+static sharedheap_pool_t *sharedheap_find_by_heap(mowgli_heap_t *heap)
 {
 	mowgli_node_t *n;
 
-	MOWGLI_ITER_FOREACH(n, sharedheap_list.head)
+	MOWGLI_ITER_FOREACH(n, sharedheap_pools.head)
 	{
-		sharedheap_t *s = n->data;
+		sharedheap_pool_t *s = n->data;
 
 		if (s->heap == heap)
 			return s;
@@ -64,12 +74,12 @@ static sharedheap_t *sharedheap_find_by_heap(mowgli_heap_t *heap)
 	return NULL;
 }
 
-static void sharedheap_destroy(sharedheap_t *s)
+static void sharedheap_destroy(sharedheap_pool_t *s)
 {
 	return_if_fail(s != NULL);
 
 	mowgli_heap_destroy(s->heap);
-	mowgli_node_delete(&s->node, &sharedheap_list);
+	mowgli_node_delete(&s->node, &sharedheap_pools);
 
 	free(s);
 }
@@ -102,31 +112,28 @@ static inline size_t sharedheap_normalize_size(size_t size)
 
 	normalized = ((size / sizeof(void *)) + ((size / sizeof(void *)) % 2)) * sizeof(void *);
 
-	slog(LG_DEBUG, "sharedheap_normalize_size(%zu): normalized=%zu", size, normalized);
-
 	return normalized;
 }
 
-static sharedheap_t *sharedheap_new(size_t size)
+static sharedheap_pool_t *sharedheap_new(size_t size)
 {
-	sharedheap_t *s;
+	sharedheap_pool_t *s;
 
-	s = smalloc(sizeof(sharedheap_t));
+	s = smalloc(sizeof(sharedheap_pool_t));
 	object_init(object(s), NULL, (destructor_t) sharedheap_destroy);
 
 	s->size = size;
-	s->heap = mowgli_heap_create(size, sharedheap_prealloc_size(size), BH_NOW);
+	s->prealloc = sharedheap_prealloc_size(size);
+	s->heap = mowgli_heap_create(size, s->prealloc, BH_NOW);
 
-	mowgli_node_add(s, &s->node, &sharedheap_list);
+	mowgli_node_add(s, &s->node, &sharedheap_pools);
 
 	return object_sink_ref(s);
 }
 
-mowgli_heap_t *sharedheap_get(size_t size)
+static sharedheap_pool_t *sharedheap_pool_get(size_t size)
 {
-	sharedheap_t *s;
-
-	size = sharedheap_normalize_size(size);
+	sharedheap_pool_t *s;
 
 	s = sharedheap_find_by_size(size);
 
@@ -143,12 +150,30 @@ mowgli_heap_t *sharedheap_get(size_t size)
 
 	object_ref(s);
 
+	return s;
+}
+
+/*
+ * sharedheap_get(size_t size)
+ *
+ * The interface from before named handles, kept for modules built
+ * against it: returns the heap for objects of the given size, without a
+ * handle, so nothing allocated from it shows up in the per-type counts.
+ * Release it with sharedheap_unref().
+ */
+mowgli_heap_t *sharedheap_get(size_t size)
+{
+	sharedheap_pool_t *s;
+
+	if ((s = sharedheap_pool_get(sharedheap_normalize_size(size))) == NULL)
+		return NULL;
+
 	return s->heap;
 }
 
 void sharedheap_unref(mowgli_heap_t *heap)
 {
-	sharedheap_t *s;
+	sharedheap_pool_t *s;
 
 	return_if_fail(heap != NULL);
 
@@ -158,3 +183,67 @@ void sharedheap_unref(mowgli_heap_t *heap)
 
 	object_unref(s);
 }
+
+/*
+ * sharedheap_get_named(size_t size, const char *name)
+ *
+ * Returns a handle on the heap for objects of the given size, named after
+ * the type kept in it; allocate with sharedheap_alloc() so that the
+ * objects are counted, and release it with sharedheap_unref_named().
+ */
+sharedheap_t *sharedheap_get_named(size_t size, const char *name)
+{
+	mowgli_node_t *n;
+	sharedheap_t *sh;
+	sharedheap_pool_t *s;
+
+	size = sharedheap_normalize_size(size);
+
+	MOWGLI_ITER_FOREACH(n, sharedheap_list.head)
+	{
+		sh = n->data;
+
+		if (sh->size == size && !strcmp(sh->name, name))
+		{
+			sh->refcount++;
+			return sh;
+		}
+	}
+
+	if ((s = sharedheap_pool_get(size)) == NULL)
+		return NULL;
+
+	sh = smalloc(sizeof(sharedheap_t));
+	sh->name = sstrdup(name);
+	sh->size = size;
+	sh->block = s->prealloc;
+	sh->heap = s->heap;
+	sh->refcount = 1;
+
+	mowgli_node_add(sh, &sh->node, &sharedheap_list);
+
+	return sh;
+}
+
+void sharedheap_unref_named(sharedheap_t *sh)
+{
+	sharedheap_pool_t *s;
+
+	return_if_fail(sh != NULL);
+
+	if (--sh->refcount > 0)
+		return;
+
+	if (sh->live != 0)
+		slog(LG_DEBUG, "sharedheap_unref_named(): %lu %s still allocated", sh->live, sh->name);
+
+	s = sharedheap_find_by_heap(sh->heap);
+
+	mowgli_node_delete(&sh->node, &sharedheap_list);
+	free((char *)sh->name);
+	free(sh);
+
+	return_if_fail(s != NULL);
+
+	object_unref(s);
+}
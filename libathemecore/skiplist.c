@@ -0,0 +1,202 @@
+/*
+ * ChatServices: A collection of minimalist IRC services
+ * skiplist.c: Ordered skip lists.
+ *
+ * Copyright (c) 2018 ChatLounge IRC Network Development Team
+ *     (http://www.chatlounge.net)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * A skip list keeps (key, data) pairs in key order and supports ordered
+ * walks from any key.  Each node carries a copy of its key, so the key
+ * a node was filed under stays known even if the object it describes
+ * has changed since.  Equal keys are allowed and are ordered by the
+ * data pointer, which lets a node be found again in logarithmic time.
+ */
+
+#include "atheme.h"
+
+#define SKIPLIST_MAX_LEVEL	24
+
+struct skiplist_ {
+	skiplist_comparator_t cmp;
+	size_t keysize;
+	size_t count;
+	unsigned int level;
+	skiplist_node_t *head;
+};
+
+skiplist_t *skiplist_create(size_t keysize, skiplist_comparator_t cmp)
+{
+	skiplist_t *sl;
+
+	return_val_if_fail(cmp != NULL, NULL);
+
+	sl = scalloc(sizeof(skiplist_t), 1);
+	sl->cmp = cmp;
+	sl->keysize = keysize;
+	sl->level = 1;
+	sl->head = scalloc(sizeof(skiplist_node_t) + SKIPLIST_MAX_LEVEL * sizeof(skiplist_node_t *), 1);
+	sl->head->level = SKIPLIST_MAX_LEVEL;
+
+	return sl;
+}
+
+void skiplist_destroy(skiplist_t *sl)
+{
+	skiplist_node_t *n, *tn;
+
+	return_if_fail(sl != NULL);
+
+	for (n = sl->head->next[0]; n != NULL; n = tn)
+	{
+		tn = n->next[0];
+		free(n);
+	}
+
+	free(sl->head);
+	free(sl);
+}
+
+/* orders by key, then by data pointer */
+static inline int skiplist_cmp(skiplist_t *sl, const skiplist_node_t *n, const void *key, const void *data)
+{
+	int r = sl->cmp(n->key, key);
+
+	if (r != 0)
+		return r;
+
+	return (uintptr_t)n->data < (uintptr_t)data ? -1 : (uintptr_t)n->data > (uintptr_t)data;
+}
+
+/* fills update[] with the last node on each level before (key, data) */
+static void skiplist_find(skiplist_t *sl, const void *key, const void *data, skiplist_node_t **update)
+{
+	skiplist_node_t *n = sl->head;
+	int i;
+
+	for (i = sl->level - 1; i >= 0; i--)
+	{
+		while (n->next[i] != NULL && skiplist_cmp(sl, n->next[i], key, data) < 0)
+			n = n->next[i];
+		update[i] = n;
+	}
+}
+
+skiplist_node_t *skiplist_insert(skiplist_t *sl, const void *key, void *data)
+{
+	skiplist_node_t *update[SKIPLIST_MAX_LEVEL];
+	skiplist_node_t *n;
+	unsigned int level, i;
+
+	return_val_if_fail(sl != NULL, NULL);
+	return_val_if_fail(key != NULL, NULL);
+
+	/* p = 1/4 */
+	for (level = 1; level < SKIPLIST_MAX_LEVEL && (arc4random() & 3) == 0; level++)
+		;
+
+	n = smalloc(sizeof(skiplist_node_t) + level * sizeof(skiplist_node_t *) + sl->keysize);
+	n->data = data;
+	n->key = &n->next[level];
+	n->level = level;
+	memcpy(n->key, key, sl->keysize);
+
+	skiplist_find(sl, key, data, update);
+
+	for (i = sl->level; i < level; i++)
+		update[i] = sl->head;
+	if (level > sl->level)
+		sl->level = level;
+
+	for (i = 0; i < level; i++)
+	{
+		n->next[i] = update[i]->next[i];
+		update[i]->next[i] = n;
+	}
+
+	sl->count++;
+
+	return n;
+}
+
+void skiplist_delete(skiplist_t *sl, skiplist_node_t *n)
+{
+	skiplist_node_t *update[SKIPLIST_MAX_LEVEL];
+	unsigned int i;
+
+	return_if_fail(sl != NULL);
+	return_if_fail(n != NULL);
+
+	skiplist_find(sl, n->key, n->data, update);
+
+	for (i = 0; i < n->level; i++)
+	{
+		return_if_fail(update[i]->next[i] == n);
+		update[i]->next[i] = n->next[i];
+	}
+
+	while (sl->level > 1 && sl->head->next[sl->level - 1] == NULL)
+		sl->level--;
+
+	sl->count--;
+	free(n);
+}
+
+skiplist_node_t *skiplist_first(skiplist_t *sl)
+{
+	return_val_if_fail(sl != NULL, NULL);
+
+	return sl->head->next[0];
+}
+
+/*
+ * skiplist_seek(skiplist_t *sl, const void *key)
+ *
+ * Returns the first node whose key is not less than the given key,
+ * or NULL if there is none.
+ */
+skiplist_node_t *skiplist_seek(skiplist_t *sl, const void *key)
+{
+	skiplist_node_t *n;
+	int i;
+
+	return_val_if_fail(sl != NULL, NULL);
+	return_val_if_fail(key != NULL, NULL);
+
+	n = sl->head;
+	for (i = sl->level - 1; i >= 0; i--)
+		while (n->next[i] != NULL && sl->cmp(n->next[i]->key, key) < 0)
+			n = n->next[i];
+
+	return n->next[0];
+}
+
+size_t skiplist_size(skiplist_t *sl)
+{
+	return_val_if_fail(sl != NULL, 0);
+
+	return sl->count;
+}
+
+/* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
+ * vim:ts=8
+ * vim:sw=8
+ * vim:noexpandtab
+ */
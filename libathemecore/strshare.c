@@ -23,36 +23,170 @@
 
 #include "atheme.h"
 
-mowgli_patricia_t *strshare_dict;
+/*
+ * Shared strings are kept in an open-addressing hash table (linear
+ * probing, backward-shift deletion) of pointers to strshare_t headers.
+ * The string itself follows its header.  Each entry caches its hash, so
+ * lookups rarely touch strings which do not match and the table can be
+ * grown without rehashing.  Small strings are carved out of per-size
+ * block heaps instead of being malloc()ed one at a time.
+ */
 
 typedef struct
 {
-	int refcount;
+	unsigned int refcount;
+	unsigned int hash;
+	unsigned int len;
 } strshare_t;
 
+#define STRSHARE_MIN_SIZE	1024	/* initial table slots, power of two */
+
+/* block heaps for header + string, by total size */
+static const size_t strshare_class_size[] = { 32, 48, 64, 96, 128 };
+#define STRSHARE_NCLASSES	ARRAY_SIZE(strshare_class_size)
+
+static sharedheap_t *strshare_heap[STRSHARE_NCLASSES];
+
+static strshare_t **strshare_table;
+static size_t strshare_size;	/* slots, power of two */
+static size_t strshare_count;	/* used slots */
+static size_t strshare_bytes;	/* string bytes, excluding headers */
+static size_t strshare_large;	/* strings too long for the heaps */
+static size_t strshare_large_bytes;
+
+static inline unsigned int strshare_hash(const char *str, size_t *len)
+{
+	const unsigned char *p = (const unsigned char *)str;
+	unsigned int h = 2166136261U;	/* FNV-1a */
+
+	while (*p != '\0')
+	{
+		h ^= *p++;
+		h *= 16777619U;
+	}
+
+	*len = (const char *)p - str;
+	return h;
+}
+
+static inline const char *strshare_str(strshare_t *ss)
+{
+	return (const char *)(ss + 1);
+}
+
+static inline strshare_t *strshare_header(stringref str)
+{
+	/* intermediate cast to suppress gcc -Wcast-qual */
+	return (strshare_t *)(uintptr_t)str - 1;
+}
+
+static inline int strshare_class(size_t len)
+{
+	size_t total = sizeof(strshare_t) + len + 1;
+	unsigned int i;
+
+	for (i = 0; i < STRSHARE_NCLASSES; i++)
+		if (total <= strshare_class_size[i])
+			return i;
+
+	return -1;
+}
+
+static strshare_t *strshare_alloc(size_t len)
+{
+	int class = strshare_class(len);
+
+	if (class < 0)
+	{
+		strshare_large++;
+		strshare_large_bytes += sizeof(strshare_t) + len + 1;
+		return smalloc(sizeof(strshare_t) + len + 1);
+	}
+
+	return sharedheap_alloc(strshare_heap[class]);
+}
+
+static void strshare_free(strshare_t *ss)
+{
+	int class = strshare_class(ss->len);
+
+	if (class < 0)
+	{
+		strshare_large--;
+		strshare_large_bytes -= sizeof(strshare_t) + ss->len + 1;
+		free(ss);
+	}
+	else
+		sharedheap_free(strshare_heap[class], ss);
+}
+
+static void strshare_resize(size_t newsize)
+{
+	strshare_t **old = strshare_table;
+	size_t oldsize = strshare_size, i, j;
+
+	strshare_table = scalloc(newsize, sizeof(strshare_t *));
+	strshare_size = newsize;
+
+	for (i = 0; i < oldsize; i++)
+	{
+		if (old[i] == NULL)
+			continue;
+
+		for (j = old[i]->hash & (newsize - 1); strshare_table[j] != NULL; j = (j + 1) & (newsize - 1))
+			;
+		strshare_table[j] = old[i];
+	}
+
+	free(old);
+}
+
 void strshare_init(void)
 {
-	strshare_dict = mowgli_patricia_create(noopcanon);
+	unsigned int i;
+
+	for (i = 0; i < STRSHARE_NCLASSES; i++)
+		strshare_heap[i] = sharedheap_get_named(strshare_class_size[i], "strshare_t");
+
+	strshare_table = scalloc(STRSHARE_MIN_SIZE, sizeof(strshare_t *));
+	strshare_size = STRSHARE_MIN_SIZE;
 }
 
 stringref strshare_get(const char *str)
 {
 	strshare_t *ss;
+	unsigned int hash;
+	size_t len, i;
 
 	if (str == NULL)
 		return NULL;
 
-	ss = mowgli_patricia_retrieve(strshare_dict, str);
-	if (ss != NULL)
-		ss->refcount++;
-	else
+	hash = strshare_hash(str, &len);
+
+	for (i = hash & (strshare_size - 1); (ss = strshare_table[i]) != NULL; i = (i + 1) & (strshare_size - 1))
 	{
-		ss = smalloc(sizeof(strshare_t) + strlen(str) + 1);
-		ss->refcount = 1;
-		strcpy((char *)(ss + 1), str);
-		mowgli_patricia_add(strshare_dict, (char *)(ss + 1), ss);
+		if (ss->hash == hash && ss->len == len && !memcmp(strshare_str(ss), str, len))
+		{
+			ss->refcount++;
+			return strshare_str(ss);
+		}
 	}
-	return (char *)(ss + 1);
+
+	ss = strshare_alloc(len);
+	ss->refcount = 1;
+	ss->hash = hash;
+	ss->len = len;
+	memcpy((char *)(ss + 1), str, len + 1);
+
+	strshare_table[i] = ss;
+	strshare_count++;
+	strshare_bytes += len + 1;
+
+	/* keep the load factor below 3/4 */
+	if (strshare_count * 4 >= strshare_size * 3)
+		strshare_resize(strshare_size * 2);
+
+	return strshare_str(ss);
 }
 
 stringref strshare_ref(stringref str)
@@ -62,13 +196,36 @@ stringref strshare_ref(stringref str)
 	if (str == NULL)
 		return NULL;
 
-	/* intermediate cast to suppress gcc -Wcast-qual */
-	ss = (strshare_t *)(uintptr_t)str - 1;
+	ss = strshare_header(str);
 	ss->refcount++;
 
 	return str;
 }
 
+static void strshare_remove(strshare_t *ss)
+{
+	size_t i, j, home;
+
+	for (i = ss->hash & (strshare_size - 1); strshare_table[i] != ss; i = (i + 1) & (strshare_size - 1))
+		;
+
+	/* backward-shift deletion: move up entries which probed past i */
+	for (j = (i + 1) & (strshare_size - 1); strshare_table[j] != NULL; j = (j + 1) & (strshare_size - 1))
+	{
+		home = strshare_table[j]->hash & (strshare_size - 1);
+
+		if (((j - home) & (strshare_size - 1)) >= ((j - i) & (strshare_size - 1)))
+		{
+			strshare_table[i] = strshare_table[j];
+			i = j;
+		}
+	}
+
+	strshare_table[i] = NULL;
+	strshare_count--;
+	strshare_bytes -= ss->len + 1;
+}
+
 void strshare_unref(stringref str)
 {
 	strshare_t *ss;
@@ -76,16 +233,36 @@ void strshare_unref(stringref str)
 	if (str == NULL)
 		return;
 
-	/* intermediate cast to suppress gcc -Wcast-qual */
-	ss = (strshare_t *)(uintptr_t)str - 1;
+	ss = strshare_header(str);
 	ss->refcount--;
 	if (ss->refcount == 0)
 	{
-		mowgli_patricia_delete(strshare_dict, str);
-		free(ss);
+		strshare_remove(ss);
+		strshare_free(ss);
 	}
 }
 
+void strshare_stats(size_t *count, size_t *bytes)
+{
+	if (count != NULL)
+		*count = strshare_count;
+	if (bytes != NULL)
+		*bytes = strshare_bytes;
+}
+
+/*
+ * strshare_memstats()
+ *
+ * The memory held outside the block heaps, which account for themselves:
+ * strings too long for them, which are malloc()ed, and the hash table.
+ */
+void strshare_memstats(size_t *large, size_t *large_bytes, size_t *table_bytes)
+{
+	*large = strshare_large;
+	*large_bytes = strshare_large_bytes;
+	*table_bytes = strshare_size * sizeof(strshare_t *);
+}
+
 /* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
  * vim:ts=8
  * vim:sw=8
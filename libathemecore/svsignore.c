@@ -21,10 +21,150 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+/*
+ * Lookup index.
+ *
+ * svsignore_find() is called for every message sent to a service, so
+ * instead of matching the user against every ignore, each ignore is
+ * filed under the literal end of its host part:
+ *
+ *   - "*!*@host.example.com" under "host.example.com",
+ *   - "*!*@*.example.com" and "*!*@foo*.example.com" under ".example.com",
+ *   - "*!*@192.0.2.0/24" in the CIDR list,
+ *   - anything else ("*!*@*", "nick!*@*") in the wildcard list.
+ *
+ * A lookup only visits the buckets for the user's full host and for each
+ * of its suffixes starting at a dot, plus the two small lists.  Entries
+ * found there are then matched properly, so the index only has to be
+ * conservative.  Entries carry a serial so the oldest matching ignore is
+ * returned, as with a linear scan of svs_ignore_list.
+ *
+ * The result is cached on the user and recomputed when the ignore list
+ * changes or svsignore_invalidate() is called after a nick, ident or host
+ * change.
+ */
+
 #include "atheme.h"
 
 mowgli_list_t svs_ignore_list;
 
+static mowgli_patricia_t *svsignore_buckets;
+static mowgli_list_t svsignore_cidr;
+static mowgli_list_t svsignore_wild;
+
+static unsigned int svsignore_serial;
+static unsigned int svsignore_gen = 1;
+
+static void svsignore_changed(void)
+{
+	/* zero marks a stale cache entry */
+	if (++svsignore_gen == 0)
+		svsignore_gen = 1;
+}
+
+static bool svsignore_is_wild(char c)
+{
+	return c == '*' || c == '?' || c == '&' || c == '#' || c == '%' || c == '\\';
+}
+
+/*
+ * Picks the index list for a mask.  Returns one of the fixed lists, or
+ * NULL with *key set to the bucket name.
+ */
+static mowgli_list_t *svsignore_classify(const char *mask, const char **key)
+{
+	const char *host, *p, *tail;
+	bool wild = false;
+
+	*key = NULL;
+
+	if ((host = strrchr(mask, '@')) == NULL)
+		return &svsignore_wild;
+
+	tail = ++host;
+	for (p = host; *p != '\0'; p++)
+	{
+		if (svsignore_is_wild(*p))
+		{
+			wild = true;
+			tail = p + 1;
+		}
+	}
+
+	if (!wild && strchr(host, '/') != NULL)
+		return &svsignore_cidr;
+
+	if (wild)
+		tail = strchr(tail, '.');
+
+	if (tail == NULL || *tail == '\0')
+		return &svsignore_wild;
+
+	*key = tail;
+	return NULL;
+}
+
+static void svsignore_index(svsignore_t *svsignore)
+{
+	const char *key;
+
+	svsignore->compiled = match_compile(svsignore->mask);
+	svsignore->bucket = svsignore_classify(svsignore->mask, &key);
+
+	if (svsignore->bucket == NULL)
+	{
+		if (svsignore_buckets == NULL)
+			svsignore_buckets = mowgli_patricia_create(irccasecanon);
+
+		svsignore->bucket = mowgli_patricia_retrieve(svsignore_buckets, key);
+		if (svsignore->bucket == NULL)
+		{
+			svsignore->bucket = mowgli_list_create();
+			mowgli_patricia_add(svsignore_buckets, key, svsignore->bucket);
+		}
+	}
+
+	mowgli_node_add(svsignore, &svsignore->bucketnode, svsignore->bucket);
+}
+
+static void svsignore_unindex(svsignore_t *svsignore)
+{
+	const char *key;
+
+	mowgli_node_delete(&svsignore->bucketnode, svsignore->bucket);
+
+	if (svsignore_classify(svsignore->mask, &key) == NULL && MOWGLI_LIST_LENGTH(svsignore->bucket) == 0)
+	{
+		mowgli_patricia_delete(svsignore_buckets, key);
+		mowgli_list_free(svsignore->bucket);
+	}
+
+	svsignore->bucket = NULL;
+	match_mask_free(svsignore->compiled);
+	svsignore->compiled = NULL;
+}
+
+/* keeps the oldest matching entry of a bucket in *best */
+static void svsignore_scan(mowgli_list_t *bucket, const char *nuh, const char *nuip, svsignore_t **best)
+{
+	mowgli_node_t *n;
+	svsignore_t *svsignore;
+
+	if (bucket == NULL)
+		return;
+
+	MOWGLI_ITER_FOREACH(n, bucket->head)
+	{
+		svsignore = (svsignore_t *)n->data;
+
+		if (*best != NULL && (*best)->serial < svsignore->serial)
+			continue;
+
+		if (!match_compiled(svsignore->compiled, nuh) || (nuip != NULL && !match_cidr(svsignore->mask, nuip)))
+			*best = svsignore;
+	}
+}
+
 /*
  * svsignore_add(const char *mask, const char *reason)
  *
@@ -55,8 +195,12 @@ svsignore_t *svsignore_add(const char *mask, const char *reason)
         svsignore->mask = sstrdup(mask);
         svsignore->settime = CURRTIME;
         svsignore->reason = sstrdup(reason);
+        svsignore->serial = ++svsignore_serial;
         cnt.svsignore++;
 
+	svsignore_index(svsignore);
+	svsignore_changed();
+
         return svsignore;
 }
 
@@ -77,29 +221,59 @@ svsignore_t *svsignore_add(const char *mask, const char *reason)
  */
 svsignore_t *svsignore_find(user_t *source)
 {
-        svsignore_t *svsignore;
-        mowgli_node_t *n;
-        char host[BUFSIZE];
+	svsignore_t *svsignore = NULL;
+	char host[BUFSIZE], ip[BUFSIZE];
+	const char *p;
 
 	if (!use_svsignore)
 		return NULL;
 
-        *host = '\0';
-        mowgli_strlcpy(host, source->nick, BUFSIZE);
-        mowgli_strlcat(host, "!", BUFSIZE);
-        mowgli_strlcat(host, source->user, BUFSIZE);
-        mowgli_strlcat(host, "@", BUFSIZE);
-        mowgli_strlcat(host, source->host, BUFSIZE);
+	if (source->svsignoregen == svsignore_gen)
+		return source->svsignore;
+
+	snprintf(host, sizeof host, "%s!%s@%s", source->nick, source->user, source->host);
+	if (source->ip != NULL)
+		snprintf(ip, sizeof ip, "%s!%s@%s", source->nick, source->user, source->ip);
 
-        MOWGLI_ITER_FOREACH(n, svs_ignore_list.head)
-        {
-                svsignore = (svsignore_t *)n->data;
+	if (svsignore_buckets != NULL)
+	{
+		p = source->host;
+		svsignore_scan(mowgli_patricia_retrieve(svsignore_buckets, p), host, NULL, &svsignore);
 
-                if (!match(svsignore->mask, host))
-                        return svsignore;
-        }
+		while ((p = strchr(p, '.')) != NULL)
+		{
+			svsignore_scan(mowgli_patricia_retrieve(svsignore_buckets, p), host, NULL, &svsignore);
+			p++;
+		}
+	}
 
-        return NULL;
+	svsignore_scan(&svsignore_cidr, host, source->ip != NULL ? ip : NULL, &svsignore);
+	svsignore_scan(&svsignore_wild, host, NULL, &svsignore);
+
+	source->svsignore = svsignore;
+	source->svsignoregen = svsignore_gen;
+
+	return svsignore;
+}
+
+/*
+ * svsignore_invalidate(user_t *user)
+ *
+ * Forgets the cached svsignore_find() result for a user.
+ *
+ * Inputs:
+ *     - user whose nick, ident or host has changed
+ *
+ * Outputs:
+ *     - nothing
+ *
+ * Side Effects:
+ *     - the next svsignore_find() for the user does a full lookup
+ */
+void svsignore_invalidate(user_t *user)
+{
+	user->svsignore = NULL;
+	user->svsignoregen = 0;
 }
 
 /*
@@ -122,8 +296,14 @@ void svsignore_delete(svsignore_t *svsignore)
 
 	n = mowgli_node_find(svsignore, &svs_ignore_list);
 	mowgli_node_delete(n, &svs_ignore_list);
+	mowgli_node_free(n);
+
+	svsignore_unindex(svsignore);
+	svsignore_changed();
+	cnt.svsignore--;
 
 	free(svsignore->mask);
+	free(svsignore->setby);
 	free(svsignore->reason);
 	free(svsignore);
 }
@@ -0,0 +1,328 @@
+/*
+ * ChatServices: A collection of minimalist IRC services
+ * trigram.c: Trigram indexes for wildcard searches.
+ *
+ * Copyright (c) 2018 ChatLounge IRC Network Development Team
+ *     (http://www.chatlounge.net)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * A trigram index maps every three character substring of some text,
+ * folded with ToLower() the same way match() folds, to the objects whose
+ * text contains it.  Any name matched by a mask must contain each
+ * literal run of the mask, so the objects posted under the rarest
+ * trigram of the mask are a superset of the matches and only those need
+ * to be checked with match().
+ *
+ * Deleted entries are only marked dead and are swept out of the posting
+ * lists once they outnumber the live references.
+ */
+
+#include "atheme.h"
+
+/* sweep dead references once there are at least this many of them */
+#define TRIGRAM_COMPACT_MIN	4096
+
+typedef struct {
+	char *key;
+	void *obj;
+	unsigned int refs;
+	bool dead;
+	mowgli_node_t deadnode;
+} trigram_entry_t;
+
+typedef struct {
+	char key[4];
+	trigram_entry_t **v;
+	unsigned int count, size;
+} trigram_posting_t;
+
+struct trigram_index_ {
+	mowgli_patricia_t *entries;
+	mowgli_patricia_t *postings;
+	mowgli_list_t dead;
+	size_t liverefs, deadrefs;
+};
+
+static int trigram_cmp(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static inline uint32_t trigram_pack(unsigned char a, unsigned char b, unsigned char c)
+{
+	return (uint32_t)ToLower(a) << 16 | (uint32_t)ToLower(b) << 8 | (uint32_t)ToLower(c);
+}
+
+static inline void trigram_unpack(uint32_t tg, char *buf)
+{
+	buf[0] = (tg >> 16) & 0xFF;
+	buf[1] = (tg >> 8) & 0xFF;
+	buf[2] = tg & 0xFF;
+	buf[3] = '\0';
+}
+
+trigram_index_t *trigram_index_create(void)
+{
+	trigram_index_t *ti;
+
+	ti = scalloc(sizeof(trigram_index_t), 1);
+	ti->entries = mowgli_patricia_create(irccasecanon);
+	ti->postings = mowgli_patricia_create(noopcanon);
+
+	return ti;
+}
+
+static void trigram_entry_free(trigram_entry_t *e)
+{
+	free(e->key);
+	free(e);
+}
+
+static void trigram_posting_destroy_cb(const char *key, void *data, void *privdata)
+{
+	trigram_posting_t *p = data;
+
+	free(p->v);
+	free(p);
+}
+
+static void trigram_entry_destroy_cb(const char *key, void *data, void *privdata)
+{
+	trigram_entry_free(data);
+}
+
+void trigram_index_destroy(trigram_index_t *ti)
+{
+	mowgli_node_t *n, *tn;
+
+	return_if_fail(ti != NULL);
+
+	mowgli_patricia_destroy(ti->postings, trigram_posting_destroy_cb, NULL);
+	mowgli_patricia_destroy(ti->entries, trigram_entry_destroy_cb, NULL);
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, ti->dead.head)
+	{
+		mowgli_node_delete(n, &ti->dead);
+		trigram_entry_free(n->data);
+	}
+
+	free(ti);
+}
+
+/* drops dead references from every posting list */
+static void trigram_index_compact(trigram_index_t *ti)
+{
+	mowgli_patricia_iteration_state_t state;
+	trigram_posting_t *p;
+	mowgli_node_t *n, *tn;
+	unsigned int i, j;
+
+	MOWGLI_PATRICIA_FOREACH(p, &state, ti->postings)
+	{
+		for (i = j = 0; i < p->count; i++)
+			if (!p->v[i]->dead)
+				p->v[j++] = p->v[i];
+		p->count = j;
+
+		if (p->count == 0)
+		{
+			mowgli_patricia_delete(ti->postings, p->key);
+			free(p->v);
+			free(p);
+		}
+	}
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, ti->dead.head)
+	{
+		mowgli_node_delete(n, &ti->dead);
+		trigram_entry_free(n->data);
+	}
+
+	ti->deadrefs = 0;
+}
+
+void trigram_index_delete(trigram_index_t *ti, const char *key)
+{
+	trigram_entry_t *e;
+
+	return_if_fail(ti != NULL);
+	return_if_fail(key != NULL);
+
+	if ((e = mowgli_patricia_delete(ti->entries, key)) == NULL)
+		return;
+
+	if (e->refs == 0)
+	{
+		trigram_entry_free(e);
+		return;
+	}
+
+	e->dead = true;
+	mowgli_node_add(e, &e->deadnode, &ti->dead);
+	ti->liverefs -= e->refs;
+	ti->deadrefs += e->refs;
+
+	if (ti->deadrefs >= TRIGRAM_COMPACT_MIN && ti->deadrefs > ti->liverefs)
+		trigram_index_compact(ti);
+}
+
+/*
+ * trigram_index_add(trigram_index_t *ti, const char *key, void *obj, const char *text)
+ *
+ * Indexes obj under key by the trigrams of text, replacing any entry
+ * which already exists for key.
+ */
+void trigram_index_add(trigram_index_t *ti, const char *key, void *obj, const char *text)
+{
+	trigram_entry_t *e;
+	trigram_posting_t *p;
+	uint32_t *tgs;
+	size_t len, count, i;
+	char buf[4];
+
+	return_if_fail(ti != NULL);
+	return_if_fail(key != NULL);
+	return_if_fail(text != NULL);
+
+	trigram_index_delete(ti, key);
+
+	e = scalloc(sizeof(trigram_entry_t), 1);
+	e->key = sstrdup(key);
+	e->obj = obj;
+	mowgli_patricia_add(ti->entries, e->key, e);
+
+	if ((len = strlen(text)) < 3)
+		return;
+
+	tgs = smalloc((len - 2) * sizeof(uint32_t));
+	for (i = 0; i < len - 2; i++)
+		tgs[i] = trigram_pack(text[i], text[i + 1], text[i + 2]);
+
+	/* each object is posted once per distinct trigram */
+	qsort(tgs, len - 2, sizeof(uint32_t), trigram_cmp);
+	for (i = count = 0; i < len - 2; i++)
+		if (count == 0 || tgs[count - 1] != tgs[i])
+			tgs[count++] = tgs[i];
+
+	for (i = 0; i < count; i++)
+	{
+		trigram_unpack(tgs[i], buf);
+
+		if ((p = mowgli_patricia_retrieve(ti->postings, buf)) == NULL)
+		{
+			p = scalloc(sizeof(trigram_posting_t), 1);
+			memcpy(p->key, buf, sizeof p->key);
+			mowgli_patricia_add(ti->postings, p->key, p);
+		}
+
+		if (p->count == p->size)
+		{
+			p->size = p->size ? p->size * 2 : 4;
+			p->v = srealloc(p->v, p->size * sizeof(trigram_entry_t *));
+		}
+
+		p->v[p->count++] = e;
+	}
+
+	e->refs = count;
+	ti->liverefs += count;
+
+	free(tgs);
+}
+
+unsigned int trigram_index_size(trigram_index_t *ti)
+{
+	return_val_if_fail(ti != NULL, 0);
+
+	return mowgli_patricia_size(ti->entries);
+}
+
+/*
+ * trigram_index_search(trigram_index_t *ti, const char *mask, trigram_search_cb_t cb, void *privdata)
+ *
+ * Calls cb for every live entry whose text may match the given match()
+ * mask.  Candidates still need to be checked with match().
+ *
+ * Returns false without calling cb if the mask has no literal run of
+ * three or more characters to search by; the caller must then fall
+ * back to checking every object.
+ */
+bool trigram_index_search(trigram_index_t *ti, const char *mask, trigram_search_cb_t cb, void *privdata)
+{
+	const unsigned char *m;
+	trigram_posting_t *p, *best = NULL;
+	unsigned char run[3];
+	size_t runlen = 0;
+	bool found = false;
+	unsigned int i;
+	char buf[4];
+
+	return_val_if_fail(ti != NULL, false);
+	return_val_if_fail(mask != NULL, false);
+
+	for (m = (const unsigned char *)mask; *m != '\0'; m++)
+	{
+		unsigned char c = *m;
+
+		if (c == '*' || c == '?' || c == '&' || c == '#' || c == '%')
+		{
+			runlen = 0;
+			continue;
+		}
+
+		/* \ only escapes the wildcards, otherwise it is literal */
+		if (c == '\\' && m[1] != '\0' && strchr("*?&#%", m[1]) != NULL)
+			c = *++m;
+
+		run[0] = run[1];
+		run[1] = run[2];
+		run[2] = c;
+
+		if (++runlen < 3)
+			continue;
+
+		found = true;
+		trigram_unpack(trigram_pack(run[0], run[1], run[2]), buf);
+
+		/* a trigram nothing contains: nothing can match */
+		if ((p = mowgli_patricia_retrieve(ti->postings, buf)) == NULL)
+			return true;
+
+		if (best == NULL || p->count < best->count)
+			best = p;
+	}
+
+	if (!found)
+		return false;
+
+	for (i = 0; i < best->count; i++)
+		if (!best->v[i]->dead)
+			cb(best->v[i]->key, best->v[i]->obj, privdata);
+
+	return true;
+}
+
+/* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
+ * vim:ts=8
+ * vim:sw=8
+ * vim:noexpandtab
+ */
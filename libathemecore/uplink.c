@@ -30,13 +30,13 @@ void (*parse) (char *line) = NULL;
 mowgli_list_t uplinks;
 uplink_t *curr_uplink;
 
-mowgli_heap_t *uplink_heap;
+sharedheap_t *uplink_heap;
 
 static void uplink_close(connection_t *cptr);
 
 void init_uplinks(void)
 {
-	uplink_heap = sharedheap_get(sizeof(uplink_t));
+	uplink_heap = sharedheap_get_named(sizeof(uplink_t), "uplink_t");
 	if (!uplink_heap)
 	{
 		slog(LG_INFO, "init_uplinks(): block allocator failed.");
@@ -70,7 +70,7 @@ uplink_t *uplink_add(const char *name, const char *host, const char *send_passwo
 	}
 	else
 	{
-		u = mowgli_heap_alloc(uplink_heap);
+		u = sharedheap_alloc(uplink_heap);
 		mowgli_node_add(u, &u->node, &uplinks);
 		cnt.uplink++;
 	}
@@ -96,7 +96,7 @@ void uplink_delete(uplink_t * u)
 		free(u->vhost);
 
 	mowgli_node_delete(&u->node, &uplinks);
-	mowgli_heap_free(uplink_heap, u);
+	sharedheap_free(uplink_heap, u);
 
 	cnt.uplink--;
 }
@@ -187,6 +187,8 @@ static void uplink_close(connection_t *cptr)
 
 	me.connected = false;
 
+	irc_capture_close();
+
 	if (curr_uplink->flags & UPF_ILLEGAL)
 	{
 		slog(LG_INFO, "uplink_close(): %s was removed from configuration, deleting", curr_uplink->name);
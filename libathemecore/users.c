@@ -25,7 +25,7 @@
 
 #include "atheme.h"
 
-mowgli_heap_t *user_heap;
+sharedheap_t *user_heap;
 
 mowgli_patricia_t *userlist;
 mowgli_patricia_t *uidlist;
@@ -46,7 +46,7 @@ mowgli_patricia_t *uidlist;
  */
 void init_users(void)
 {
-	user_heap = sharedheap_get(sizeof(user_t));
+	user_heap = sharedheap_get_named(sizeof(user_t), "user_t");
 
 	if (user_heap == NULL)
 	{
@@ -152,7 +152,7 @@ user_t *user_add(const char *nick, const char *user, const char *host,
 		}
 	}
 
-	u = mowgli_heap_alloc(user_heap);
+	u = sharedheap_alloc(user_heap);
 	object_init(object(u), nick, (destructor_t) user_delete);
 
 	if (uid != NULL)
@@ -183,7 +183,10 @@ user_t *user_add(const char *nick, const char *user, const char *host,
 
 	hdata.u = u;
 	hdata.oldnick = NULL;
-	hook_call_user_add(&hdata);
+	if (burst_is_deferring(server))
+		burst_user_add(&hdata);
+	else
+		hook_call_user_add(&hdata);
 
 	return hdata.u;
 }
@@ -229,6 +232,8 @@ void user_delete(user_t *u, const char *comment)
 				.comment = comment}));
 	hook_call_user_delete(u);
 
+	burst_cancel(&u->burstnode);
+
 	u->server->users--;
 	if (is_ircop(u))
 		u->server->opers--;
@@ -280,7 +285,7 @@ void user_delete(user_t *u, const char *comment)
 	strshare_unref(u->chost);
 	strshare_unref(u->ip);
 
-	mowgli_heap_free(user_heap, u);
+	sharedheap_free(user_heap, u);
 
 	cnt.user--;
 
@@ -495,6 +500,7 @@ bool user_changenick(user_t *u, const char *nick, time_t ts)
 
 	strshare_unref(u->nick);
 	u->nick = strshare_get(nick);
+	svsignore_invalidate(u);
 
 	u->ts = ts;
 
@@ -0,0 +1,450 @@
+/*
+ * ChatServices: A collection of minimalist IRC services
+ * watchdog.c: Event loop stall detection.
+ *
+ * Copyright (c) 2018 ChatLounge IRC Network Development Team
+ *     (http://www.chatlounge.net)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Everything services does happens inside one event loop iteration, so
+ * an iteration which runs for seconds means the uplink, httpd clients and
+ * everyone else are waiting.  io_loop() stamps the start of each
+ * iteration; a separate thread checks that stamp and, once it is older
+ * than general::stall_threshold, logs what the main thread was running
+ * and a backtrace taken from inside it.  A one second timer keeps the
+ * loop waking up while idle, so waiting in poll() never counts as a
+ * stall.
+ *
+ * The watchdog thread never follows a pointer into services' data: the
+ * main thread publishes copies of the command and hook names under
+ * watchdog_lock whenever loop_activity changes, and the thread logs to a
+ * descriptor of its own, not through the logfile_t which a rehash may
+ * close.  The timer run by the iteration is only known to the main
+ * thread, which names it when it logs the stall after the iteration.
+ */
+
+#include "atheme.h"
+#include <signal.h>
+#include <fcntl.h>
+
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
+#ifdef HAVE_EXECINFO_H
+# include <execinfo.h>
+#endif
+
+#if defined(HAVE_PTHREAD) && defined(HAVE_BACKTRACE) && defined(HAVE_EXECINFO_H) && defined(SIGPROF)
+# define WATCHDOG_BACKTRACE
+#endif
+
+#define WATCHDOG_TIMER		"watchdog"
+
+/* the idle loop wakes up this often, in seconds */
+#define WATCHDOG_TICK		1
+
+/* how often the watchdog thread checks the loop, in ms */
+#define WATCHDOG_POLL_MS	250
+
+/* how long to wait for the main thread to take its backtrace, in ms */
+#define WATCHDOG_SAMPLE_MS	100
+
+#define WATCHDOG_FRAMES		48
+
+/* longest name kept of a service, command, hook or module */
+#define WATCHDOG_NAMELEN	64
+
+loop_activity_t loop_activity;
+histogram_t loop_stalls;
+
+static unsigned int watchdog_threshold;		/* seconds, 0 if disabled */
+static mowgli_eventloop_timer_t *watchdog_timer;
+static const char *watchdog_last_ran;
+static volatile uint64_t loop_started;
+
+#ifdef HAVE_PTHREAD
+static bool watchdog_running;
+static pthread_t main_thread;
+static pthread_mutex_t watchdog_lock = PTHREAD_MUTEX_INITIALIZER;
+static int watchdog_log_fd = -1;
+
+/* copied from loop_activity by the main thread, under watchdog_lock */
+static struct {
+	char service[WATCHDOG_NAMELEN];
+	char command[WATCHDOG_NAMELEN];
+	char hook[WATCHDOG_NAMELEN];
+	char hook_owner[WATCHDOG_NAMELEN];
+} watchdog_activity;
+
+/* written by the watchdog thread under watchdog_lock */
+static uint64_t stall_reported;
+static char stall_where[BUFSIZE];
+#endif
+
+#ifdef WATCHDOG_BACKTRACE
+static void *stall_frames[WATCHDOG_FRAMES];
+static volatile sig_atomic_t stall_nframes;
+static volatile sig_atomic_t stall_sampled;
+#endif
+
+static void watchdog_tick(void *unused)
+{
+	/* nothing to do; waking the loop up is the point */
+}
+
+/*
+ * watchdog_publish()
+ *
+ * Called by the main thread after changing loop_activity, so that the
+ * watchdog thread sees the new names.
+ */
+void watchdog_publish(void)
+{
+#ifdef HAVE_PTHREAD
+	command_stats_t *cs = loop_activity.command;
+	hook_t *hook = loop_activity.hook;
+	const char *owner = loop_activity.hook_owner;
+
+	if (!watchdog_running || watchdog_threshold == 0)
+		return;
+
+	pthread_mutex_lock(&watchdog_lock);
+	mowgli_strlcpy(watchdog_activity.service, cs != NULL ? cs->service : "", WATCHDOG_NAMELEN);
+	mowgli_strlcpy(watchdog_activity.command, cs != NULL ? cs->name : "", WATCHDOG_NAMELEN);
+	mowgli_strlcpy(watchdog_activity.hook, hook != NULL ? hook->name : "", WATCHDOG_NAMELEN);
+	mowgli_strlcpy(watchdog_activity.hook_owner, hook != NULL && owner != NULL ? owner : "", WATCHDOG_NAMELEN);
+	pthread_mutex_unlock(&watchdog_lock);
+#endif
+}
+
+#ifdef HAVE_PTHREAD
+/* call with watchdog_lock held */
+static void watchdog_describe(char *buf, size_t len)
+{
+	char part[BUFSIZE];
+
+	*buf = '\0';
+
+	if (*watchdog_activity.command != '\0')
+	{
+		snprintf(part, sizeof part, ", command %s %s", watchdog_activity.service, watchdog_activity.command);
+		mowgli_strlcat(buf, part, len);
+	}
+	if (*watchdog_activity.hook != '\0')
+	{
+		if (*watchdog_activity.hook_owner != '\0')
+			snprintf(part, sizeof part, ", hook %s in %s", watchdog_activity.hook, watchdog_activity.hook_owner);
+		else
+			snprintf(part, sizeof part, ", hook %s", watchdog_activity.hook);
+		mowgli_strlcat(buf, part, len);
+	}
+}
+
+/* like slog(), for the watchdog thread: one write() to the main log file */
+static void watchdog_log(const char *fmt, ...)
+{
+	va_list args;
+	char buf[BUFSIZE], datetime[64];
+	time_t t;
+	struct tm tm;
+	int len;
+
+	if (watchdog_log_fd < 0)
+		return;
+
+	time(&t);
+	localtime_r(&t, &tm);
+	strftime(datetime, sizeof datetime, "[%d/%m/%Y %H:%M:%S]", &tm);
+
+	len = snprintf(buf, sizeof buf, "%s ", datetime);
+
+	va_start(args, fmt);
+	vsnprintf(buf + len, sizeof buf - len - 1, fmt, args);
+	va_end(args);
+
+	len = strlen(buf);
+	buf[len++] = '\n';
+
+	/* nowhere to report a failure to */
+	if (write(watchdog_log_fd, buf, len) < 0)
+		return;
+}
+
+/*
+ * Opens the log file again for the watchdog thread.  dup2() swaps the
+ * descriptor in one step, so the thread writes either to the old file or
+ * the new one, even while we do this.
+ */
+static void watchdog_log_open(void)
+{
+	int fd;
+
+	if (log_path == NULL)
+		return;
+
+	if ((fd = open(log_path, O_WRONLY | O_APPEND | O_CREAT, 0600)) < 0)
+	{
+		slog(LG_ERROR, "watchdog: cannot open %s: %s", log_path, strerror(errno));
+		return;
+	}
+
+#ifdef FD_CLOEXEC
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+#endif
+
+	if (watchdog_log_fd < 0)
+	{
+		watchdog_log_fd = fd;
+		return;
+	}
+
+	dup2(fd, watchdog_log_fd);
+	close(fd);
+}
+
+#ifdef WATCHDOG_BACKTRACE
+/* runs on the main thread, wherever it happens to be stuck */
+static void watchdog_sample(int signum)
+{
+	int saved_errno = errno;
+
+	stall_nframes = backtrace(stall_frames, WATCHDOG_FRAMES);
+	stall_sampled = 1;
+
+	errno = saved_errno;
+}
+
+static void watchdog_backtrace(void)
+{
+	struct timespec ts = { 0, 1000000 };
+	char **symbols;
+	int i, waited;
+
+	stall_sampled = 0;
+	if (pthread_kill(main_thread, SIGPROF) != 0)
+		return;
+
+	for (waited = 0; !stall_sampled && waited < WATCHDOG_SAMPLE_MS; waited++)
+		nanosleep(&ts, NULL);
+
+	if (!stall_sampled)
+	{
+		watchdog_log("watchdog: main thread did not take a backtrace");
+		return;
+	}
+
+	/* symbols are only resolved for exported functions; use addr2line for the rest */
+	symbols = backtrace_symbols(stall_frames, stall_nframes);
+	if (symbols == NULL)
+		return;
+
+	/* skip watchdog_sample() and the signal trampoline */
+	for (i = 2; i < stall_nframes; i++)
+		watchdog_log("watchdog:   #%-2d %s", i - 2, symbols[i]);
+
+	free(symbols);
+}
+#endif
+
+static void watchdog_report(uint64_t started, uint64_t elapsed)
+{
+	char where[BUFSIZE];
+
+	pthread_mutex_lock(&watchdog_lock);
+	watchdog_describe(where, sizeof where);
+	stall_reported = started;
+	mowgli_strlcpy(stall_where, where, sizeof stall_where);
+	pthread_mutex_unlock(&watchdog_lock);
+
+	watchdog_log("watchdog: event loop stalled for %u ms so far%s", (unsigned int)(elapsed / 1000), where);
+
+#ifdef WATCHDOG_BACKTRACE
+	watchdog_backtrace();
+#endif
+}
+
+/* a 64-bit store may be split in two on some platforms */
+static uint64_t watchdog_loop_started(void)
+{
+	uint64_t started;
+
+	do
+		started = loop_started;
+	while (started != loop_started);
+
+	return started;
+}
+
+static void *watchdog_thread(void *unused)
+{
+	struct timespec ts = { 0, WATCHDOG_POLL_MS * 1000000 };
+	uint64_t started, elapsed, last = 0;
+	unsigned int threshold;
+
+	for (;;)
+	{
+		nanosleep(&ts, NULL);
+
+		threshold = watchdog_threshold;
+		started = watchdog_loop_started();
+
+		/* one report per stalled iteration */
+		if (threshold == 0 || started == 0 || started == last)
+			continue;
+
+		elapsed = mono_usec() - started;
+		if (elapsed < (uint64_t)threshold * 1000000)
+			continue;
+
+		last = started;
+		watchdog_report(started, elapsed);
+	}
+
+	return NULL;
+}
+
+static void watchdog_start(void)
+{
+	pthread_t thread;
+	sigset_t all, old;
+	int err;
+
+#ifdef WATCHDOG_BACKTRACE
+	/* the first call may load libgcc, which is not safe in a signal handler */
+	stall_nframes = backtrace(stall_frames, WATCHDOG_FRAMES);
+	mowgli_signal_install_handler(SIGPROF, watchdog_sample);
+#endif
+
+	main_thread = pthread_self();
+
+	/* signals stay with the main thread */
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	err = pthread_create(&thread, NULL, watchdog_thread, NULL);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	if (err != 0)
+	{
+		slog(LG_ERROR, "watchdog_start(): pthread_create failed: %s", strerror(err));
+		return;
+	}
+
+	pthread_detach(thread);
+	watchdog_running = true;
+}
+#endif
+
+static void watchdog_configure(void *unused)
+{
+	watchdog_threshold = config_options.stall_threshold;
+
+	/* an idle loop may legitimately sleep for a whole tick */
+	if (watchdog_threshold != 0 && watchdog_threshold <= WATCHDOG_TICK)
+		watchdog_threshold = WATCHDOG_TICK + 1;
+
+	if (watchdog_threshold == 0)
+	{
+		if (watchdog_timer != NULL)
+		{
+			mowgli_timer_destroy(base_eventloop, watchdog_timer);
+			watchdog_timer = NULL;
+		}
+		return;
+	}
+
+	if (watchdog_timer == NULL)
+		watchdog_timer = mowgli_timer_add(base_eventloop, WATCHDOG_TIMER, watchdog_tick, NULL, WATCHDOG_TICK);
+
+#ifdef HAVE_PTHREAD
+	/* follow the log file if it was moved away for rotation */
+	watchdog_log_open();
+
+	if (!watchdog_running)
+		watchdog_start();
+#endif
+}
+
+/*
+ * watchdog_init()
+ *
+ * Must be called after detaching from the terminal: the watchdog thread
+ * would not survive the fork.
+ */
+void watchdog_init(void)
+{
+	hook_add_event("config_ready");
+	hook_add_config_ready(watchdog_configure);
+
+	watchdog_configure(NULL);
+}
+
+void watchdog_loop_start(void)
+{
+	if (watchdog_threshold == 0)
+		return;
+
+	/* a different name at the end means a timer ran in between */
+	watchdog_last_ran = base_eventloop->last_ran;
+
+	loop_started = mono_usec();
+}
+
+void watchdog_loop_end(void)
+{
+	uint64_t started = loop_started, elapsed;
+	const char *timer = base_eventloop->last_ran;
+	char where[BUFSIZE];
+
+	if (started == 0)
+		return;
+
+	elapsed = mono_usec() - started;
+	loop_started = 0;
+
+	if (watchdog_threshold == 0 || elapsed < (uint64_t)watchdog_threshold * 1000000)
+		return;
+
+	histogram_add(&loop_stalls, elapsed > UINT_MAX ? UINT_MAX : elapsed);
+
+	/*
+	 * The same timer running in two iterations in a row is missed here;
+	 * the backtrace logged during the stall still shows it.
+	 */
+	*where = '\0';
+	if (timer != NULL && timer != watchdog_last_ran && strcmp(timer, WATCHDOG_TIMER))
+		snprintf(where, sizeof where, ", timer %s", timer);
+
+	/* what the watchdog saw mid-stall beats what is left now */
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&watchdog_lock);
+	if (stall_reported == started)
+		mowgli_strlcat(where, stall_where, sizeof where);
+	pthread_mutex_unlock(&watchdog_lock);
+#endif
+
+	slog(LG_INFO, "watchdog: event loop stalled for %u ms%s", (unsigned int)(elapsed / 1000), where);
+}
+
+/* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
+ * vim:ts=8
+ * vim:sw=8
+ * vim:noexpandtab
+ */
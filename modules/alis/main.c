@@ -53,6 +53,11 @@ DECLARE_MODULE_V1
 
 service_t *alis;
 
+/* trigram indexes over channel names and topics, keyed by channel name */
+static trigram_index_t *alis_names;
+static trigram_index_t *alis_topics;
+static int alis_mapping;	/* the casemapping they were folded with */
+
 static void alis_cmd_list(sourceinfo_t *si, int parc, char *parv[]);
 static void alis_cmd_help(sourceinfo_t *si, int parc, char *parv[]);
 
@@ -79,15 +84,80 @@ struct alis_query
 	int showsecret;
 };
 
+static void alis_channel_topic(channel_t *c)
+{
+	if (c->topic != NULL)
+		trigram_index_add(alis_topics, c->name, c, c->topic);
+	else
+		trigram_index_delete(alis_topics, c->name);
+}
+
+static void alis_channel_add(channel_t *c)
+{
+	trigram_index_add(alis_names, c->name, c, c->name);
+	alis_channel_topic(c);
+}
+
+static void alis_channel_delete(channel_t *c)
+{
+	trigram_index_delete(alis_names, c->name);
+	trigram_index_delete(alis_topics, c->name);
+}
+
+static void alis_reindex(void)
+{
+	channel_t *c;
+	mowgli_patricia_iteration_state_t state;
+
+	if (alis_names != NULL)
+		trigram_index_destroy(alis_names);
+	if (alis_topics != NULL)
+		trigram_index_destroy(alis_topics);
+
+	alis_names = trigram_index_create();
+	alis_topics = trigram_index_create();
+	alis_mapping = match_mapping;
+
+	MOWGLI_PATRICIA_FOREACH(c, &state, chanlist)
+		alis_channel_add(c);
+}
+
+/* a rehash may have changed the casemapping the indexes are folded with */
+static void alis_config_ready(void *unused)
+{
+	if (alis_mapping != match_mapping)
+		alis_reindex();
+}
+
 void _modinit(module_t *m)
 {
 	alis = service_add("alis", NULL);
 	service_bind_command(alis, &alis_list);
 	service_bind_command(alis, &alis_help);
+
+	alis_reindex();
+
+	hook_add_event("channel_add");
+	hook_add_channel_add(alis_channel_add);
+	hook_add_event("channel_delete");
+	hook_add_channel_delete(alis_channel_delete);
+	hook_add_event("channel_topic");
+	hook_add_channel_topic(alis_channel_topic);
+	hook_add_event("config_ready");
+	hook_add_config_ready(alis_config_ready);
 }
 
 void _moddeinit(module_unload_intent_t intent)
 {
+	hook_del_channel_add(alis_channel_add);
+	hook_del_channel_delete(alis_channel_delete);
+	hook_del_channel_topic(alis_channel_topic);
+	hook_del_config_ready(alis_config_ready);
+
+	trigram_index_destroy(alis_names);
+	trigram_index_destroy(alis_topics);
+	alis_names = alis_topics = NULL;
+
 	service_unbind_command(alis, &alis_list);
 	service_unbind_command(alis, &alis_help);
 
@@ -400,11 +470,66 @@ static int show_channel(channel_t *chptr, struct alis_query *query)
 	return 1;
 }
 
+struct alis_candidates
+{
+	channel_t **v;
+	size_t count;
+	size_t size;
+};
+
+static void alis_collect(const char *key, void *obj, void *privdata)
+{
+	struct alis_candidates *cand = privdata;
+
+	if (cand->count == cand->size)
+	{
+		cand->size = cand->size ? cand->size * 2 : 64;
+		cand->v = srealloc(cand->v, cand->size * sizeof(channel_t *));
+	}
+
+	cand->v[cand->count++] = obj;
+}
+
+/* orders channel names the way chanlist's irccasecanon() keys sort */
+static int alis_candidate_cmp(const void *a, const void *b)
+{
+	const unsigned char *s1 = (const unsigned char *)(*(channel_t *const *)a)->name;
+	const unsigned char *s2 = (const unsigned char *)(*(channel_t *const *)b)->name;
+
+	while (*s1 != '\0' && ToUpper(*s1) == ToUpper(*s2))
+	{
+		s1++;
+		s2++;
+	}
+
+	return ToUpper(*s1) - ToUpper(*s2);
+}
+
+/* returns false once the output limit has been reached */
+static bool alis_show(sourceinfo_t *si, channel_t *chptr, struct alis_query *query, int *maxmatch)
+{
+	/* matches, so show it */
+	if(show_channel(chptr, query))
+	{
+		print_channel(si, chptr, query);
+
+		if(--*maxmatch == 0)
+		{
+			command_success_nodata(si, "Maximum channel output reached");
+			return false;
+		}
+	}
+
+	return true;
+}
+
 static void alis_cmd_list(sourceinfo_t *si, int parc, char *parv[])
 {
 	channel_t *chptr;
 	struct alis_query query;
 	mowgli_patricia_iteration_state_t state;
+	struct alis_candidates cand = { NULL, 0, 0 };
+	size_t i;
 	int maxmatch;
 
 	memset(&query, 0, sizeof(struct alis_query));
@@ -439,19 +564,23 @@ static void alis_cmd_list(sourceinfo_t *si, int parc, char *parv[])
 		return;
 	}
 
-	MOWGLI_PATRICIA_FOREACH(chptr, &state, chanlist)
+	if (trigram_index_search(alis_names, query.mask, alis_collect, &cand) ||
+			(query.topic != NULL && trigram_index_search(alis_topics, query.topic, alis_collect, &cand)))
 	{
-		/* matches, so show it */
-		if(show_channel(chptr, &query))
-		{
-			print_channel(si, chptr, &query);
+		/* keep the output in the same order as a walk of chanlist */
+		qsort(cand.v, cand.count, sizeof(channel_t *), alis_candidate_cmp);
 
-			if(--maxmatch == 0)
-			{
-				command_success_nodata(si, "Maximum channel output reached");
+		for (i = 0; i < cand.count; i++)
+			if (!alis_show(si, cand.v[i], &query, &maxmatch))
+				break;
+
+		free(cand.v);
+	}
+	else
+	{
+		MOWGLI_PATRICIA_FOREACH(chptr, &state, chanlist)
+			if (!alis_show(si, chptr, &query, &maxmatch))
 				break;
-			}
-		}
 	}
 
 	command_success_nodata(si, "End of output");
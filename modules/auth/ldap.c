@@ -22,6 +22,11 @@
    binddn -- distinguished name to bind to for searching (optional)
    bindauth -- password for the distinguished name (optional, must specify if binddn given)
 
+ and optionally:
+
+   poolsize -- number of connections used for IDENTIFY and SASL PLAIN (default 4)
+   timeout -- how long such a login may wait for the server (default 5 seconds)
+
 */
 
 #include "atheme.h"
@@ -39,11 +44,16 @@ struct
 	char *base;
 	char *binddn;
 	char *bindauth;
+	unsigned int poolsize;
+	unsigned int timeout;
 	bool useDN;
 } ldap_config;
 LDAP *ldap_conn;
 
-static void ldap_config_ready(void *unused)
+static void ldap_pool_create(void);
+static void ldap_pool_release(void);
+
+static bool ldap_setup(void)
 {
 	int res;
 	char *p;
@@ -55,17 +65,17 @@ static void ldap_config_ready(void *unused)
 	if (ldap_config.url == NULL)
 	{
 		slog(LG_ERROR, "ldap_config_ready(): ldap {} missing url definition");
-		return;
+		return false;
 	}
 	if ((ldap_config.dnformat == NULL) && ((ldap_config.base == NULL) || (ldap_config.attribute == NULL)))
 	{
 		slog(LG_ERROR, "ldap_config_ready(): ldap {} block requires dnformat or base & attribute definition");
-		return;
+		return false;
 	}
 	if (ldap_config.binddn != NULL && ldap_config.bindauth == NULL)
 	{
 		slog(LG_ERROR, "ldap_config_ready(): ldap{} block requires bindauth to be defined if binddn is defined");
-		return;
+		return false;
 	}
 
 	if (ldap_config.dnformat != NULL)
@@ -75,7 +85,7 @@ static void ldap_config_ready(void *unused)
 		if (p == NULL || p[1] != 's' || strchr(p + 1, '%'))
 		{
 			slog(LG_ERROR, "ldap_config_ready(): dnformat must contain exactly one %%s and no other %%");
-			return;
+			return false;
 		}
 	}
 	else
@@ -94,7 +104,7 @@ static void ldap_config_ready(void *unused)
 			wallops("Problem with LDAP server: %s", ldap_err2string(res));
 			lastwarning = CURRTIME;
 		}
-		return;
+		return false;
 	}
 
 	/* short timeouts, because this blocks atheme as a whole */
@@ -102,24 +112,22 @@ static void ldap_config_ready(void *unused)
 	ldap_set_option(ldap_conn, LDAP_OPT_NETWORK_TIMEOUT, &(const struct timeval){1, 0});
 	ldap_set_option(ldap_conn, LDAP_OPT_DEREF, &(const int){false});
 	ldap_set_option(ldap_conn, LDAP_OPT_REFERRALS, &(const int){false});
+
+	return true;
 }
 
-static bool ldap_auth_user(myuser_t *mu, const char *password)
+static void ldap_config_ready(void *unused)
 {
-	int res;
-	struct berval cred;
-	LDAPMessage *message, *entry;
+	/* logins in progress start again on the new connections */
+	ldap_pool_release();
 
-	if (ldap_conn == NULL)
-	{
-		ldap_config_ready(NULL);
-	}
-	if (ldap_conn == NULL)
-	{
-		slog(LG_INFO, "ldap_auth_user(): no connection");
-		return false;
-	}
+	if (ldap_setup())
+		ldap_pool_create();
+}
 
+/* names which could change the meaning of a DN or search filter */
+static bool ldap_name_ok(myuser_t *mu)
+{
 	if (strchr(entity(mu)->name, ' '))
 	{
 		slog(LG_INFO, "ldap_auth_user(%s): bad name: found space", entity(mu)->name);
@@ -136,6 +144,28 @@ static bool ldap_auth_user(myuser_t *mu, const char *password)
 		return false;
 	}
 
+	return true;
+}
+
+static bool ldap_auth_user(myuser_t *mu, const char *password)
+{
+	int res;
+	struct berval cred;
+	LDAPMessage *message, *entry;
+
+	if (ldap_conn == NULL)
+	{
+		ldap_setup();
+	}
+	if (ldap_conn == NULL)
+	{
+		slog(LG_INFO, "ldap_auth_user(): no connection");
+		return false;
+	}
+
+	if (!ldap_name_ok(mu))
+		return false;
+
 /* Use DN to find exact match */
 	if (ldap_config.useDN)
 	{
@@ -148,7 +178,7 @@ static bool ldap_auth_user(myuser_t *mu, const char *password)
 		res = ldap_sasl_bind_s(ldap_conn, dn, LDAP_SASL_SIMPLE, &cred, NULL, NULL, NULL);
 		if (res == LDAP_SERVER_DOWN)
 		{
-			ldap_config_ready(NULL);
+			ldap_setup();
 			res = ldap_sasl_bind_s(ldap_conn, dn, LDAP_SASL_SIMPLE, &cred, NULL, NULL, NULL);
 		}
 		if (res == LDAP_SUCCESS)
@@ -181,7 +211,7 @@ static bool ldap_auth_user(myuser_t *mu, const char *password)
 		res = ldap_sasl_bind_s(ldap_conn, binddn, LDAP_SASL_SIMPLE, &cred, NULL, NULL, NULL);
 		if (res == LDAP_SERVER_DOWN)
 		{
-			ldap_config_ready(NULL);
+			ldap_setup();
 			res = ldap_sasl_bind_s(ldap_conn, binddn, LDAP_SASL_SIMPLE, &cred, NULL, NULL, NULL);
 		}
 		if (res != LDAP_SUCCESS)
@@ -219,6 +249,469 @@ static bool ldap_auth_user(myuser_t *mu, const char *password)
 	return false;
 }
 
+/*
+ * IDENTIFY and SASL PLAIN check passwords through a small pool of
+ * connections driven by the event loop, so a slow directory server only
+ * delays the logins which are waiting for it.  Other password checks
+ * still go through the blocking connection above.
+ */
+
+typedef enum {
+	LDAP_STEP_BIND_SEARCHER,	/* bind as binddn to look the account up */
+	LDAP_STEP_SEARCH,		/* find the account's DNs */
+	LDAP_STEP_BIND_USER,		/* bind as dns[dn_next] with the password */
+} ldap_step_t;
+
+typedef struct ldap_pool_conn_ ldap_pool_conn_t;
+
+typedef struct {
+	myuser_t *mu;
+	char *password;
+	verify_password_cb_t cb;
+	void *privdata;
+
+	ldap_step_t step;
+	char **dns;
+	unsigned int ndns, dn_next;
+	bool retried;
+
+	ldap_pool_conn_t *conn;			/* NULL while queued */
+	mowgli_eventloop_timer_t *deadline;
+	mowgli_node_t node;			/* in ldap_queue while queued */
+} ldap_request_t;
+
+struct ldap_pool_conn_ {
+	LDAP *ld;				/* NULL until first needed */
+	int fd;
+	mowgli_eventloop_pollable_t *pollable;
+	ldap_request_t *req;			/* NULL while idle */
+	int msgid;
+};
+
+static ldap_pool_conn_t *ldap_pool;
+static unsigned int ldap_pool_size;
+static mowgli_list_t ldap_queue;
+
+static void ldap_request_begin(ldap_request_t *req);
+static void ldap_pool_dispatch(void);
+
+static bool ldap_pool_conn_open(ldap_pool_conn_t *conn)
+{
+	int res;
+
+	res = ldap_initialize(&conn->ld, ldap_config.url);
+	if (res != LDAP_SUCCESS)
+	{
+		slog(LG_ERROR, "ldap_pool_conn_open(): ldap_initialize(%s) failed: %s", ldap_config.url, ldap_err2string(res));
+		conn->ld = NULL;
+		return false;
+	}
+
+	ldap_set_option(conn->ld, LDAP_OPT_NETWORK_TIMEOUT, &(const struct timeval){1, 0});
+	ldap_set_option(conn->ld, LDAP_OPT_DEREF, &(const int){false});
+	ldap_set_option(conn->ld, LDAP_OPT_REFERRALS, LDAP_OPT_OFF);
+#ifdef LDAP_OPT_CONNECT_ASYNC
+	ldap_set_option(conn->ld, LDAP_OPT_CONNECT_ASYNC, LDAP_OPT_ON);
+#endif
+
+	return true;
+}
+
+static void ldap_pool_conn_close(ldap_pool_conn_t *conn)
+{
+	if (conn->pollable != NULL)
+		mowgli_pollable_destroy(base_eventloop, conn->pollable);
+	conn->pollable = NULL;
+	conn->fd = -1;
+
+	if (conn->ld != NULL)
+		ldap_unbind_ext(conn->ld, NULL, NULL);
+	conn->ld = NULL;
+}
+
+static void ldap_pool_conn_read(ldap_pool_conn_t *conn);
+
+static void ldap_pool_conn_io(mowgli_eventloop_t *eventloop, mowgli_eventloop_io_t *io,
+	mowgli_eventloop_io_dir_t dir, void *userdata)
+{
+	ldap_pool_conn_t *conn = userdata;
+
+	if (dir == MOWGLI_EVENTLOOP_IO_WRITE)
+	{
+		/* a non-blocking connect has finished, send what had to wait for it */
+		mowgli_pollable_setselect(base_eventloop, conn->pollable, MOWGLI_EVENTLOOP_IO_WRITE, NULL);
+		if (conn->req != NULL)
+			ldap_request_begin(conn->req);
+		return;
+	}
+
+	ldap_pool_conn_read(conn);
+}
+
+/* start watching the connection's socket, which libldap may have replaced */
+static void ldap_pool_conn_watch(ldap_pool_conn_t *conn)
+{
+	int fd = -1;
+
+	if (ldap_get_option(conn->ld, LDAP_OPT_DESC, &fd) != LDAP_OPT_SUCCESS || fd < 0)
+		return;
+
+	if (conn->pollable != NULL && conn->fd == fd)
+		return;
+
+	if (conn->pollable != NULL)
+		mowgli_pollable_destroy(base_eventloop, conn->pollable);
+
+	conn->fd = fd;
+	conn->pollable = mowgli_pollable_create(base_eventloop, fd, conn);
+	mowgli_pollable_setselect(base_eventloop, conn->pollable, MOWGLI_EVENTLOOP_IO_READ, ldap_pool_conn_io);
+}
+
+static void ldap_request_finish(ldap_request_t *req, bool verified)
+{
+	ldap_pool_conn_t *conn = req->conn;
+	unsigned int i;
+
+	if (req->deadline != NULL)
+		mowgli_timer_destroy(base_eventloop, req->deadline);
+
+	if (conn != NULL)
+		conn->req = NULL;
+	else
+		mowgli_node_delete(&req->node, &ldap_queue);
+
+	req->cb(req->mu, verified, req->privdata);
+
+	object_unref(req->mu);
+	for (i = 0; i < req->ndns; i++)
+		free(req->dns[i]);
+	free(req->dns);
+	free(req->password);
+	free(req);
+
+	if (conn != NULL)
+		ldap_pool_dispatch();
+}
+
+static void ldap_request_send(ldap_request_t *req)
+{
+	ldap_pool_conn_t *conn = req->conn;
+	struct berval cred;
+	char filter[512];
+	int res = LDAP_OTHER;
+
+	switch (req->step)
+	{
+	case LDAP_STEP_BIND_SEARCHER:
+		cred.bv_val = ldap_config.bindauth;
+		cred.bv_len = ldap_config.bindauth != NULL ? strlen(ldap_config.bindauth) : 0;
+		res = ldap_sasl_bind(conn->ld, ldap_config.binddn, LDAP_SASL_SIMPLE, &cred, NULL, NULL, &conn->msgid);
+		break;
+	case LDAP_STEP_SEARCH:
+		snprintf(filter, sizeof filter, "%s=%s", ldap_config.attribute, entity(req->mu)->name);
+		res = ldap_search_ext(conn->ld, ldap_config.base, LDAP_SCOPE_SUBTREE, filter, NULL, 0, NULL, NULL, NULL, 0, &conn->msgid);
+		break;
+	case LDAP_STEP_BIND_USER:
+		cred.bv_val = req->password;
+		cred.bv_len = strlen(req->password);
+		res = ldap_sasl_bind(conn->ld, req->dns[req->dn_next], LDAP_SASL_SIMPLE, &cred, NULL, NULL, &conn->msgid);
+		break;
+	}
+
+#ifdef LDAP_X_CONNECTING
+	/* try again once the socket is writable */
+	if (res == LDAP_X_CONNECTING)
+	{
+		ldap_pool_conn_watch(conn);
+		if (conn->pollable != NULL)
+		{
+			mowgli_pollable_setselect(base_eventloop, conn->pollable, MOWGLI_EVENTLOOP_IO_WRITE, ldap_pool_conn_io);
+			return;
+		}
+	}
+#endif
+
+	if (res == LDAP_SUCCESS)
+	{
+		ldap_pool_conn_watch(conn);
+		return;
+	}
+
+	/* reconnect once, as the blocking code does */
+	if ((res == LDAP_SERVER_DOWN || res == LDAP_CONNECT_ERROR) && !req->retried)
+	{
+		req->retried = true;
+		ldap_pool_conn_close(conn);
+
+		if (ldap_pool_conn_open(conn))
+		{
+			ldap_request_begin(req);
+			return;
+		}
+	}
+
+	slog(LG_INFO, "ldap_auth_user(%s): ldap request failed: %s", entity(req->mu)->name, ldap_err2string(res));
+	ldap_request_finish(req, false);
+}
+
+/* (re)starts a request from its first step on its connection */
+static void ldap_request_begin(ldap_request_t *req)
+{
+	char dn[512];
+
+	while (req->ndns > 0)
+		free(req->dns[--req->ndns]);
+	req->dn_next = 0;
+
+	if (ldap_config.useDN)
+	{
+		snprintf(dn, sizeof dn, ldap_config.dnformat, entity(req->mu)->name);
+		req->dns = srealloc(req->dns, sizeof(char *));
+		req->dns[req->ndns++] = sstrdup(dn);
+		req->step = LDAP_STEP_BIND_USER;
+	}
+	else
+		req->step = LDAP_STEP_BIND_SEARCHER;
+
+	ldap_request_send(req);
+}
+
+static void ldap_request_result(ldap_request_t *req, LDAPMessage *result)
+{
+	ldap_pool_conn_t *conn = req->conn;
+	LDAPMessage *entry;
+	char *dn;
+	int err = LDAP_OTHER;
+
+	if (req->step == LDAP_STEP_SEARCH)
+	{
+		for (entry = ldap_first_entry(conn->ld, result); entry != NULL; entry = ldap_next_entry(conn->ld, entry))
+		{
+			if ((dn = ldap_get_dn(conn->ld, entry)) == NULL)
+				continue;
+
+			req->dns = srealloc(req->dns, (req->ndns + 1) * sizeof(char *));
+			req->dns[req->ndns++] = sstrdup(dn);
+			ldap_memfree(dn);
+		}
+	}
+
+	ldap_parse_result(conn->ld, result, &err, NULL, NULL, NULL, NULL, 1);
+
+	switch (req->step)
+	{
+	case LDAP_STEP_BIND_SEARCHER:
+		if (err != LDAP_SUCCESS)
+		{
+			slog(LG_INFO, "ldap_auth_user(): ldap_bind failed: %s", ldap_err2string(err));
+			ldap_request_finish(req, false);
+			return;
+		}
+
+		req->step = LDAP_STEP_SEARCH;
+		ldap_request_send(req);
+		return;
+	case LDAP_STEP_SEARCH:
+		if (err != LDAP_SUCCESS)
+		{
+			slog(LG_INFO, "ldap_auth_user(%s): ldap search failed: %s", entity(req->mu)->name, ldap_err2string(err));
+			ldap_request_finish(req, false);
+			return;
+		}
+
+		if (req->ndns == 0)
+			break;
+
+		req->step = LDAP_STEP_BIND_USER;
+		ldap_request_send(req);
+		return;
+	case LDAP_STEP_BIND_USER:
+		if (err == LDAP_SUCCESS)
+		{
+			ldap_request_finish(req, true);
+			return;
+		}
+
+		if (++req->dn_next < req->ndns)
+		{
+			ldap_request_send(req);
+			return;
+		}
+		break;
+	}
+
+	slog(LG_INFO, "ldap_auth_user(%s): ldap auth bind failed: %s", entity(req->mu)->name, ldap_err2string(err));
+	ldap_request_finish(req, false);
+}
+
+static void ldap_pool_conn_read(ldap_pool_conn_t *conn)
+{
+	LDAPMessage *result;
+	int res, err = LDAP_SERVER_DOWN;
+
+	/* nothing is expected while idle; the server has probably gone away */
+	if (conn->req == NULL)
+	{
+		ldap_pool_conn_close(conn);
+		return;
+	}
+
+	res = ldap_result(conn->ld, conn->msgid, LDAP_MSG_ALL, &(struct timeval){0, 0}, &result);
+	if (res == 0)
+		return;
+
+	if (res < 0)
+	{
+		ldap_get_option(conn->ld, LDAP_OPT_RESULT_CODE, &err);
+		ldap_pool_conn_close(conn);
+
+		if (!conn->req->retried && ldap_pool_conn_open(conn))
+		{
+			conn->req->retried = true;
+			ldap_request_begin(conn->req);
+			return;
+		}
+
+		slog(LG_INFO, "ldap_auth_user(%s): ldap request failed: %s", entity(conn->req->mu)->name, ldap_err2string(err));
+		ldap_request_finish(conn->req, false);
+		return;
+	}
+
+	ldap_request_result(conn->req, result);
+}
+
+static void ldap_request_timeout(void *vptr)
+{
+	ldap_request_t *req = vptr;
+
+	req->deadline = NULL;
+
+	slog(LG_INFO, "ldap_auth_user(%s): no answer within %u seconds", entity(req->mu)->name, ldap_config.timeout);
+
+	/* whatever the server is doing, don't wait for it on this connection */
+	if (req->conn != NULL)
+		ldap_pool_conn_close(req->conn);
+
+	ldap_request_finish(req, false);
+}
+
+/* finds a connection with nothing to do, opening it if needed */
+static ldap_pool_conn_t *ldap_pool_idle(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < ldap_pool_size; i++)
+	{
+		ldap_pool_conn_t *conn = &ldap_pool[i];
+
+		if (conn->req != NULL)
+			continue;
+
+		if (conn->ld == NULL && !ldap_pool_conn_open(conn))
+			return NULL;
+
+		return conn;
+	}
+
+	return NULL;
+}
+
+/* hands queued requests to idle connections */
+static void ldap_pool_dispatch(void)
+{
+	static bool dispatching;
+	ldap_pool_conn_t *conn;
+	ldap_request_t *req;
+
+	/* finishing a request calls back in here */
+	if (dispatching)
+		return;
+	dispatching = true;
+
+	while (ldap_queue.head != NULL && (conn = ldap_pool_idle()) != NULL)
+	{
+		req = ldap_queue.head->data;
+		mowgli_node_delete(&req->node, &ldap_queue);
+
+		req->conn = conn;
+		conn->req = req;
+		ldap_request_begin(req);
+	}
+
+	dispatching = false;
+}
+
+static void ldap_pool_create(void)
+{
+	unsigned int i;
+
+	ldap_pool_size = ldap_config.poolsize;
+	ldap_pool = scalloc(ldap_pool_size, sizeof(ldap_pool_conn_t));
+
+	for (i = 0; i < ldap_pool_size; i++)
+		ldap_pool[i].fd = -1;
+
+	ldap_pool_dispatch();
+}
+
+/*
+ * Closes the pool's connections, putting the requests they were working
+ * on back at the head of the queue.  Those keep their deadlines and are
+ * started from their first step by the next pool, if there is one.
+ */
+static void ldap_pool_release(void)
+{
+	ldap_request_t *req;
+	unsigned int i;
+
+	for (i = ldap_pool_size; i-- > 0; )
+	{
+		req = ldap_pool[i].req;
+		ldap_pool[i].req = NULL;
+		ldap_pool_conn_close(&ldap_pool[i]);
+
+		if (req == NULL)
+			continue;
+
+		req->conn = NULL;
+		req->retried = false;
+		mowgli_node_add_head(req, &req->node, &ldap_queue);
+	}
+
+	ldap_pool_size = 0;
+	free(ldap_pool);
+	ldap_pool = NULL;
+}
+
+static void ldap_pool_destroy(void)
+{
+	ldap_pool_release();
+
+	while (ldap_queue.head != NULL)
+		ldap_request_finish(ldap_queue.head->data, false);
+}
+
+static void ldap_auth_user_async(myuser_t *mu, const char *password, verify_password_cb_t cb, void *privdata)
+{
+	ldap_request_t *req;
+
+	if (ldap_pool == NULL || !ldap_name_ok(mu))
+	{
+		cb(mu, false, privdata);
+		return;
+	}
+
+	req = scalloc(1, sizeof(ldap_request_t));
+	req->mu = object_ref(mu);
+	req->password = sstrdup(password);
+	req->cb = cb;
+	req->privdata = privdata;
+	req->deadline = mowgli_timer_add_once(base_eventloop, "ldap_request_timeout", ldap_request_timeout, req, ldap_config.timeout);
+
+	mowgli_node_add(req, &req->node, &ldap_queue);
+	ldap_pool_dispatch();
+}
+
 void _modinit(module_t * m)
 {
 	hook_add_event("config_ready");
@@ -231,8 +724,11 @@ void _modinit(module_t * m)
 	add_dupstr_conf_item("ATTRIBUTE", &conf_ldap_table, 0, &ldap_config.attribute, NULL);
 	add_dupstr_conf_item("BINDDN", &conf_ldap_table, 0, &ldap_config.binddn, NULL);
 	add_dupstr_conf_item("BINDAUTH", &conf_ldap_table, 0, &ldap_config.bindauth, NULL);
+	add_uint_conf_item("POOLSIZE", &conf_ldap_table, 0, &ldap_config.poolsize, 1, 64, 4);
+	add_duration_conf_item("TIMEOUT", &conf_ldap_table, 0, &ldap_config.timeout, "s", 5);
 
 	auth_user_custom = &ldap_auth_user;
+	auth_user_custom_async = &ldap_auth_user_async;
 
 	auth_module_loaded = true;
 }
@@ -240,9 +736,12 @@ void _modinit(module_t * m)
 void _moddeinit(module_unload_intent_t intent)
 {
 	auth_user_custom = NULL;
+	auth_user_custom_async = NULL;
 
 	auth_module_loaded = false;
 
+	ldap_pool_destroy();
+
 	if (ldap_conn != NULL)
 		ldap_unbind_ext_s(ldap_conn, NULL, NULL);
 
@@ -253,6 +752,8 @@ void _moddeinit(module_unload_intent_t intent)
 	del_conf_item("ATTRIBUTE", &conf_ldap_table);
 	del_conf_item("BINDDN", &conf_ldap_table);
 	del_conf_item("BINDAUTH", &conf_ldap_table);
+	del_conf_item("POOLSIZE", &conf_ldap_table);
+	del_conf_item("TIMEOUT", &conf_ldap_table);
 	del_top_conf("LDAP");
 }
 
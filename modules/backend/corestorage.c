@@ -28,12 +28,53 @@ DECLARE_MODULE_V1
 unsigned int dbv;
 unsigned int their_ca_all;
 
+/* shared memo bodies read so far, by MB id; only exists while loading */
+typedef struct {
+	stringref text;
+	unsigned int batch;
+} memo_body_t;
+
+static mowgli_patricia_t *memo_bodies;
+
 extern mowgli_list_t modules;
 
 static void corestorage_db_write(void *filename, db_save_strategy_t strategy);
 static void corestorage_db_write_blocking(void *filename);
 static void corestorage_db_saved_cb(pid_t, int, void*);
 
+/*
+ * The copies of a mass memo, such as a SENDALL, have the same nonzero
+ * batch number.  Their text is written once as MB <batch> <text> ahead of
+ * the first copy, and each copy refers to it with
+ * MR <account> <sender> <sent> <status> <batch>.  These rows are new in
+ * schema version 13; contrib/memobodies-downgrade.py turns them back into
+ * ME rows for older versions.
+ */
+static void corestorage_write_memo_ref(database_handle_t *db, myuser_t *mu, mymemo_t *mz, mowgli_patricia_t *bodies)
+{
+	char key[16];
+
+	snprintf(key, sizeof key, "%u", mz->batch);
+
+	if (mowgli_patricia_retrieve(bodies, key) == NULL)
+	{
+		mowgli_patricia_add(bodies, key, mz);
+
+		db_start_row(db, "MB");
+		db_write_uint(db, mz->batch);
+		db_write_str(db, mz->text);
+		db_commit_row(db);
+	}
+
+	db_start_row(db, "MR");
+	db_write_word(db, entity(mu)->name);
+	db_write_word(db, mz->sender);
+	db_write_time(db, mz->sent);
+	db_write_uint(db, mz->status);
+	db_write_uint(db, mz->batch);
+	db_commit_row(db);
+}
+
 /* write atheme.db (core fields) */
 static void
 corestorage_db_save(database_handle_t *db)
@@ -52,12 +93,13 @@ corestorage_db_save(database_handle_t *db)
 	mowgli_node_t *n, *tn;
 	mowgli_patricia_iteration_state_t state;
 	myentity_iteration_state_t mestate;
+	mowgli_patricia_t *bodies;
 
 	errno = 0;
 
 	/* write the database version */
 	db_start_row(db, "DBV");
-	db_write_int(db, 12);
+	db_write_int(db, 13);
 	db_commit_row(db);
 
 	MOWGLI_ITER_FOREACH(n, modules.head)
@@ -79,6 +121,8 @@ corestorage_db_save(database_handle_t *db)
 
 	slog(LG_DEBUG, "db_save(): saving myusers");
 
+	bodies = mowgli_patricia_create(noopcanon);
+
 	MYENTITY_FOREACH_T(ment, &mestate, ENT_USER)
 	{
 		mu = user(ment);
@@ -115,6 +159,12 @@ corestorage_db_save(database_handle_t *db)
 		{
 			mymemo_t *mz = (mymemo_t *)tn->data;
 
+			if (mz->batch != 0)
+			{
+				corestorage_write_memo_ref(db, mu, mz, bodies);
+				continue;
+			}
+
 			db_start_row(db, "ME");
 			db_write_word(db, entity(mu)->name);
 			db_write_word(db, mz->sender);
@@ -163,6 +213,8 @@ corestorage_db_save(database_handle_t *db)
 		}
 	}
 
+	mowgli_patricia_destroy(bodies, NULL, NULL);
+
 	/* XXX: groupserv hack.  remove when we have proper dependency resolution. --nenolod */
 	hook_call_db_write_pre_ca(db);
 
@@ -447,6 +499,18 @@ static void corestorage_h_mu(database_handle_t *db, const char *type)
 		mu->language = language_add(language);
 }
 
+/* memos are limited to MEMOLEN when sent, this keeps older data in line */
+static stringref corestorage_memo_text(const char *text)
+{
+	char buf[MEMOLEN];
+
+	if (strlen(text) < sizeof buf)
+		return strshare_get(text);
+
+	mowgli_strlcpy(buf, text, sizeof buf);
+	return strshare_get(buf);
+}
+
 static void corestorage_h_me(database_handle_t *db, const char *type)
 {
 	const char *dest, *src, *text;
@@ -467,9 +531,79 @@ static void corestorage_h_me(database_handle_t *db, const char *type)
 		return;
 	}
 
-	mz = smalloc(sizeof *mz);
+	mz = scalloc(sizeof *mz, 1);
 	mowgli_strlcpy(mz->sender, src, NICKLEN);
-	mowgli_strlcpy(mz->text, text, MEMOLEN);
+	mz->text = corestorage_memo_text(text);
+	mz->sent = sent;
+	mz->status = status;
+
+	if (!(mz->status & MEMO_READ))
+		mu->memoct_new++;
+
+	mowgli_node_add(mz, mowgli_node_create(), &mu->memos);
+}
+
+static void corestorage_h_mb(database_handle_t *db, const char *type)
+{
+	const char *id, *text;
+	memo_body_t *mb;
+
+	id = db_sread_word(db);
+	text = db_sread_str(db);
+
+	if (memo_bodies == NULL)
+	{
+		slog(LG_ERROR, "db-h-mb: line %d: memo body outside of a database load", db->line);
+		return;
+	}
+
+	if ((mb = mowgli_patricia_retrieve(memo_bodies, id)) != NULL)
+	{
+		slog(LG_DEBUG, "db-h-mb: line %d: duplicate memo body %s", db->line, id);
+		strshare_unref(mb->text);
+	}
+	else
+	{
+		mb = smalloc(sizeof *mb);
+		mowgli_patricia_add(memo_bodies, id, mb);
+	}
+
+	/* the ids only mean something within one file */
+	mb->text = corestorage_memo_text(text);
+	mb->batch = mymemo_batch_new();
+}
+
+static void corestorage_h_mr(database_handle_t *db, const char *type)
+{
+	const char *dest, *src, *id;
+	time_t sent;
+	unsigned int status;
+	memo_body_t *mb;
+	myuser_t *mu;
+	mymemo_t *mz;
+
+	dest = db_sread_word(db);
+	src = db_sread_word(db);
+	sent = db_sread_time(db);
+	status = db_sread_int(db);
+	id = db_sread_word(db);
+
+	if (!(mu = myuser_find(dest)))
+	{
+		slog(LG_DEBUG, "db-h-mr: line %d: memo for unknown account %s", db->line, dest);
+		return;
+	}
+
+	if (memo_bodies == NULL || !(mb = mowgli_patricia_retrieve(memo_bodies, id)))
+	{
+		slog(LG_ERROR, "db-h-mr: line %d: memo for %s refers to unknown body %s", db->line, dest, id);
+		return;
+	}
+
+	mz = scalloc(sizeof *mz, 1);
+	mowgli_strlcpy(mz->sender, src, NICKLEN);
+	mz->text = strshare_ref(mb->text);
+	mz->batch = mb->batch;
 	mz->sent = sent;
 	mz->status = status;
 
@@ -923,6 +1057,14 @@ static void corestorage_ignore_row(database_handle_t *db, const char *type)
 	return;
 }
 
+static void corestorage_memo_body_free(const char *key, void *data, void *privdata)
+{
+	memo_body_t *mb = data;
+
+	strshare_unref(mb->text);
+	free(mb);
+}
+
 static void corestorage_db_load(const char *filename)
 {
 	database_handle_t *db;
@@ -931,8 +1073,14 @@ static void corestorage_db_load(const char *filename)
 	if (db == NULL)
 		return;
 
+	/* MB rows, by id; only needed while loading */
+	memo_bodies = mowgli_patricia_create(noopcanon);
+
 	db_parse(db);
 	db_close(db);
+
+	mowgli_patricia_destroy(memo_bodies, corestorage_memo_body_free, NULL);
+	memo_bodies = NULL;
 }
 
 #ifdef HAVE_FORK
@@ -950,7 +1098,7 @@ static void corestorage_db_saved_cb(pid_t pid, int status, void *data)
 }
 #endif
 
-static void corestorage_db_write(void *filename, db_save_strategy_t strategy)
+static void corestorage_db_write_strategy(void *filename, db_save_strategy_t strategy)
 {
 #ifndef HAVE_FORK
 	corestorage_db_write_blocking(filename);
@@ -998,6 +1146,25 @@ static void corestorage_db_write(void *filename, db_save_strategy_t strategy)
 #endif
 }
 
+/* with a fork, only the time taken to start the child is counted */
+static void corestorage_db_write(void *filename, db_save_strategy_t strategy)
+{
+#ifdef HAVE_GETTIMEOFDAY
+	struct timeval sttime, ttime;
+
+	s_time(&sttime);
+#endif
+
+	corestorage_db_write_strategy(filename, strategy);
+
+#ifdef HAVE_GETTIMEOFDAY
+	e_time(sttime, &ttime);
+	db_save_stats.last_ms = tv2ms(&ttime);
+	db_save_stats.total_ms += db_save_stats.last_ms;
+#endif
+	db_save_stats.saves++;
+}
+
 static void corestorage_db_write_blocking(void *filename)
 {
 	database_handle_t *db;
@@ -1029,6 +1196,8 @@ void _modinit(module_t *m)
 	db_register_type_handler("CF", corestorage_h_cf);
 	db_register_type_handler("MU", corestorage_h_mu);
 	db_register_type_handler("ME", corestorage_h_me);
+	db_register_type_handler("MB", corestorage_h_mb);
+	db_register_type_handler("MR", corestorage_h_mr);
 	db_register_type_handler("MI", corestorage_h_mi);
 	db_register_type_handler("AC", corestorage_h_ac);
 	db_register_type_handler("MN", corestorage_h_mn);
@@ -196,6 +196,7 @@ static void flatfile_db_load(const char *filename)
 		{
 			/* memo */
 			char *sender, *text;
+			char memotext[MEMOLEN];
 			time_t mtime;
 			unsigned int status;
 			mymemo_t *mz;
@@ -215,10 +216,11 @@ static void flatfile_db_load(const char *filename)
 			if (!sender || !mtime || !text)
 				continue;
 
-			mz = smalloc(sizeof(mymemo_t));
+			mz = scalloc(sizeof(mymemo_t), 1);
 
 			mowgli_strlcpy(mz->sender, sender, NICKLEN);
-			mowgli_strlcpy(mz->text, text, MEMOLEN);
+			mowgli_strlcpy(memotext, text, sizeof memotext);
+			mz->text = strshare_get(memotext);
 			mz->sent = mtime;
 			mz->status = status;
 
@@ -13,6 +13,9 @@
 # include <unistd.h>
 # include <sys/file.h>
 #endif
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
 
 DECLARE_MODULE_V1
 (
@@ -21,6 +24,9 @@ DECLARE_MODULE_V1
 	VENDOR_STRING
 );
 
+typedef struct opensex_reader_ opensex_reader_t;
+typedef struct opensex_word_ opensex_word_t;
+
 typedef struct opensex_ {
 	/* Lexing state */
 	char *buf;
@@ -28,6 +34,15 @@ typedef struct opensex_ {
 	char *token;
 	FILE *f;
 
+	/* Row batches read ahead by a reader thread, if any */
+	opensex_reader_t *reader;
+
+	/* The current row's words, when the reader thread split it */
+	char *row;
+	opensex_word_t *words;
+	unsigned int nwords;
+	unsigned int word;	/* next word to hand out */
+
 	/* Interpreting state */
 	unsigned int grver;
 } opensex_t;
@@ -36,6 +51,71 @@ typedef struct opensex_ {
 static int lockfd;
 #endif
 
+#ifdef HAVE_PTHREAD
+/*
+ * Loading: a reader thread does the file I/O, splits the file into rows
+ * and the rows into words, and parses the words that look like numbers.
+ * It hands this over in batches; the main thread only applies the rows.
+ * At most OPENSEX_READ_DEPTH batches are queued, so the reader never runs
+ * far ahead of the main thread.
+ *
+ * The reader thread must not touch anything the main thread owns, so it
+ * uses plain malloc() and reports failure through ->error instead of
+ * calling smalloc() or slog().
+ */
+#define OPENSEX_BATCH_SIZE	262144	/* bytes of row data per batch */
+#define OPENSEX_READ_DEPTH	4
+
+typedef struct opensex_batch_ opensex_batch_t;
+
+struct opensex_word_ {
+	unsigned int start;	/* offset within the row */
+	unsigned int len;
+	bool int_ok;		/* strtol() took the whole word */
+	bool uint_ok;		/* strtoul() took the whole word */
+	long int_val;
+	unsigned long uint_val;
+};
+
+typedef struct {
+	size_t start;		/* offset within the batch's data */
+	size_t word;		/* index of its first word */
+	unsigned int nwords;
+} opensex_row_t;
+
+struct opensex_batch_ {
+	char *data;		/* NUL-terminated rows */
+	size_t len;
+	size_t size;
+
+	opensex_row_t *rows;
+	size_t nrows;
+	size_t rowsize;
+
+	opensex_word_t *words;
+	size_t nwords;
+	size_t wordsize;
+
+	size_t pos;		/* next row to hand out */
+	opensex_batch_t *next;
+};
+
+struct opensex_reader_ {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+
+	FILE *f;
+	opensex_batch_t *head, *tail;
+	unsigned int depth;
+	bool eof;
+	bool stop;
+	int error;
+
+	opensex_batch_t *cur;	/* owned by the main thread */
+};
+#endif
+
 static void opensex_db_parse(database_handle_t *db)
 {
 	const char *cmd;
@@ -59,12 +139,347 @@ static void opensex_h_grver(database_handle_t *db, const char *type)
 
 /***************************************************************************************************/
 
+#ifdef HAVE_PTHREAD
+/* the functions below up to opensex_reader_start() run on the reader thread */
+static void opensex_batch_destroy(opensex_batch_t *b)
+{
+	free(b->data);
+	free(b->rows);
+	free(b->words);
+	free(b);
+}
+
+static opensex_batch_t *opensex_batch_create(void)
+{
+	opensex_batch_t *b;
+
+	if ((b = calloc(1, sizeof(opensex_batch_t))) == NULL)
+		return NULL;
+
+	b->size = OPENSEX_BATCH_SIZE;
+	b->rowsize = OPENSEX_BATCH_SIZE / 64;
+	b->wordsize = OPENSEX_BATCH_SIZE / 8;
+	b->data = malloc(b->size);
+	b->rows = malloc(b->rowsize * sizeof(opensex_row_t));
+	b->words = malloc(b->wordsize * sizeof(opensex_word_t));
+
+	if (b->data == NULL || b->rows == NULL || b->words == NULL)
+	{
+		opensex_batch_destroy(b);
+		return NULL;
+	}
+
+	return b;
+}
+
+/* doubles an array of *size elements; false if out of memory */
+static bool opensex_grow(void **array, size_t *size, size_t elemsize)
+{
+	void *p;
+
+	if ((p = realloc(*array, *size * 2 * elemsize)) == NULL)
+		return false;
+
+	*array = p;
+	*size *= 2;
+	return true;
+}
+
+/* does what opensex_read_int() and friends would do with the word s */
+static void opensex_word_parse(opensex_word_t *w, const char *s)
+{
+	char *rp;
+
+	w->int_ok = w->uint_ok = false;
+	w->int_val = 0;
+	w->uint_val = 0;
+
+	/* names, flags and the like, which strtol() would reject anyway */
+	if (w->len == 0 || isalpha((unsigned char)*s))
+		return;
+
+	/* the word ends at a space or NUL, where strtol() stops too */
+	w->int_val = strtol(s, &rp, 0);
+	w->int_ok = rp == s + w->len;
+	w->uint_val = strtoul(s, &rp, 0);
+	w->uint_ok = rp == s + w->len;
+}
+
+/* splits the row at b->data + start into words, like opensex_read_word() */
+static bool opensex_batch_add_row(opensex_batch_t *b, size_t start)
+{
+	opensex_row_t *row;
+	opensex_word_t *w;
+	const char *rowp = b->data + start, *p = rowp, *s;
+
+	if (b->nrows == b->rowsize && !opensex_grow((void **)&b->rows, &b->rowsize, sizeof(opensex_row_t)))
+		return false;
+
+	row = &b->rows[b->nrows++];
+	row->start = start;
+	row->word = b->nwords;
+	row->nwords = 0;
+
+	for (;;)
+	{
+		if (b->nwords == b->wordsize && !opensex_grow((void **)&b->words, &b->wordsize, sizeof(opensex_word_t)))
+			return false;
+
+		for (s = p; *p != ' ' && *p != '\0'; p++)
+			;
+
+		w = &b->words[b->nwords++];
+		w->start = s - rowp;
+		w->len = p - s;
+		opensex_word_parse(w, s);
+		row->nwords++;
+
+		if (*p == '\0')
+			return true;
+		p++;
+	}
+}
+
+/* returns false if the main thread has gone away */
+static bool opensex_reader_push(opensex_reader_t *r, opensex_batch_t *b)
+{
+	bool stop;
+
+	pthread_mutex_lock(&r->lock);
+
+	while (r->depth >= OPENSEX_READ_DEPTH && !r->stop)
+		pthread_cond_wait(&r->cond, &r->lock);
+
+	stop = r->stop;
+	if (!stop)
+	{
+		if (r->tail != NULL)
+			r->tail->next = b;
+		else
+			r->head = b;
+		r->tail = b;
+		r->depth++;
+		pthread_cond_broadcast(&r->cond);
+	}
+
+	pthread_mutex_unlock(&r->lock);
+
+	if (stop)
+		opensex_batch_destroy(b);
+
+	return !stop;
+}
+
+static void *opensex_reader_thread(void *arg)
+{
+	opensex_reader_t *r = arg;
+	opensex_batch_t *b;
+	size_t linestart = 0;
+	int c, error = 0;
+
+	if ((b = opensex_batch_create()) == NULL)
+	{
+		error = ENOMEM;
+		goto done;
+	}
+
+	while ((c = getc(r->f)) != EOF)
+	{
+		/* leave room for a terminating NUL */
+		if (b->len + 1 >= b->size && !opensex_grow((void **)&b->data, &b->size, 1))
+		{
+			error = ENOMEM;
+			goto done;
+		}
+
+		if (c != '\n')
+		{
+			b->data[b->len++] = c;
+			continue;
+		}
+
+		b->data[b->len++] = '\0';
+		if (!opensex_batch_add_row(b, linestart))
+		{
+			error = ENOMEM;
+			goto done;
+		}
+		linestart = b->len;
+
+		if (b->len >= OPENSEX_BATCH_SIZE)
+		{
+			if (!opensex_reader_push(r, b))
+				return NULL;
+			linestart = 0;
+			if ((b = opensex_batch_create()) == NULL)
+			{
+				error = ENOMEM;
+				goto done;
+			}
+		}
+	}
+
+	if (ferror(r->f))
+		error = errno != 0 ? errno : EIO;
+
+	/* a last row without a newline */
+	if (error == 0 && b->len > linestart)
+	{
+		b->data[b->len++] = '\0';
+		if (!opensex_batch_add_row(b, linestart))
+			error = ENOMEM;
+	}
+
+	if (error == 0 && b->nrows > 0)
+	{
+		if (!opensex_reader_push(r, b))
+			return NULL;
+		b = NULL;
+	}
+
+done:
+	if (b != NULL)
+		opensex_batch_destroy(b);
+
+	pthread_mutex_lock(&r->lock);
+	r->error = error;
+	r->eof = true;
+	pthread_cond_broadcast(&r->cond);
+	pthread_mutex_unlock(&r->lock);
+
+	return NULL;
+}
+
+static opensex_reader_t *opensex_reader_start(FILE *f)
+{
+	opensex_reader_t *r;
+
+	r = scalloc(sizeof(opensex_reader_t), 1);
+	r->f = f;
+	pthread_mutex_init(&r->lock, NULL);
+	pthread_cond_init(&r->cond, NULL);
+
+	if (pthread_create(&r->thread, NULL, opensex_reader_thread, r) != 0)
+	{
+		slog(LG_INFO, "db-open-read: pthread_create() failed; reading database on the main thread");
+		pthread_cond_destroy(&r->cond);
+		pthread_mutex_destroy(&r->lock);
+		free(r);
+		return NULL;
+	}
+
+	return r;
+}
+
+static void opensex_reader_stop(opensex_reader_t *r)
+{
+	opensex_batch_t *b, *next;
+
+	pthread_mutex_lock(&r->lock);
+	r->stop = true;
+	pthread_cond_broadcast(&r->cond);
+	pthread_mutex_unlock(&r->lock);
+
+	pthread_join(r->thread, NULL);
+
+	for (b = r->head; b != NULL; b = next)
+	{
+		next = b->next;
+		opensex_batch_destroy(b);
+	}
+	if (r->cur != NULL)
+		opensex_batch_destroy(r->cur);
+
+	pthread_cond_destroy(&r->cond);
+	pthread_mutex_destroy(&r->lock);
+	free(r);
+}
+
+static bool opensex_reader_next_row(database_handle_t *hdl)
+{
+	opensex_t *rs = (opensex_t *)hdl->priv;
+	opensex_reader_t *r = rs->reader;
+	opensex_batch_t *b = r->cur;
+	opensex_row_t *row;
+	int error;
+
+	if (b == NULL || b->pos >= b->nrows)
+	{
+		if (b != NULL)
+			opensex_batch_destroy(b);
+
+		pthread_mutex_lock(&r->lock);
+		while (r->head == NULL && !r->eof)
+			pthread_cond_wait(&r->cond, &r->lock);
+
+		b = r->head;
+		if (b != NULL)
+		{
+			r->head = b->next;
+			if (r->head == NULL)
+				r->tail = NULL;
+			r->depth--;
+			pthread_cond_broadcast(&r->cond);
+		}
+		error = r->error;
+		pthread_mutex_unlock(&r->lock);
+
+		r->cur = b;
+		if (b == NULL)
+		{
+			rs->nwords = 0;
+
+			if (error != 0)
+			{
+				slog(LG_ERROR, "opensex-read-next-row: error at %s line %d: %s", hdl->file, hdl->line, strerror(error));
+				slog(LG_ERROR, "opensex-read-next-row: exiting to avoid data loss");
+				exit(EXIT_FAILURE);
+			}
+
+			return false;
+		}
+	}
+
+	/* words are terminated in place as they are read, the batch is ours now */
+	row = &b->rows[b->pos++];
+	rs->row = b->data + row->start;
+	rs->words = b->words + row->word;
+	rs->nwords = row->nwords;
+	rs->word = 0;
+
+	hdl->line++;
+	hdl->token = 0;
+	return true;
+}
+
+/* the next word of a row split by the reader thread, or NULL at its end */
+static opensex_word_t *opensex_reader_next_word(database_handle_t *db)
+{
+	opensex_t *rs = (opensex_t *)db->priv;
+	opensex_word_t *w;
+
+	if (rs->word >= rs->nwords)
+		return NULL;
+
+	w = &rs->words[rs->word++];
+	rs->row[w->start + w->len] = '\0';
+
+	db->token++;
+	return w;
+}
+#endif
+
 static bool opensex_read_next_row(database_handle_t *hdl)
 {
 	int c = 0;
 	unsigned int n = 0;
 	opensex_t *rs = (opensex_t *)hdl->priv;
 
+#ifdef HAVE_PTHREAD
+	if (rs->reader != NULL)
+		return opensex_reader_next_row(hdl);
+#endif
+
 	while ((c = getc(rs->f)) != EOF && c != '\n')
 	{
 		rs->buf[n++] = c;
@@ -98,6 +513,12 @@ static const char *opensex_read_word(database_handle_t *db)
 	char *ptr = rs->token;
 	char *res;
 	static char buf[BUFSIZE];
+#ifdef HAVE_PTHREAD
+	opensex_word_t *w;
+
+	if (rs->reader != NULL)
+		return (w = opensex_reader_next_word(db)) != NULL ? rs->row + w->start : NULL;
+#endif
 
 	res = rs->token;
 	if (res == NULL)
@@ -122,7 +543,12 @@ static const char *opensex_read_str(database_handle_t *db)
 	opensex_t *rs = (opensex_t *)db->priv;
 	char *res;
 
-	res = rs->token;
+#ifdef HAVE_PTHREAD
+	if (rs->reader != NULL)
+		res = rs->word < rs->nwords ? rs->row + rs->words[rs->word].start : NULL;
+	else
+#endif
+		res = rs->token;
 
 	db->token++;
 	return res;
@@ -130,9 +556,25 @@ static const char *opensex_read_str(database_handle_t *db)
 
 static bool opensex_read_int(database_handle_t *db, int *res)
 {
-	const char *s = db_read_word(db);
+	const char *s;
 	char *rp;
 
+#ifdef HAVE_PTHREAD
+	opensex_t *rs = (opensex_t *)db->priv;
+	opensex_word_t *w;
+
+	/* parsed on the reader thread already */
+	if (rs->reader != NULL)
+	{
+		if ((w = opensex_reader_next_word(db)) == NULL)
+			return false;
+
+		*res = w->int_val;
+		return w->int_ok;
+	}
+#endif
+
+	s = db_read_word(db);
 	if (!s) return false;
 
 	*res = strtol(s, &rp, 0);
@@ -141,9 +583,25 @@ static bool opensex_read_int(database_handle_t *db, int *res)
 
 static bool opensex_read_uint(database_handle_t *db, unsigned int *res)
 {
-	const char *s = db_read_word(db);
+	const char *s;
 	char *rp;
 
+#ifdef HAVE_PTHREAD
+	opensex_t *rs = (opensex_t *)db->priv;
+	opensex_word_t *w;
+
+	/* parsed on the reader thread already */
+	if (rs->reader != NULL)
+	{
+		if ((w = opensex_reader_next_word(db)) == NULL)
+			return false;
+
+		*res = w->uint_val;
+		return w->uint_ok;
+	}
+#endif
+
+	s = db_read_word(db);
 	if (!s) return false;
 
 	*res = strtoul(s, &rp, 0);
@@ -152,9 +610,25 @@ static bool opensex_read_uint(database_handle_t *db, unsigned int *res)
 
 static bool opensex_read_time(database_handle_t *db, time_t *res)
 {
-	const char *s = db_read_word(db);
+	const char *s;
 	char *rp;
 
+#ifdef HAVE_PTHREAD
+	opensex_t *rs = (opensex_t *)db->priv;
+	opensex_word_t *w;
+
+	/* parsed on the reader thread already */
+	if (rs->reader != NULL)
+	{
+		if ((w = opensex_reader_next_word(db)) == NULL)
+			return false;
+
+		*res = w->uint_val;
+		return w->uint_ok;
+	}
+#endif
+
+	s = db_read_word(db);
 	if (!s) return false;
 
 	*res = strtoul(s, &rp, 0);
@@ -177,8 +651,6 @@ static bool opensex_start_row(database_handle_t *db, const char *type)
 static bool opensex_write_cell(database_handle_t *db, const char *data, bool multiword)
 {
 	opensex_t *rs;
-	char buf[BUFSIZE], *bi;
-	const char *i;
 
 	return_val_if_fail(db != NULL, false);
 	rs = (opensex_t *)db->priv;
@@ -283,6 +755,9 @@ static database_handle_t *opensex_db_open_read(const char *filename)
 	rs->bufsize = 512;
 	rs->token = NULL;
 	rs->f = f;
+#ifdef HAVE_PTHREAD
+	rs->reader = opensex_reader_start(f);
+#endif
 
 	db = scalloc(sizeof(database_handle_t), 1);
 	db->priv = rs;
@@ -373,6 +848,11 @@ static void opensex_db_close(database_handle_t *db)
 
 	mowgli_strlcpy(newpath, db->file, sizeof newpath);
 
+#ifdef HAVE_PTHREAD
+	if (rs->reader != NULL)
+		opensex_reader_stop(rs->reader);
+#endif
+
 	fclose(rs->f);
 
 	if (db->txn == DB_WRITE)
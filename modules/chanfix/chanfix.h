@@ -23,6 +23,9 @@
  */
 #define CHANFIX_EXPIRE_DIVISOR	672
 
+/* initial size of the per-channel oprecord hash tables, a power of two */
+#define CHANFIX_OPRECORD_HASH_MIN	8
+
 typedef struct chanfix_channel {
 	object_t parent;
 
@@ -32,8 +35,18 @@ typedef struct chanfix_channel {
 	time_t ts;
 	time_t lastupdate;
 
+	/* oprecords hashed by account and by user@host, see gather.c */
+	struct chanfix_oprecord **entity_hash;
+	struct chanfix_oprecord **host_hash;
+	unsigned int hash_size;
+
 	channel_t *chan;
 
+	/* ops as of the last settle, and when that was */
+	mowgli_list_t ops;
+	time_t settled;
+	bool ops_dirty;
+
 	time_t fix_started;
 	bool fix_requested;
 } chanfix_channel_t;
@@ -51,6 +64,10 @@ typedef struct chanfix_oprecord {
 	time_t firstseen;
 	time_t lastevent;
 	unsigned int age;
+
+	unsigned int hostval;
+	struct chanfix_oprecord *entity_next;
+	struct chanfix_oprecord *host_next;
 } chanfix_oprecord_t;
 
 typedef struct chanfix_persist {
@@ -68,13 +85,14 @@ E mowgli_patricia_t *chanfix_channels;
 E void chanfix_gather_init(chanfix_persist_record_t *);
 E void chanfix_gather_deinit(module_unload_intent_t, chanfix_persist_record_t *);
 
-E void chanfix_oprecord_update(chanfix_channel_t *chan, user_t *u);
+E void chanfix_oprecord_update(chanfix_channel_t *chan, user_t *u, unsigned int ticks);
 E void chanfix_oprecord_delete(chanfix_oprecord_t *orec);
 E chanfix_oprecord_t *chanfix_oprecord_create(chanfix_channel_t *chan, user_t *u);
 E chanfix_oprecord_t *chanfix_oprecord_find(chanfix_channel_t *chan, user_t *u);
 E chanfix_channel_t *chanfix_channel_create(const char *name, channel_t *chan);
 E chanfix_channel_t *chanfix_channel_find(const char *name);
 E chanfix_channel_t *chanfix_channel_get(channel_t *chan);
+E void chanfix_channel_settle(chanfix_channel_t *chan);
 E void chanfix_gather(void *unused);
 E void chanfix_expire(void *unused);
 
@@ -84,6 +84,7 @@ static void chanfix_lower_ts(chanfix_channel_t *chan)
 		chanuser_t *cu = n->data;
 		cu->modes = 0;
 	}
+	chan->ops_dirty = true;
 
 	chan_lowerts(ch, chanfix->me);
 	cfu = chanuser_add(ch, CLIENT_NAME(chanfix->me));
@@ -99,6 +100,8 @@ static unsigned int chanfix_get_highscore(chanfix_channel_t *chan)
 	unsigned int highscore = 0;
 	mowgli_node_t *n;
 
+	chanfix_channel_settle(chan);
+
 	MOWGLI_ITER_FOREACH(n, chan->oprecords.head)
 	{
 		unsigned int score;
@@ -171,6 +174,9 @@ static bool chanfix_fix_channel(chanfix_channel_t *chan)
 	if (opped == 0)
 		return false;
 
+	/* the ops were set directly, not through a mode event */
+	chan->ops_dirty = true;
+
 	/* flush the modestacker. */
 	modestack_flush_channel(ch);
 
@@ -415,6 +421,8 @@ static void chanfix_cmd_scores(sourceinfo_t *si, int parc, char *parv[])
 		return;
 	}
 
+	chanfix_channel_settle(chan);
+
 	/* sort records by score. */
 	mowgli_list_sort(&chan->oprecords, chanfix_compare_records, NULL);
 
@@ -474,6 +482,8 @@ static void chanfix_cmd_info(sourceinfo_t *si, int parc, char *parv[])
 		return;
 	}
 
+	chanfix_channel_settle(chan);
+
 	/* sort records by score. */
 	mowgli_list_sort(&chan->oprecords, chanfix_compare_records, NULL);
 
@@ -12,13 +12,125 @@ mowgli_patricia_t *chanfix_channels = NULL;
 mowgli_heap_t *chanfix_channel_heap = NULL;
 mowgli_heap_t *chanfix_oprecord_heap = NULL;
 
-mowgli_eventloop_timer_t *chanfix_gather_timer = NULL;
 mowgli_eventloop_timer_t *chanfix_expire_timer = NULL;
 
 static int loading_cfdbv = 0;
 
 /*************************************************************************************/
 
+/*
+ * Each channel keeps two chained hash tables over its oprecords, one keyed
+ * by account and one by user@host, so finding the record for a user does
+ * not need to walk and compare every record.
+ */
+static unsigned int chanfix_hash_userhost(const char *user, const char *host)
+{
+	unsigned int hashval = 2166136261U;
+
+	for (; *user != '\0'; user++)
+		hashval = (hashval ^ (unsigned char)ToUpper(*user)) * 16777619U;
+
+	hashval = (hashval ^ '@') * 16777619U;
+
+	for (; *host != '\0'; host++)
+		hashval = (hashval ^ (unsigned char)ToUpper(*host)) * 16777619U;
+
+	return hashval;
+}
+
+static unsigned int chanfix_hash_entity(myentity_t *mt)
+{
+	return (unsigned int)(((uintptr_t)mt >> 4) * 2654435761U);
+}
+
+static void chanfix_hash_insert(chanfix_channel_t *chan, chanfix_oprecord_t *orec)
+{
+	unsigned int mask = chan->hash_size - 1;
+	unsigned int i;
+
+	i = orec->hostval & mask;
+	orec->host_next = chan->host_hash[i];
+	chan->host_hash[i] = orec;
+
+	if (orec->entity != NULL)
+	{
+		i = chanfix_hash_entity(orec->entity) & mask;
+		orec->entity_next = chan->entity_hash[i];
+		chan->entity_hash[i] = orec;
+	}
+}
+
+static void chanfix_hash_remove(chanfix_channel_t *chan, chanfix_oprecord_t *orec)
+{
+	unsigned int mask = chan->hash_size - 1;
+	chanfix_oprecord_t **p;
+
+	if (chan->hash_size == 0)
+		return;
+
+	for (p = &chan->host_hash[orec->hostval & mask]; *p != NULL; p = &(*p)->host_next)
+	{
+		if (*p == orec)
+		{
+			*p = orec->host_next;
+			break;
+		}
+	}
+
+	if (orec->entity == NULL)
+		return;
+
+	for (p = &chan->entity_hash[chanfix_hash_entity(orec->entity) & mask]; *p != NULL; p = &(*p)->entity_next)
+	{
+		if (*p == orec)
+		{
+			*p = orec->entity_next;
+			break;
+		}
+	}
+}
+
+static void chanfix_channel_rehash(chanfix_channel_t *chan)
+{
+	mowgli_node_t *n;
+	unsigned int size = CHANFIX_OPRECORD_HASH_MIN;
+
+	while (size < MOWGLI_LIST_LENGTH(&chan->oprecords))
+		size <<= 1;
+
+	free(chan->entity_hash);
+	free(chan->host_hash);
+
+	chan->hash_size = size;
+	chan->entity_hash = scalloc(size, sizeof(chanfix_oprecord_t *));
+	chan->host_hash = scalloc(size, sizeof(chanfix_oprecord_t *));
+
+	MOWGLI_ITER_FOREACH(n, chan->oprecords.head)
+		chanfix_hash_insert(chan, n->data);
+}
+
+/* adds a record, already on its channel's list, to the hash tables */
+static void chanfix_oprecord_link(chanfix_oprecord_t *orec)
+{
+	chanfix_channel_t *chan = orec->chan;
+
+	orec->hostval = chanfix_hash_userhost(orec->user, orec->host);
+
+	/* grow at an average chain length of two */
+	if (chan->hash_size == 0 || MOWGLI_LIST_LENGTH(&chan->oprecords) > chan->hash_size * 2)
+		chanfix_channel_rehash(chan);
+	else
+		chanfix_hash_insert(chan, orec);
+}
+
+static void chanfix_oprecord_set_entity(chanfix_oprecord_t *orec, myentity_t *mt)
+{
+	chanfix_hash_remove(orec->chan, orec);
+	orec->entity = mt;
+	if (orec->chan->hash_size != 0)
+		chanfix_hash_insert(orec->chan, orec);
+}
+
 chanfix_oprecord_t *chanfix_oprecord_create(chanfix_channel_t *chan, user_t *u)
 {
 	chanfix_oprecord_t *orec;
@@ -49,31 +161,44 @@ chanfix_oprecord_t *chanfix_oprecord_create(chanfix_channel_t *chan, user_t *u)
 
 	mowgli_node_add(orec, &orec->node, &chan->oprecords);
 
+	/* records from the database are linked once they are filled in */
+	if (u != NULL)
+		chanfix_oprecord_link(orec);
+
 	return orec;
 }
 
 chanfix_oprecord_t *chanfix_oprecord_find(chanfix_channel_t *chan, user_t *u)
 {
-	mowgli_node_t *n;
+	chanfix_oprecord_t *orec;
+	myentity_t *mt;
+	unsigned int mask, hashval;
 
 	return_val_if_fail(chan != NULL, NULL);
 	return_val_if_fail(u != NULL, NULL);
 
-	MOWGLI_ITER_FOREACH(n, chan->oprecords.head)
+	if (chan->hash_size == 0)
+		return NULL;
+
+	mask = chan->hash_size - 1;
+
+	if ((mt = entity(u->myuser)) != NULL)
 	{
-		chanfix_oprecord_t *orec = n->data;
+		for (orec = chan->entity_hash[chanfix_hash_entity(mt) & mask]; orec != NULL; orec = orec->entity_next)
+			if (orec->entity == mt)
+				return orec;
+	}
 
-		if (orec->entity != NULL && orec->entity == entity(u->myuser))
-			return orec;
+	hashval = chanfix_hash_userhost(u->user, u->vhost);
 
-		if (!irccasecmp(orec->user, u->user) && !irccasecmp(orec->host, u->vhost))
+	for (orec = chan->host_hash[hashval & mask]; orec != NULL; orec = orec->host_next)
+		if (orec->hostval == hashval && !irccasecmp(orec->user, u->user) && !irccasecmp(orec->host, u->vhost))
 			return orec;
-	}
 
 	return NULL;
 }
 
-void chanfix_oprecord_update(chanfix_channel_t *chan, user_t *u)
+void chanfix_oprecord_update(chanfix_channel_t *chan, user_t *u, unsigned int ticks)
 {
 	chanfix_oprecord_t *orec;
 
@@ -83,16 +208,17 @@ void chanfix_oprecord_update(chanfix_channel_t *chan, user_t *u)
 	orec = chanfix_oprecord_find(chan, u);
 	if (orec != NULL)
 	{
-		orec->age++;
+		orec->age += ticks;
 		orec->lastevent = CURRTIME;
 
 		if (orec->entity == NULL && u->myuser != NULL)
-			orec->entity = entity(u->myuser);
+			chanfix_oprecord_set_entity(orec, entity(u->myuser));
 
 		return;
 	}
 
-	chanfix_oprecord_create(chan, u);
+	orec = chanfix_oprecord_create(chan, u);
+	orec->age = ticks;
 	chan->lastupdate = CURRTIME;
 }
 
@@ -100,6 +226,7 @@ void chanfix_oprecord_delete(chanfix_oprecord_t *orec)
 {
 	return_if_fail(orec != NULL);
 
+	chanfix_hash_remove(orec->chan, orec);
 	mowgli_node_delete(&orec->node, &orec->chan->oprecords);
 	mowgli_heap_free(chanfix_oprecord_heap, orec);
 }
@@ -121,6 +248,14 @@ static void chanfix_channel_delete(chanfix_channel_t *c)
 		chanfix_oprecord_delete(orec);
 	}
 
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, c->ops.head)
+	{
+		mowgli_node_delete(n, &c->ops);
+		mowgli_node_free(n);
+	}
+
+	free(c->entity_hash);
+	free(c->host_hash);
 	free(c->name);
 	mowgli_heap_free(chanfix_channel_heap, c);
 }
@@ -137,6 +272,8 @@ chanfix_channel_t *chanfix_channel_create(const char *name, channel_t *chan)
 	c->name = sstrdup(name);
 	c->chan = chan;
 	c->fix_started = 0;
+	c->settled = CURRTIME;
+	c->ops_dirty = true;
 
 	if (c->chan != NULL)
 		c->ts = c->chan->ts;
@@ -160,6 +297,78 @@ chanfix_channel_t *chanfix_channel_get(channel_t *chan)
 
 /*************************************************************************************/
 
+/*
+ * Op time is credited per channel when something could change who is
+ * opped: a mode change, an op joining or an op leaving.  Each settle gives
+ * the ops seen at the previous settle one point of age for every
+ * CHANFIX_GATHER_INTERVAL boundary passed since then, which is what
+ * sampling all channels on a timer used to give them.  Channels nobody
+ * touches are settled when their scores are looked at, when the database
+ * is written and before expiry.
+ */
+static void chanfix_channel_clear_ops(chanfix_channel_t *chan)
+{
+	mowgli_node_t *n, *tn;
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, chan->ops.head)
+	{
+		mowgli_node_delete(n, &chan->ops);
+		mowgli_node_free(n);
+	}
+}
+
+/* rebuilds the list of ops from the channel, leaving out one member */
+static void chanfix_channel_snapshot(chanfix_channel_t *chan, chanuser_t *except)
+{
+	mowgli_node_t *n;
+
+	chanfix_channel_clear_ops(chan);
+	chan->ops_dirty = false;
+
+	if (chan->chan == NULL)
+		return;
+
+	MOWGLI_ITER_FOREACH(n, chan->chan->members.head)
+	{
+		chanuser_t *cu = n->data;
+
+		if (cu != except && cu->modes & CSTATUS_OP)
+			mowgli_node_add(cu, mowgli_node_create(), &chan->ops);
+	}
+}
+
+static void chanfix_channel_settle_except(chanfix_channel_t *chan, chanuser_t *except)
+{
+	mowgli_node_t *n;
+	unsigned int ticks;
+
+	if (chan->ops_dirty)
+		chanfix_channel_snapshot(chan, except);
+
+	ticks = CURRTIME / CHANFIX_GATHER_INTERVAL - chan->settled / CHANFIX_GATHER_INTERVAL;
+	chan->settled = CURRTIME;
+
+	if (ticks == 0 || chan->chan == NULL)
+		return;
+
+	if (mychan_find(chan->name) != NULL)
+		return;
+
+	MOWGLI_ITER_FOREACH(n, chan->ops.head)
+	{
+		chanuser_t *cu = n->data;
+
+		chanfix_oprecord_update(chan, cu->user, ticks);
+	}
+}
+
+void chanfix_channel_settle(chanfix_channel_t *chan)
+{
+	return_if_fail(chan != NULL);
+
+	chanfix_channel_settle_except(chan, NULL);
+}
+
 static void chanfix_channel_add_ev(channel_t *ch)
 {
 	chanfix_channel_t *chan;
@@ -169,6 +378,8 @@ static void chanfix_channel_add_ev(channel_t *ch)
 	if ((chan = chanfix_channel_get(ch)) != NULL)
 	{
 		chan->chan = ch;
+		chan->settled = CURRTIME;
+		chan->ops_dirty = true;
 		return;
 	}
 
@@ -183,6 +394,8 @@ static void chanfix_channel_delete_ev(channel_t *ch)
 
 	if ((chan = chanfix_channel_get(ch)) != NULL)
 	{
+		/* members have already gone, along with their op time */
+		chanfix_channel_clear_ops(chan);
 		chan->chan = NULL;
 		return;
 	}
@@ -190,40 +403,97 @@ static void chanfix_channel_delete_ev(channel_t *ch)
 	chanfix_channel_create(ch->name, NULL);
 }
 
+/* called before the modes are applied; look at the ops again next time */
+static void chanfix_channel_mode_ev(hook_channel_mode_t *data)
+{
+	chanfix_channel_t *chan;
+
+	return_if_fail(data != NULL);
+
+	if ((chan = chanfix_channel_get(data->c)) == NULL)
+		return;
+
+	chanfix_channel_settle(chan);
+	chan->ops_dirty = true;
+}
+
+static void chanfix_channel_tschange_ev(channel_t *ch)
+{
+	chanfix_channel_t *chan;
+
+	return_if_fail(ch != NULL);
+
+	if ((chan = chanfix_channel_get(ch)) == NULL)
+		return;
+
+	chanfix_channel_settle(chan);
+	chan->ops_dirty = true;
+}
+
+static void chanfix_channel_join_ev(hook_channel_joinpart_t *data)
+{
+	chanfix_channel_t *chan;
+	chanuser_t *cu = data->cu;
+
+	if (cu == NULL || !(cu->modes & CSTATUS_OP))
+		return;
+
+	if ((chan = chanfix_channel_get(cu->chan)) == NULL)
+		return;
+
+	chanfix_channel_settle_except(chan, cu);
+	mowgli_node_add(cu, mowgli_node_create(), &chan->ops);
+}
+
+static void chanfix_channel_part_ev(hook_channel_joinpart_t *data)
+{
+	chanfix_channel_t *chan;
+	chanuser_t *cu = data->cu;
+	mowgli_node_t *n;
+
+	if (cu == NULL)
+		return;
+
+	if ((chan = chanfix_channel_get(cu->chan)) == NULL)
+		return;
+
+	/* the member may have been deopped without a mode event */
+	if ((n = mowgli_node_find(cu, &chan->ops)) == NULL)
+		return;
+
+	chanfix_channel_settle(chan);
+
+	/* settling may have rebuilt the list */
+	if ((n = mowgli_node_find(cu, &chan->ops)) != NULL)
+	{
+		mowgli_node_delete(n, &chan->ops);
+		mowgli_node_free(n);
+	}
+}
+
+/*
+ * chanfix_gather()
+ *
+ * Settles op time for every tracked channel.
+ */
 void chanfix_gather(void *unused)
 {
-	channel_t *ch;
+	chanfix_channel_t *chan;
 	mowgli_patricia_iteration_state_t state;
-	int chans = 0, oprecords = 0;
+	int chans = 0, ops = 0;
 
-	MOWGLI_PATRICIA_FOREACH(ch, &state, chanlist)
+	MOWGLI_PATRICIA_FOREACH(chan, &state, chanfix_channels)
 	{
-		mychan_t *mc;
-		mowgli_node_t *n;
-		chanfix_channel_t *chan;
-
-		if ((mc = mychan_find(ch->name)) != NULL)
+		if (chan->chan == NULL)
 			continue;
 
-		chan = chanfix_channel_get(ch);
-		if (chan == NULL)
-			chan = chanfix_channel_create(ch->name, ch);
-
-		MOWGLI_ITER_FOREACH(n, ch->members.head)
-		{
-			chanuser_t *cu = n->data;
-
-			if (cu->modes & CSTATUS_OP)
-			{
-				chanfix_oprecord_update(chan, cu->user);
-				oprecords++;
-			}
-		}
+		chanfix_channel_settle(chan);
 
+		ops += MOWGLI_LIST_LENGTH(&chan->ops);
 		chans++;
 	}
 
-	slog(LG_DEBUG, "chanfix_gather(): gathered %d channels and %d oprecords.", chans, oprecords);
+	slog(LG_DEBUG, "chanfix_gather(): settled %d channels with %d ops.", chans, ops);
 }
 
 void chanfix_expire(void *unused)
@@ -231,6 +501,8 @@ void chanfix_expire(void *unused)
 	chanfix_channel_t *chan;
 	mowgli_patricia_iteration_state_t state;
 
+	chanfix_gather(NULL);
+
 	MOWGLI_PATRICIA_FOREACH(chan, &state, chanfix_channels)
 	{
 		mowgli_node_t *n, *tn;
@@ -276,6 +548,9 @@ static void write_chanfixdb(database_handle_t *db)
 	{
 		mowgli_node_t *n;
 
+		if (chan->chan != NULL)
+			chanfix_channel_settle(chan);
+
 		db_start_row(db, "CFCHAN");
 		db_write_word(db, chan->name);
 		db_write_time(db, chan->ts);
@@ -372,6 +647,8 @@ static void db_h_cfop(database_handle_t *db, const char *type)
 	orec->lastevent = lastevent;
 
 	orec->age = age;
+
+	chanfix_oprecord_link(orec);
 }
 
 static void db_h_cfmd(database_handle_t *db, const char *type)
@@ -391,9 +668,16 @@ static void db_h_cfmd(database_handle_t *db, const char *type)
 
 void chanfix_gather_init(chanfix_persist_record_t *rec)
 {
+	channel_t *ch;
+	mowgli_patricia_iteration_state_t state;
+
 	hook_add_db_write(write_chanfixdb);
 	hook_add_channel_add(chanfix_channel_add_ev);
 	hook_add_channel_delete(chanfix_channel_delete_ev);
+	hook_add_channel_mode(chanfix_channel_mode_ev);
+	hook_add_channel_tschange(chanfix_channel_tschange_ev);
+	hook_add_channel_join(chanfix_channel_join_ev);
+	hook_add_channel_part(chanfix_channel_part_ev);
 
 	db_register_type_handler("CFDBV", db_h_cfdbv);
 	db_register_type_handler("CFCHAN", db_h_cfchan);
@@ -415,7 +699,10 @@ void chanfix_gather_init(chanfix_persist_record_t *rec)
 	chanfix_channels = mowgli_patricia_create(strcasecanon);
 
 	chanfix_expire_timer = mowgli_timer_add(base_eventloop, "chanfix_expire", chanfix_expire, NULL, CHANFIX_EXPIRE_INTERVAL);
-	chanfix_gather_timer = mowgli_timer_add(base_eventloop, "chanfix_gather", chanfix_gather, NULL, CHANFIX_GATHER_INTERVAL);
+
+	/* start tracking channels which already exist */
+	MOWGLI_PATRICIA_FOREACH(ch, &state, chanlist)
+		chanfix_channel_add_ev(ch);
 }
 
 void chanfix_gather_deinit(module_unload_intent_t intent, chanfix_persist_record_t *rec)
@@ -423,13 +710,16 @@ void chanfix_gather_deinit(module_unload_intent_t intent, chanfix_persist_record
 	hook_del_db_write(write_chanfixdb);
 	hook_del_channel_add(chanfix_channel_add_ev);
 	hook_del_channel_delete(chanfix_channel_delete_ev);
+	hook_del_channel_mode(chanfix_channel_mode_ev);
+	hook_del_channel_tschange(chanfix_channel_tschange_ev);
+	hook_del_channel_join(chanfix_channel_join_ev);
+	hook_del_channel_part(chanfix_channel_part_ev);
 
 	db_unregister_type_handler("CFDBV");
 	db_unregister_type_handler("CFCHAN");
 	db_unregister_type_handler("CFOP");
 
 	mowgli_timer_destroy(base_eventloop, chanfix_expire_timer);
-	mowgli_timer_destroy(base_eventloop, chanfix_gather_timer);
 
 	switch (intent)
 	{
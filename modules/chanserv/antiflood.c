@@ -55,52 +55,18 @@ typedef struct {
 	char *name;
 	size_t max;
 	time_t last_used;
-	mowgli_list_t entries;
+	msgring_t ring;
 } mqueue_t;
 
-typedef struct {
-	stringref source;
-	char *message;
-	time_t time;
-	mowgli_node_t node;
-} msg_t;
-
-static mowgli_heap_t *msg_heap = NULL;
-
 static void
-msg_destroy(msg_t *msg, mqueue_t *mq)
-{
-	free(msg->message);
-	strshare_unref(msg->source);
-	mowgli_node_delete(&msg->node, &mq->entries);
-
-	mowgli_heap_free(msg_heap, msg);
-}
-
-static msg_t *
-msg_create(mqueue_t *mq, user_t *u, const char *message)
+mqueue_add(mqueue_t *mq, user_t *u, const char *message)
 {
-	msg_t *msg;
-
-	msg = mowgli_heap_alloc(msg_heap);
-	msg->message = sstrdup(message);
-	msg->time = CURRTIME;
-	msg->source = u->uid != NULL ? strshare_ref(u->uid) : strshare_ref(u->nick);
-
-	if (MOWGLI_LIST_LENGTH(&mq->entries) > mq->max)
-	{
-		msg_t *head_msg = mq->entries.head->data;
-		msg_destroy(head_msg, mq);
-	}
-
-	mowgli_node_add(msg, &msg->node, &mq->entries);
+	msgring_add(&mq->ring, mq->max, u->uid != NULL ? u->uid : u->nick, message, CURRTIME);
 	mq->last_used = CURRTIME;
-
-	return msg;
 }
 
 static mowgli_patricia_t *mqueue_trie = NULL;
-static mowgli_heap_t *mqueue_heap = NULL;
+static sharedheap_t *mqueue_heap = NULL;
 static mowgli_eventloop_timer_t *mqueue_gc_timer = NULL;
 
 static mqueue_t *
@@ -108,10 +74,12 @@ mqueue_create(const char *name)
 {
 	mqueue_t *mq;
 
-	mq = mowgli_heap_alloc(mqueue_heap);
+	mq = sharedheap_alloc(mqueue_heap);
 	mq->name = sstrdup(name);
 	mq->last_used = CURRTIME;
-	mq->max = antiflood_msg_count;
+
+	/* msgring_add() clamps max to this, so a larger one could never be reached */
+	mq->max = antiflood_msg_count < MSGRING_SIZE - 1 ? antiflood_msg_count : MSGRING_SIZE - 1;
 
 	mowgli_patricia_add(mqueue_trie, mq->name, mq);
 
@@ -121,17 +89,10 @@ mqueue_create(const char *name)
 static void
 mqueue_free(mqueue_t *mq)
 {
-	mowgli_node_t *n, *tn;
-
-	MOWGLI_ITER_FOREACH_SAFE(n, tn, mq->entries.head)
-	{
-		msg_t *msg = n->data;
-
-		msg_destroy(msg, mq);
-	}
+	msgring_clear(&mq->ring);
 
 	free(mq->name);
-	mowgli_heap_free(mqueue_heap, mq);
+	sharedheap_free(mqueue_heap, mq);
 }
 
 static mqueue_t *
@@ -178,46 +139,28 @@ mqueue_gc(void *unused)
 static mqueue_enforce_strategy_t
 mqueue_should_enforce(mqueue_t *mq)
 {
-	msg_t *oldest, *newest;
+	const msgring_entry_t *oldest, *newest;
 	time_t age_delta;
 
-	if (MOWGLI_LIST_LENGTH(&mq->entries) < mq->max)
+	if (mq->ring.count < mq->max || mq->ring.count < 2)
 		return MQ_ENFORCE_NONE;
 
-	oldest = mq->entries.head->data;
-	newest = mq->entries.tail->data;
-
-	if (oldest == NULL || newest == NULL || oldest == newest)
-		return MQ_ENFORCE_NONE;
+	oldest = MSGRING_OLDEST(&mq->ring);
+	newest = MSGRING_NEWEST(&mq->ring);
 
 	age_delta = newest->time - oldest->time;
 
 	if (age_delta <= antiflood_msg_time)
 	{
-		mowgli_node_t *n;
-		size_t msg_matches = 0, usr_matches = 0;
-		time_t usr_first_seen = 0;
+		size_t msg_matches, usr_matches;
+		time_t usr_first_seen;
 
-		MOWGLI_ITER_FOREACH(n, mq->entries.head)
-		{
-			msg_t *msg = n->data;
-
-			if (!strcasecmp(msg->message, newest->message))
-				msg_matches++;
-
-			if (msg->source == newest->source)
-			{
-				usr_matches++;
+		msgring_match_newest(&mq->ring, &msg_matches, &usr_matches, &usr_first_seen);
 
-				if (!usr_first_seen)
-					usr_first_seen = msg->time;
-			}
-		}
-
-		if (msg_matches > (antiflood_msg_count / 2))
+		if (msg_matches > (mq->max / 2))
 			return MQ_ENFORCE_MSG;
 
-		if (usr_matches > (antiflood_msg_count / 2) &&
+		if (usr_matches > (mq->max / 2) &&
 			((newest->time - usr_first_seen) < antiflood_msg_time / 4))
 			return MQ_ENFORCE_LINE;
 	}
@@ -350,7 +293,6 @@ on_channel_message(hook_cmessage_data_t *data)
 	chanuser_t *cu;
 	mychan_t *mc;
 	mqueue_t *mq;
-	msg_t *msg;
 
 	return_if_fail(data != NULL);
 	return_if_fail(data->msg != NULL);
@@ -368,7 +310,7 @@ on_channel_message(hook_cmessage_data_t *data)
 	mq = mqueue_get(mc);
 	return_if_fail(mq != NULL);
 
-	msg = msg_create(mq, data->u, data->msg);
+	mqueue_add(mq, data->u, data->msg);
 
 	/* never enforce against any user who has special CSTATUS flags. */
 	if (cu->modes)
@@ -559,9 +501,7 @@ _modinit(module_t *m)
 	hook_add_event("channel_drop");
 	hook_add_channel_drop(on_channel_drop);
 
-	msg_heap = sharedheap_get(sizeof(msg_t));
-
-	mqueue_heap = sharedheap_get(sizeof(mqueue_t));
+	mqueue_heap = sharedheap_get_named(sizeof(mqueue_t), "mqueue_t");
 	mqueue_trie = mowgli_patricia_create(irccasecanon);
 	mqueue_gc_timer = mowgli_timer_add(base_eventloop, "mqueue_gc", mqueue_gc, NULL, 300);
 
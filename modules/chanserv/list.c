@@ -21,13 +21,65 @@ static void cs_cmd_list(sourceinfo_t *si, int parc, char *parv[]);
 
 command_t cs_list = { "LIST", N_("Lists channels registered matching a given pattern."), PRIV_CHAN_AUSPEX, 10, cs_cmd_list, { .path = "cservice/list" } };
 
+/* trigram index over registered channel names, and the mapping it was folded with */
+static trigram_index_t *cs_list_index;
+static int cs_list_mapping;
+
+static void cs_list_mychan_add(mychan_t *mc)
+{
+	trigram_index_add(cs_list_index, mc->name, mc, mc->name);
+}
+
+static void cs_list_mychan_delete(mychan_t *mc)
+{
+	trigram_index_delete(cs_list_index, mc->name);
+}
+
+static void cs_list_reindex(void)
+{
+	mychan_t *mc;
+	mowgli_patricia_iteration_state_t state;
+
+	if (cs_list_index != NULL)
+		trigram_index_destroy(cs_list_index);
+
+	cs_list_index = trigram_index_create();
+	cs_list_mapping = match_mapping;
+
+	MOWGLI_PATRICIA_FOREACH(mc, &state, mclist)
+		cs_list_mychan_add(mc);
+}
+
+/* a rehash may have changed the casemapping the index is folded with */
+static void cs_list_config_ready(void *unused)
+{
+	if (cs_list_mapping != match_mapping)
+		cs_list_reindex();
+}
+
 void _modinit(module_t *m)
 {
 	service_named_bind_command("chanserv", &cs_list);
+
+	cs_list_reindex();
+
+	hook_add_event("mychan_add");
+	hook_add_mychan_add(cs_list_mychan_add);
+	hook_add_event("mychan_delete");
+	hook_add_mychan_delete(cs_list_mychan_delete);
+	hook_add_event("config_ready");
+	hook_add_config_ready(cs_list_config_ready);
 }
 
 void _moddeinit(module_unload_intent_t intent)
 {
+	hook_del_mychan_add(cs_list_mychan_add);
+	hook_del_mychan_delete(cs_list_mychan_delete);
+	hook_del_config_ready(cs_list_config_ready);
+
+	trigram_index_destroy(cs_list_index);
+	cs_list_index = NULL;
+
 	service_named_unbind_command("chanserv", &cs_list);
 }
 
@@ -100,116 +152,181 @@ static void process_parvarray(list_option_t *opts, size_t optsize, int parc, cha
 	}
 }
 
-static void cs_cmd_list(sourceinfo_t *si, int parc, char *parv[])
+typedef struct {
+	char *chanpattern;
+	char *markpattern;
+	char *closedpattern;
+	unsigned int flagset;
+	int aclsize;
+	time_t age;
+	time_t lastused;
+	bool closed;
+	bool marked;
+} list_criteria_t;
+
+typedef struct {
+	mychan_t **v;
+	size_t count;
+	size_t size;
+} list_candidates_t;
+
+static void cs_list_collect(const char *key, void *obj, void *privdata)
+{
+	list_candidates_t *cand = privdata;
+
+	if (cand->count == cand->size)
+	{
+		cand->size = cand->size ? cand->size * 2 : 64;
+		cand->v = srealloc(cand->v, cand->size * sizeof(mychan_t *));
+	}
+
+	cand->v[cand->count++] = obj;
+}
+
+/* orders channel names the way mclist's irccasecanon() keys sort */
+static int cs_list_candidate_cmp(const void *a, const void *b)
+{
+	const unsigned char *s1 = (const unsigned char *)(*(mychan_t *const *)a)->name;
+	const unsigned char *s2 = (const unsigned char *)(*(mychan_t *const *)b)->name;
+
+	while (*s1 != '\0' && ToUpper(*s1) == ToUpper(*s2))
+	{
+		s1++;
+		s2++;
+	}
+
+	return ToUpper(*s1) - ToUpper(*s2);
+}
+
+static bool cs_list_one(sourceinfo_t *si, mychan_t *mc, list_criteria_t *crit)
 {
-	mychan_t *mc;
 	metadata_t *md, *mdclosed;
-	char *chanpattern = NULL, *markpattern = NULL, *closedpattern = NULL;
 	char buf[BUFSIZE];
-	char criteriastr[BUFSIZE];
-	unsigned int matches = 0;
-	unsigned int flagset = 0;
-	int aclsize = 0;
-	time_t age = 0, lastused = 0;
-	bool closed = false, marked = false, markmatch, closedmatch;
-	mowgli_patricia_iteration_state_t state;
-	list_option_t optstable[] = {
-		{"pattern",	OPT_STRING,	{.strval = &chanpattern}, 0},
-		{"mark-reason", OPT_STRING,	{.strval = &markpattern}, 0},
-		{"close-reason", OPT_STRING,    {.strval = &closedpattern}, 0},
-		{"noexpire",	OPT_FLAG,	{.flagval = &flagset}, MC_HOLD},
-		{"held",	OPT_FLAG,	{.flagval = &flagset}, MC_HOLD},
-		{"hold",	OPT_FLAG,	{.flagval = &flagset}, MC_HOLD},
-		{"noop",	OPT_FLAG,	{.flagval = &flagset}, MC_NOOP},
-		{"limitflags",	OPT_FLAG,	{.flagval = &flagset}, MC_LIMITFLAGS},
-		{"secure",	OPT_FLAG,	{.flagval = &flagset}, MC_SECURE},
-		{"nosync",	OPT_FLAG,	{.flagval = &flagset}, MC_NOSYNC},
-		{"verbose",	OPT_FLAG,	{.flagval = &flagset}, MC_VERBOSE},
-		{"restricted",	OPT_FLAG,	{.flagval = &flagset}, MC_RESTRICTED},
-		{"keeptopic",	OPT_FLAG,	{.flagval = &flagset}, MC_KEEPTOPIC},
-		{"verbose-ops",	OPT_FLAG,	{.flagval = &flagset}, MC_VERBOSE_OPS},
-		{"topiclock",	OPT_FLAG,	{.flagval = &flagset}, MC_TOPICLOCK},
-		{"guard",	OPT_FLAG,	{.flagval = &flagset}, MC_GUARD},
-		{"private",	OPT_FLAG,	{.flagval = &flagset}, MC_PRIVATE},
-		{"pubacl",	OPT_FLAG,	{.flagval = &flagset}, MC_PUBACL},
-		{"closed",	OPT_BOOL,	{.boolval = &closed}, 0},
-		{"marked",	OPT_BOOL,	{.boolval = &marked}, 0},
-		{"aclsize",	OPT_INT,	{.intval = &aclsize}, 0},
-		{"registered",	OPT_AGE,	{.ageval = &age}, 0},
-		{"lastused",	OPT_AGE,	{.ageval = &lastused}, 0},
-	};
+	bool markmatch, closedmatch;
 
-	process_parvarray(optstable, ARRAY_SIZE(optstable), parc, parv);
-	build_criteriastr(criteriastr, parc, parv);
+	if (crit->chanpattern != NULL && match(crit->chanpattern, mc->name))
+		return false;
 
-	command_success_nodata(si, _("Channels matching \2%s\2:"), criteriastr);
+	if (crit->markpattern)
+	{
+		markmatch = false;
+		md = metadata_find(mc, "private:mark:reason");
+		if (md != NULL && !match(crit->markpattern, md->value))
+			markmatch = true;
 
-	MOWGLI_PATRICIA_FOREACH(mc, &state, mclist)
+		if (!markmatch)
+			return false;
+	}
+
+	if (crit->closedpattern)
 	{
-		if (chanpattern != NULL && match(chanpattern, mc->name))
-			continue;
+		closedmatch = false;
+		mdclosed = metadata_find(mc, "private:close:reason");
+		if (mdclosed != NULL && !match(crit->closedpattern, mdclosed->value))
+			closedmatch = true;
 
-		if (markpattern)
-		{
-			markmatch = false;
-			md = metadata_find(mc, "private:mark:reason");
-			if (md != NULL && !match(markpattern, md->value))
-				markmatch = true;
+		if (!closedmatch)
+			return false;
+	}
 
-			if (!markmatch)
-				continue;
-		}
+	if (crit->marked && !metadata_find(mc, "private:mark:setter"))
+		return false;
 
-		if (closedpattern)
-		{
-			closedmatch = false;
-			mdclosed = metadata_find(mc, "private:close:reason");
-			if (mdclosed != NULL && !match(closedpattern, mdclosed->value))
-				closedmatch = true;
+	if (crit->closed && !metadata_find(mc, "private:close:closer"))
+		return false;
 
-			if (!closedmatch)
-				continue;
-		}
+	if (crit->flagset && (mc->flags & crit->flagset) != crit->flagset)
+		return false;
 
-		if (marked && !metadata_find(mc, "private:mark:setter"))
-			continue;
+	if (crit->aclsize && MOWGLI_LIST_LENGTH(&mc->chanacs) < (unsigned int)crit->aclsize)
+		return false;
 
-		if (closed && !metadata_find(mc, "private:close:closer"))
-			continue;
+	if (crit->age && (CURRTIME - mc->registered) < crit->age)
+		return false;
 
-		if (flagset && (mc->flags & flagset) != flagset)
-			continue;
+	if (crit->lastused && (CURRTIME - mc->used) < crit->lastused)
+		return false;
 
-		if (aclsize && MOWGLI_LIST_LENGTH(&mc->chanacs) < (unsigned int)aclsize)
-			continue;
+	/* in the future we could add a LIMIT parameter */
+	*buf = '\0';
 
-		if (age && (CURRTIME - mc->registered) < age)
-			continue;
+	if (metadata_find(mc, "private:mark:setter")) {
+		mowgli_strlcat(buf, "\2[marked]\2", BUFSIZE);
+	}
+	if (metadata_find(mc, "private:close:closer")) {
+		if (*buf)
+			mowgli_strlcat(buf, " ", BUFSIZE);
 
-		if (lastused && (CURRTIME - mc->used) < lastused)
-			continue;
+		mowgli_strlcat(buf, "\2[closed]\2", BUFSIZE);
+	}
+	if (mc->flags & MC_HOLD) {
+		if (*buf)
+			mowgli_strlcat(buf, " ", BUFSIZE);
 
-		/* in the future we could add a LIMIT parameter */
-		*buf = '\0';
+		mowgli_strlcat(buf, "\2[held]\2", BUFSIZE);
+	}
 
-		if (metadata_find(mc, "private:mark:setter")) {
-			mowgli_strlcat(buf, "\2[marked]\2", BUFSIZE);
-		}
-		if (metadata_find(mc, "private:close:closer")) {
-			if (*buf)
-				mowgli_strlcat(buf, " ", BUFSIZE);
+	command_success_nodata(si, "- %s (%s) %s", mc->name, mychan_founder_names(mc), buf);
+	return true;
+}
 
-			mowgli_strlcat(buf, "\2[closed]\2", BUFSIZE);
-		}
-		if (mc->flags & MC_HOLD) {
-			if (*buf)
-				mowgli_strlcat(buf, " ", BUFSIZE);
+static void cs_cmd_list(sourceinfo_t *si, int parc, char *parv[])
+{
+	mychan_t *mc;
+	list_criteria_t crit;
+	list_candidates_t cand = { NULL, 0, 0 };
+	char criteriastr[BUFSIZE];
+	unsigned int matches = 0;
+	size_t i;
+	mowgli_patricia_iteration_state_t state;
+	list_option_t optstable[] = {
+		{"pattern",	OPT_STRING,	{.strval = &crit.chanpattern}, 0},
+		{"mark-reason", OPT_STRING,	{.strval = &crit.markpattern}, 0},
+		{"close-reason", OPT_STRING,    {.strval = &crit.closedpattern}, 0},
+		{"noexpire",	OPT_FLAG,	{.flagval = &crit.flagset}, MC_HOLD},
+		{"held",	OPT_FLAG,	{.flagval = &crit.flagset}, MC_HOLD},
+		{"hold",	OPT_FLAG,	{.flagval = &crit.flagset}, MC_HOLD},
+		{"noop",	OPT_FLAG,	{.flagval = &crit.flagset}, MC_NOOP},
+		{"limitflags",	OPT_FLAG,	{.flagval = &crit.flagset}, MC_LIMITFLAGS},
+		{"secure",	OPT_FLAG,	{.flagval = &crit.flagset}, MC_SECURE},
+		{"nosync",	OPT_FLAG,	{.flagval = &crit.flagset}, MC_NOSYNC},
+		{"verbose",	OPT_FLAG,	{.flagval = &crit.flagset}, MC_VERBOSE},
+		{"restricted",	OPT_FLAG,	{.flagval = &crit.flagset}, MC_RESTRICTED},
+		{"keeptopic",	OPT_FLAG,	{.flagval = &crit.flagset}, MC_KEEPTOPIC},
+		{"verbose-ops",	OPT_FLAG,	{.flagval = &crit.flagset}, MC_VERBOSE_OPS},
+		{"topiclock",	OPT_FLAG,	{.flagval = &crit.flagset}, MC_TOPICLOCK},
+		{"guard",	OPT_FLAG,	{.flagval = &crit.flagset}, MC_GUARD},
+		{"private",	OPT_FLAG,	{.flagval = &crit.flagset}, MC_PRIVATE},
+		{"pubacl",	OPT_FLAG,	{.flagval = &crit.flagset}, MC_PUBACL},
+		{"closed",	OPT_BOOL,	{.boolval = &crit.closed}, 0},
+		{"marked",	OPT_BOOL,	{.boolval = &crit.marked}, 0},
+		{"aclsize",	OPT_INT,	{.intval = &crit.aclsize}, 0},
+		{"registered",	OPT_AGE,	{.ageval = &crit.age}, 0},
+		{"lastused",	OPT_AGE,	{.ageval = &crit.lastused}, 0},
+	};
 
-			mowgli_strlcat(buf, "\2[held]\2", BUFSIZE);
-		}
+	memset(&crit, 0, sizeof crit);
 
-		command_success_nodata(si, "- %s (%s) %s", mc->name, mychan_founder_names(mc), buf);
-		matches++;
+	process_parvarray(optstable, ARRAY_SIZE(optstable), parc, parv);
+	build_criteriastr(criteriastr, parc, parv);
+
+	command_success_nodata(si, _("Channels matching \2%s\2:"), criteriastr);
+
+	if (crit.chanpattern != NULL && trigram_index_search(cs_list_index, crit.chanpattern, cs_list_collect, &cand))
+	{
+		qsort(cand.v, cand.count, sizeof(mychan_t *), cs_list_candidate_cmp);
+
+		for (i = 0; i < cand.count; i++)
+			if (cs_list_one(si, cand.v[i], &crit))
+				matches++;
+
+		free(cand.v);
+	}
+	else
+	{
+		MOWGLI_PATRICIA_FOREACH(mc, &state, mclist)
+			if (cs_list_one(si, mc, &crit))
+				matches++;
 	}
 
 	logcommand(si, CMDLOG_ADMIN, "LIST: \2%s\2 (\2%d\2 match%s)",
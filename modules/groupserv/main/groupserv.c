@@ -40,16 +40,140 @@ groupserv_config_t gs_config;
 
 mowgli_heap_t *mygroup_heap, *groupacs_heap;
 
+/*
+ * Transitive membership index.
+ *
+ * The closure of an entity maps every group it belongs to, directly or
+ * through any depth of nested groups, to the union of the flags on its own
+ * entries at the end of those paths.  With it, a recursive groupacs_find()
+ * is one lookup instead of a walk over every nested ACL.
+ *
+ * Closures are built on first use and thrown away by groupacs_invalidate()
+ * when an ACL change could alter them.
+ */
+typedef struct {
+	mygroup_t *mg;
+	unsigned int flags;	/* flags reachable through any path */
+} groupacs_closure_t;
+
+static mowgli_heap_t *groupacs_closure_heap;
+static mowgli_patricia_t *groupacs_closures;
+
+static void groupacs_closure_free(const char *key, void *data, void *privdata)
+{
+	mowgli_heap_free(groupacs_closure_heap, data);
+}
+
+static void groupacs_closure_destroy(const char *key, void *data, void *privdata)
+{
+	mowgli_patricia_destroy(data, groupacs_closure_free, NULL);
+}
+
+/*
+ * Records that the entity reaches mg with the given flags, then carries
+ * them up to the groups mg is itself a member of.  Flags only ever grow,
+ * so cycles end.
+ */
+static void groupacs_closure_add(mowgli_patricia_t *closure, mygroup_t *mg, unsigned int flags)
+{
+	groupacs_closure_t *gc;
+	mowgli_list_t *l;
+	mowgli_node_t *n;
+	bool fresh = false;
+
+	gc = mowgli_patricia_retrieve(closure, entity(mg)->id);
+	if (gc == NULL)
+	{
+		gc = mowgli_heap_alloc(groupacs_closure_heap);
+		gc->mg = mg;
+		mowgli_patricia_add(closure, entity(mg)->id, gc);
+		fresh = true;
+	}
+
+	if ((gc->flags | flags) != gc->flags)
+		fresh = true;
+	gc->flags |= flags;
+
+	if (!fresh)
+		return;
+
+	/* the flags on a path are those of the entry at its end */
+	l = myentity_get_membership_list(entity(mg));
+	MOWGLI_ITER_FOREACH(n, l->head)
+	{
+		groupacs_t *parent = n->data;
+
+		groupacs_closure_add(closure, parent->mg, flags);
+	}
+}
+
+static mowgli_patricia_t *groupacs_closure_get(myentity_t *mt)
+{
+	mowgli_patricia_t *closure;
+	mowgli_list_t *l;
+	mowgli_node_t *n;
+
+	if ((closure = mowgli_patricia_retrieve(groupacs_closures, mt->id)) != NULL)
+		return closure;
+
+	/* not worth keeping for entities in no groups at all */
+	l = myentity_get_membership_list(mt);
+	if (MOWGLI_LIST_LENGTH(l) == 0)
+		return NULL;
+
+	closure = mowgli_patricia_create(noopcanon);
+
+	MOWGLI_ITER_FOREACH(n, l->head)
+	{
+		groupacs_t *ga = n->data;
+
+		groupacs_closure_add(closure, ga->mg, ga->flags);
+	}
+
+	mowgli_patricia_add(groupacs_closures, mt->id, closure);
+
+	return closure;
+}
+
+/*
+ * Drops the closures an ACL change on mt could affect.  Changing a nested
+ * group's entry affects everything below it, which is rare enough that
+ * starting from scratch is simplest.
+ */
+static void groupacs_invalidate(myentity_t *mt)
+{
+	mowgli_patricia_t *closure;
+
+	if (isgroup(mt))
+	{
+		mowgli_patricia_destroy(groupacs_closures, groupacs_closure_destroy, NULL);
+		groupacs_closures = mowgli_patricia_create(noopcanon);
+		return;
+	}
+
+	if ((closure = mowgli_patricia_retrieve(groupacs_closures, mt->id)) != NULL)
+	{
+		mowgli_patricia_delete(groupacs_closures, mt->id);
+		groupacs_closure_destroy(mt->id, closure, NULL);
+	}
+}
+
 void mygroups_init(void)
 {
 	mygroup_heap = mowgli_heap_create(sizeof(mygroup_t), HEAP_USER, BH_NOW);
 	groupacs_heap = mowgli_heap_create(sizeof(groupacs_t), HEAP_CHANACS, BH_NOW);
+	groupacs_closure_heap = mowgli_heap_create(sizeof(groupacs_closure_t), HEAP_CHANACS, BH_NOW);
+
+	groupacs_closures = mowgli_patricia_create(noopcanon);
 }
 
 void mygroups_deinit(void)
 {
+	mowgli_patricia_destroy(groupacs_closures, groupacs_closure_destroy, NULL);
+
 	mowgli_heap_destroy(mygroup_heap);
 	mowgli_heap_destroy(groupacs_heap);
+	mowgli_heap_destroy(groupacs_closure_heap);
 }
 
 static void mygroup_delete(mygroup_t *mg)
@@ -58,6 +182,8 @@ static void mygroup_delete(mygroup_t *mg)
 
 	myentity_del(entity(mg));
 
+	groupacs_invalidate(entity(mg));
+
 	MOWGLI_ITER_FOREACH_SAFE(n, tn, mg->acs.head)
 	{
 		groupacs_t *ga = n->data;
@@ -142,50 +268,87 @@ groupacs_t *groupacs_add(mygroup_t *mg, myentity_t *mt, unsigned int flags)
 	mowgli_node_add(ga, &ga->gnode, &mg->acs);
 	mowgli_node_add(ga, &ga->unode, myentity_get_membership_list(mt));
 
+	groupacs_invalidate(mt);
+
 	return ga;
 }
 
-groupacs_t *groupacs_find(mygroup_t *mg, myentity_t *mt, unsigned int flags, bool allow_recurse)
+/* finds mt's own entry in mg, walking whichever list is shorter */
+static groupacs_t *groupacs_find_direct(mygroup_t *mg, myentity_t *mt, unsigned int flags)
 {
+	mowgli_list_t *l;
 	mowgli_node_t *n;
-	groupacs_t *out = NULL;
 
-	return_val_if_fail(mg != NULL, NULL);
-	return_val_if_fail(mt != NULL, NULL);
+	l = myentity_get_membership_list(mt);
+
+	if (MOWGLI_LIST_LENGTH(l) < MOWGLI_LIST_LENGTH(&mg->acs))
+	{
+		MOWGLI_ITER_FOREACH(n, l->head)
+		{
+			groupacs_t *ga = n->data;
 
-	mg->visited = true;
+			if (ga->mg == mg && (!flags || ga->flags & flags))
+				return ga;
+		}
+
+		return NULL;
+	}
 
 	MOWGLI_ITER_FOREACH(n, mg->acs.head)
 	{
 		groupacs_t *ga = n->data;
 
-		if (out != NULL)
-			break;
+		if (ga->mt == mt && (!flags || ga->flags & flags))
+			return ga;
+	}
 
-		if (isgroup(ga->mt) && allow_recurse && !(group(ga->mt)->visited))
-		{
-			groupacs_t *ga2;
+	return NULL;
+}
 
-			ga2 = groupacs_find(group(ga->mt), mt, flags, allow_recurse);
+/*
+ * groupacs_find(mygroup_t *mg, myentity_t *mt, unsigned int flags, bool allow_recurse)
+ *
+ * Finds the entry giving mt access to mg.  With allow_recurse, mt may be
+ * a member of a group nested in mg at any depth, and the entry returned is
+ * the first one in mg's list which is either mt's own entry with the flags
+ * or the entry of a nested group through which mt has them.
+ */
+groupacs_t *groupacs_find(mygroup_t *mg, myentity_t *mt, unsigned int flags, bool allow_recurse)
+{
+	mowgli_patricia_t *closure;
+	groupacs_closure_t *gc;
+	mowgli_node_t *n;
 
-			if (ga2 != NULL)
-				out = ga;
-		}
-		else
+	return_val_if_fail(mg != NULL, NULL);
+	return_val_if_fail(mt != NULL, NULL);
+
+	if (!allow_recurse)
+		return groupacs_find_direct(mg, mt, flags);
+
+	if ((closure = groupacs_closure_get(mt)) == NULL)
+		return NULL;
+
+	/* most lookups fail, and this answers those without a walk */
+	gc = mowgli_patricia_retrieve(closure, entity(mg)->id);
+	if (gc == NULL || (flags && !(gc->flags & flags)))
+		return NULL;
+
+	MOWGLI_ITER_FOREACH(n, mg->acs.head)
+	{
+		groupacs_t *ga = n->data;
+		groupacs_closure_t *sub;
+
+		if (isgroup(ga->mt))
 		{
-			if (flags)
-			{
-				if (ga->mt == mt && ga->mg == mg && (ga->flags & flags))
-					out = ga;
-			}
-			else if (ga->mt == mt && ga->mg == mg)
-				out = ga;
+			sub = mowgli_patricia_retrieve(closure, ga->mt->id);
+			if (sub != NULL && (!flags || sub->flags & flags))
+				return ga;
 		}
+		else if (ga->mt == mt && (!flags || ga->flags & flags))
+			return ga;
 	}
 
-	mg->visited = false;
-
-	return out;
+	return NULL;
 }
 
 void groupacs_delete(mygroup_t *mg, myentity_t *mt)
@@ -195,12 +358,30 @@ void groupacs_delete(mygroup_t *mg, myentity_t *mt)
 	ga = groupacs_find(mg, mt, 0, false);
 	if (ga != NULL)
 	{
+		groupacs_invalidate(mt);
+
 		mowgli_node_delete(&ga->gnode, &mg->acs);
 		mowgli_node_delete(&ga->unode, myentity_get_membership_list(mt));
 		object_unref(ga);
 	}
 }
 
+/*
+ * groupacs_set_flags(groupacs_t *ga, unsigned int flags)
+ *
+ * Replaces the flags on an entry, keeping the membership index current.
+ */
+void groupacs_set_flags(groupacs_t *ga, unsigned int flags)
+{
+	return_if_fail(ga != NULL);
+
+	if (ga->flags == flags)
+		return;
+
+	ga->flags = flags;
+	groupacs_invalidate(ga->mt);
+}
+
 bool groupacs_sourceinfo_has_flag(mygroup_t *mg, sourceinfo_t *si, unsigned int flag)
 {
 	return groupacs_find(mg, entity(si->smu), flag, true) != NULL;
@@ -620,7 +801,7 @@ bool groupacs_modify(groupacs_t *ga, unsigned int *addflags, unsigned int *remov
 	/* attempting to manipulate user with more privs? */
 	if (~restrictflags & ga->flags)
 		return false;
-	ga->flags = (ga->flags | *addflags) & ~*removeflags;
+	groupacs_set_flags(ga, (ga->flags | *addflags) & ~*removeflags);
 	//ga->tmodified = CURRTIME;
 
 	return true;
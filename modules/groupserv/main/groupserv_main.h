@@ -21,6 +21,7 @@ E mygroup_t *mygroup_find(const char *name);
 E groupacs_t *groupacs_add(mygroup_t *mg, myentity_t *mt, unsigned int flags);
 E groupacs_t *groupacs_find(mygroup_t *mg, myentity_t *mt, unsigned int flags, bool allow_recurse);
 E void groupacs_delete(mygroup_t *mg, myentity_t *mt);
+E void groupacs_set_flags(groupacs_t *ga, unsigned int flags);
 
 E bool groupacs_sourceinfo_has_flag(mygroup_t *mg, sourceinfo_t *si, unsigned int flag);
 
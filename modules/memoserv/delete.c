@@ -111,6 +111,7 @@ static void ms_cmd_delete(sourceinfo_t *si, int parc, char *parv[])
 			mowgli_node_delete(n, &si->smu->memos);
 			mowgli_node_free(n);
 
+			strshare_unref(memo->text);
 			free(memo);
 		}
 
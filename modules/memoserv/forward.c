@@ -156,13 +156,13 @@ static void ms_cmd_forward(sourceinfo_t *si, int parc, char *parv[])
 		{
 			/* should have some function for send here...  ask nenolod*/
 			memo = (mymemo_t *)n->data;
-			newmemo = smalloc(sizeof(mymemo_t));
+			newmemo = scalloc(sizeof(mymemo_t), 1);
 
 			/* Create memo */
 			newmemo->sent = CURRTIME;
 			newmemo->status = 0;
 			mowgli_strlcpy(newmemo->sender,entity(si->smu)->name,NICKLEN);
-			mowgli_strlcpy(newmemo->text,memo->text,MEMOLEN);
+			newmemo->text = strshare_ref(memo->text);
 
 			/* Create node, add to their linked list of memos */
 			temp = mowgli_node_create();
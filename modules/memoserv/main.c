@@ -196,11 +196,11 @@ bool send_user_memo(sourceinfo_t *si, myuser_t *target,
 	logcommand(si, CMDLOG_SET, "SEND: to \2%s\2", entity(target)->name);
 
 	/* Malloc and populate struct */
-	memo = smalloc(sizeof(mymemo_t));
+	memo = scalloc(sizeof(mymemo_t), 1);
 	memo->sent = CURRTIME;
 	memo->status = status;
 	mowgli_strlcpy(memo->sender, entity(si->smu)->name, NICKLEN);
-	mowgli_strlcpy(memo->text, memotext, MEMOLEN);
+	memo->text = strshare_get(memotext);
 
 	/* Create a linked list node and add to memos */
 	n = mowgli_node_create();
@@ -302,11 +302,11 @@ bool send_user_memo_misc(myuser_t *target,
 		return false;
 
 	/* Malloc and populate struct */
-	memo = smalloc(sizeof(mymemo_t));
+	memo = scalloc(sizeof(mymemo_t), 1);
 	memo->sent = CURRTIME;
 	memo->status = status;
 	mowgli_strlcpy(memo->sender, memosvs->me->nick, NICKLEN);
-	mowgli_strlcpy(memo->text, memotext, MEMOLEN);
+	memo->text = strshare_get(memotext);
 
 	/* Create a linked list node and add to memos */
 	n = mowgli_node_create();
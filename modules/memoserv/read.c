@@ -42,6 +42,7 @@ static void ms_cmd_read(sourceinfo_t *si, int parc, char *parv[])
 	mowgli_node_t *n;
 	unsigned int i = 1, memonum = 0, numread = 0;
 	char strfbuf[BUFSIZE];
+	char text[MEMOLEN];
 	struct tm tm;
 	bool readnew;
 
@@ -110,11 +111,12 @@ static void ms_cmd_read(sourceinfo_t *si, int parc, char *parv[])
 					if ( (tmu != NULL) && (tmu->memos.count < me.mdlimit) && strcasecmp(si->service->nick, memo->sender))
 					{
 						/* Malloc and populate memo struct */
-						receipt = smalloc(sizeof(mymemo_t));
+						receipt = scalloc(sizeof(mymemo_t), 1);
 						receipt->sent = CURRTIME;
 						receipt->status = 0;
 						mowgli_strlcpy(receipt->sender, si->service->nick, NICKLEN);
-						snprintf(receipt->text, MEMOLEN, "%s has read a memo from you sent at %s", entity(si->smu)->name, strfbuf);
+						snprintf(text, sizeof text, "%s has read a memo from you sent at %s", entity(si->smu)->name, strfbuf);
+						receipt->text = strshare_get(text);
 
 						/* Attach to their linked list */
 						n = mowgli_node_create();
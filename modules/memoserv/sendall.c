@@ -37,6 +37,8 @@ static void ms_cmd_sendall(sourceinfo_t *si, int parc, char *parv[])
 	myentity_t *mt;
 	mowgli_node_t *n;
 	mymemo_t *memo;
+	stringref body;
+	unsigned int batch;
 	int sent = 0, tried = 0;
 	bool ignored;
 	service_t *memoserv;
@@ -93,6 +95,10 @@ static void ms_cmd_sendall(sourceinfo_t *si, int parc, char *parv[])
 	si->smu->memo_ratelimit_num++;
 	si->smu->memo_ratelimit_time = CURRTIME;
 
+	/* every recipient shares one copy of the text */
+	body = strshare_get(m);
+	batch = mymemo_batch_new();
+
 	MYENTITY_FOREACH_T(mt, &state, ENT_USER)
 	{
 		myuser_t *tmu = user(mt);
@@ -134,11 +140,12 @@ static void ms_cmd_sendall(sourceinfo_t *si, int parc, char *parv[])
 			continue;
 
 		/* Malloc and populate struct */
-		memo = smalloc(sizeof(mymemo_t));
+		memo = scalloc(sizeof(mymemo_t), 1);
 		memo->sent = CURRTIME;
 		memo->status = MEMO_CHANNEL;
 		mowgli_strlcpy(memo->sender,entity(si->smu)->name,NICKLEN);
-		mowgli_strlcpy(memo->text, m, MEMOLEN);
+		memo->text = strshare_ref(body);
+		memo->batch = batch;
 
 		/* Create a linked list node and add to memos */
 		n = mowgli_node_create();
@@ -164,6 +171,8 @@ static void ms_cmd_sendall(sourceinfo_t *si, int parc, char *parv[])
 					ircd->uses_rcommand ? "" : "msg ", memoserv->disp, MOWGLI_LIST_LENGTH(&tmu->memos));
 	}
 
+	strshare_unref(body);
+
 	/* Tell user memo sent, return */
 	if (sent > 4)
 		command_add_flood(si, FLOOD_HEAVY);
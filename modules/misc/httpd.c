@@ -12,6 +12,11 @@
 
 #define REQUEST_MAX 65536 /* maximum size of one call */
 
+#if defined(HAVE_SENDFILE) && defined(HAVE_SYS_SENDFILE_H)
+# include <sys/sendfile.h>
+# define USE_SENDFILE
+#endif
+
 DECLARE_MODULE_V1
 (
 	"misc/httpd", false, _modinit, _moddeinit,
@@ -20,7 +25,15 @@ DECLARE_MODULE_V1
 );
 
 connection_t *listener;
-mowgli_list_t httpd_path_handlers;
+
+/* registered path handlers, and the same indexed by path */
+static mowgli_list_t path_handlers;
+static mowgli_patricia_t *path_table;
+
+static void httpd_path_add(path_handler_t *ph);
+static void httpd_path_delete(path_handler_t *ph);
+
+httpd_path_func_t httpd_path_funcs = { &httpd_path_add, &httpd_path_delete };
 
 /* conf stuff */
 mowgli_list_t conf_httpd_table;
@@ -50,6 +63,62 @@ static void clear_httpddata(struct httpddata *hd)
 	hd->correct_content_type = false;
 	hd->expect_100_continue = false;
 	hd->sent_reply = false;
+	hd->handler = NULL;
+}
+
+static void httpd_path_rehash(void)
+{
+	mowgli_node_t *n;
+	path_handler_t *ph;
+
+	if (path_table != NULL)
+		mowgli_patricia_destroy(path_table, NULL, NULL);
+
+	path_table = mowgli_patricia_create(NULL);
+
+	/* the first handler registered for a path wins */
+	MOWGLI_ITER_FOREACH(n, path_handlers.head)
+	{
+		ph = n->data;
+		if (ph->path != NULL && mowgli_patricia_retrieve(path_table, ph->path) == NULL)
+			mowgli_patricia_add(path_table, ph->path, ph);
+	}
+}
+
+/* registers a handler, or picks up a change to its path */
+static void httpd_path_add(path_handler_t *ph)
+{
+	if (mowgli_node_find(ph, &path_handlers) == NULL)
+		mowgli_node_add(ph, mowgli_node_create(), &path_handlers);
+
+	httpd_path_rehash();
+}
+
+static void httpd_path_delete(path_handler_t *ph)
+{
+	mowgli_node_t *n, *tn;
+	connection_t *cptr;
+	struct httpddata *hd;
+
+	if ((n = mowgli_node_find(ph, &path_handlers)) == NULL)
+		return;
+
+	mowgli_node_delete(n, &path_handlers);
+	mowgli_node_free(n);
+
+	httpd_path_rehash();
+
+	/* drop requests in progress for it */
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, connection_list.head)
+	{
+		cptr = n->data;
+		if (listener == NULL || cptr->listener != listener)
+			continue;
+
+		hd = cptr->userdata;
+		if (hd != NULL && hd->handler == ph)
+			connection_close_soon(cptr);
+	}
 }
 
 static int open_file(const char *filename)
@@ -155,6 +224,68 @@ static const char *content_type(const char *filename)
 	return "application/octet-stream";
 }
 
+#ifdef USE_SENDFILE
+static void httpd_recvqhandler(connection_t *cptr);
+
+static void httpd_sendfile_done(connection_t *cptr)
+{
+	struct httpddata *hd = cptr->userdata;
+
+	close(hd->file_fd);
+	hd->file_fd = -1;
+	connection_setselect_write(cptr, NULL);
+	connection_setselect_read(cptr, recvq_put);
+}
+
+static void httpd_sendfile(connection_t *cptr)
+{
+	struct httpddata *hd = cptr->userdata;
+	ssize_t count;
+	int len;
+
+	/* the headers go out first */
+	if (sendq_nonempty(cptr))
+	{
+		sendq_flush(cptr);
+		if (sendq_nonempty(cptr) || CF_IS_DEAD(cptr))
+			return;
+	}
+
+	count = sendfile(cptr->fd, hd->file_fd, &hd->file_offset, hd->file_left);
+	if (count <= 0)
+	{
+		if (count < 0 && mowgli_eventloop_ignore_errno(ioerrno()))
+		{
+			connection_setselect_write(cptr, httpd_sendfile);
+			return;
+		}
+
+		slog(LG_INFO, "httpd_sendfile(): disconnecting fd %d (%s), sendfile failed on %s", cptr->fd, cptr->hbuf, hd->filename);
+		httpd_sendfile_done(cptr);
+		cptr->flags |= CF_DEAD;
+		return;
+	}
+
+	hd->file_left -= count;
+	if (hd->file_left > 0)
+	{
+		connection_setselect_write(cptr, httpd_sendfile);
+		return;
+	}
+
+	httpd_sendfile_done(cptr);
+	check_close(cptr);
+
+	/* answer whatever was pipelined behind this request */
+	while ((len = recvq_length(cptr)) > 0 && cptr->recvq_handler != NULL)
+	{
+		httpd_recvqhandler(cptr);
+		if (recvq_length(cptr) == len || hd->file_fd != -1)
+			break;
+	}
+}
+#endif
+
 static void httpd_recvqhandler(connection_t *cptr)
 {
 	char buf[BUFSIZE * 2];
@@ -164,21 +295,20 @@ static void httpd_recvqhandler(connection_t *cptr)
 	char *p;
 	int in;
 	struct stat sb;
+#ifndef USE_SENDFILE
 	off_t count1;
-	mowgli_node_t *n;
-	path_handler_t *ph = NULL;
-	bool is_get, is_post, handling_done = false;
+#endif
+	path_handler_t *ph;
+	bool is_get, is_post, handling_done;
 
 	hd = cptr->userdata;
 
-	MOWGLI_ITER_FOREACH(n, httpd_path_handlers.head)
-	{
-		ph = (path_handler_t *)n->data;
-		handling_done = !strcmp(hd->filename, ph->path);
+	/* pipelined requests wait until a file being sent has gone out */
+	if (hd->file_fd != -1)
+		return;
 
-		if (handling_done)
-			break;
-	}
+	ph = hd->handler;
+	handling_done = ph != NULL;
 
 	if (handling_done)
 	{
@@ -231,6 +361,7 @@ static void httpd_recvqhandler(connection_t *cptr)
 		if (p == NULL)
 			return;
 		mowgli_strlcpy(hd->filename, p, sizeof hd->filename);
+		hd->handler = mowgli_patricia_retrieve(path_table, hd->filename);
 		p = strtok(NULL, "");
 		if (p == NULL || !strcmp(p, "HTTP/1.0"))
 			hd->connection_close = true;
@@ -250,6 +381,21 @@ static void httpd_recvqhandler(connection_t *cptr)
 
 		hd->method[0] = '\0';
 
+		if (handling_done && is_get && ph->get_handler != NULL)
+		{
+			ph->get_handler(cptr);
+			check_close(cptr);
+			clear_httpddata(hd);
+			return;
+		}
+
+		if (handling_done && ph->handler == NULL)
+		{
+			send_error(cptr, 405, "Method Not Allowed", true);
+			sendq_add_eof(cptr);
+			return;
+		}
+
 		if (!handling_done)
 		{
 			in = open_file(hd->filename);
@@ -269,6 +415,21 @@ static void httpd_recvqhandler(connection_t *cptr)
 					content_type(hd->filename),
 					(unsigned long)sb.st_size);
 			sendq_add(cptr, outbuf, strlen(outbuf));
+#ifdef USE_SENDFILE
+			if (is_get && sb.st_size > 0)
+			{
+				/* the file goes out after the headers, straight
+				 * from the page cache */
+				hd->file_fd = in;
+				hd->file_offset = 0;
+				hd->file_left = sb.st_size;
+				connection_setselect_read(cptr, NULL);
+				connection_setselect_write(cptr, httpd_sendfile);
+				return;
+			}
+			close(in);
+			check_close(cptr);
+#else
 			count1 = is_get ? sb.st_size : 0;
 			while (count1 > 0)
 			{
@@ -289,6 +450,7 @@ static void httpd_recvqhandler(connection_t *cptr)
 			}
 			else
 				check_close(cptr);
+#endif
 		}
 		else
 		{
@@ -332,6 +494,8 @@ static void httpd_closehandler(connection_t *cptr)
 	hd = cptr->userdata;
 	if (hd != NULL)
 	{
+		if (hd->file_fd != -1)
+			close(hd->file_fd);
 		free(hd->requestbuf);
 		free(hd);
 	}
@@ -349,6 +513,7 @@ static void do_listen(connection_t *cptr)
 	hd->requestbuf = NULL;
 	hd->replybuf = NULL;
 	hd->connection_close = false;
+	hd->file_fd = -1;
 	clear_httpddata(hd);
 	newptr->userdata = hd;
 	newptr->recvq_handler = httpd_recvqhandler;
@@ -368,7 +533,9 @@ static void httpd_checkidle(void *arg)
 		cptr = n->data;
 		if (cptr->listener == listener && cptr->last_recv + 300 < CURRTIME)
 		{
-			if (sendq_nonempty(cptr))
+			struct httpddata *hd = cptr->userdata;
+
+			if (sendq_nonempty(cptr) || (hd != NULL && hd->file_fd != -1))
 				cptr->last_recv = CURRTIME;
 			else
 				/* from a timeout function,
@@ -400,6 +567,8 @@ static mowgli_eventloop_timer_t *httpd_checkidle_timer = NULL;
 
 void _modinit(module_t *m)
 {
+	httpd_path_rehash();
+
 	httpd_checkidle_timer = mowgli_timer_add(base_eventloop, "httpd_checkidle", httpd_checkidle, NULL, 60);
 
 	/* This module needs a rehash to initialize fully if loaded
@@ -419,6 +588,9 @@ void _moddeinit(module_unload_intent_t intent)
 
 	hook_del_config_ready(httpd_config_ready);
 	connection_close_soon_children(listener);
+
+	mowgli_patricia_destroy(path_table, NULL, NULL);
+	path_table = NULL;
 	del_conf_item("HOST", &conf_httpd_table);
 	del_conf_item("WWW_ROOT", &conf_httpd_table);
 	del_conf_item("PORT", &conf_httpd_table);
@@ -0,0 +1,283 @@
+/*
+ * ChatServices: A collection of minimalist IRC services
+ * metrics.c: Prometheus metrics over misc/httpd.
+ *
+ * Copyright (c) 2018 ChatLounge IRC Network Development Team
+ *     (http://www.chatlounge.net)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Serves GET /metrics in the Prometheus text exposition format.  The
+ * counters themselves are plain fields bumped where the work happens
+ * (pcommand_t, hook_t, service_t, cnt, db_save_stats, loop_stalls,
+ * sharedheap_t); nothing is formatted, and memory usage is not read,
+ * until a scrape comes in.
+ */
+
+#include "atheme.h"
+#include "httpd.h"
+#include "datastream.h"
+
+DECLARE_MODULE_V1
+(
+	"misc/metrics", false, _modinit, _moddeinit,
+	PACKAGE_STRING,
+	VENDOR_STRING
+);
+
+static void metrics_handle_get(connection_t *cptr);
+
+static httpd_path_func_t *httpd_path_funcs;
+static path_handler_t handle_metrics = { "/metrics", NULL, metrics_handle_get };
+
+static void metrics_printf(mowgli_string_t *s, const char *fmt, ...) PRINTFLIKE(2, 3);
+
+static void metrics_printf(mowgli_string_t *s, const char *fmt, ...)
+{
+	char buf[BUFSIZE];
+	va_list args;
+	int len;
+
+	va_start(args, fmt);
+	len = vsnprintf(buf, sizeof buf, fmt, args);
+	va_end(args);
+
+	if (len < 0)
+		return;
+	if ((size_t)len >= sizeof buf)
+		len = sizeof buf - 1;
+
+	mowgli_string_append(s, buf, len);
+}
+
+static void metrics_describe(mowgli_string_t *s, const char *name, const char *type, const char *help)
+{
+	metrics_printf(s, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void metrics_value(mowgli_string_t *s, const char *name, const char *type, const char *help, unsigned long value)
+{
+	metrics_describe(s, name, type, help);
+	metrics_printf(s, "%s %lu\n", name, value);
+}
+
+/* label values may hold anything a module or uplink chose to name things */
+static void metrics_labelled(mowgli_string_t *s, const char *name, const char *label, const char *labelval, unsigned long value)
+{
+	char buf[BUFSIZE];
+	const char *p;
+	size_t i = 0;
+
+	for (p = labelval; *p != '\0' && i < sizeof buf - 3; p++)
+	{
+		if (*p == '\\' || *p == '"')
+			buf[i++] = '\\';
+		else if (*p == '\n')
+		{
+			buf[i++] = '\\';
+			buf[i++] = 'n';
+			continue;
+		}
+		buf[i++] = *p;
+	}
+	buf[i] = '\0';
+
+	metrics_printf(s, "%s{%s=\"%s\"} %lu\n", name, label, buf, value);
+}
+
+static void metrics_protocol(mowgli_string_t *s)
+{
+	mowgli_patricia_iteration_state_t state;
+	pcommand_t *pcmd;
+
+	metrics_describe(s, "atheme_protocol_lines_total", "counter", "Lines received from the uplink, by command.");
+	MOWGLI_PATRICIA_FOREACH(pcmd, &state, pcommands)
+	{
+		if (pcmd->calls != 0)
+			metrics_labelled(s, "atheme_protocol_lines_total", "command", pcmd->token, pcmd->calls);
+	}
+}
+
+static void metrics_hooks(mowgli_string_t *s)
+{
+	mowgli_patricia_iteration_state_t state;
+	hook_t *h;
+
+	metrics_describe(s, "atheme_hook_calls_total", "counter", "Hook events raised, by hook.");
+	MOWGLI_PATRICIA_FOREACH(h, &state, hooks)
+	{
+		if (h->calls != 0)
+			metrics_labelled(s, "atheme_hook_calls_total", "hook", h->name, h->calls);
+	}
+}
+
+static void metrics_services(mowgli_string_t *s)
+{
+	mowgli_patricia_iteration_state_t state;
+	service_t *svs;
+
+	metrics_describe(s, "atheme_commands_total", "counter", "Commands executed, by service.");
+	MOWGLI_PATRICIA_FOREACH(svs, &state, services_name)
+	{
+		metrics_labelled(s, "atheme_commands_total", "service", svs->internal_name, svs->commands_run);
+	}
+}
+
+static void metrics_queues(mowgli_string_t *s)
+{
+	mowgli_node_t *n;
+	connection_t *cptr;
+	unsigned long sendq = 0, recvq = 0;
+
+	MOWGLI_ITER_FOREACH(n, connection_list.head)
+	{
+		cptr = n->data;
+		sendq += sendq_length(cptr);
+		recvq += recvq_length(cptr);
+	}
+
+	metrics_value(s, "atheme_connections", "gauge", "Open connections, including listeners.", MOWGLI_LIST_LENGTH(&connection_list));
+	metrics_value(s, "atheme_sendq_bytes", "gauge", "Bytes waiting to be sent, over all connections.", sendq);
+	metrics_value(s, "atheme_recvq_bytes", "gauge", "Bytes received but not yet parsed, over all connections.", recvq);
+	metrics_value(s, "atheme_sent_bytes_total", "counter", "Bytes sent.", cnt.bout);
+	metrics_value(s, "atheme_received_bytes_total", "counter", "Bytes received.", cnt.bin);
+}
+
+/* types sharing a name, such as the string heaps, are summed */
+static void metrics_heaps(mowgli_string_t *s, const char *name, const char *help, bool bytes)
+{
+	mowgli_node_t *n, *n2;
+	const sharedheap_t *sh, *other;
+	unsigned long value;
+
+	metrics_describe(s, name, "gauge", help);
+
+	MOWGLI_ITER_FOREACH(n, sharedheap_list.head)
+	{
+		sh = n->data;
+
+		for (n2 = sharedheap_list.head; n2 != n; n2 = n2->next)
+			if (!strcmp(((const sharedheap_t *)n2->data)->name, sh->name))
+				break;
+		if (n2 != n)
+			continue;
+
+		for (value = 0; n2 != NULL; n2 = n2->next)
+		{
+			other = n2->data;
+			if (!strcmp(other->name, sh->name))
+				value += bytes ? other->live * other->size : other->live;
+		}
+
+		metrics_labelled(s, name, "type", sh->name, value);
+	}
+}
+
+static void metrics_memory(mowgli_string_t *s)
+{
+	memstat_t ms;
+
+	memstat_get(&ms);
+
+	if (ms.rss != 0)
+		metrics_value(s, "atheme_resident_bytes", "gauge", "Resident set size.", ms.rss);
+	if (ms.pss != 0)
+		metrics_value(s, "atheme_proportional_bytes", "gauge", "Proportional set size, with shared pages split between sharers.", ms.pss);
+	if (ms.malloc_used != 0)
+	{
+		metrics_value(s, "atheme_malloc_used_bytes", "gauge", "Memory handed out by malloc().", ms.malloc_used);
+		metrics_value(s, "atheme_malloc_free_bytes", "gauge", "Memory held by malloc() for reuse.", ms.malloc_free);
+	}
+	metrics_value(s, "atheme_heap_reserved_bytes", "gauge", "Least memory the shared heaps' blocks can take.", ms.heap_reserved);
+
+	metrics_heaps(s, "atheme_heap_objects", "Objects allocated from the shared heaps, by type.", false);
+	metrics_heaps(s, "atheme_heap_bytes", "Memory taken by objects in the shared heaps, by type.", true);
+}
+
+static void metrics_build(mowgli_string_t *s)
+{
+	metrics_value(s, "atheme_start_time_seconds", "gauge", "Start time of the process since the Unix epoch.", me.start);
+
+	metrics_value(s, "atheme_servers", "gauge", "Servers on the network.", cnt.server);
+	metrics_value(s, "atheme_users", "gauge", "Users on the network.", cnt.user);
+	metrics_value(s, "atheme_channels", "gauge", "Channels on the network.", cnt.chan);
+	metrics_value(s, "atheme_channel_members", "gauge", "Channel memberships on the network.", cnt.chanuser);
+	metrics_value(s, "atheme_accounts", "gauge", "Registered accounts.", cnt.myuser);
+	metrics_value(s, "atheme_nicks", "gauge", "Registered nicknames.", cnt.mynick);
+	metrics_value(s, "atheme_registered_channels", "gauge", "Registered channels.", cnt.mychan);
+
+	metrics_queues(s);
+
+	metrics_value(s, "atheme_db_saves_total", "counter", "Database saves started.", db_save_stats.saves);
+	metrics_describe(s, "atheme_db_save_last_seconds", "gauge", "Main loop time taken by the last database save.");
+	metrics_printf(s, "atheme_db_save_last_seconds %u.%03u\n", db_save_stats.last_ms / 1000, db_save_stats.last_ms % 1000);
+	metrics_describe(s, "atheme_db_save_seconds_total", "counter", "Main loop time taken by database saves.");
+	metrics_printf(s, "atheme_db_save_seconds_total %lu.%03lu\n", db_save_stats.total_ms / 1000, db_save_stats.total_ms % 1000);
+
+	metrics_value(s, "atheme_loop_stalls_total", "counter", "Event loop iterations longer than general::stall_threshold.", loop_stalls.count);
+	metrics_describe(s, "atheme_loop_stall_seconds_total", "counter", "Time spent in stalled event loop iterations.");
+	metrics_printf(s, "atheme_loop_stall_seconds_total %llu.%06llu\n", (unsigned long long)(loop_stalls.total / 1000000), (unsigned long long)(loop_stalls.total % 1000000));
+
+	metrics_value(s, "atheme_mail_queue_depth", "gauge", "Messages in the outgoing mail queue.", mailqueue_stats.depth);
+	metrics_value(s, "atheme_mail_sent_total", "counter", "Messages accepted by the MTA.", mailqueue_stats.sent);
+	metrics_value(s, "atheme_mail_deferred_total", "counter", "Temporary delivery failures, to be retried.", mailqueue_stats.deferred);
+	metrics_value(s, "atheme_mail_failed_total", "counter", "Messages given up on.", mailqueue_stats.failed);
+
+	metrics_memory(s);
+	metrics_protocol(s);
+	metrics_hooks(s);
+	metrics_services(s);
+}
+
+static void metrics_handle_get(connection_t *cptr)
+{
+	mowgli_string_t *s;
+	char hdr[300];
+
+	s = mowgli_string_create();
+	metrics_build(s);
+
+	snprintf(hdr, sizeof hdr, "HTTP/1.1 200 OK\r\n"
+			"Server: Atheme/%s\r\n"
+			"Content-Type: text/plain; version=0.0.4\r\n"
+			"Content-Length: %lu\r\n\r\n",
+			PACKAGE_VERSION, (unsigned long)s->pos);
+	sendq_add(cptr, hdr, strlen(hdr));
+	sendq_add(cptr, s->str, s->pos);
+
+	mowgli_string_destroy(s);
+}
+
+void _modinit(module_t *m)
+{
+	MODULE_TRY_REQUEST_SYMBOL(m, httpd_path_funcs, "misc/httpd", "httpd_path_funcs");
+
+	httpd_path_funcs->path_add(&handle_metrics);
+}
+
+void _moddeinit(module_unload_intent_t intent)
+{
+	httpd_path_funcs->path_delete(&handle_metrics);
+}
+
+/* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
+ * vim:ts=8
+ * vim:sw=8
+ * vim:noexpandtab
+ */
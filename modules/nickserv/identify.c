@@ -29,6 +29,13 @@ DECLARE_MODULE_V1
 void (*add_login_history_entry)(myuser_t *smu, myuser_t *tmu, const char *desc) = NULL;
 
 static void ns_cmd_login(sourceinfo_t *si, int parc, char *parv[]);
+static void ns_login_verified(myuser_t *mu, bool verified, void *privdata);
+
+/* an IDENTIFY waiting for its password to be checked */
+typedef struct {
+	sourceinfo_t *si;
+	char *client;		/* CLIENT_NAME() of si->su */
+} login_request_t;
 
 #ifdef NICKSERV_LOGIN
 command_t ns_login = { "LOGIN", N_("Authenticates to a services account."), AC_NONE, 2, ns_cmd_login, { .path = "nickserv/login" } };
@@ -59,12 +66,10 @@ static void ns_cmd_login(sourceinfo_t *si, int parc, char *parv[])
 {
 	user_t *u = si->su;
 	myuser_t *mu;
-	mowgli_node_t *n, *tn;
 	const char *target = parv[0];
 	const char *password = parv[1];
-	char buf[BUFSIZE], lau[BUFSIZE];
-	char description[300];
 	hook_user_login_check_t req;
+	login_request_t *lr;
 
 	if (si->su == NULL)
 	{
@@ -138,7 +143,33 @@ static void ns_cmd_login(sourceinfo_t *si, int parc, char *parv[])
 		return;
 	}
 
-	if (verify_password(mu, password))
+	lr = smalloc(sizeof(login_request_t));
+	lr->si = object_ref(si);
+	lr->client = sstrdup(CLIENT_NAME(u));
+
+	verify_password_async(mu, password, ns_login_verified, lr);
+}
+
+static void ns_login_verified(myuser_t *mu, bool verified, void *privdata)
+{
+	login_request_t *lr = privdata;
+	sourceinfo_t *si = lr->si;
+	user_t *u;
+	mowgli_node_t *n, *tn;
+	char lau[BUFSIZE];
+
+	/* the user or the account may have gone away while we waited */
+	u = user_find(lr->client);
+	if (u == NULL || u != si->su || myuser_find(entity(mu)->name) != mu)
+		goto out;
+
+	if (u->myuser == mu)
+	{
+		command_fail(si, fault_nochange, _("You are already logged in as: \2%s\2"), entity(u->myuser)->name);
+		goto out;
+	}
+
+	if (verified)
 	{
 		if (MOWGLI_LIST_LENGTH(&mu->logins) >= me.maxlogins)
 		{
@@ -155,7 +186,7 @@ static void ns_cmd_login(sourceinfo_t *si, int parc, char *parv[])
 			}
 
 			logcommand(si, CMDLOG_LOGIN, "failed " COMMAND_UC " to \2%s\2 (too many logins)", entity(mu)->name);
-			return;
+			goto out;
 		}
 
 		/* if they are identified to another account, nuke their session first */
@@ -165,7 +196,7 @@ static void ns_cmd_login(sourceinfo_t *si, int parc, char *parv[])
 
 			if (ircd_on_logout(u, entity(u->myuser)->name))
 				/* logout killed the user... */
-				return;
+				goto out;
 		        u->myuser->lastlogin = CURRTIME;
 		        MOWGLI_ITER_FOREACH_SAFE(n, tn, u->myuser->logins.head)
 		        {
@@ -184,13 +215,18 @@ static void ns_cmd_login(sourceinfo_t *si, int parc, char *parv[])
 		myuser_login(si->service, u, mu, true, "IDENTIFY");
 		logcommand(si, CMDLOG_LOGIN, COMMAND_UC);
 
-		return;
+		goto out;
 	}
 
 	logcommand(si, CMDLOG_LOGIN, "failed " COMMAND_UC " to \2%s\2 (bad password)", entity(mu)->name);
 
 	command_fail(si, fault_authfail, _("Invalid password for: \2%s\2"), entity(mu)->name);
 	bad_password(si, mu, "IDENTIFY");
+
+out:
+	object_unref(si);
+	free(lr->client);
+	free(lr);
 }
 
 /* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
@@ -100,6 +100,23 @@ static bool has_waitauth(myuser_t *mu, const void *arg) {
 	return (mu->flags & MU_WAITAUTH) == MU_WAITAUTH;
 }
 
+static bool email_candidates(const void *arg, void (*cb)(myuser_t *mu, void *privdata), void *privdata)
+{
+	return myuser_foreach_email_match((const char *)arg, cb, privdata);
+}
+
+static bool lastlogin_candidates(const void *arg, void (*cb)(myuser_t *mu, void *privdata), void *privdata)
+{
+	myuser_foreach_lastlogin_before(CURRTIME - *(time_t *)arg, cb, privdata);
+	return true;
+}
+
+static bool registered_candidates(const void *arg, void (*cb)(myuser_t *mu, void *privdata), void *privdata)
+{
+	myuser_foreach_registered_before(CURRTIME - *(time_t *)arg, cb, privdata);
+	return true;
+}
+
 void _modinit(module_t *m)
 {
 	list_params = mowgli_patricia_create(strcasecanon);
@@ -109,10 +126,12 @@ void _modinit(module_t *m)
 	static list_param_account_t email;
 	email.opttype = OPT_STRING;
 	email.is_match = email_match;
+	email.candidates = email_candidates;
 
 	static list_param_account_t lastlogin;
 	lastlogin.opttype = OPT_AGE;
 	lastlogin.is_match = lastlogin_match;
+	lastlogin.candidates = lastlogin_candidates;
 
 	static list_param_account_t pattern;
 	pattern.opttype = OPT_STRING;
@@ -121,6 +140,7 @@ void _modinit(module_t *m)
 	static list_param_account_t registered;
 	registered.opttype = OPT_AGE;
 	registered.is_match = registered_match;
+	registered.candidates = registered_candidates;
 
 	list_account_register("email", &email);
 	list_account_register("lastlogin", &lastlogin);
@@ -197,92 +217,160 @@ static void list_one(sourceinfo_t *si, myuser_t *mu, mynick_t *mn)
 		command_success_nodata(si, "- %s (%s) (%s) %s", mn->nick, mu->email, entity(mu)->name, buf);
 }
 
+typedef struct {
+	list_param_account_t *param;
+	union {
+		bool boolval;
+		int intval;
+		const char *strval;
+		time_t ageval;
+	} arg;
+} list_criterion_t;
+
+typedef struct {
+	myuser_t **v;
+	size_t count;
+	size_t size;
+} list_candidates_t;
+
+static const void *criterion_arg(const list_criterion_t *crit)
+{
+	switch (crit->param->opttype)
+	{
+	case OPT_BOOL:
+		return &crit->arg.boolval;
+	case OPT_INT:
+		return &crit->arg.intval;
+	case OPT_STRING:
+		return crit->arg.strval;
+	case OPT_AGE:
+		return &crit->arg.ageval;
+	default:
+		return NULL;
+	}
+}
+
+static bool list_check(myuser_t *mu, const list_criterion_t *crit, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++)
+	{
+		/* flag criteria take no argument and are never checked */
+		if (crit[i].param->opttype == OPT_FLAG)
+			continue;
+
+		if (!crit[i].param->is_match(mu, criterion_arg(&crit[i])))
+			return false;
+	}
+
+	return true;
+}
+
+static void list_collect(myuser_t *mu, void *privdata)
+{
+	list_candidates_t *cand = privdata;
+
+	if (cand->count == cand->size)
+	{
+		cand->size = cand->size ? cand->size * 2 : 64;
+		cand->v = srealloc(cand->v, cand->size * sizeof(myuser_t *));
+	}
+
+	cand->v[cand->count++] = mu;
+}
+
+/* orders account names the way accountlist's irccasecanon() keys sort */
+static int list_candidate_cmp(const void *a, const void *b)
+{
+	const unsigned char *s1 = (const unsigned char *)entity(*(myuser_t *const *)a)->name;
+	const unsigned char *s2 = (const unsigned char *)entity(*(myuser_t *const *)b)->name;
+
+	while (*s1 != '\0' && ToUpper(*s1) == ToUpper(*s2))
+	{
+		s1++;
+		s2++;
+	}
+
+	return ToUpper(*s1) - ToUpper(*s2);
+}
+
 static void ns_cmd_list(sourceinfo_t *si, int parc, char *parv[])
 {
 	char criteriastr[BUFSIZE];
 
 	mowgli_patricia_iteration_state_t state;
-	myentity_iteration_state_t mestate;
 	myuser_t *mu;
 
+	list_criterion_t crit[10];
+	list_candidates_t cand = { NULL, 0, 0 };
+	size_t ncrit = 0, j;
+	bool indexed = false;
+
 	int matches = 0;
 
 	int i;
-	bool error = false;
-	bool found;
 
-	MOWGLI_PATRICIA_FOREACH(mu, &state, accountlist)
+	for (i = 0; i < parc && ncrit < ARRAY_SIZE(crit); i++)
 	{
-		found = true;
+		list_param_account_t *param = mowgli_patricia_retrieve(list_params, parv[i]);
 
-		for (i = 0; i < parc; i++)
-		{
-			list_param_account_t *param = mowgli_patricia_retrieve(list_params, parv[i]);
+		if (param == NULL) {
+			command_fail(si, fault_badparams, _("\2%s\2 is not a recognized LIST criterion"), parv[i]);
+			return;
+		}
 
-			if (param == NULL) {
-				command_fail(si, fault_badparams, _("\2%s\2 is not a recognized LIST criterion"), parv[i]);
-				error = true;
-				break;
-			}
+		crit[ncrit].param = param;
 
-			if (param->opttype == OPT_BOOL) {
-				bool arg = true;
-
-				if (!param->is_match(mu, &arg)) {
-					found = false;
-					break;
-				}
-			} else if (param->opttype == OPT_INT) {
-				if (i + 1 < parc) {
-					int arg = atoi(parv[++i]);
-
-					if (!param->is_match(mu, &arg)) {
-						found = false;
-						break;
-					}
-				} else {
-					command_fail(si, fault_needmoreparams, STR_INSUFFICIENT_PARAMS, parv[i]);
-					error = true;
-					break;
-				}
-			} else if (param->opttype == OPT_STRING) {
-				if (i + 1 < parc) {
-					if (!param->is_match(mu, parv[++i])) {
-						found = false;
-						break;
-					}
-				} else {
-					command_fail(si, fault_needmoreparams, STR_INSUFFICIENT_PARAMS, parv[i]);
-					error = true;
-					break;
-				}
-			}
-			else if (param->opttype == OPT_AGE) {
-				if (i + 1 < parc)
-				{
-					time_t age = parse_age(parv[++i]);
-
-					if (!param->is_match(mu, &age)) {
-						found = false;
-						break;
-					}
-				} else {
-					command_fail(si, fault_needmoreparams, STR_INSUFFICIENT_PARAMS, parv[i]);
-					error = true;
-					break;
-				}
+		if (param->opttype == OPT_BOOL) {
+			crit[ncrit].arg.boolval = true;
+		} else if (param->opttype == OPT_INT || param->opttype == OPT_STRING || param->opttype == OPT_AGE) {
+			if (i + 1 >= parc) {
+				command_fail(si, fault_needmoreparams, STR_INSUFFICIENT_PARAMS, parv[i]);
+				return;
 			}
-		} //for (i = 0; i < parc; i++)
 
-		if (error) {
-			break;
+			i++;
+			if (param->opttype == OPT_INT)
+				crit[ncrit].arg.intval = atoi(parv[i]);
+			else if (param->opttype == OPT_STRING)
+				crit[ncrit].arg.strval = parv[i];
+			else
+				crit[ncrit].arg.ageval = parse_age(parv[i]);
 		}
 
-		if (found) {
-			list_one(si, mu, NULL);
-			matches++;
+		ncrit++;
+	}
+
+	/* let the first indexed criterion pick the accounts to look at */
+	for (j = 0; j < ncrit && !indexed; j++)
+		if (crit[j].param->candidates != NULL && crit[j].param->opttype != OPT_FLAG)
+			indexed = crit[j].param->candidates(criterion_arg(&crit[j]), list_collect, &cand);
+
+	if (indexed)
+	{
+		qsort(cand.v, cand.count, sizeof(myuser_t *), list_candidate_cmp);
+
+		for (j = 0; j < cand.count; j++)
+		{
+			if (list_check(cand.v[j], crit, ncrit)) {
+				list_one(si, cand.v[j], NULL);
+				matches++;
+			}
 		}
-	} //MOWGLI_PATRICIA_FOREACH(mn, &state, nicklist)
+
+		free(cand.v);
+	}
+	else
+	{
+		MOWGLI_PATRICIA_FOREACH(mu, &state, accountlist)
+		{
+			if (list_check(mu, crit, ncrit)) {
+				list_one(si, mu, NULL);
+				matches++;
+			}
+		}
+	}
 
 	build_criteriastr(criteriastr, parc, parv);
 
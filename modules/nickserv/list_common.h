@@ -23,6 +23,10 @@ typedef struct {
 typedef struct {
 	list_opttype_t opttype;
 	bool (*is_match)(myuser_t *mu, const void *arg);
+
+	/* optional: calls cb for a superset of the accounts is_match()
+	 * accepts, or returns false if it cannot narrow them down */
+	bool (*candidates)(const void *arg, void (*cb)(myuser_t *mu, void *privdata), void *privdata);
 } list_param_account_t;
 
 #endif /* !NSLIST_COMMON_H */
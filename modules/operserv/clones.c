@@ -126,7 +126,7 @@ void _modinit(module_t *m)
 	hook_add_config_ready(clones_configready);
 
 	hook_add_event("user_add");
-	hook_add_user_add(clones_newuser);
+	hook_add_deferrable_user_add(clones_newuser);
 	hook_add_event("user_delete");
 	hook_add_user_delete(clones_userquit);
 	hook_add_db_write(write_exemptdb);
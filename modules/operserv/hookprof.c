@@ -0,0 +1,175 @@
+/*
+ * ChatServices: A collection of minimalist IRC services
+ * hookprof.c: OperServ HOOKPROF, what hook handlers cost.
+ *
+ * Copyright (c) 2018 ChatLounge IRC Network Development Team
+ *     (http://www.chatlounge.net)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "atheme.h"
+
+DECLARE_MODULE_V1
+(
+	"operserv/hookprof", false, _modinit, _moddeinit,
+	PACKAGE_STRING,
+	VENDOR_STRING
+);
+
+/* handlers shown by HOOKPROF LIST without a hook name */
+#define HOOKPROF_LIST_MAX	30
+
+static void os_cmd_hookprof(sourceinfo_t *si, int parc, char *parv[]);
+
+command_t os_hookprof = { "HOOKPROF", N_("Profiles hook handlers."),
+			PRIV_SERVER_AUSPEX, 2, os_cmd_hookprof, { .path = "oservice/hookprof" } };
+
+typedef struct {
+	hook_t *hook;
+	unsigned int position;
+	const hook_profile_t *prof;
+} hookprof_entry_t;
+
+typedef struct {
+	const char *hookname;
+	hookprof_entry_t *v;
+	size_t count, size;
+} hookprof_list_t;
+
+void _modinit(module_t *m)
+{
+	service_named_bind_command("operserv", &os_hookprof);
+}
+
+void _moddeinit(module_unload_intent_t intent)
+{
+	service_named_unbind_command("operserv", &os_hookprof);
+
+	/* nothing would be left to turn it off */
+	hook_profiling = false;
+}
+
+static void hookprof_collect(hook_t *hook, unsigned int position, const hook_profile_t *prof, void *privdata)
+{
+	hookprof_list_t *l = privdata;
+
+	if (l->hookname != NULL ? strcasecmp(hook->name, l->hookname) : prof->calls == 0)
+		return;
+
+	if (l->count == l->size)
+	{
+		l->size = l->size ? l->size * 2 : 64;
+		l->v = srealloc(l->v, l->size * sizeof(hookprof_entry_t));
+	}
+
+	l->v[l->count].hook = hook;
+	l->v[l->count].position = position;
+	l->v[l->count].prof = prof;
+	l->count++;
+}
+
+/* most CPU time first */
+static int hookprof_cmp(const void *a, const void *b)
+{
+	const hookprof_entry_t *ea = a, *eb = b;
+
+	if (ea->prof->cpu != eb->prof->cpu)
+		return ea->prof->cpu < eb->prof->cpu ? 1 : -1;
+
+	return 0;
+}
+
+static void hookprof_list(sourceinfo_t *si, const char *hookname)
+{
+	hookprof_list_t l = { hookname, NULL, 0, 0 };
+	const hook_profile_t *prof;
+	size_t i;
+
+	hook_profile_foreach(hookprof_collect, &l);
+
+	/* one hook's handlers are shown in the order they run */
+	if (hookname == NULL)
+		qsort(l.v, l.count, sizeof(hookprof_entry_t), hookprof_cmp);
+
+	for (i = 0; i < l.count && (hookname != NULL || i < HOOKPROF_LIST_MAX); i++)
+	{
+		prof = l.v[i].prof;
+		command_success_nodata(si, _("\2%s\2 #%u (%s): %lu calls, %llu.%03llu ms total, %u.%03u ms max"),
+				l.v[i].hook->name, l.v[i].position, prof->owner, prof->calls,
+				(unsigned long long)prof->cpu / 1000, (unsigned long long)prof->cpu % 1000,
+				prof->max / 1000, prof->max % 1000);
+	}
+
+	if (l.count == 0 && hookname != NULL)
+		command_success_nodata(si, _("No handlers for hook \2%s\2."), hookname);
+	else if (l.count == 0)
+		command_success_nodata(si, _("No hook handlers have been profiled."));
+	else
+		command_success_nodata(si, _("End of hook profile, %zu of %zu handlers shown."), i, l.count);
+
+	if (!hook_profiling)
+		command_success_nodata(si, _("Hook profiling is disabled."));
+
+	free(l.v);
+
+	logcommand(si, CMDLOG_GET, "HOOKPROF:LIST: \2%s\2", hookname != NULL ? hookname : "*");
+}
+
+static void os_cmd_hookprof(sourceinfo_t *si, int parc, char *parv[])
+{
+	const char *action = parc > 0 ? parv[0] : "LIST";
+
+	if (!strcasecmp(action, "LIST"))
+	{
+		hookprof_list(si, parc > 1 ? parv[1] : NULL);
+		return;
+	}
+
+	if (strcasecmp(action, "ON") && strcasecmp(action, "OFF") && strcasecmp(action, "RESET"))
+	{
+		command_fail(si, fault_badparams, STR_INVALID_PARAMS, "HOOKPROF");
+		command_fail(si, fault_badparams, _("Syntax: HOOKPROF [LIST [hook]|ON|OFF|RESET]"));
+		return;
+	}
+
+	if (!has_priv(si, PRIV_ADMIN))
+	{
+		command_fail(si, fault_noprivs, STR_NO_PRIVILEGE, PRIV_ADMIN);
+		return;
+	}
+
+	if (!strcasecmp(action, "RESET"))
+	{
+		hook_profile_reset();
+		logcommand(si, CMDLOG_ADMIN, "HOOKPROF:RESET");
+		command_success_nodata(si, _("Hook profile counters have been reset."));
+		return;
+	}
+
+	hook_profiling = !strcasecmp(action, "ON");
+
+	wallops("%s %s hook profiling.", get_oper_name(si), hook_profiling ? "enabled" : "disabled");
+	logcommand(si, CMDLOG_ADMIN, "HOOKPROF:%s", hook_profiling ? "ON" : "OFF");
+	command_success_nodata(si, hook_profiling ? _("Hook profiling is now enabled.") : _("Hook profiling is now disabled."));
+}
+
+/* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
+ * vim:ts=8
+ * vim:sw=8
+ * vim:noexpandtab
+ */
@@ -28,7 +28,6 @@ command_t os_ignore_list = { "LIST", N_("List services ignores"), PRIV_ADMIN, 0,
 command_t os_ignore_clear = { "CLEAR", N_("Clear all services ignores"), PRIV_ADMIN, 0, os_cmd_ignore_clear, { .path = "" } };
 
 mowgli_patricia_t *os_ignore_cmds;
-mowgli_list_t svs_ignore_list;
 
 
 void _modinit(module_t *m)
@@ -179,12 +178,7 @@ static void os_cmd_ignore_clear(sourceinfo_t *si, int parc, char *parv[])
 		svsignore = (svsignore_t *)n->data;
 
 		command_success_nodata(si, _("\2%s\2 has been removed from the services ignore list."), svsignore->mask);
-		mowgli_node_delete(n,&svs_ignore_list);
-		mowgli_node_free(n);
-		free(svsignore->mask);
-		free(svsignore->setby);
-		free(svsignore->reason);
-
+		svsignore_delete(svsignore);
 	}
 
 	command_success_nodata(si, _("Services ignore list has been wiped!"));
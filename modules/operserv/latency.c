@@ -0,0 +1,104 @@
+/*
+ * ChatServices: A collection of minimalist IRC services
+ * latency.c: OperServ LATENCY, execution times of services commands.
+ *
+ * Copyright (c) 2018 ChatLounge IRC Network Development Team
+ *     (http://www.chatlounge.net)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "atheme.h"
+
+DECLARE_MODULE_V1
+(
+	"operserv/latency", false, _modinit, _moddeinit,
+	PACKAGE_STRING,
+	VENDOR_STRING
+);
+
+static void os_cmd_latency(sourceinfo_t *si, int parc, char *parv[]);
+
+command_t os_latency = { "LATENCY", N_("Shows how long services commands take to run."), PRIV_SERVER_AUSPEX, 1, os_cmd_latency, { .path = "oservice/latency" } };
+
+void _modinit(module_t *m)
+{
+	service_named_bind_command("operserv", &os_latency);
+}
+
+void _moddeinit(module_unload_intent_t intent)
+{
+	service_named_unbind_command("operserv", &os_latency);
+}
+
+static const char *latency_ms(char *buf, size_t len, unsigned int us)
+{
+	snprintf(buf, len, "%u.%03u", us / 1000, us % 1000);
+	return buf;
+}
+
+static void os_cmd_latency(sourceinfo_t *si, int parc, char *parv[])
+{
+	const char *target = parv[0];
+	service_t *svs;
+	command_stats_t *cs;
+	mowgli_patricia_iteration_state_t state;
+	char avg[16], p50[16], p99[16], max[16];
+	unsigned int count = 0;
+
+	/* accept the service's nick as well as its internal name */
+	if (target != NULL && (svs = service_find_nick(target)) != NULL)
+		target = svs->internal_name;
+
+	if (target == NULL && loop_stalls.count != 0)
+		command_success_nodata(si, _("\2Event loop stalls\2: %lu, avg %s ms, 50%% %s ms, 99%% %s ms, max %s ms"),
+				loop_stalls.count,
+				latency_ms(avg, sizeof avg, loop_stalls.total / loop_stalls.count),
+				latency_ms(p50, sizeof p50, histogram_percentile(&loop_stalls, 50)),
+				latency_ms(p99, sizeof p99, histogram_percentile(&loop_stalls, 99)),
+				latency_ms(max, sizeof max, loop_stalls.max));
+
+	MOWGLI_PATRICIA_FOREACH(cs, &state, command_stats)
+	{
+		if (cs->latency.count == 0)
+			continue;
+		if (target != NULL && strcasecmp(cs->service, target))
+			continue;
+
+		command_success_nodata(si, _("\2%s %s\2: %lu calls, avg %s ms, 50%% %s ms, 99%% %s ms, max %s ms"),
+				cs->service, cs->name, cs->latency.count,
+				latency_ms(avg, sizeof avg, cs->latency.total / cs->latency.count),
+				latency_ms(p50, sizeof p50, histogram_percentile(&cs->latency, 50)),
+				latency_ms(p99, sizeof p99, histogram_percentile(&cs->latency, 99)),
+				latency_ms(max, sizeof max, cs->latency.max));
+		count++;
+	}
+
+	if (count == 0)
+		command_success_nodata(si, _("No commands have been timed."));
+	else
+		command_success_nodata(si, ngettext(N_("End of latency report, %u command."),
+				N_("End of latency report, %u commands."), count), count);
+
+	logcommand(si, CMDLOG_GET, "LATENCY: \2%s\2", target != NULL ? target : "*");
+}
+
+/* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
+ * vim:ts=8
+ * vim:sw=8
+ * vim:noexpandtab
+ */
@@ -0,0 +1,211 @@
+/*
+ * ChatServices: A collection of minimalist IRC services
+ * memory.c: Reports what services' memory is used for.
+ *
+ * Copyright (c) 2018 ChatLounge IRC Network Development Team
+ *     (http://www.chatlounge.net)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "atheme.h"
+
+DECLARE_MODULE_V1
+(
+	"operserv/memory", false, _modinit, _moddeinit,
+	PACKAGE_STRING,
+	VENDOR_STRING
+);
+
+static void os_cmd_memory(sourceinfo_t *si, int parc, char *parv[]);
+
+command_t os_memory = { "MEMORY", N_("Shows what services' memory is used for."), PRIV_SERVER_AUSPEX, 1, os_cmd_memory, { .path = "oservice/memory" } };
+
+void _modinit(module_t *m)
+{
+	service_named_bind_command("operserv", &os_memory);
+}
+
+void _moddeinit(module_unload_intent_t intent)
+{
+	service_named_unbind_command("operserv", &os_memory);
+}
+
+static const char *memory_size(char *buf, size_t len, size_t bytes)
+{
+	if (bytes < 1024)
+		snprintf(buf, len, "%zu B", bytes);
+	else if (bytes < 1024 * 1024)
+		snprintf(buf, len, "%.1f KB", bytes / 1024.0);
+	else if (bytes < 1024 * 1024 * 1024)
+		snprintf(buf, len, "%.1f MB", bytes / (1024.0 * 1024));
+	else
+		snprintf(buf, len, "%.2f GB", bytes / (1024.0 * 1024 * 1024));
+
+	return buf;
+}
+
+static int memory_cmp(const void *a, const void *b)
+{
+	const sharedheap_t *x = *(const sharedheap_t *const *)a;
+	const sharedheap_t *y = *(const sharedheap_t *const *)b;
+	size_t xb = x->live * x->size, yb = y->live * y->size;
+
+	return xb > yb ? -1 : xb < yb;
+}
+
+static void memory_totals(sourceinfo_t *si)
+{
+	memstat_t ms;
+	size_t strings, string_bytes;
+	char a[32], b[32], c[32];
+
+	memstat_get(&ms);
+	strshare_stats(&strings, &string_bytes);
+
+	if (ms.rss != 0)
+		command_success_nodata(si, _("\2Resident\2: %s (peak %s), %s anonymous"),
+				memory_size(a, sizeof a, ms.rss), memory_size(b, sizeof b, ms.rss_peak),
+				memory_size(c, sizeof c, ms.rss_anon));
+	if (ms.pss != 0)
+		command_success_nodata(si, _("\2Proportional set size\2: %s"), memory_size(a, sizeof a, ms.pss));
+	if (ms.malloc_used != 0)
+		command_success_nodata(si, _("\2malloc\2: %s in use (%s mmap()ed), %s free"),
+				memory_size(a, sizeof a, ms.malloc_used), memory_size(b, sizeof b, ms.malloc_mmap),
+				memory_size(c, sizeof c, ms.malloc_free));
+
+	command_success_nodata(si, _("\2Shared heaps\2: %lu objects, %s, in blocks of at least %s"),
+			ms.heap_objects, memory_size(a, sizeof a, ms.heap_used),
+			memory_size(b, sizeof b, ms.heap_reserved));
+	command_success_nodata(si, _("\2Shared strings\2: %zu, %s of text; %zu too long for the heaps, %s; hash table %s"),
+			strings, memory_size(a, sizeof a, string_bytes),
+			ms.strings_large, memory_size(b, sizeof b, ms.strings_large_bytes),
+			memory_size(c, sizeof c, ms.strings_table));
+}
+
+/* one line per object type, largest first */
+static unsigned int memory_types(sourceinfo_t *si)
+{
+	mowgli_node_t *n;
+	sharedheap_t **v;
+	char a[32];
+	unsigned int i, count = 0;
+
+	v = smalloc(MOWGLI_LIST_LENGTH(&sharedheap_list) * sizeof *v + 1);
+
+	MOWGLI_ITER_FOREACH(n, sharedheap_list.head)
+	{
+		sharedheap_t *sh = n->data;
+
+		if (sh->live != 0)
+			v[count++] = sh;
+	}
+
+	qsort(v, count, sizeof *v, memory_cmp);
+
+	for (i = 0; i < count; i++)
+		command_success_nodata(si, _("\2%s\2: %lu objects of %zu bytes, %s (peak %lu)"),
+				v[i]->name, v[i]->live, v[i]->size,
+				memory_size(a, sizeof a, v[i]->live * v[i]->size), v[i]->peak);
+
+	free(v);
+
+	return count;
+}
+
+/* one line per heap, with the types sharing it */
+static unsigned int memory_heaps(sourceinfo_t *si)
+{
+	mowgli_node_t *n, *n2;
+	char names[BUFSIZE], a[32], b[32];
+	unsigned int count = 0;
+	unsigned long live;
+
+	MOWGLI_ITER_FOREACH(n, sharedheap_list.head)
+	{
+		sharedheap_t *sh = n->data;
+		bool seen = false;
+
+		*names = '\0';
+		live = 0;
+
+		MOWGLI_ITER_FOREACH(n2, sharedheap_list.head)
+		{
+			sharedheap_t *other = n2->data;
+
+			if (other->heap != sh->heap)
+				continue;
+			if (n2 != n && *names == '\0')
+			{
+				/* reported with an earlier type */
+				seen = true;
+				break;
+			}
+
+			if (*names != '\0')
+				mowgli_strlcat(names, ", ", sizeof names);
+			mowgli_strlcat(names, other->name, sizeof names);
+			live += other->live;
+		}
+
+		if (seen)
+			continue;
+
+		command_success_nodata(si, _("\2%zu bytes\2 (%s): %lu objects, %s, in blocks of at least %s, %zu per block"),
+				sh->size, names, live, memory_size(a, sizeof a, live * sh->size),
+				memory_size(b, sizeof b, memstat_heap_reserved(sh)), sh->block);
+		count++;
+	}
+
+	return count;
+}
+
+static void os_cmd_memory(sourceinfo_t *si, int parc, char *parv[])
+{
+	bool heaps = parv[0] != NULL && !strcasecmp(parv[0], "HEAPS");
+	unsigned int count;
+
+	if (parv[0] != NULL && !heaps)
+	{
+		command_fail(si, fault_badparams, STR_INVALID_PARAMS, "MEMORY");
+		command_fail(si, fault_badparams, _("Syntax: MEMORY [HEAPS]"));
+		return;
+	}
+
+	memory_totals(si);
+
+	if (heaps)
+	{
+		count = memory_heaps(si);
+		command_success_nodata(si, ngettext(N_("End of memory report, %u heap."),
+				N_("End of memory report, %u heaps."), count), count);
+	}
+	else
+	{
+		count = memory_types(si);
+		command_success_nodata(si, ngettext(N_("End of memory report, %u object type."),
+				N_("End of memory report, %u object types."), count), count);
+	}
+
+	logcommand(si, CMDLOG_GET, "MEMORY%s", heaps ? " HEAPS" : "");
+}
+
+/* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
+ * vim:ts=8
+ * vim:sw=8
+ * vim:noexpandtab
+ */
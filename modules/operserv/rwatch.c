@@ -69,7 +69,7 @@ void _modinit(module_t *m)
 	command_add(&os_rwatch_set, os_rwatch_cmds);
 
 	hook_add_event("user_add");
-	hook_add_user_add(rwatch_newuser);
+	hook_add_deferrable_user_add(rwatch_newuser);
 	hook_add_event("user_nickchange");
 	hook_add_user_nickchange(rwatch_nickchange);
 	hook_add_db_write(write_rwatchdb);
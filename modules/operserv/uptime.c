@@ -41,6 +41,9 @@ static void os_cmd_uptime(sourceinfo_t *si, int parc, char *parv[])
         	command_success_nodata(si, _("Registered nicknames: %d"), cnt.mynick);
         command_success_nodata(si, _("Registered channels: %d"), cnt.mychan);
         command_success_nodata(si, _("Users currently online: %d"), cnt.user - me.me->users);
+        if (me.mta != NULL)
+                command_success_nodata(si, _("Mail queue: %u waiting, %u sent, %u deferred, %u failed"),
+                                mailqueue_stats.depth, mailqueue_stats.sent, mailqueue_stats.deferred, mailqueue_stats.failed);
 }
 
 /* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
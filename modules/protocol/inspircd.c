@@ -1362,6 +1362,7 @@ static void m_fident(sourceinfo_t *si, int parc, char *parv[])
 {
 	strshare_unref(si->su->user);
 	si->su->user = strshare_get(parv[0]);
+	svsignore_invalidate(si->su);
 }
 
 static void m_fhost(sourceinfo_t *si, int parc, char *parv[])
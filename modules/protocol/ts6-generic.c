@@ -1314,6 +1314,7 @@ static void m_encap(sourceinfo_t *si, int parc, char *parv[])
 
 		strshare_unref(u->host);
 		u->host = strshare_get(parv[2]);
+		svsignore_invalidate(u);
 	}
 	else if (!irccasecmp(parv[1], "CHGHOST"))
 	{
@@ -1398,6 +1399,7 @@ static void m_signon(sourceinfo_t *si, int parc, char *parv[])
 	/* USER */
 	strshare_unref(u->user);
 	u->user = strshare_get(parv[1]);
+	svsignore_invalidate(u);
 
 	/* HOST */
 	strshare_unref(u->vhost);
@@ -96,11 +96,28 @@ struct Blacklist {
 	mowgli_node_t node;
 };
 
+/* A cached or in-flight lookup of one IP address in one DNSBL */
+struct BlacklistLookup {
+	char name[IRCD_RES_HOSTLEN + 1];	/* 2.0.0.127.dnsbl.example.org */
+	struct Blacklist *blacklist;
+	enum {
+		LOOKUP_PENDING,
+		LOOKUP_CLEAR,
+		LOOKUP_LISTED,
+	} state;
+	time_t expires;
+	dns_query_t dns_query;
+	mowgli_list_t clients;	/* BlacklistClients waiting for the answer */
+
+	mowgli_node_t node;	/* in dnsbl_cache_lru */
+};
+
 /* A lookup in progress for a particular DNSBL for a particular client */
 struct BlacklistClient {
 	struct Blacklist *blacklist;
 	user_t *u;
-	dns_query_t dns_query;
+	struct BlacklistLookup *lookup;
+	mowgli_node_t lookup_node;
 	mowgli_node_t node;
 };
 
@@ -117,6 +134,23 @@ typedef struct dnsbl_exempt_ dnsbl_exempt_t;
 
 mowgli_list_t dnsbl_elist;
 
+/*
+ * Answers are cached by query name, which covers both the IP address and
+ * the blacklist, for as long as their TTL allows.  Clients connecting from
+ * an address which is already being looked up wait for the same query.
+ */
+static mowgli_patricia_t *dnsbl_cache;
+static mowgli_list_t dnsbl_cache_lru;		/* least recently used first */
+static sharedheap_t *dnsbl_lookup_heap;
+static mowgli_eventloop_timer_t *dnsbl_cache_timer;
+
+static unsigned int dnsbl_cache_size;		/* most answers to keep */
+static unsigned int dnsbl_cache_ttl;		/* longest time to keep a listing */
+static unsigned int dnsbl_negative_ttl;		/* time to keep a non-listing;
+							 * failed lookups are not kept */
+
+static unsigned int dnsbl_cache_hits, dnsbl_cache_misses, dnsbl_cache_coalesced;
+
 static void os_cmd_set_dnsblaction(sourceinfo_t *si, int parc, char *parv[]);
 static void dnsbl_hit(user_t *u, struct Blacklist *blptr);
 static void abort_blacklist_queries(user_t *u);
@@ -315,77 +349,205 @@ static struct Blacklist *find_blacklist(char *name)
 	return NULL;
 }
 
-static void blacklist_dns_callback(void *vptr, dns_reply_t *reply)
+static void dnsbl_lookup_free(struct BlacklistLookup *lookup)
 {
-	struct BlacklistClient *blcptr = (struct BlacklistClient *) vptr;
-	int listed = 0;
-	mowgli_list_t *l;
+	mowgli_patricia_delete(dnsbl_cache, lookup->name);
+	mowgli_node_delete(&lookup->node, &dnsbl_cache_lru);
 
-	if (blcptr == NULL)
-		return;
+	object_unref(lookup->blacklist);
+	sharedheap_free(dnsbl_lookup_heap, lookup);
+}
+
+/* drops answers, oldest first, until the cache is back within its size */
+static void dnsbl_cache_trim(void)
+{
+	mowgli_node_t *n, *tn;
 
-	if (blcptr->u == NULL)
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, dnsbl_cache_lru.head)
 	{
-		free(blcptr);
-		return;
+		struct BlacklistLookup *lookup = n->data;
+
+		if (MOWGLI_LIST_LENGTH(&dnsbl_cache_lru) <= dnsbl_cache_size)
+			break;
+
+		if (lookup->state != LOOKUP_PENDING)
+			dnsbl_lookup_free(lookup);
 	}
+}
 
-	l = dnsbl_queries(blcptr->u);
-	mowgli_node_delete(&blcptr->node, l);
+static void dnsbl_cache_expire(void *unused)
+{
+	mowgli_node_t *n, *tn;
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, dnsbl_cache_lru.head)
+	{
+		struct BlacklistLookup *lookup = n->data;
+
+		if (lookup->state != LOOKUP_PENDING && lookup->expires <= CURRTIME)
+			dnsbl_lookup_free(lookup);
+	}
+}
+
+static void dnsbl_cache_destroy(void)
+{
+	mowgli_node_t *n, *tn, *n2, *tn2;
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, dnsbl_cache_lru.head)
+	{
+		struct BlacklistLookup *lookup = n->data;
+
+		if (lookup->state == LOOKUP_PENDING)
+			delete_resolver_queries(&lookup->dns_query);
+
+		MOWGLI_ITER_FOREACH_SAFE(n2, tn2, lookup->clients.head)
+		{
+			struct BlacklistClient *blcptr = n2->data;
+
+			mowgli_node_delete(&blcptr->node, dnsbl_queries(blcptr->u));
+			object_unref(blcptr->blacklist);
+			free(blcptr);
+		}
+
+		dnsbl_lookup_free(lookup);
+	}
+}
 
-	if (reply != NULL)
+static void blacklist_dns_callback(void *vptr, dns_reply_t *reply)
+{
+	struct BlacklistLookup *lookup = vptr;
+	mowgli_node_t *n, *tn;
+	time_t ttl = dnsbl_negative_ttl;
+
+	lookup->state = LOOKUP_CLEAR;
+
+	if (reply == NULL && !lookup->dns_query.nxdomain)
+	{
+		/* a timeout or server error says nothing about the address */
+		slog(LG_DEBUG, "blacklist_dns_callback(): lookup of %s failed", lookup->name);
+		ttl = 0;
+	}
+	else if (reply != NULL)
 	{
 		/* only accept 127.x.y.z as a listing */
 		if (reply->addr.saddr.sa.sa_family == AF_INET &&
 				!memcmp(&((struct sockaddr_in *)&reply->addr)->sin_addr, "\177", 1))
-			listed++;
-		else if (blcptr->blacklist->lastwarning + 3600 < CURRTIME)
+		{
+			lookup->state = LOOKUP_LISTED;
+			ttl = reply->ttl < dnsbl_cache_ttl ? reply->ttl : dnsbl_cache_ttl;
+		}
+		else if (lookup->blacklist->lastwarning + 3600 < CURRTIME)
 		{
 			slog(LG_DEBUG,
 					"Garbage reply from blacklist %s",
-					blcptr->blacklist->host);
-			blcptr->blacklist->lastwarning = CURRTIME;
+					lookup->blacklist->host);
+			lookup->blacklist->lastwarning = CURRTIME;
 		}
 	}
 
-	/* they have a blacklist entry for this client */
-	if (listed)
-		dnsbl_hit(blcptr->u, blcptr->blacklist);
+	lookup->expires = CURRTIME + ttl;
+
+	/* a hit aborts that client's other queries, but never one on this lookup */
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, lookup->clients.head)
+	{
+		struct BlacklistClient *blcptr = n->data;
+
+		mowgli_node_delete(&blcptr->lookup_node, &lookup->clients);
+		mowgli_node_delete(&blcptr->node, dnsbl_queries(blcptr->u));
 
-	object_unref(blcptr->blacklist);
-	free(blcptr);
+		/* they have a blacklist entry for this client */
+		if (lookup->state == LOOKUP_LISTED)
+			dnsbl_hit(blcptr->u, blcptr->blacklist);
+
+		object_unref(blcptr->blacklist);
+		free(blcptr);
+	}
+
+	if (ttl == 0)
+		dnsbl_lookup_free(lookup);
+	else
+		dnsbl_cache_trim();
 }
 
+/*
+ * Starts a lookup of the user in a DNSBL, or joins one already in flight.
+ * Returns true if a cached answer says that the user is listed.
+ */
 /* XXX: no IPv6 implementation, not to concerned right now though. */
 /* 2015-12-06: at least we shouldn't crash on bad inputs anymore... -bcode */
-static void initiate_blacklist_dnsquery(struct Blacklist *blptr, user_t *u)
+static bool initiate_blacklist_dnsquery(struct Blacklist *blptr, user_t *u)
 {
 	char buf[IRCD_RES_HOSTLEN + 1];
 	int ip[4];
-	mowgli_list_t *l;
+	struct BlacklistLookup *lookup;
+	struct BlacklistClient *blcptr;
+	mowgli_node_t *n;
 
 	if (u->ip == NULL)
-		return;
+		return false;
 
 	/* A sscanf worked fine for chary for many years, it'll be fine here */
 	if (sscanf(u->ip, "%d.%d.%d.%d", &ip[3], &ip[2], &ip[1], &ip[0]) != 4)
-		return;
+		return false;
 
-	struct BlacklistClient *blcptr = smalloc(sizeof(struct BlacklistClient));
+	/* becomes 2.0.0.127.torbl.ahbl.org or whatever */
+	snprintf(buf, sizeof buf, "%d.%d.%d.%d.%s", ip[0], ip[1], ip[2], ip[3], blptr->host);
 
-	blcptr->blacklist = object_ref(blptr);
-	blcptr->u = u;
+	lookup = mowgli_patricia_retrieve(dnsbl_cache, buf);
+	if (lookup != NULL && lookup->state != LOOKUP_PENDING && lookup->expires <= CURRTIME)
+	{
+		dnsbl_lookup_free(lookup);
+		lookup = NULL;
+	}
 
-	blcptr->dns_query.ptr = blcptr;
-	blcptr->dns_query.callback = blacklist_dns_callback;
+	if (lookup == NULL)
+	{
+		dnsbl_cache_misses++;
 
-	/* becomes 2.0.0.127.torbl.ahbl.org or whatever */
-	snprintf(buf, sizeof buf, "%d.%d.%d.%d.%s", ip[0], ip[1], ip[2], ip[3], blptr->host);
+		lookup = sharedheap_alloc(dnsbl_lookup_heap);
+		mowgli_strlcpy(lookup->name, buf, sizeof lookup->name);
+		lookup->blacklist = object_ref(blptr);
+		lookup->state = LOOKUP_PENDING;
+		lookup->dns_query.ptr = lookup;
+		lookup->dns_query.callback = blacklist_dns_callback;
+
+		mowgli_patricia_add(dnsbl_cache, lookup->name, lookup);
+		mowgli_node_add(lookup, &lookup->node, &dnsbl_cache_lru);
+		dnsbl_cache_trim();
+
+		gethost_byname_type(buf, &lookup->dns_query, T_A);
+	}
+	else
+	{
+		mowgli_node_delete(&lookup->node, &dnsbl_cache_lru);
+		mowgli_node_add(lookup, &lookup->node, &dnsbl_cache_lru);
+
+		if (lookup->state != LOOKUP_PENDING)
+		{
+			dnsbl_cache_hits++;
+			return lookup->state == LOOKUP_LISTED;
+		}
+
+		/* already waiting for it, e.g. DNSBLSCAN during the first lookup */
+		MOWGLI_ITER_FOREACH(n, dnsbl_queries(u)->head)
+		{
+			blcptr = n->data;
 
-	gethost_byname_type(buf, &blcptr->dns_query, T_A);
+			if (blcptr->lookup == lookup)
+				return false;
+		}
+
+		dnsbl_cache_coalesced++;
+	}
+
+	blcptr = smalloc(sizeof(struct BlacklistClient));
+	blcptr->blacklist = object_ref(blptr);
+	blcptr->u = u;
+	blcptr->lookup = lookup;
 
-	l = dnsbl_queries(u);
-	mowgli_node_add(blcptr, &blcptr->node, l);
+	mowgli_node_add(blcptr, &blcptr->lookup_node, &lookup->clients);
+	mowgli_node_add(blcptr, &blcptr->node, dnsbl_queries(u));
+
+	return false;
 }
 
 /* public interfaces */
@@ -422,7 +584,11 @@ static void lookup_blacklists(user_t *u)
 		if (u == NULL)
 			return;
 
-		initiate_blacklist_dnsquery(blptr, u);
+		if (initiate_blacklist_dnsquery(blptr, u))
+		{
+			dnsbl_hit(u, blptr);
+			return;
+		}
 	}
 }
 
@@ -546,8 +712,10 @@ static void abort_blacklist_queries(user_t *u)
 	{
 		struct BlacklistClient *blcptr = n->data;
 
-		delete_resolver_queries(&blcptr->dns_query);
+		/* the query itself carries on, to answer whoever asks next */
+		mowgli_node_delete(&blcptr->lookup_node, &blcptr->lookup->clients);
 		mowgli_node_delete(n, l);
+		object_unref(blcptr->blacklist);
 		free(blcptr);
 	}
 }
@@ -569,6 +737,8 @@ static void osinfo_hook(sourceinfo_t *si)
 
 		command_success_nodata(si, _("Blacklist(s): %s"), blptr->host);
 	}
+	command_success_nodata(si, _("DNSBL cache: %zu answers, %u hits, %u misses, %u joined in-flight lookups"),
+			MOWGLI_LIST_LENGTH(&dnsbl_cache_lru), dnsbl_cache_hits, dnsbl_cache_misses, dnsbl_cache_coalesced);
 	command_success_nodata(si, _("===================================="));
 }
 
@@ -633,7 +803,7 @@ _modinit(module_t *m)
 	hook_add_config_purge(dnsbl_config_purge);
 
 	hook_add_event("user_add");
-	hook_add_user_add(check_dnsbls);
+	hook_add_deferrable_user_add(check_dnsbls);
 
 	hook_add_event("user_delete");
 	hook_add_user_delete(abort_blacklist_queries);
@@ -643,6 +813,13 @@ _modinit(module_t *m)
 
 	add_conf_item("DNSBL_ACTION", &proxyscan->conf_table, dnsbl_action_config_handler);
 	add_conf_item("BLACKLISTS", &proxyscan->conf_table, dnsbl_config_handler);
+	add_uint_conf_item("DNSBL_CACHE_SIZE", &proxyscan->conf_table, 0, &dnsbl_cache_size, 0, INT_MAX, 65536);
+	add_duration_conf_item("DNSBL_CACHE_TTL", &proxyscan->conf_table, 0, &dnsbl_cache_ttl, "s", 3600);
+	add_duration_conf_item("DNSBL_NEGATIVE_TTL", &proxyscan->conf_table, 0, &dnsbl_negative_ttl, "s", 300);
+
+	dnsbl_cache = mowgli_patricia_create(strcasecanon);
+	dnsbl_lookup_heap = sharedheap_get_named(sizeof(struct BlacklistLookup), "BlacklistLookup");
+	dnsbl_cache_timer = mowgli_timer_add(base_eventloop, "dnsbl_cache_expire", dnsbl_cache_expire, NULL, 300);
 
 	command_add(&os_set_dnsblaction, *os_set_cmdtree);
 }
@@ -664,6 +841,13 @@ _moddeinit(module_unload_intent_t intent)
 
 	del_conf_item("DNSBL_ACTION", &proxyscan->conf_table);
 	del_conf_item("BLACKLISTS", &proxyscan->conf_table);
+	del_conf_item("DNSBL_CACHE_SIZE", &proxyscan->conf_table);
+	del_conf_item("DNSBL_CACHE_TTL", &proxyscan->conf_table);
+	del_conf_item("DNSBL_NEGATIVE_TTL", &proxyscan->conf_table);
+
+	mowgli_timer_destroy(base_eventloop, dnsbl_cache_timer);
+	dnsbl_cache_destroy();
+	mowgli_patricia_destroy(dnsbl_cache, NULL, NULL);
 
 	command_delete(&os_set_dnsblaction, *os_set_cmdtree);
 
@@ -31,6 +31,8 @@ void destroy_session(sasl_session_t *p);
 static sourceinfo_t *sasl_sourceinfo_create(sasl_session_t *p);
 static void sasl_input(sasl_message_t *smsg);
 static void sasl_packet(sasl_session_t *p, char *buf, int len);
+static void sasl_packet_result(sasl_session_t *p, int rc, char *out, size_t out_len);
+static void sasl_mech_complete(sasl_session_t *p, int rc);
 static void sasl_write(char *target, char *data, int length);
 static bool may_impersonate(myuser_t *source_mu, myuser_t *target_mu);
 static myuser_t *login_user(sasl_session_t *p);
@@ -45,7 +47,7 @@ static const char *sasl_format_sourceinfo(sourceinfo_t *si, bool full);
 static const char *sasl_get_source_name(sourceinfo_t *si);
 static void on_shutdown(void *unused);
 
-sasl_mech_register_func_t sasl_mech_register_funcs = { &sasl_mech_register, &sasl_mech_unregister };
+sasl_mech_register_func_t sasl_mech_register_funcs = { &sasl_mech_register, &sasl_mech_unregister, &sasl_mech_complete };
 
 typedef struct {
 	sourceinfo_t parent;
@@ -431,12 +433,18 @@ static void sasl_packet(sasl_session_t *p, char *buf, int len)
 {
 	int rc;
 	size_t tlen = 0;
-	char *cloak, *out = NULL;
+	char *out = NULL;
 	char temp[BUFSIZE];
 	char mech[61];
-	char description[300];
 	size_t out_len = 0;
-	metadata_t *md;
+
+	/* nothing more may be sent while the mechanism is busy */
+	if (p->flags & ASASL_WAITING)
+	{
+		sasl_sts(p->uid, 'D', "F");
+		destroy_session(p);
+		return;
+	}
 
 	/* First piece of data in a session is the name of
 	 * the SASL mechanism that will be used.
@@ -476,6 +484,32 @@ static void sasl_packet(sasl_session_t *p, char *buf, int len)
 			rc = ASASL_FAIL;
 	}
 
+	if (rc == ASASL_WAIT)
+	{
+		p->flags |= ASASL_WAITING;
+		return;
+	}
+
+	sasl_packet_result(p, rc, out, out_len);
+}
+
+/* called by a mechanism which returned ASASL_WAIT, once it has an answer */
+static void sasl_mech_complete(sasl_session_t *p, int rc)
+{
+	return_if_fail(p->flags & ASASL_WAITING);
+
+	p->flags &= ~ASASL_WAITING;
+	sasl_packet_result(p, rc, NULL, 0);
+}
+
+/* act on what the mechanism made of the last packet */
+static void sasl_packet_result(sasl_session_t *p, int rc, char *out, size_t out_len)
+{
+	char *cloak;
+	char temp[BUFSIZE];
+	char description[300];
+	metadata_t *md;
+
 	/* Some progress has been made, reset timeout. */
 	p->flags &= ~ASASL_MARKED_FOR_DELETION;
 
@@ -21,8 +21,17 @@ sasl_mech_register_func_t *regfuncs;
 static int mech_start(sasl_session_t *p, char **out, size_t *out_len);
 static int mech_step(sasl_session_t *p, char *message, size_t len, char **out, size_t *out_len);
 static void mech_finish(sasl_session_t *p);
+static void plain_verified(myuser_t *mu, bool verified, void *privdata);
 sasl_mechanism_t mech = {"PLAIN", &mech_start, &mech_step, &mech_finish};
 
+/* a password check in progress, kept in the session's mechdata */
+typedef struct {
+	sasl_session_t *p;	/* NULL once the session is gone */
+	bool waiting;		/* mech_step() has returned ASASL_WAIT */
+	bool done;
+	int result;
+} plain_request_t;
+
 void _modinit(module_t *m)
 {
 	MODULE_TRY_REQUEST_SYMBOL(m, regfuncs, "saslserv/main", "sasl_mech_register_funcs");
@@ -46,6 +55,7 @@ static int mech_step(sasl_session_t *p, char *message, size_t len, char **out, s
 	char pass[256];
 	myuser_t *mu;
 	char *end;
+	plain_request_t *req;
 
 	/* Copy the authzid */
 	end = memchr(message, '\0', len);
@@ -92,24 +102,64 @@ static int mech_step(sasl_session_t *p, char *message, size_t len, char **out, s
 	p->username = sstrdup(authc);
 	p->authzid = sstrdup(authz);
 
-	if (verify_password(mu, pass))
-		return ASASL_DONE;
-	else
+	req = scalloc(1, sizeof(plain_request_t));
+	req->p = p;
+	p->mechdata = req;
+
+	verify_password_async(mu, pass, plain_verified, req);
+
+	/* answered straight away */
+	if (req->done)
 	{
-		char description[300];
+		int rc = req->result;
 
-		if ((add_login_history_entry = module_locate_symbol("nickserv/loginhistory", "add_login_history_entry")) != NULL)
-		{
-			snprintf(description, sizeof description, "Failed login: SASL (Plain)");
-			add_login_history_entry(mu, mu, description);
-		}
+		p->mechdata = NULL;
+		free(req);
+		return rc;
+	}
 
-		return ASASL_FAIL;
+	req->waiting = true;
+	return ASASL_WAIT;
+}
+
+static void plain_verified(myuser_t *mu, bool verified, void *privdata)
+{
+	plain_request_t *req = privdata;
+	sasl_session_t *p = req->p;
+	char description[300];
+
+	req->done = true;
+	req->result = verified ? ASASL_DONE : ASASL_FAIL;
+
+	if (!verified && (add_login_history_entry = module_locate_symbol("nickserv/loginhistory", "add_login_history_entry")) != NULL)
+	{
+		snprintf(description, sizeof description, "Failed login: SASL (Plain)");
+		add_login_history_entry(mu, mu, description);
 	}
+
+	/* otherwise mech_step() picks the result up */
+	if (!req->waiting)
+		return;
+
+	free(req);
+
+	if (p == NULL)
+		return;
+
+	p->mechdata = NULL;
+	regfuncs->mech_complete(p, verified ? ASASL_DONE : ASASL_FAIL);
 }
 
 static void mech_finish(sasl_session_t *p)
 {
+	plain_request_t *req = p->mechdata;
+
+	/* the password check carries on, but nobody is waiting for it */
+	if (req != NULL)
+	{
+		req->p = NULL;
+		p->mechdata = NULL;
+	}
 }
 
 /* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs
@@ -11,35 +11,26 @@
 #include "atheme.h"
 #include "jsonrpclib.h"
 
-void jsonrpc_process(char *buffer, void *userdata)
-{
-	if (!buffer)
-	{
-		return;
-	}
-
-	mowgli_json_t *parsed = mowgli_json_parse_string(buffer);
+/* most requests accepted in a single batch */
+#define JSONRPC_BATCH_MAX	1000
 
-	if (parsed == NULL) {
-		return;
-	}
+static void jsonrpc_batch_begin(void *conn);
+static void jsonrpc_batch_end(void *conn);
 
+static void jsonrpc_process_request(mowgli_json_t *parsed, void *userdata)
+{
 	mowgli_json_tag_t tag = MOWGLI_JSON_TAG(parsed);
 
 	//JSON RPC works with JSON objects only, anything else can't be correct.
 
 	if (tag != MOWGLI_JSON_TAG_OBJECT)
 	{
+		jsonrpc_failure_string(userdata, fault_badparams, "Invalid request.", NULL);
 		return;
 	}
 
 	mowgli_patricia_t *obj = MOWGLI_JSON_OBJECT(parsed);
 
-	if (parsed == NULL)
-	{
-		return;
-	}
-
 	mowgli_json_t *method = mowgli_patricia_retrieve(obj, "method");
 	mowgli_json_t *params = mowgli_patricia_retrieve(obj, "params");
 	mowgli_json_t *id = mowgli_patricia_retrieve(obj, "id");
@@ -49,6 +40,7 @@ void jsonrpc_process(char *buffer, void *userdata)
 
 	if (id == NULL || params == NULL || method == NULL)
 	{
+		jsonrpc_failure_string(userdata, fault_badparams, "Invalid request.", NULL);
 		return;
 	}
 
@@ -56,6 +48,7 @@ void jsonrpc_process(char *buffer, void *userdata)
 			MOWGLI_JSON_TAG(id) != MOWGLI_JSON_TAG_STRING ||
 			MOWGLI_JSON_TAG(params) != MOWGLI_JSON_TAG_ARRAY)
 	{
+		jsonrpc_failure_string(userdata, fault_badparams, "Invalid request.", NULL);
 		return;
 	}
 
@@ -73,7 +66,8 @@ void jsonrpc_process(char *buffer, void *userdata)
 		param = n->data;
 
 		if (MOWGLI_JSON_TAG(param) != MOWGLI_JSON_TAG_STRING) {
-			continue;
+			jsonrpc_failure_string(userdata, fault_badparams, "Parameters must be strings.", id_str);
+			return;
 		}
 
 	}
@@ -92,54 +86,318 @@ void jsonrpc_process(char *buffer, void *userdata)
 		call_method(userdata, params_str, id_str);
 	} else {
 		jsonrpc_failure_string(userdata, fault_badparams, "Invalid command", id_str);
+	}
+
+	mowgli_node_t *tn;
+
+	MOWGLI_LIST_FOREACH_SAFE(n, tn, params_str->head)
+	{
+		mowgli_node_delete(n, params_str);
+		mowgli_node_free(n);
+	}
+
+	mowgli_list_free(params_str);
+}
+
+void jsonrpc_process(char *buffer, void *userdata)
+{
+	if (!buffer)
+	{
+		return;
+	}
+
+	mowgli_json_t *parsed = mowgli_json_parse_string(buffer);
+
+	if (parsed == NULL) {
 		return;
 	}
 
+	/* a batch: run every request and answer with one array */
+	if (MOWGLI_JSON_TAG(parsed) == MOWGLI_JSON_TAG_ARRAY)
+	{
+		mowgli_list_t *requests = MOWGLI_JSON_ARRAY(parsed);
+		mowgli_node_t *n;
+
+		if (MOWGLI_LIST_LENGTH(requests) == 0)
+		{
+			jsonrpc_failure_string(userdata, fault_badparams, "Empty batch.", NULL);
+			return;
+		}
+
+		if (MOWGLI_LIST_LENGTH(requests) > JSONRPC_BATCH_MAX)
+		{
+			jsonrpc_failure_string(userdata, fault_toomany, "Too many requests in batch.", NULL);
+			return;
+		}
+
+		jsonrpc_batch_begin(userdata);
+
+		MOWGLI_LIST_FOREACH(n, requests->head)
+			jsonrpc_process_request(n->data, userdata);
+
+		jsonrpc_batch_end(userdata);
+		return;
+	}
+
+	jsonrpc_process_request(parsed, userdata);
 }
 
-void jsonrpc_success_string(void *conn, const char *result, const char *id)
+/*
+ * Responses are written straight into the connection's sendq through a
+ * fixed-size buffer instead of being built up as a mowgli_json_t tree and
+ * serialized.  A response which fits in the buffer is sent with a
+ * Content-Length; a longer one is sent in chunks as it is written.
+ */
+
+/* the batch being answered, if any; its responses share one stream */
+static jsonrpc_stream_t *batch_stream;
+
+static void jsonrpc_stream_flush(jsonrpc_stream_t *js, bool last)
 {
-	mowgli_json_t *obj = mowgli_json_create_object();
+	unsigned int flags = 0;
 
-	mowgli_patricia_t *patricia = MOWGLI_JSON_OBJECT(obj);
+	if (!js->started)
+		flags |= JSONRPC_SEND_FIRST;
+	if (last)
+		flags |= JSONRPC_SEND_LAST;
 
-	mowgli_json_t *resultobj = mowgli_json_create_string(result);
-	mowgli_json_t *idobj = mowgli_json_create_string(id);
+	jsonrpc_send_stream(js->conn, js->buf, js->len, flags);
 
-	mowgli_patricia_add(patricia, "result", resultobj);
-	mowgli_patricia_add(patricia, "id", idobj);
-	mowgli_patricia_add(patricia, "error", mowgli_json_null);
+	js->started = true;
+	js->len = 0;
+}
 
-	mowgli_string_t *str = mowgli_string_create();
+static void jsonrpc_stream_write(jsonrpc_stream_t *js, const char *data, size_t len)
+{
+	size_t n;
+
+	while (len > 0)
+	{
+		if (js->len == sizeof js->buf)
+			jsonrpc_stream_flush(js, false);
 
-	mowgli_json_serialize_to_string(obj, str, 0);
+		n = sizeof js->buf - js->len;
+		if (n > len)
+			n = len;
 
-	jsonrpc_send_data(conn, str->str);
+		memcpy(js->buf + js->len, data, n);
+		js->len += n;
+		data += n;
+		len -= n;
+	}
 }
 
-void jsonrpc_failure_string(void *conn, int code, const char *error, const char *id)
+/* separate a value from the one before it at the same level */
+static void jsonrpc_stream_value(jsonrpc_stream_t *js)
 {
-	mowgli_json_t *obj = mowgli_json_create_object();
-	mowgli_json_t *errorobj = mowgli_json_create_object();
+	if (js->comma)
+		jsonrpc_stream_write(js, ",", 1);
 
-	mowgli_patricia_t *patricia = MOWGLI_JSON_OBJECT(errorobj);
+	js->comma = true;
+}
 
-	mowgli_patricia_add(patricia, "code", mowgli_json_create_integer(code));
-	mowgli_patricia_add(patricia, "message", mowgli_json_create_string(error));
+static void jsonrpc_stream_escape(jsonrpc_stream_t *js, const char *str)
+{
+	const char *p;
+	char esc[8];
 
-	patricia = MOWGLI_JSON_OBJECT(obj);
+	for (p = str; *p != '\0'; p++)
+	{
+		unsigned char c = *p;
 
-	mowgli_json_t *idobj = mowgli_json_create_string(id);
+		if (c >= 0x20 && c != '"' && c != '\\')
+			continue;
 
-	mowgli_patricia_add(patricia, "result", mowgli_json_null);
-	mowgli_patricia_add(patricia, "id", idobj);
-	mowgli_patricia_add(patricia, "error", errorobj);
+		jsonrpc_stream_write(js, str, p - str);
+		str = p + 1;
 
-	mowgli_string_t *str = mowgli_string_create();
+		switch (c)
+		{
+			case '"':
+				jsonrpc_stream_write(js, "\\\"", 2);
+				break;
+			case '\\':
+				jsonrpc_stream_write(js, "\\\\", 2);
+				break;
+			case '\n':
+				jsonrpc_stream_write(js, "\\n", 2);
+				break;
+			default:
+				snprintf(esc, sizeof esc, "\\u%04x", c);
+				jsonrpc_stream_write(js, esc, 6);
+				break;
+		}
+	}
 
-	mowgli_json_serialize_to_string(obj, str, 0);
+	jsonrpc_stream_write(js, str, p - str);
+}
+
+void jsonrpc_stream_object_begin(jsonrpc_stream_t *js)
+{
+	jsonrpc_stream_value(js);
+	jsonrpc_stream_write(js, "{", 1);
+	js->comma = false;
+}
+
+void jsonrpc_stream_object_end(jsonrpc_stream_t *js)
+{
+	jsonrpc_stream_write(js, "}", 1);
+	js->comma = true;
+}
+
+void jsonrpc_stream_array_begin(jsonrpc_stream_t *js)
+{
+	jsonrpc_stream_value(js);
+	jsonrpc_stream_write(js, "[", 1);
+	js->comma = false;
+}
+
+void jsonrpc_stream_array_end(jsonrpc_stream_t *js)
+{
+	jsonrpc_stream_write(js, "]", 1);
+	js->comma = true;
+}
+
+void jsonrpc_stream_key(jsonrpc_stream_t *js, const char *key)
+{
+	jsonrpc_stream_value(js);
+	jsonrpc_stream_write(js, "\"", 1);
+	jsonrpc_stream_escape(js, key);
+	jsonrpc_stream_write(js, "\":", 2);
+	js->comma = false;
+}
+
+void jsonrpc_stream_string(jsonrpc_stream_t *js, const char *str)
+{
+	jsonrpc_stream_string_begin(js);
+	jsonrpc_stream_escape(js, str);
+	jsonrpc_stream_string_end(js);
+}
+
+/* true, false, null or a number */
+void jsonrpc_stream_literal(jsonrpc_stream_t *js, const char *lit)
+{
+	jsonrpc_stream_value(js);
+	jsonrpc_stream_write(js, lit, strlen(lit));
+}
+
+/* a string value written a piece at a time */
+void jsonrpc_stream_string_begin(jsonrpc_stream_t *js)
+{
+	jsonrpc_stream_value(js);
+	jsonrpc_stream_write(js, "\"", 1);
+}
+
+void jsonrpc_stream_string_append(jsonrpc_stream_t *js, const char *str)
+{
+	jsonrpc_stream_escape(js, str);
+}
+
+void jsonrpc_stream_string_end(jsonrpc_stream_t *js)
+{
+	jsonrpc_stream_write(js, "\"", 1);
+}
+
+static jsonrpc_stream_t *jsonrpc_stream_open(void *conn)
+{
+	jsonrpc_stream_t *js;
+
+	if (batch_stream != NULL)
+		return batch_stream;
+
+	js = smalloc(sizeof *js);
+	js->conn = conn;
 
-	jsonrpc_send_data(conn, str->str);
+	return js;
+}
+
+static void jsonrpc_stream_close(jsonrpc_stream_t *js)
+{
+	if (js == batch_stream)
+		return;
+
+	jsonrpc_stream_flush(js, true);
+	free(js);
+}
+
+/* requests which could not be parsed far enough to find their id get a null one */
+static void jsonrpc_stream_id(jsonrpc_stream_t *js, const char *id)
+{
+	jsonrpc_stream_key(js, "id");
+	if (id != NULL)
+		jsonrpc_stream_string(js, id);
+	else
+		jsonrpc_stream_literal(js, "null");
+}
+
+static void jsonrpc_batch_begin(void *conn)
+{
+	batch_stream = jsonrpc_stream_open(conn);
+	jsonrpc_stream_array_begin(batch_stream);
+}
+
+static void jsonrpc_batch_end(void *conn)
+{
+	jsonrpc_stream_t *js = batch_stream;
+
+	batch_stream = NULL;
+
+	jsonrpc_stream_array_end(js);
+	jsonrpc_stream_close(js);
+}
+
+/*
+ * Starts a successful response; the caller writes the result value to
+ * the returned stream and finishes with jsonrpc_response_end().
+ */
+jsonrpc_stream_t *jsonrpc_response_begin(void *conn, const char *id)
+{
+	jsonrpc_stream_t *js = jsonrpc_stream_open(conn);
+
+	jsonrpc_stream_object_begin(js);
+	jsonrpc_stream_id(js, id);
+	jsonrpc_stream_key(js, "error");
+	jsonrpc_stream_literal(js, "null");
+	jsonrpc_stream_key(js, "result");
+
+	return js;
+}
+
+void jsonrpc_response_end(jsonrpc_stream_t *js)
+{
+	jsonrpc_stream_object_end(js);
+	jsonrpc_stream_close(js);
+}
+
+void jsonrpc_success_string(void *conn, const char *result, const char *id)
+{
+	jsonrpc_stream_t *js = jsonrpc_response_begin(conn, id);
+
+	jsonrpc_stream_string(js, result);
+	jsonrpc_response_end(js);
+}
+
+void jsonrpc_failure_string(void *conn, int code, const char *error, const char *id)
+{
+	jsonrpc_stream_t *js = jsonrpc_stream_open(conn);
+	char codebuf[16];
+
+	snprintf(codebuf, sizeof codebuf, "%d", code);
+
+	jsonrpc_stream_object_begin(js);
+	jsonrpc_stream_id(js, id);
+	jsonrpc_stream_key(js, "result");
+	jsonrpc_stream_literal(js, "null");
+	jsonrpc_stream_key(js, "error");
+	jsonrpc_stream_object_begin(js);
+	jsonrpc_stream_key(js, "code");
+	jsonrpc_stream_literal(js, codebuf);
+	jsonrpc_stream_key(js, "message");
+	jsonrpc_stream_string(js, error);
+	jsonrpc_stream_object_end(js);
+	jsonrpc_stream_object_end(js);
+
+	jsonrpc_stream_close(js);
 }
 
 char *jsonrpc_normalizeBuffer(const char *buf)
@@ -17,6 +17,21 @@ typedef struct {
     char *id;
 } jsonrpc_sourceinfo_t;
 
+/* how much of a response is buffered before it is sent */
+#define JSONRPC_STREAM_BUFSIZE	4096
+
+typedef struct {
+	void *conn;
+	bool started;		/* part of the response has been sent */
+	bool comma;		/* a value precedes the next one at this level */
+	size_t len;
+	char buf[JSONRPC_STREAM_BUFSIZE];
+} jsonrpc_stream_t;
+
+/* flags for jsonrpc_send_stream() */
+#define JSONRPC_SEND_FIRST	0x1	/* first part of a response */
+#define JSONRPC_SEND_LAST	0x2	/* last part of a response */
+
 E char *jsonrpc_normalizeBuffer(const char *buf);
 
 E jsonrpc_method_t get_json_method(const char *method_name);
@@ -24,8 +39,21 @@ E jsonrpc_method_t get_json_method(const char *method_name);
 E void jsonrpc_process(char *buffer, void *userdata);
 E void jsonrpc_register_method(const char *method_name, bool (*method)(void *conn, mowgli_list_t *params, char *id));
 E void jsonrpc_unregister_method(const char *method_name);
-E void jsonrpc_send_data(void *conn, char *str);
+E void jsonrpc_send_stream(void *conn, const char *buf, size_t len, unsigned int flags);
 E void jsonrpc_success_string(void *conn, const char *str, const char *id);
 E void jsonrpc_failure_string(void *conn, int code, const char *str, const char *id);
 
+E jsonrpc_stream_t *jsonrpc_response_begin(void *conn, const char *id);
+E void jsonrpc_response_end(jsonrpc_stream_t *js);
+E void jsonrpc_stream_object_begin(jsonrpc_stream_t *js);
+E void jsonrpc_stream_object_end(jsonrpc_stream_t *js);
+E void jsonrpc_stream_array_begin(jsonrpc_stream_t *js);
+E void jsonrpc_stream_array_end(jsonrpc_stream_t *js);
+E void jsonrpc_stream_key(jsonrpc_stream_t *js, const char *key);
+E void jsonrpc_stream_string(jsonrpc_stream_t *js, const char *str);
+E void jsonrpc_stream_literal(jsonrpc_stream_t *js, const char *lit);
+E void jsonrpc_stream_string_begin(jsonrpc_stream_t *js);
+E void jsonrpc_stream_string_append(jsonrpc_stream_t *js, const char *str);
+E void jsonrpc_stream_string_end(jsonrpc_stream_t *js);
+
 #endif
@@ -21,7 +21,7 @@ DECLARE_MODULE_V1
 
 static void handle_request(connection_t *cptr, void *requestbuf);
 
-mowgli_list_t *httpd_path_handlers;
+httpd_path_func_t *httpd_path_funcs;
 static mowgli_patricia_t *json_methods;
 
 static bool jsonrpcmethod_login(void *conn, mowgli_list_t *params, char *id);
@@ -30,7 +30,10 @@ static bool jsonrpcmethod_command(void *conn, mowgli_list_t *params, char *id);
 static bool jsonrpcmethod_privset(void *conn, mowgli_list_t *params, char *id);
 static bool jsonrpcmethod_ison(void *conn, mowgli_list_t *params, char *id);
 static bool jsonrpcmethod_metadata(void *conn, mowgli_list_t *params, char *id);
-
+static bool jsonrpcmethod_ison_bulk(void *conn, mowgli_list_t *params, char *id);
+static bool jsonrpcmethod_metadata_bulk(void *conn, mowgli_list_t *params, char *id);
+static bool jsonrpcmethod_latency(void *conn, mowgli_list_t *params, char *id);
+static bool jsonrpcmethod_memory(void *conn, mowgli_list_t *params, char *id);
 
 static void jsonrpc_command_fail(sourceinfo_t *si, cmd_faultcode_t code, const char *message);
 static void jsonrpc_command_success_string(sourceinfo_t *si, const char *result, const char *message);
@@ -55,10 +58,10 @@ static void handle_request(connection_t *cptr, void *requestbuf)
 
 void _modinit(module_t *m)
 {
-	MODULE_TRY_REQUEST_SYMBOL(m, httpd_path_handlers, "misc/httpd", "httpd_path_handlers");
+	MODULE_TRY_REQUEST_SYMBOL(m, httpd_path_funcs, "misc/httpd", "httpd_path_funcs");
 
 	handle_jsonrpc.path = "/jsonrpc";
-	mowgli_node_add(&handle_jsonrpc, mowgli_node_create(), httpd_path_handlers);
+	httpd_path_funcs->path_add(&handle_jsonrpc);
 
 	json_methods = mowgli_patricia_create(strcasecanon);
 
@@ -69,13 +72,15 @@ void _modinit(module_t *m)
 	jsonrpc_register_method("atheme.privset", jsonrpcmethod_privset);
 	jsonrpc_register_method("atheme.ison", jsonrpcmethod_ison);
 	jsonrpc_register_method("atheme.metadata", jsonrpcmethod_metadata);
+	jsonrpc_register_method("atheme.ison.bulk", jsonrpcmethod_ison_bulk);
+	jsonrpc_register_method("atheme.metadata.bulk", jsonrpcmethod_metadata_bulk);
+	jsonrpc_register_method("atheme.latency", jsonrpcmethod_latency);
+	jsonrpc_register_method("atheme.memory", jsonrpcmethod_memory);
 
 }
 
 void _moddeinit(module_unload_intent_t intent)
 {
-	mowgli_node_t *n;
-
 	jsonrpc_unregister_method("atheme.login");
 	jsonrpc_unregister_method("atheme.logout");
 	jsonrpc_unregister_method("atheme.command");
@@ -83,12 +88,12 @@ void _moddeinit(module_unload_intent_t intent)
 	jsonrpc_unregister_method("atheme.privset");
 	jsonrpc_unregister_method("atheme.ison");
 	jsonrpc_unregister_method("atheme.metadata");
+	jsonrpc_unregister_method("atheme.ison.bulk");
+	jsonrpc_unregister_method("atheme.metadata.bulk");
+	jsonrpc_unregister_method("atheme.latency");
+	jsonrpc_unregister_method("atheme.memory");
 
-	if ((n = mowgli_node_find(&handle_jsonrpc, httpd_path_handlers)) != NULL)
-	{
-		mowgli_node_delete(n, httpd_path_handlers);
-		mowgli_node_free(n);
-	}
+	httpd_path_funcs->path_delete(&handle_jsonrpc);
 }
 
 void jsonrpc_register_method(const char *method_name, jsonrpc_method_t method) {
@@ -246,6 +251,25 @@ static bool jsonrpcmethod_logout(void *conn, mowgli_list_t *params, char *id)
 	return 0;
 }
 
+/*
+ * Output of atheme.command is collected in hd->replybuf, but once it grows
+ * past a stream buffer's worth the response is started and the rest of
+ * the output is streamed into it.
+ */
+static connection_t *command_conn;
+static jsonrpc_stream_t *command_stream;
+
+/* the response has already been started; all we can do is add to it */
+static bool jsonrpc_command_append(connection_t *cptr, const char *message)
+{
+	if (command_stream == NULL || cptr != command_conn)
+		return false;
+
+	jsonrpc_stream_string_append(command_stream, "\n");
+	jsonrpc_stream_string_append(command_stream, message);
+	return true;
+}
+
 static void jsonrpc_command_fail(sourceinfo_t *si, cmd_faultcode_t code, const char *message)
 {
 	connection_t *cptr;
@@ -258,6 +282,12 @@ static void jsonrpc_command_fail(sourceinfo_t *si, cmd_faultcode_t code, const c
 		return;
 	newmessage = jsonrpc_normalizeBuffer(message);
 
+	if (jsonrpc_command_append(cptr, newmessage))
+	{
+		free(newmessage);
+		return;
+	}
+
 	jsonrpc_sourceinfo_t *jsi = (jsonrpc_sourceinfo_t *)si;
 
 	jsonrpc_failure_string(cptr, code, newmessage, jsi->id);
@@ -277,6 +307,9 @@ static void jsonrpc_command_success_string(sourceinfo_t *si, const char *result,
 	if (hd->sent_reply)
 		return;
 
+	if (jsonrpc_command_append(cptr, result))
+		return;
+
 	jsonrpc_sourceinfo_t *jsi = (jsonrpc_sourceinfo_t *)si;
 
 	jsonrpc_success_string(cptr, result, jsi->id);
@@ -293,7 +326,7 @@ static void jsonrpc_command_success_nodata(sourceinfo_t *si, const char *message
 
 	cptr = si->connection;
 	hd = cptr->userdata;
-	if (hd->sent_reply)
+	if (hd->sent_reply || jsonrpc_command_append(cptr, newmessage))
 	{
 		free(newmessage);
 		return;
@@ -312,6 +345,18 @@ static void jsonrpc_command_success_nodata(sourceinfo_t *si, const char *message
 
 	strcpy(p, newmessage);
 	free(newmessage);
+
+	if (cptr == command_conn && strlen(hd->replybuf) >= JSONRPC_STREAM_BUFSIZE)
+	{
+		jsonrpc_sourceinfo_t *jsi = (jsonrpc_sourceinfo_t *)si;
+
+		command_stream = jsonrpc_response_begin(cptr, jsi->id);
+		jsonrpc_stream_string_begin(command_stream);
+		jsonrpc_stream_string_append(command_stream, hd->replybuf);
+
+		free(hd->replybuf);
+		hd->replybuf = NULL;
+	}
 }
 
 /*
@@ -351,6 +396,11 @@ static bool jsonrpcmethod_command(void *conn, mowgli_list_t *params, char *id)
 	mowgli_node_t *n;
 	char *param;
 
+	/* a batch may run several commands over the same connection */
+	hd->sent_reply = false;
+	free(hd->replybuf);
+	hd->replybuf = NULL;
+
 	MOWGLI_LIST_FOREACH(n, params->head)
 	{
 		param = n->data;
@@ -425,7 +475,17 @@ static bool jsonrpcmethod_command(void *conn, mowgli_list_t *params, char *id)
 	jsi->base = si;
 	jsi->id = id;
 
+	command_conn = conn;
 	command_exec(svs, si, cmd, newparc-5, newparv);
+	command_conn = NULL;
+
+	if (command_stream != NULL)
+	{
+		jsonrpc_stream_string_end(command_stream);
+		jsonrpc_response_end(command_stream);
+		command_stream = NULL;
+		hd->sent_reply = true;
+	}
 
 	/* XXX: needs to be fixed up for restartable commands... */
 	if (!hd->sent_reply)
@@ -508,6 +568,16 @@ static bool jsonrpcmethod_privset(void *conn, mowgli_list_t *params, char *id)
 	return 0;
 }
 
+static void jsonrpc_ison_result(jsonrpc_stream_t *js, user_t *u)
+{
+	jsonrpc_stream_object_begin(js);
+	jsonrpc_stream_key(js, "online");
+	jsonrpc_stream_literal(js, u != NULL ? "true" : "false");
+	jsonrpc_stream_key(js, "accountname");
+	jsonrpc_stream_string(js, u != NULL && u->myuser != NULL ? entity(u->myuser)->name : "*");
+	jsonrpc_stream_object_end(js);
+}
+
 /*
  * atheme.ison
  *
@@ -523,8 +593,6 @@ static bool jsonrpcmethod_privset(void *conn, mowgli_list_t *params, char *id)
 
 static bool jsonrpcmethod_ison(void *conn, mowgli_list_t *params, char *id)
 {
-	user_t *u;
-
 	char *param, *user;
 	user = mowgli_node_nth_data(params, 0);
 
@@ -549,55 +617,34 @@ static bool jsonrpcmethod_ison(void *conn, mowgli_list_t *params, char *id)
 		return 0;
 	}
 
-	u = user_find(user);
-	if (u == NULL)
-	{
-		mowgli_json_t *resultobj = mowgli_json_create_object();
-		mowgli_patricia_t *patricia = MOWGLI_JSON_OBJECT(resultobj);
-
-		mowgli_patricia_add(patricia, "online", mowgli_json_false);
-		mowgli_patricia_add(patricia, "accountname", mowgli_json_create_string("*"));
-
-		mowgli_json_t *obj = mowgli_json_create_object();
-		patricia = MOWGLI_JSON_OBJECT(obj);
-
-		mowgli_json_t *idobj = mowgli_json_create_string(id);
-
-		mowgli_patricia_add(patricia, "result", resultobj);
-		mowgli_patricia_add(patricia, "id", idobj);
-		mowgli_patricia_add(patricia, "error", mowgli_json_null);
-
-		mowgli_string_t *str = mowgli_string_create();
-
-		mowgli_json_serialize_to_string(obj, str, 0);
+	jsonrpc_stream_t *js = jsonrpc_response_begin(conn, id);
 
-		jsonrpc_send_data(conn, str->str);
+	jsonrpc_ison_result(js, user_find(user));
+	jsonrpc_response_end(js);
 
-		return 0;
-	}
-
-	mowgli_json_t *resultobj = mowgli_json_create_object();
-	mowgli_patricia_t *patricia = MOWGLI_JSON_OBJECT(resultobj);
-
-	mowgli_patricia_add(patricia, "online", mowgli_json_true);
-	mowgli_patricia_add(patricia, "accountname",  mowgli_json_create_string(u->myuser != NULL ? entity(u->myuser)->name : "*"));
-
-	mowgli_json_t *obj = mowgli_json_create_object();
-	patricia = MOWGLI_JSON_OBJECT(obj);
-
-	mowgli_json_t *idobj = mowgli_json_create_string(id);
+	return 0;
+}
 
-	mowgli_patricia_add(patricia, "result", resultobj);
-	mowgli_patricia_add(patricia, "id", idobj);
-	mowgli_patricia_add(patricia, "error", mowgli_json_null);
+static void *jsonrpc_metadata_target(const char *name)
+{
+	myentity_t *mt;
 
-	mowgli_string_t *str = mowgli_string_create();
+	if (*name == '#')
+		return mychan_find(name);
 
-	mowgli_json_serialize_to_string(obj, str, 0);
+	mt = myentity_find(name);
+	if (mt == NULL)
+		mt = myentity_find_uid(name);
 
-	jsonrpc_send_data(conn, str->str);
+	return mt;
+}
 
-	return 0;
+static void jsonrpc_metadata_notarget(void *conn, const char *name, char *id)
+{
+	if (*name == '#')
+		jsonrpc_failure_string(conn, fault_nosuch_source, "No channel registration was found for the provided channel name.", id);
+	else
+		jsonrpc_failure_string(conn, fault_nosuch_source, "No account was found for this accountname or UID.", id);
 }
 
 /*
@@ -615,6 +662,7 @@ static bool jsonrpcmethod_ison(void *conn, mowgli_list_t *params, char *id)
 static bool jsonrpcmethod_metadata(void *conn, mowgli_list_t *params, char *id)
 {
 	metadata_t *md;
+	void *target;
 
 	char *param, *name, *metadata;
 
@@ -641,66 +689,426 @@ static bool jsonrpcmethod_metadata(void *conn, mowgli_list_t *params, char *id)
 		return 0;
 	}
 
-	if (*name == '#')
+	if ((target = jsonrpc_metadata_target(name)) == NULL)
+	{
+		jsonrpc_metadata_notarget(conn, name, id);
+		return 0;
+	}
+
+	md = metadata_find(target, metadata);
+
+	if (md == NULL)
+	{
+		jsonrpc_failure_string(conn, fault_nosuch_source, "No metadata found matching this account/channel and key.", id);
+		return 0;
+	}
+
+	jsonrpc_success_string(conn, md->value, id);
+
+	return 0;
+}
+
+/*
+ * atheme.ison.bulk
+ *
+ * JSON inputs:
+ *       one or more nicknames
+ *
+ * JSON outputs:
+ *       An object with a property for each nickname, holding the same
+ *       object atheme.ison would return for it.  Repeated nicknames are
+ *       listed once.
+ */
+
+static bool jsonrpcmethod_ison_bulk(void *conn, mowgli_list_t *params, char *id)
+{
+	mowgli_patricia_t *seen;
+	mowgli_node_t *n;
+	char *param;
+
+	MOWGLI_LIST_FOREACH(n, params->head)
 	{
-		mychan_t *mc;
+		param = n->data;
 
-		mc = mychan_find(name);
-		if (mc == NULL)
+		if (*param == '\0' || strchr(param, '\r') || strchr(param, '\n'))
 		{
-			jsonrpc_failure_string(conn, fault_nosuch_source, "No channel registration was found for the provided channel name.", id);
+			jsonrpc_failure_string(conn, fault_badparams, "Invalid nickname.", id);
 			return 0;
 		}
+	}
 
-		md = metadata_find(mc, metadata);
+	if (MOWGLI_LIST_LENGTH(params) < 1)
+	{
+		jsonrpc_failure_string(conn, fault_needmoreparams, "Insufficient parameters.", id);
+		return 0;
 	}
-	else
+
+	jsonrpc_stream_t *js = jsonrpc_response_begin(conn, id);
+
+	jsonrpc_stream_object_begin(js);
+
+	/* a repeated name would otherwise produce a duplicate key */
+	seen = mowgli_patricia_create(NULL);
+
+	MOWGLI_LIST_FOREACH(n, params->head)
 	{
-		myentity_t *mt;
+		param = n->data;
+
+		if (mowgli_patricia_retrieve(seen, param) != NULL)
+			continue;
+
+		mowgli_patricia_add(seen, param, param);
 
-		mt = myentity_find(name);
-		if (mt == NULL)
-			mt = myentity_find_uid(name);
+		jsonrpc_stream_key(js, param);
+		jsonrpc_ison_result(js, user_find(param));
+	}
+
+	mowgli_patricia_destroy(seen, NULL, NULL);
+
+	jsonrpc_stream_object_end(js);
+	jsonrpc_response_end(js);
+
+	return 0;
+}
+
+/*
+ * atheme.metadata.bulk
+ *
+ * JSON inputs:
+ *       entity name, UID or channel name
+ *       one or more metadata keys
+ *
+ * JSON outputs:
+ *       An object with a property for each key, holding its value, or null
+ *       if the key is not set.  Repeated keys are listed once.
+ */
+
+static bool jsonrpcmethod_metadata_bulk(void *conn, mowgli_list_t *params, char *id)
+{
+	metadata_t *md;
+	void *target;
+	mowgli_patricia_t *seen;
+	mowgli_node_t *n;
+	char *param, *name;
+
+	MOWGLI_LIST_FOREACH(n, params->head)
+	{
+		param = n->data;
 
-		if (mt == NULL)
+		if (*param == '\0' || strchr(param, '\r') || strchr(param, '\n'))
 		{
-			jsonrpc_failure_string(conn, fault_nosuch_source, "No account was found for this accountname or UID.", id);
+			jsonrpc_failure_string(conn, fault_badparams, "Invalid parameter.", id);
 			return 0;
 		}
+	}
 
-		md = metadata_find(mt, metadata);
+	if (MOWGLI_LIST_LENGTH(params) < 2)
+	{
+		jsonrpc_failure_string(conn, fault_needmoreparams, "Insufficient parameters.", id);
+		return 0;
 	}
 
-	if (md == NULL)
+	name = params->head->data;
+
+	if ((target = jsonrpc_metadata_target(name)) == NULL)
 	{
-		jsonrpc_failure_string(conn, fault_nosuch_source, "No metadata found matching this account/channel and key.", id);
+		jsonrpc_metadata_notarget(conn, name, id);
 		return 0;
 	}
 
-	jsonrpc_success_string(conn, md->value, id);
+	jsonrpc_stream_t *js = jsonrpc_response_begin(conn, id);
+
+	jsonrpc_stream_object_begin(js);
+
+	seen = mowgli_patricia_create(NULL);
+
+	MOWGLI_LIST_FOREACH(n, params->head->next)
+	{
+		param = n->data;
+
+		if (mowgli_patricia_retrieve(seen, param) != NULL)
+			continue;
+
+		mowgli_patricia_add(seen, param, param);
+
+		jsonrpc_stream_key(js, param);
+
+		if ((md = metadata_find(target, param)) != NULL)
+			jsonrpc_stream_string(js, md->value);
+		else
+			jsonrpc_stream_literal(js, "null");
+	}
+
+	mowgli_patricia_destroy(seen, NULL, NULL);
+
+	jsonrpc_stream_object_end(js);
+	jsonrpc_response_end(js);
+
+	return 0;
+}
+
+static void jsonrpc_number(jsonrpc_stream_t *js, const char *key, unsigned long long value)
+{
+	char buf[32];
+
+	snprintf(buf, sizeof buf, "%llu", value);
+	jsonrpc_stream_key(js, key);
+	jsonrpc_stream_literal(js, buf);
+}
+
+/*
+ * atheme.latency
+ *
+ * JSON inputs:
+ *       authcookie, account name, optional service name
+ *
+ * JSON outputs:
+ *       An array with an object for each command which has run:
+ *       { service, command, count, total_us, max_us, p50_us, p90_us, p99_us }
+ *       Requires the server:auspex privilege.
+ */
+
+static bool jsonrpcmethod_latency(void *conn, mowgli_list_t *params, char *id)
+{
+	myuser_t *mu;
+	service_t *svs;
+	command_stats_t *cs;
+	mowgli_patricia_iteration_state_t state;
+	mowgli_node_t *n;
+	char *param, *cookie, *accountname;
+	const char *target;
+
+	MOWGLI_LIST_FOREACH(n, params->head)
+	{
+		param = n->data;
+
+		if (*param == '\0' || strchr(param, '\r') || strchr(param, '\n'))
+		{
+			jsonrpc_failure_string(conn, fault_badparams, "Invalid parameter.", id);
+			return 0;
+		}
+	}
+
+	if (MOWGLI_LIST_LENGTH(params) < 2)
+	{
+		jsonrpc_failure_string(conn, fault_needmoreparams, "Insufficient parameters.", id);
+		return 0;
+	}
+
+	cookie = mowgli_node_nth_data(params, 0);
+	accountname = mowgli_node_nth_data(params, 1);
+	target = mowgli_node_nth_data(params, 2);
+
+	if ((mu = myuser_find(accountname)) == NULL)
+	{
+		jsonrpc_failure_string(conn, fault_nosuch_source, "Unknown user.", id);
+		return 0;
+	}
+
+	if (authcookie_validate(cookie, mu) == false)
+	{
+		jsonrpc_failure_string(conn, fault_badauthcookie, "Invalid authcookie for this account.", id);
+		return 0;
+	}
+
+	if (!has_priv_myuser(mu, PRIV_SERVER_AUSPEX))
+	{
+		jsonrpc_failure_string(conn, fault_noprivs, "You do not have sufficient privileges.", id);
+		return 0;
+	}
+
+	if (target != NULL && (svs = service_find_nick(target)) != NULL)
+		target = svs->internal_name;
+
+	jsonrpc_stream_t *js = jsonrpc_response_begin(conn, id);
+
+	jsonrpc_stream_array_begin(js);
+
+	MOWGLI_PATRICIA_FOREACH(cs, &state, command_stats)
+	{
+		if (cs->latency.count == 0)
+			continue;
+		if (target != NULL && strcasecmp(cs->service, target))
+			continue;
+
+		jsonrpc_stream_object_begin(js);
+		jsonrpc_stream_key(js, "service");
+		jsonrpc_stream_string(js, cs->service);
+		jsonrpc_stream_key(js, "command");
+		jsonrpc_stream_string(js, cs->name);
+		jsonrpc_number(js, "count", cs->latency.count);
+		jsonrpc_number(js, "total_us", cs->latency.total);
+		jsonrpc_number(js, "max_us", cs->latency.max);
+		jsonrpc_number(js, "p50_us", histogram_percentile(&cs->latency, 50));
+		jsonrpc_number(js, "p90_us", histogram_percentile(&cs->latency, 90));
+		jsonrpc_number(js, "p99_us", histogram_percentile(&cs->latency, 99));
+		jsonrpc_stream_object_end(js);
+	}
+
+	jsonrpc_stream_array_end(js);
+	jsonrpc_response_end(js);
+
+	return 0;
+}
+
+/*
+ * atheme.memory
+ *
+ * JSON inputs:
+ *       authcookie, account name
+ *
+ * JSON outputs:
+ *       An object with the process' memory use in bytes, 0 where the
+ *       platform cannot tell, and a "types" array with an object for each
+ *       type allocated from the shared heaps:
+ *       { name, size, block, objects, peak, bytes }
+ *       Requires the server:auspex privilege.
+ */
+
+static bool jsonrpcmethod_memory(void *conn, mowgli_list_t *params, char *id)
+{
+	myuser_t *mu;
+	sharedheap_t *sh;
+	memstat_t ms;
+	mowgli_node_t *n;
+	char *param, *cookie, *accountname;
+
+	MOWGLI_LIST_FOREACH(n, params->head)
+	{
+		param = n->data;
+
+		if (*param == '\0' || strchr(param, '\r') || strchr(param, '\n'))
+		{
+			jsonrpc_failure_string(conn, fault_badparams, "Invalid parameter.", id);
+			return 0;
+		}
+	}
+
+	if (MOWGLI_LIST_LENGTH(params) < 2)
+	{
+		jsonrpc_failure_string(conn, fault_needmoreparams, "Insufficient parameters.", id);
+		return 0;
+	}
+
+	cookie = mowgli_node_nth_data(params, 0);
+	accountname = mowgli_node_nth_data(params, 1);
+
+	if ((mu = myuser_find(accountname)) == NULL)
+	{
+		jsonrpc_failure_string(conn, fault_nosuch_source, "Unknown user.", id);
+		return 0;
+	}
+
+	if (authcookie_validate(cookie, mu) == false)
+	{
+		jsonrpc_failure_string(conn, fault_badauthcookie, "Invalid authcookie for this account.", id);
+		return 0;
+	}
+
+	if (!has_priv_myuser(mu, PRIV_SERVER_AUSPEX))
+	{
+		jsonrpc_failure_string(conn, fault_noprivs, "You do not have sufficient privileges.", id);
+		return 0;
+	}
+
+	memstat_get(&ms);
+
+	jsonrpc_stream_t *js = jsonrpc_response_begin(conn, id);
+
+	jsonrpc_stream_object_begin(js);
+	jsonrpc_number(js, "rss", ms.rss);
+	jsonrpc_number(js, "rss_peak", ms.rss_peak);
+	jsonrpc_number(js, "rss_anon", ms.rss_anon);
+	jsonrpc_number(js, "pss", ms.pss);
+	jsonrpc_number(js, "malloc_used", ms.malloc_used);
+	jsonrpc_number(js, "malloc_free", ms.malloc_free);
+	jsonrpc_number(js, "malloc_mmap", ms.malloc_mmap);
+	jsonrpc_number(js, "heap_objects", ms.heap_objects);
+	jsonrpc_number(js, "heap_used", ms.heap_used);
+	jsonrpc_number(js, "heap_reserved", ms.heap_reserved);
+	jsonrpc_number(js, "strings_large", ms.strings_large);
+	jsonrpc_number(js, "strings_large_bytes", ms.strings_large_bytes);
+	jsonrpc_number(js, "strings_table", ms.strings_table);
+
+	jsonrpc_stream_key(js, "types");
+	jsonrpc_stream_array_begin(js);
+
+	MOWGLI_ITER_FOREACH(n, sharedheap_list.head)
+	{
+		sh = n->data;
+
+		jsonrpc_stream_object_begin(js);
+		jsonrpc_stream_key(js, "name");
+		jsonrpc_stream_string(js, sh->name);
+		jsonrpc_number(js, "size", sh->size);
+		jsonrpc_number(js, "block", sh->block);
+		jsonrpc_number(js, "objects", sh->live);
+		jsonrpc_number(js, "peak", sh->peak);
+		jsonrpc_number(js, "bytes", (unsigned long long)sh->live * sh->size);
+		jsonrpc_stream_object_end(js);
+	}
+
+	jsonrpc_stream_array_end(js);
+	jsonrpc_stream_object_end(js);
+	jsonrpc_response_end(js);
 
 	return 0;
 }
 
-void jsonrpc_send_data(void *conn, char *str) {
-	struct httpddata *hd = ((connection_t *) conn)->userdata;
+void jsonrpc_send_stream(void *conn, const char *buf, size_t len, unsigned int flags)
+{
+	connection_t *cptr = conn;
+	struct httpddata *hd = cptr->userdata;
+	char hdr[300];
 
-	char buf[300];
+	if (flags & JSONRPC_SEND_FIRST)
+	{
+		/* a response sent in one piece gets a length, otherwise it is
+		 * chunked, or ended by closing the connection if the client
+		 * asked for that (HTTP/1.0 clients do not understand chunks) */
+		if (flags & JSONRPC_SEND_LAST)
+			snprintf(hdr, sizeof hdr, "Content-Length: %lu\r\n", (unsigned long)len);
+		else if (!hd->connection_close)
+			mowgli_strlcpy(hdr, "Transfer-Encoding: chunked\r\n", sizeof hdr);
+		else
+			hdr[0] = '\0';
 
-	size_t len = strlen(str);
+		sendq_add(cptr, "HTTP/1.1 200 OK\r\n", 17);
 
-	snprintf(buf, sizeof buf, "HTTP/1.1 200 OK\r\n"
-			"%s"
-			"Server: Atheme/%s\r\n"
-			"Content-Type: application/json\r\n"
-			"Content-Length: %lu\r\n\r\n",
-			hd->connection_close ? "Connection: close\r\n" : "",
-			PACKAGE_VERSION, (unsigned long)len);
+		if (hd->connection_close)
+			sendq_add(cptr, "Connection: close\r\n", 19);
 
-	sendq_add((connection_t *)conn, buf, strlen(buf));
-	sendq_add((connection_t *)conn, str, len);
+		sendq_add(cptr, hdr, strlen(hdr));
 
-	if (hd->connection_close) {
-		sendq_add_eof((connection_t *) conn);
+		snprintf(hdr, sizeof hdr, "Server: Atheme/%s\r\n"
+				"Content-Type: application/json\r\n\r\n",
+				PACKAGE_VERSION);
+		sendq_add(cptr, hdr, strlen(hdr));
+
+		if (flags & JSONRPC_SEND_LAST)
+		{
+			sendq_add(cptr, (char *)buf, len);
+			if (hd->connection_close)
+				sendq_add_eof(cptr);
+			return;
+		}
+	}
+
+	if (hd->connection_close)
+		sendq_add(cptr, (char *)buf, len);
+	else if (len > 0)
+	{
+		snprintf(hdr, sizeof hdr, "%lx\r\n", (unsigned long)len);
+		sendq_add(cptr, hdr, strlen(hdr));
+		sendq_add(cptr, (char *)buf, len);
+		sendq_add(cptr, "\r\n", 2);
+	}
+
+	if (flags & JSONRPC_SEND_LAST)
+	{
+		if (hd->connection_close)
+			sendq_add_eof(cptr);
+		else
+			sendq_add(cptr, "0\r\n\r\n", 5);
 	}
 }
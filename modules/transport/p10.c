@@ -180,6 +180,7 @@ static void p10_parse(char *line)
 				slog(LG_INFO, "p10_parse(): insufficient parameters for command %s", pcmd->token);
 				goto cleanup;
 			}
+			pcmd->calls++;
 			if (pcmd->handler)
 			{
 				pcmd->handler(si, parc, parv);
@@ -171,6 +171,7 @@ void irc_parse(char *line)
 				slog(LG_INFO, "irc_parse(): insufficient parameters for command %s", pcmd->token);
 				goto cleanup;
 			}
+			pcmd->calls++;
 			if (pcmd->handler)
 			{
 				pcmd->handler(si, parc, parv);
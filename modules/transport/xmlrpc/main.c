@@ -30,7 +30,7 @@ struct
 
 connection_t *current_cptr; /* XXX: Hack: src/xmlrpc.c requires us to do this */
 
-mowgli_list_t *httpd_path_handlers;
+httpd_path_func_t *httpd_path_funcs;
 
 static void xmlrpc_command_fail(sourceinfo_t *si, cmd_faultcode_t code, const char *message);
 static void xmlrpc_command_success_nodata(sourceinfo_t *si, const char *message);
@@ -42,6 +42,8 @@ static int xmlrpcmethod_command(void *conn, int parc, char *parv[]);
 static int xmlrpcmethod_privset(void *conn, int parc, char *parv[]);
 static int xmlrpcmethod_ison(void *conn, int parc, char *parv[]);
 static int xmlrpcmethod_metadata(void *conn, int parc, char *parv[]);
+static int xmlrpcmethod_latency(void *conn, int parc, char *parv[]);
+static int xmlrpcmethod_memory(void *conn, int parc, char *parv[]);
 
 /* Configuration */
 mowgli_list_t conf_xmlrpc_table;
@@ -89,20 +91,16 @@ static void xmlrpc_config_ready(void *vptr)
 	 */
 	handle_xmlrpc.path = xmlrpc_config.path;
 
+	/* this also picks up a changed path on rehash */
 	if (handle_xmlrpc.handler != NULL)
-	{
-		if (mowgli_node_find(&handle_xmlrpc, httpd_path_handlers))
-			return;
-
-		mowgli_node_add(&handle_xmlrpc, mowgli_node_create(), httpd_path_handlers);
-	}
+		httpd_path_funcs->path_add(&handle_xmlrpc);
 	else
 		slog(LG_ERROR, "xmlrpc_config_ready(): xmlrpc {} block missing or invalid");
 }
 
 void _modinit(module_t *m)
 {
-	MODULE_TRY_REQUEST_SYMBOL(m, httpd_path_handlers, "misc/httpd", "httpd_path_handlers");
+	MODULE_TRY_REQUEST_SYMBOL(m, httpd_path_funcs, "misc/httpd", "httpd_path_funcs");
 
 	hook_add_event("config_ready");
 	hook_add_config_ready(xmlrpc_config_ready);
@@ -120,24 +118,22 @@ void _modinit(module_t *m)
 	xmlrpc_register_method("atheme.privset", xmlrpcmethod_privset);
 	xmlrpc_register_method("atheme.ison", xmlrpcmethod_ison);
 	xmlrpc_register_method("atheme.metadata", xmlrpcmethod_metadata);
+	xmlrpc_register_method("atheme.latency", xmlrpcmethod_latency);
+	xmlrpc_register_method("atheme.memory", xmlrpcmethod_memory);
 }
 
 void _moddeinit(module_unload_intent_t intent)
 {
-	mowgli_node_t *n;
-
 	xmlrpc_unregister_method("atheme.login");
 	xmlrpc_unregister_method("atheme.logout");
 	xmlrpc_unregister_method("atheme.command");
 	xmlrpc_unregister_method("atheme.privset");
 	xmlrpc_unregister_method("atheme.ison");
 	xmlrpc_unregister_method("atheme.metadata");
+	xmlrpc_unregister_method("atheme.latency");
+	xmlrpc_unregister_method("atheme.memory");
 
-	if ((n = mowgli_node_find(&handle_xmlrpc, httpd_path_handlers)) != NULL)
-	{
-		mowgli_node_delete(n, httpd_path_handlers);
-		mowgli_node_free(n);
-	}
+	httpd_path_funcs->path_delete(&handle_xmlrpc);
 
 	del_conf_item("PATH", &conf_xmlrpc_table);
 	del_top_conf("XMLRPC");
@@ -615,5 +611,175 @@ static int xmlrpcmethod_metadata(void *conn, int parc, char *parv[])
 	return 0;
 }
 
+/*
+ * atheme.latency
+ *
+ * XML inputs:
+ *       authcookie, account name, optional service name
+ *
+ * XML outputs:
+ *       A string with a line for each command which has run:
+ *       service command count total_us max_us p50_us p90_us p99_us
+ *       Requires the server:auspex privilege.
+ */
+static int xmlrpcmethod_latency(void *conn, int parc, char *parv[])
+{
+	myuser_t *mu;
+	service_t *svs;
+	command_stats_t *cs;
+	mowgli_patricia_iteration_state_t state;
+	mowgli_string_t *s;
+	const char *target;
+	char buf[BUFSIZE];
+	int i;
+
+	for (i = 0; i < parc; i++)
+	{
+		if (strchr(parv[i], '\r') || strchr(parv[i], '\n'))
+		{
+			xmlrpc_generic_error(fault_badparams, "Invalid parameters.");
+			return 0;
+		}
+	}
+
+	if (parc < 2)
+	{
+		xmlrpc_generic_error(fault_needmoreparams, "Insufficient parameters.");
+		return 0;
+	}
+
+	if ((mu = myuser_find(parv[1])) == NULL)
+	{
+		xmlrpc_generic_error(fault_nosuch_source, "Unknown user.");
+		return 0;
+	}
+
+	if (authcookie_validate(parv[0], mu) == false)
+	{
+		xmlrpc_generic_error(fault_badauthcookie, "Invalid authcookie for this account.");
+		return 0;
+	}
+
+	if (!has_priv_myuser(mu, PRIV_SERVER_AUSPEX))
+	{
+		xmlrpc_generic_error(fault_noprivs, "You do not have sufficient privileges.");
+		return 0;
+	}
+
+	target = parc > 2 ? parv[2] : NULL;
+	if (target != NULL && (svs = service_find_nick(target)) != NULL)
+		target = svs->internal_name;
+
+	s = mowgli_string_create();
+
+	MOWGLI_PATRICIA_FOREACH(cs, &state, command_stats)
+	{
+		if (cs->latency.count == 0)
+			continue;
+		if (target != NULL && strcasecmp(cs->service, target))
+			continue;
+
+		snprintf(buf, sizeof buf, "%s %s %lu %llu %u %u %u %u\n",
+				cs->service, cs->name, cs->latency.count,
+				(unsigned long long)cs->latency.total, cs->latency.max,
+				histogram_percentile(&cs->latency, 50),
+				histogram_percentile(&cs->latency, 90),
+				histogram_percentile(&cs->latency, 99));
+		s->append(s, buf, strlen(buf));
+	}
+	s->append_char(s, '\0');
+
+	xmlrpc_send_string(s->str);
+	s->destroy(s);
+
+	return 0;
+}
+
+/*
+ * atheme.memory
+ *
+ * XML inputs:
+ *       authcookie, account name
+ *
+ * XML outputs:
+ *       A string with a "key bytes" line for each process-wide figure
+ *       (0 where the platform cannot tell), then a line for each type
+ *       allocated from the shared heaps:
+ *       type name size objects peak
+ *       Requires the server:auspex privilege.
+ */
+static int xmlrpcmethod_memory(void *conn, int parc, char *parv[])
+{
+	myuser_t *mu;
+	sharedheap_t *sh;
+	memstat_t ms;
+	mowgli_node_t *n;
+	mowgli_string_t *s;
+	char buf[BUFSIZE];
+	int i;
+
+	for (i = 0; i < parc; i++)
+	{
+		if (strchr(parv[i], '\r') || strchr(parv[i], '\n'))
+		{
+			xmlrpc_generic_error(fault_badparams, "Invalid parameters.");
+			return 0;
+		}
+	}
+
+	if (parc < 2)
+	{
+		xmlrpc_generic_error(fault_needmoreparams, "Insufficient parameters.");
+		return 0;
+	}
+
+	if ((mu = myuser_find(parv[1])) == NULL)
+	{
+		xmlrpc_generic_error(fault_nosuch_source, "Unknown user.");
+		return 0;
+	}
+
+	if (authcookie_validate(parv[0], mu) == false)
+	{
+		xmlrpc_generic_error(fault_badauthcookie, "Invalid authcookie for this account.");
+		return 0;
+	}
+
+	if (!has_priv_myuser(mu, PRIV_SERVER_AUSPEX))
+	{
+		xmlrpc_generic_error(fault_noprivs, "You do not have sufficient privileges.");
+		return 0;
+	}
+
+	memstat_get(&ms);
+
+	s = mowgli_string_create();
+
+	snprintf(buf, sizeof buf, "rss %zu\nrss_peak %zu\nrss_anon %zu\npss %zu\n"
+			"malloc_used %zu\nmalloc_free %zu\nmalloc_mmap %zu\n"
+			"heap_objects %lu\nheap_used %zu\nheap_reserved %zu\n"
+			"strings_large %zu\nstrings_large_bytes %zu\nstrings_table %zu\n",
+			ms.rss, ms.rss_peak, ms.rss_anon, ms.pss,
+			ms.malloc_used, ms.malloc_free, ms.malloc_mmap,
+			ms.heap_objects, ms.heap_used, ms.heap_reserved,
+			ms.strings_large, ms.strings_large_bytes, ms.strings_table);
+	s->append(s, buf, strlen(buf));
+
+	MOWGLI_ITER_FOREACH(n, sharedheap_list.head)
+	{
+		sh = n->data;
+
+		snprintf(buf, sizeof buf, "type %s %zu %lu %lu\n",
+				sh->name, sh->size, sh->live, sh->peak);
+		s->append(s, buf, strlen(buf));
+	}
+	s->append_char(s, '\0');
+
+	xmlrpc_send_string(s->str);
+	s->destroy(s);
+
+	return 0;
+}
+
 /* vim:cinoptions=>s,e0,n0,f0,{0,}0,^0,=s,ps,t0,c3,+s,(2s,us,)20,*30,gs,hs ts=8 sw=8 noexpandtab
  */
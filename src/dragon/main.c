@@ -78,14 +78,24 @@ void burst_world(void)
 void phase_buildworld(void)
 {
 	struct timeval ts, te;
+	size_t strcount, strbytes;
+	memstat_t before, after;
 
 	slog(LG_INFO, "building world, please wait.");
 
+	memstat_get(&before);
 	s_time(&ts);
 	build_world();
 	e_time(ts, &te);
+	memstat_get(&after);
 
 	slog(LG_INFO, "world created in %d msec", tv2ms(&te));
+	slog(LG_INFO, "resident: +%zu KB, malloc: +%zu KB",
+			(after.rss - before.rss) / 1024, (after.malloc_used - before.malloc_used) / 1024);
+
+	strshare_stats(&strcount, &strbytes);
+	slog(LG_INFO, "shared strings: %zu (%zu bytes), table %zu KB, %zu too large for the heaps (%zu bytes)",
+			strcount, strbytes, after.strings_table / 1024, after.strings_large, after.strings_large_bytes);
 }
 
 static void m_pong(sourceinfo_t *si, int parc, char *parv[])
@@ -0,0 +1,247 @@
+/*
+ * ChatServices: A collection of minimalist IRC services
+ * main.c: Benchmark for antiflood message tracking.
+ *
+ * Copyright (c) 2018 ChatLounge IRC Network Development Team
+ *     (http://www.chatlounge.net)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Replays a busy channel through two message trackers: a list of
+ * heap-allocated copies of each message, as chanserv/antiflood used to
+ * keep, and a message ring.  Both are checked for flooding after every
+ * message the way chanserv/antiflood does it, and must agree.
+ *
+ * usage: floodbench [messages [users]]
+ */
+
+#include "atheme.h"
+
+#define DEFAULT_MESSAGES	2000000
+#define DEFAULT_USERS		300
+
+#define MSG_COUNT		10
+#define MSG_TIME		60
+
+static const char *const lines[] = {
+	"hi", "hello everyone", "lol", "anyone around?", "brb", "ok", "thanks!",
+	"has anyone tried the new release yet? the changelog looks interesting",
+	"what's the best way to configure this thing without breaking it",
+	"BUY CHEAP STUFF AT EXAMPLE DOT COM", "buy cheap stuff at example dot com",
+};
+
+typedef struct {
+	stringref source;
+	char *message;
+	time_t time;
+	mowgli_node_t node;
+} msg_t;
+
+static mowgli_heap_t *msg_heap;
+
+static void list_add(mowgli_list_t *l, stringref source, const char *message, time_t ts)
+{
+	msg_t *msg;
+
+	msg = mowgli_heap_alloc(msg_heap);
+	msg->message = sstrdup(message);
+	msg->time = ts;
+	msg->source = strshare_ref(source);
+
+	if (MOWGLI_LIST_LENGTH(l) > MSG_COUNT)
+	{
+		msg_t *head_msg = l->head->data;
+
+		free(head_msg->message);
+		strshare_unref(head_msg->source);
+		mowgli_node_delete(&head_msg->node, l);
+		mowgli_heap_free(msg_heap, head_msg);
+	}
+
+	mowgli_node_add(msg, &msg->node, l);
+}
+
+static int list_check(mowgli_list_t *l)
+{
+	msg_t *oldest, *newest, *msg;
+	mowgli_node_t *n;
+	size_t msg_matches = 0, usr_matches = 0;
+	time_t usr_first_seen = 0;
+
+	if (MOWGLI_LIST_LENGTH(l) < MSG_COUNT)
+		return 0;
+
+	oldest = l->head->data;
+	newest = l->tail->data;
+
+	if (newest->time - oldest->time > MSG_TIME)
+		return 0;
+
+	MOWGLI_ITER_FOREACH(n, l->head)
+	{
+		msg = n->data;
+
+		if (!strcasecmp(msg->message, newest->message))
+			msg_matches++;
+
+		if (msg->source == newest->source)
+		{
+			usr_matches++;
+
+			if (!usr_first_seen)
+				usr_first_seen = msg->time;
+		}
+	}
+
+	if (msg_matches > MSG_COUNT / 2)
+		return 1;
+
+	if (usr_matches > MSG_COUNT / 2 && newest->time - usr_first_seen < MSG_TIME / 4)
+		return 2;
+
+	return 0;
+}
+
+static int ring_check(msgring_t *ring)
+{
+	const msgring_entry_t *oldest, *newest;
+	size_t msg_matches, usr_matches;
+	time_t usr_first_seen;
+
+	if (ring->count < MSG_COUNT)
+		return 0;
+
+	oldest = MSGRING_OLDEST(ring);
+	newest = MSGRING_NEWEST(ring);
+
+	if (newest->time - oldest->time > MSG_TIME)
+		return 0;
+
+	msgring_match_newest(ring, &msg_matches, &usr_matches, &usr_first_seen);
+
+	if (msg_matches > MSG_COUNT / 2)
+		return 1;
+
+	if (usr_matches > MSG_COUNT / 2 && newest->time - usr_first_seen < MSG_TIME / 4)
+		return 2;
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int nmsgs = DEFAULT_MESSAGES, nusers = DEFAULT_USERS;
+	stringref *users;
+	unsigned int *from, *said;
+	mowgli_list_t list = { NULL, NULL, 0 };
+	mowgli_node_t *n, *tn;
+	msgring_t *ring;
+	double start;
+	unsigned long flagged[3] = { 0, 0, 0 }, mismatches = 0;
+	double list_us, ring_us;
+	unsigned int i, *verdicts;
+	char buf[BUFSIZE];
+
+	if (argc > 1)
+		nmsgs = atoi(argv[1]);
+	if (argc > 2)
+		nusers = atoi(argv[2]);
+	if (nmsgs == 0 || nusers == 0)
+		return EXIT_FAILURE;
+
+	srand(1);
+	strshare_init();
+	msg_heap = mowgli_heap_create(sizeof(msg_t), 1024, BH_NOW);
+
+	users = smalloc(nusers * sizeof(stringref));
+	for (i = 0; i < nusers; i++)
+	{
+		snprintf(buf, sizeof buf, "42XAAA%03u", i);
+		users[i] = strshare_get(buf);
+	}
+
+	/* mostly chatter, with the odd burst from a single user */
+	from = smalloc(nmsgs * sizeof(unsigned int));
+	said = smalloc(nmsgs * sizeof(unsigned int));
+	verdicts = scalloc(nmsgs, sizeof(unsigned int));
+	for (i = 0; i < nmsgs; i++)
+	{
+		if (i > 0 && rand() % 8 == 0)
+		{
+			from[i] = from[i - 1];
+			said[i] = rand() % 4 == 0 ? said[i - 1] : rand() % ARRAY_SIZE(lines);
+		}
+		else
+		{
+			from[i] = rand() % nusers;
+			said[i] = rand() % ARRAY_SIZE(lines);
+		}
+	}
+
+	start = mono_usec_double();
+	for (i = 0; i < nmsgs; i++)
+	{
+		list_add(&list, users[from[i]], lines[said[i]], i / 50);
+		verdicts[i] = list_check(&list);
+	}
+	list_us = mono_usec_double() - start;
+
+	ring = scalloc(1, sizeof(msgring_t));
+	start = mono_usec_double();
+	for (i = 0; i < nmsgs; i++)
+	{
+		int verdict;
+
+		msgring_add(ring, MSG_COUNT, users[from[i]], lines[said[i]], i / 50);
+		verdict = ring_check(ring);
+
+		flagged[verdict]++;
+		if (verdict != (int)verdicts[i] && mismatches++ < 10)
+			printf("disagreement at message %u: list %u, ring %d\n", i, verdicts[i], verdict);
+	}
+	ring_us = mono_usec_double() - start;
+
+	printf("%u messages from %u users, %lu repeats and %lu line floods seen\n",
+			nmsgs, nusers, flagged[1], flagged[2]);
+	printf("list %10.0f us (%6.1f ns/message)  ring %10.0f us (%6.1f ns/message)\n",
+			list_us, list_us * 1000 / nmsgs, ring_us, ring_us * 1000 / nmsgs);
+
+	MOWGLI_ITER_FOREACH_SAFE(n, tn, list.head)
+	{
+		msg_t *msg = n->data;
+
+		free(msg->message);
+		strshare_unref(msg->source);
+		mowgli_node_delete(&msg->node, &list);
+		mowgli_heap_free(msg_heap, msg);
+	}
+	mowgli_heap_destroy(msg_heap);
+
+	msgring_clear(ring);
+	free(ring);
+
+	for (i = 0; i < nusers; i++)
+		strshare_unref(users[i]);
+	free(users);
+	free(from);
+	free(said);
+	free(verdicts);
+
+	return mismatches != 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -8,6 +8,47 @@
 #include "atheme.h"
 #include "serno.h"
 
+/*
+ * Interns the strings each made-up user would hold, the way user_add()
+ * does, and reports what the shared string pool measurably took.
+ */
+static void footprint_strings(unsigned int usercount)
+{
+	memstat_t before, after;
+	size_t count, bytes;
+	char buf[BUFSIZE];
+	unsigned int i;
+
+	strshare_init();
+	memstat_get(&before);
+
+	for (i = 0; i < usercount; i++)
+	{
+		snprintf(buf, sizeof buf, "Guest%u", i);
+		strshare_get(buf);
+		snprintf(buf, sizeof buf, "~guest%u", i % 1000);
+		strshare_get(buf);
+		snprintf(buf, sizeof buf, "host-%u.dynamic.example.net", i);
+		strshare_get(buf);
+		strshare_get(buf);
+		strshare_get(buf);
+		snprintf(buf, sizeof buf, "Realname of user %u", i % 5000);
+		strshare_get(buf);
+		snprintf(buf, sizeof buf, "10.%u.%u.%u", (i >> 16) & 255, (i >> 8) & 255, i & 255);
+		strshare_get(buf);
+	}
+
+	memstat_get(&after);
+	strshare_stats(&count, &bytes);
+
+	printf("shared strings: %zu (%zu B of text), %zu too large for the heaps\n", count, bytes, after.strings_large);
+	printf("shared string table: %zu KB\n", after.strings_table / 1024);
+	printf("shared string heaps: %zu KB\n", (after.heap_used - before.heap_used) / 1024);
+	if (after.malloc_used != 0)
+		printf("malloc() growth: %zu KB --> %zu B per user\n", (after.malloc_used - before.malloc_used) / 1024,
+				usercount ? (after.malloc_used - before.malloc_used) / usercount : 0);
+}
+
 int main(int argc, char *argv[])
 {
 	unsigned int usercount = 0, channelcount = 0, membercount = 0,
@@ -70,5 +111,9 @@ int main(int argc, char *argv[])
 
 	printf("sizeof server_t: %zu B --> %zu KB\n", sizeof(server_t), (servercount * sizeof(server_t)) / 1024);
 
+	printf("\n* * *\n\n");
+
+	footprint_strings(usercount);
+
 	return EXIT_SUCCESS;
 }
@@ -0,0 +1,332 @@
+/*
+ * ChatServices: A collection of minimalist IRC services
+ * main.c: Benchmark for HTTP keep-alive and pipelining in misc/httpd.
+ *
+ * Copyright (c) 2018 ChatLounge IRC Network Development Team
+ *     (http://www.chatlounge.net)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Sends the same JSON-RPC call to a running services' misc/httpd, first
+ * on a new connection per request, then one request at a time over a
+ * single kept-alive connection, then pipelined a batch at a time, and
+ * reports the rate of each.
+ *
+ * usage: httpbench host port [requests [path]]
+ */
+
+#include "atheme.h"
+
+#include <netdb.h>
+#include <netinet/tcp.h>
+
+#define DEFAULT_REQUESTS	10000
+#define DEFAULT_PATH		"/jsonrpc"
+
+#define PIPELINE_DEPTH		16
+
+static const char body[] = "{\"method\":\"atheme.ison\",\"params\":[\"nick\"],\"id\":\"1\"}";
+
+typedef struct {
+	int fd;
+	char buf[65536];
+	size_t start, end;
+} reader_t;
+
+static char request[BUFSIZE], request_close[BUFSIZE];
+static size_t request_len, request_close_len;
+
+static int connect_to(struct addrinfo *ai)
+{
+	int fd, one = 1;
+
+	fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+	if (fd == -1)
+		return -1;
+
+	if (connect(fd, ai->ai_addr, ai->ai_addrlen) == -1)
+	{
+		close(fd);
+		return -1;
+	}
+
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+
+	return fd;
+}
+
+static bool send_all(int fd, const char *buf, size_t len)
+{
+	ssize_t l;
+
+	while (len > 0)
+	{
+		l = send(fd, buf, len, 0);
+		if (l <= 0)
+			return false;
+		buf += l;
+		len -= l;
+	}
+
+	return true;
+}
+
+/* returns the number of bytes buffered, 0 at EOF or -1 on error */
+static ssize_t reader_fill(reader_t *r)
+{
+	ssize_t l;
+
+	if (r->start > 0)
+	{
+		memmove(r->buf, r->buf + r->start, r->end - r->start);
+		r->end -= r->start;
+		r->start = 0;
+	}
+
+	if (r->end == sizeof r->buf)
+		return -1;
+
+	l = recv(r->fd, r->buf + r->end, sizeof r->buf - r->end, 0);
+	if (l > 0)
+		r->end += l;
+
+	return l;
+}
+
+static char *reader_line(reader_t *r)
+{
+	char *p, *line;
+
+	while ((p = memchr(r->buf + r->start, '\n', r->end - r->start)) == NULL)
+		if (reader_fill(r) <= 0)
+			return NULL;
+
+	line = r->buf + r->start;
+	r->start = p - r->buf + 1;
+	*p = '\0';
+	if (p > line && p[-1] == '\r')
+		p[-1] = '\0';
+
+	return line;
+}
+
+static bool reader_skip(reader_t *r, size_t len)
+{
+	size_t l;
+
+	while (len > 0)
+	{
+		if (r->start == r->end && reader_fill(r) <= 0)
+			return false;
+
+		l = r->end - r->start;
+		if (l > len)
+			l = len;
+		r->start += l;
+		len -= l;
+	}
+
+	return true;
+}
+
+/* reads one response, whichever of the three ways it is delimited */
+static bool read_response(reader_t *r)
+{
+	char *line, *p;
+	long length = -1;
+	bool chunked = false;
+
+	line = reader_line(r);
+	if (line == NULL || strncmp(line, "HTTP/1.", 7) || strncmp(line + 8, " 200", 4))
+		return false;
+
+	while ((line = reader_line(r)) != NULL && *line != '\0')
+	{
+		p = strchr(line, ':');
+		if (p == NULL)
+			continue;
+		*p++ = '\0';
+		while (*p == ' ')
+			p++;
+
+		if (!strcasecmp(line, "Content-Length"))
+			length = atol(p);
+		else if (!strcasecmp(line, "Transfer-Encoding") && !strcasecmp(p, "chunked"))
+			chunked = true;
+	}
+	if (line == NULL)
+		return false;
+
+	if (chunked)
+	{
+		do
+		{
+			if ((line = reader_line(r)) == NULL)
+				return false;
+			length = strtol(line, NULL, 16);
+			if (!reader_skip(r, length) || reader_line(r) == NULL)
+				return false;
+		} while (length > 0);
+
+		return true;
+	}
+
+	if (length >= 0)
+		return reader_skip(r, length);
+
+	/* delimited by the end of the connection */
+	r->start = r->end = 0;
+	while (reader_fill(r) > 0)
+		r->start = r->end = 0;
+
+	return true;
+}
+
+static unsigned int bench_close(struct addrinfo *ai, unsigned int nreq)
+{
+	reader_t *r;
+	unsigned int i;
+
+	r = smalloc(sizeof *r);
+	for (i = 0; i < nreq; i++)
+	{
+		r->fd = connect_to(ai);
+		r->start = r->end = 0;
+		if (r->fd == -1)
+			break;
+
+		if (!send_all(r->fd, request_close, request_close_len) || !read_response(r))
+		{
+			close(r->fd);
+			break;
+		}
+		close(r->fd);
+	}
+	free(r);
+
+	return i;
+}
+
+static unsigned int bench_pipelined(struct addrinfo *ai, unsigned int nreq, unsigned int depth)
+{
+	reader_t *r;
+	char *batch;
+	unsigned int i, j, n, done = 0;
+
+	batch = smalloc(request_len * depth);
+	for (j = 0; j < depth; j++)
+		memcpy(batch + j * request_len, request, request_len);
+
+	r = smalloc(sizeof *r);
+	r->start = r->end = 0;
+	r->fd = connect_to(ai);
+	if (r->fd == -1)
+	{
+		free(r);
+		free(batch);
+		return 0;
+	}
+
+	for (i = 0; i < nreq; i += n)
+	{
+		n = nreq - i < depth ? nreq - i : depth;
+		if (!send_all(r->fd, batch, request_len * n))
+			break;
+
+		for (j = 0; j < n; j++, done++)
+			if (!read_response(r))
+				goto out;
+	}
+
+out:
+	close(r->fd);
+	free(r);
+	free(batch);
+
+	return done;
+}
+
+int main(int argc, char *argv[])
+{
+	struct addrinfo hints, *ai;
+	double start;
+	const char *path = DEFAULT_PATH;
+	unsigned int nreq = DEFAULT_REQUESTS, done;
+	double us;
+	int err;
+
+	if (argc < 3)
+	{
+		fprintf(stderr, "usage: %s host port [requests [path]]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (argc > 3)
+		nreq = atoi(argv[3]);
+	if (argc > 4)
+		path = argv[4];
+	if (nreq == 0)
+		return EXIT_FAILURE;
+
+	memset(&hints, 0, sizeof hints);
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	if ((err = getaddrinfo(argv[1], argv[2], &hints, &ai)) != 0)
+	{
+		fprintf(stderr, "%s: %s\n", argv[1], gai_strerror(err));
+		return EXIT_FAILURE;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+
+	request_len = snprintf(request, sizeof request,
+			"POST %s HTTP/1.1\r\nHost: %s\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n\r\n%s",
+			path, argv[1], strlen(body), body);
+	request_close_len = snprintf(request_close, sizeof request_close,
+			"POST %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n\r\n%s",
+			path, argv[1], strlen(body), body);
+
+	start = mono_usec_double();
+	done = bench_close(ai, nreq);
+	us = mono_usec_double() - start;
+	printf("connection per request  %6u requests %10.0f us (%8.0f requests/s)\n", done, us, done * 1000000.0 / us);
+	if (done < nreq)
+		goto fail;
+
+	start = mono_usec_double();
+	done = bench_pipelined(ai, nreq, 1);
+	us = mono_usec_double() - start;
+	printf("keep-alive              %6u requests %10.0f us (%8.0f requests/s)\n", done, us, done * 1000000.0 / us);
+	if (done < nreq)
+		goto fail;
+
+	start = mono_usec_double();
+	done = bench_pipelined(ai, nreq, PIPELINE_DEPTH);
+	us = mono_usec_double() - start;
+	printf("pipelined, depth %-3u    %6u requests %10.0f us (%8.0f requests/s)\n", PIPELINE_DEPTH, done, us, done * 1000000.0 / us);
+	if (done < nreq)
+		goto fail;
+
+	freeaddrinfo(ai);
+	return EXIT_SUCCESS;
+
+fail:
+	fprintf(stderr, "request %u failed\n", done + 1);
+	freeaddrinfo(ai);
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,207 @@
+/*
+ * ChatServices: A collection of minimalist IRC services
+ * main.c: Microbenchmark for case mapping and wildcard matching.
+ *
+ * Copyright (c) 2018 ChatLounge IRC Network Development Team
+ *     (http://www.chatlounge.net)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Times irccasecmp(), match() and match_compiled() against a set of
+ * nick!user@host masks and names shaped like those on a real network,
+ * and cross-checks that match() and match_compiled() agree.
+ *
+ * usage: matchbench [masks [names]]
+ */
+
+#include "atheme.h"
+
+#define DEFAULT_MASKS	500
+#define DEFAULT_NAMES	5000
+
+static const char *const words[] = {
+	"alice", "bob", "Carol", "dave", "Eve", "mallory", "trent", "peggy",
+	"victor", "walter", "[away]", "{zz}", "^caret", "pipe|", "under_score",
+};
+
+static const char *const domains[] = {
+	"example.com", "example.net", "dsl.provider.example", "cable.isp.example",
+	"users.irc.example", "staff.irc.example", "cloud.example.org",
+};
+
+static const char *pick(const char *const *list, size_t count)
+{
+	return list[rand() % count];
+}
+
+static void make_name(char *buf, size_t len)
+{
+	const char *nick = pick(words, ARRAY_SIZE(words));
+	const char *host = pick(domains, ARRAY_SIZE(domains));
+
+	switch (rand() % 3)
+	{
+	case 0:
+		snprintf(buf, len, "%s%d!~%s@%d-%d-%d-%d.%s", nick, rand() % 100,
+				nick, rand() % 256, rand() % 256, rand() % 256, rand() % 256, host);
+		break;
+	case 1:
+		snprintf(buf, len, "%s!%s@user/%s", nick, nick, nick);
+		break;
+	default:
+		snprintf(buf, len, "%s_%d!%s@host%d.%s", nick, rand() % 1000,
+				pick(words, ARRAY_SIZE(words)), rand() % 50, host);
+		break;
+	}
+}
+
+static void make_mask(char *buf, size_t len)
+{
+	const char *nick = pick(words, ARRAY_SIZE(words));
+	const char *host = pick(domains, ARRAY_SIZE(domains));
+
+	switch (rand() % 6)
+	{
+	case 0:
+		snprintf(buf, len, "*!*@*.%s", host);
+		break;
+	case 1:
+		snprintf(buf, len, "%s*!*@*", nick);
+		break;
+	case 2:
+		snprintf(buf, len, "*!*%s@*", nick);
+		break;
+	case 3:
+		snprintf(buf, len, "*!*@user/%s", nick);
+		break;
+	case 4:
+		/* '#' stands for a digit, and stays on the compiled path */
+		snprintf(buf, len, "%s#*!*@*", nick);
+		break;
+	default:
+		/* not literal, takes the match() fallback */
+		snprintf(buf, len, "%s?\?!*@*.%s", nick, host);
+		break;
+	}
+}
+
+static void report(const char *what, double us, unsigned long ops, unsigned long hits)
+{
+	printf("%-24s %10.0f us  %8.1f ns/op  %lu hits\n", what, us, us * 1000.0 / ops, hits);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int nmasks = DEFAULT_MASKS, nnames = DEFAULT_NAMES;
+	char **masks, **names;
+	match_mask_t **compiled;
+	double start;
+	unsigned long ops, hits, mismatches = 0;
+	unsigned int i, j;
+	int mapping;
+	char buf[BUFSIZE];
+
+	if (argc > 1)
+		nmasks = atoi(argv[1]);
+	if (argc > 2)
+		nnames = atoi(argv[2]);
+
+	srand(1);
+
+	masks = smalloc(nmasks * sizeof(char *));
+	compiled = smalloc(nmasks * sizeof(match_mask_t *));
+	names = smalloc(nnames * sizeof(char *));
+
+	for (i = 0; i < nmasks; i++)
+	{
+		make_mask(buf, sizeof buf);
+		masks[i] = sstrdup(buf);
+	}
+
+	for (i = 0; i < nnames; i++)
+	{
+		make_name(buf, sizeof buf);
+		names[i] = sstrdup(buf);
+	}
+
+	for (mapping = MATCH_RFC1459; mapping <= MATCH_ASCII; mapping++)
+	{
+		set_match_mapping(mapping);
+		printf("%s mapping, %u masks x %u names\n", mapping == MATCH_ASCII ? "ascii" : "rfc1459", nmasks, nnames);
+
+		ops = (unsigned long)nnames * nnames;
+		hits = 0;
+		start = mono_usec_double();
+		for (i = 0; i < nnames; i++)
+			for (j = 0; j < nnames; j++)
+				hits += irccasecmp(names[i], names[j]) == 0;
+		report("irccasecmp", mono_usec_double() - start, ops, hits);
+
+		ops = (unsigned long)nnames * nnames;
+		hits = 0;
+		start = mono_usec_double();
+		for (i = 0; i < nnames; i++)
+			for (j = 0; j < nnames; j++)
+				hits += ircncasecmp(names[i], names[j], NICKLEN) == 0;
+		report("ircncasecmp", mono_usec_double() - start, ops, hits);
+
+		start = mono_usec_double();
+		for (i = 0; i < nmasks; i++)
+			compiled[i] = match_compile(masks[i]);
+		report("match_compile", mono_usec_double() - start, nmasks, nmasks);
+
+		ops = (unsigned long)nmasks * nnames;
+		hits = 0;
+		start = mono_usec_double();
+		for (i = 0; i < nmasks; i++)
+			for (j = 0; j < nnames; j++)
+				hits += match(masks[i], names[j]) == 0;
+		report("match", mono_usec_double() - start, ops, hits);
+
+		hits = 0;
+		start = mono_usec_double();
+		for (i = 0; i < nmasks; i++)
+			for (j = 0; j < nnames; j++)
+				hits += match_compiled(compiled[i], names[j]) == 0;
+		report("match_compiled", mono_usec_double() - start, ops, hits);
+
+		for (i = 0; i < nmasks; i++)
+			for (j = 0; j < nnames; j++)
+				if (match(masks[i], names[j]) != match_compiled(compiled[i], names[j]))
+				{
+					if (mismatches++ < 10)
+						printf("disagreement: %s vs %s\n", masks[i], names[j]);
+				}
+
+		for (i = 0; i < nmasks; i++)
+			match_mask_free(compiled[i]);
+
+		printf("\n");
+	}
+
+	for (i = 0; i < nmasks; i++)
+		free(masks[i]);
+	for (i = 0; i < nnames; i++)
+		free(names[i]);
+	free(masks);
+	free(compiled);
+	free(names);
+
+	return mismatches != 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
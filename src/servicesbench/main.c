@@ -0,0 +1,926 @@
+/*
+ * ChatServices: A collection of minimalist IRC services
+ * main.c: End-to-end benchmark of services against a fake uplink.
+ *
+ * Copyright (c) 2018 ChatLounge IRC Network Development Team
+ *     (http://www.chatlounge.net)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Runs an installed services binary against a fake charybdis uplink and
+ * times it through a fixed sequence of workloads:
+ *
+ *   db_load         startup with a generated database, until it links
+ *   burst           users and channels introduced by the uplink
+ *   join_storm      every user joining registered channels
+ *   identify_storm  users identifying to NickServ
+ *   ban_channels    joins to channels with long akick and ban lists,
+ *                   and ban churn on them
+ *   db_save         OperServ UPDATE
+ *   shutdown        SIGTERM until exit, which includes the final save
+ *
+ * then restarts services on the database it saved, a number of times,
+ * repeating db_load, db_save and shutdown.
+ *
+ * Every workload is written to the link as fast as services reads it,
+ * with a PING every PROBE_INTERVAL lines.  Latency is the time from
+ * writing a PING (or an IDENTIFY or UPDATE) to reading its answer, so it
+ * includes the time spent waiting behind the lines before it.
+ *
+ * Results are printed one JSON object per line, for comparing runs.
+ * Passwords are stored unhashed, so no crypto module is involved.
+ *
+ * usage: servicesbench [-s services] [-u users] [-c channels] [-j joins]
+ *                      [-i identifies] [-b ban channels] [-m bans]
+ *                      [-S saves] [-r cycles] [-k]
+ *
+ * Modules are loaded from the installed services' module directory, so
+ * run "make install" first; "make bench" then runs this with the
+ * installed binary and $(BENCHFLAGS).  -k keeps the generated
+ * configuration, database and log.
+ */
+
+#include "atheme.h"
+
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <signal.h>
+
+#define UPLINK_NAME		"irc.bench"
+#define UPLINK_SID		"001"
+#define SERVICES_NAME		"services.bench"
+#define SERVICES_SID		"00A"
+#define LINK_PASSWORD		"benchlink"
+#define USER_PASSWORD		"benchpass"
+#define OPER_ACCOUNT		"benchoper"
+#define OPER_UID		UPLINK_SID "ZZZZZZ"
+
+#define DEFAULT_USERS		20000
+#define DEFAULT_CHANNELS	2000
+#define DEFAULT_JOINS		3
+#define DEFAULT_BAN_CHANNELS	50
+#define DEFAULT_BANS		200
+#define DEFAULT_SAVES		5
+#define DEFAULT_CYCLES		3
+
+/* lines between latency probes */
+#define PROBE_INTERVAL		500
+
+/* members per SJOIN and masks per BMASK, to stay under 512 bytes */
+#define SJOIN_CHUNK		40
+#define BMASK_CHUNK		20
+
+/* seconds to wait for services before giving up */
+#define BENCH_TIMEOUT		600
+
+typedef struct {
+	size_t offset;		/* end of the line in the output buffer */
+	bool request;		/* IDENTIFY or UPDATE rather than a PING */
+	double sent, done;	/* microseconds, 0 until it happens */
+} mark_t;
+
+static struct {
+	const char *services;
+	unsigned int users, channels, joins, identifies;
+	unsigned int ban_channels, bans, saves, cycles;
+	bool keep;
+} opt = {
+	BINDIR "/services",
+	DEFAULT_USERS, DEFAULT_CHANNELS, DEFAULT_JOINS, 0,
+	DEFAULT_BAN_CHANNELS, DEFAULT_BANS, DEFAULT_SAVES, DEFAULT_CYCLES,
+	false
+};
+
+static char dir[256];
+static int listen_fd = -1, link_fd = -1;
+static pid_t services_pid;
+static time_t now;
+static unsigned int cycle;
+
+static char *outbuf;
+static size_t out_len, out_off, out_cap;
+
+static char inbuf[65536];
+static size_t in_len;
+
+static mark_t *marks;
+static unsigned int nmarks, marks_cap, marks_sent;
+static unsigned int *uid_marks;		/* user index -> mark + 1 */
+static unsigned int update_next;	/* next UPDATE mark to be answered */
+
+static unsigned long lines_out, lines_in;
+static double phase_start;
+
+static void cleanup(void)
+{
+	static const char *const files[] = { "services.conf", "services.db", "services.db.new", "services.log", "services.pid" };
+	char path[BUFSIZE];
+	unsigned int i;
+
+	if (services_pid > 0)
+	{
+		kill(services_pid, SIGKILL);
+		waitpid(services_pid, NULL, 0);
+		services_pid = 0;
+	}
+
+	if (opt.keep || *dir == '\0')
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(files); i++)
+	{
+		snprintf(path, sizeof path, "%s/%s", dir, files[i]);
+		unlink(path);
+	}
+	rmdir(dir);
+}
+
+static void fail(const char *fmt, ...) PRINTFLIKE(1, 2);
+
+static void fail(const char *fmt, ...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	fprintf(stderr, "servicesbench: ");
+	vfprintf(stderr, fmt, args);
+	fprintf(stderr, "\n");
+	va_end(args);
+
+	if (*dir != '\0')
+	{
+		fprintf(stderr, "servicesbench: files kept in %s\n", dir);
+		opt.keep = true;
+	}
+	cleanup();
+	exit(EXIT_FAILURE);
+}
+
+/* three letters of server ID and six of a base-26 index */
+static const char *uid_of(unsigned int i)
+{
+	static char buf[10];
+	int pos;
+
+	memcpy(buf, UPLINK_SID, 3);
+	for (pos = 8; pos >= 3; pos--)
+	{
+		buf[pos] = 'A' + i % 26;
+		i /= 26;
+	}
+	buf[9] = '\0';
+
+	return buf;
+}
+
+static bool index_of_uid(const char *uid, unsigned int *i)
+{
+	int pos;
+
+	if (strlen(uid) != 9 || strncmp(uid, UPLINK_SID, 3))
+		return false;
+
+	*i = 0;
+	for (pos = 3; pos < 9; pos++)
+	{
+		if (uid[pos] < 'A' || uid[pos] > 'Z')
+			return false;
+		*i = *i * 26 + (uid[pos] - 'A');
+	}
+
+	return *i < opt.users;
+}
+
+/*
+ * The database.
+ */
+
+static void write_database(void)
+{
+	char path[BUFSIZE];
+	FILE *f;
+	unsigned int i, j;
+
+	snprintf(path, sizeof path, "%s/services.db", dir);
+	if ((f = fopen(path, "w")) == NULL)
+		fail("%s: %s", path, strerror(errno));
+
+	fprintf(f, "DBV 12\n");
+	fprintf(f, "CF +AFHORVbefhiorstv\n");
+
+	/* one account per user, named after its nick */
+	for (i = 0; i < opt.users; i++)
+	{
+		fprintf(f, "MU " SERVICES_SID "%06u u%07u " USER_PASSWORD " u%07u@bench.example %lu %lu +\n",
+				i, i, i, (unsigned long)now, (unsigned long)now);
+		fprintf(f, "MN u%07u u%07u %lu %lu\n", i, i, (unsigned long)now, (unsigned long)now);
+	}
+	fprintf(f, "MU " SERVICES_SID "%06u " OPER_ACCOUNT " " USER_PASSWORD " oper@bench.example %lu %lu +\n",
+			opt.users, (unsigned long)now, (unsigned long)now);
+
+	for (i = 0; i < opt.channels; i++)
+	{
+		fprintf(f, "MC #c%u %lu %lu + 0 0 0\n", i, (unsigned long)now, (unsigned long)now);
+		fprintf(f, "CA #c%u u%07u +AFORVefiorstv %lu *\n", i, i % opt.users, (unsigned long)now);
+	}
+
+	for (i = 0; i < opt.ban_channels; i++)
+	{
+		fprintf(f, "MC #ban%u %lu %lu + 0 0 0\n", i, (unsigned long)now, (unsigned long)now);
+		fprintf(f, "CA #ban%u u%07u +AFORVefiorstv %lu *\n", i, i % opt.users, (unsigned long)now);
+		for (j = 0; j < opt.bans; j++)
+			fprintf(f, "CA #ban%u *!*@bad%u.example +b %lu *\n", i, j, (unsigned long)now);
+	}
+
+	if (fclose(f) != 0)
+		fail("%s: %s", path, strerror(errno));
+}
+
+static void write_config(unsigned int port)
+{
+	char path[BUFSIZE];
+	FILE *f;
+
+	snprintf(path, sizeof path, "%s/services.conf", dir);
+	if ((f = fopen(path, "w")) == NULL)
+		fail("%s: %s", path, strerror(errno));
+
+	fprintf(f,
+		"loadmodule \"modules/protocol/charybdis\";\n"
+		"loadmodule \"modules/backend/opensex\";\n"
+		"loadmodule \"modules/nickserv/main\";\n"
+		"loadmodule \"modules/nickserv/identify\";\n"
+		"loadmodule \"modules/chanserv/main\";\n"
+		"loadmodule \"modules/operserv/main\";\n"
+		"loadmodule \"modules/operserv/update\";\n"
+		"\n"
+		"serverinfo {\n"
+		"\tname = \"" SERVICES_NAME "\";\n"
+		"\tdesc = \"servicesbench\";\n"
+		"\tnumeric = \"" SERVICES_SID "\";\n"
+		"\tnetname = \"BenchNet\";\n"
+		"\tadminname = \"servicesbench\";\n"
+		"\tadminemail = \"servicesbench@bench.example\";\n"
+		"\tauth = none;\n"
+		"};\n"
+		"\n"
+		"uplink \"" UPLINK_NAME "\" {\n"
+		"\thost = \"127.0.0.1\";\n"
+		"\tport = %u;\n"
+		"\tpassword = \"" LINK_PASSWORD "\";\n"
+		"};\n"
+		"\n"
+		"general {\n"
+		"\tuplink_sendq_limit = %d;\n"
+		"};\n"
+		"\n"
+		"operclass \"bench\" {\n"
+		"\tprivs {\n"
+		"\t\tgeneral:admin;\n"
+		"\t};\n"
+		"};\n"
+		"\n"
+		"operator \"" OPER_ACCOUNT "\" {\n"
+		"\toperclass = \"bench\";\n"
+		"};\n",
+		port, INT_MAX);
+
+	if (fclose(f) != 0)
+		fail("%s: %s", path, strerror(errno));
+}
+
+static unsigned int listen_local(void)
+{
+	struct sockaddr_in sin;
+	socklen_t len = sizeof sin;
+
+	if ((listen_fd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+		fail("socket: %s", strerror(errno));
+
+	memset(&sin, 0, sizeof sin);
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(listen_fd, (struct sockaddr *)&sin, sizeof sin) == -1 || listen(listen_fd, 1) == -1)
+		fail("bind: %s", strerror(errno));
+
+	if (getsockname(listen_fd, (struct sockaddr *)&sin, &len) == -1)
+		fail("getsockname: %s", strerror(errno));
+
+	return ntohs(sin.sin_port);
+}
+
+/*
+ * Talking to services.
+ */
+
+static void out_line(const char *fmt, ...) PRINTFLIKE(1, 2);
+
+static void out_line(const char *fmt, ...)
+{
+	va_list args;
+	int len;
+
+	/* start over once everything has been written */
+	if (out_off == out_len && marks_sent == nmarks)
+		out_off = out_len = 0;
+
+	if (out_cap - out_len < BUFSIZE)
+	{
+		out_cap = out_cap * 2 + 65536;
+		outbuf = srealloc(outbuf, out_cap);
+	}
+
+	va_start(args, fmt);
+	len = vsnprintf(outbuf + out_len, BUFSIZE - 2, fmt, args);
+	va_end(args);
+
+	if (len > BUFSIZE - 3)
+		len = BUFSIZE - 3;
+	out_len += len;
+	outbuf[out_len++] = '\r';
+	outbuf[out_len++] = '\n';
+
+	lines_out++;
+}
+
+static unsigned int add_mark(bool request)
+{
+	mark_t *m;
+
+	if (nmarks == marks_cap)
+	{
+		marks_cap = marks_cap * 2 + 1024;
+		marks = srealloc(marks, marks_cap * sizeof *marks);
+	}
+
+	m = &marks[nmarks];
+	m->offset = out_len;
+	m->request = request;
+	m->sent = m->done = 0;
+
+	return nmarks++;
+}
+
+static unsigned int probe(void)
+{
+	out_line(":" UPLINK_SID " PING p%u", nmarks);
+
+	return add_mark(false);
+}
+
+/* after every line of a workload */
+static void maybe_probe(unsigned int *count)
+{
+	if (++*count % PROBE_INTERVAL == 0)
+		probe();
+}
+
+static void mark_done(unsigned int n)
+{
+	if (n < nmarks && marks[n].done == 0)
+		marks[n].done = mono_usec_double();
+}
+
+static void handle_line(char *line)
+{
+	char *parv[8];
+	int parc = 0;
+
+	lines_in++;
+
+	if (*line == ':')
+		line = strchr(line, ' ');
+	while (line != NULL && *line != '\0' && parc < 8)
+	{
+		while (*line == ' ')
+			line++;
+		if (*line == ':')
+		{
+			parv[parc++] = line + 1;
+			break;
+		}
+		parv[parc++] = line;
+		if ((line = strchr(line, ' ')) != NULL)
+			*line++ = '\0';
+	}
+	if (parc == 0)
+		return;
+
+	if (!strcmp(parv[0], "PING"))
+		out_line(":" UPLINK_SID " PONG " UPLINK_NAME " :%s", parc > 1 ? parv[parc - 1] : SERVICES_NAME);
+	else if (!strcmp(parv[0], "PONG") && parc > 2 && parv[2][0] == 'p')
+		mark_done(strtoul(parv[2] + 1, NULL, 10));
+	else if (!strcmp(parv[0], "ENCAP") && parc > 3 && !strcmp(parv[2], "SU"))
+	{
+		unsigned int i;
+
+		if (index_of_uid(parv[3], &i) && uid_marks[i] != 0)
+			mark_done(uid_marks[i] - 1);
+	}
+	else if (!strcmp(parv[0], "NOTICE") && parc > 2 && !strcmp(parv[1], OPER_UID) && !strcmp(parv[2], "UPDATE completed."))
+	{
+		/* answers come back in the order the UPDATEs were sent */
+		while (update_next < nmarks && !marks[update_next].request)
+			update_next++;
+		if (update_next < nmarks)
+			mark_done(update_next++);
+	}
+	else if (!strcmp(parv[0], "ERROR") || !strcmp(parv[0], "SQUIT"))
+		fail("services dropped the link: %s", parv[parc - 1]);
+}
+
+static void read_lines(void)
+{
+	char *p, *line;
+	ssize_t l;
+
+	l = recv(link_fd, inbuf + in_len, sizeof inbuf - in_len, 0);
+	if (l == 0)
+		fail("services closed the link");
+	if (l < 0)
+	{
+		if (errno == EAGAIN || errno == EINTR)
+			return;
+		fail("recv: %s", strerror(errno));
+	}
+	in_len += l;
+
+	line = inbuf;
+	while ((p = memchr(line, '\n', in_len - (line - inbuf))) != NULL)
+	{
+		*p = '\0';
+		if (p > line && p[-1] == '\r')
+			p[-1] = '\0';
+		handle_line(line);
+		line = p + 1;
+	}
+
+	in_len -= line - inbuf;
+	memmove(inbuf, line, in_len);
+
+	if (in_len == sizeof inbuf)
+		fail("line from services too long");
+}
+
+static void write_lines(void)
+{
+	ssize_t l;
+	double t;
+
+	l = send(link_fd, outbuf + out_off, out_len - out_off, 0);
+	if (l < 0)
+	{
+		if (errno == EAGAIN || errno == EINTR)
+			return;
+		fail("send: %s", strerror(errno));
+	}
+	out_off += l;
+
+	t = mono_usec_double();
+	while (marks_sent < nmarks && marks[marks_sent].offset <= out_off)
+		marks[marks_sent++].sent = t;
+}
+
+/* writes everything queued and reads until mark n has been answered */
+static void pump(unsigned int n)
+{
+	struct pollfd pfd;
+	double deadline = mono_usec_double() + BENCH_TIMEOUT * 1000000.0;
+
+	while (marks[n].done == 0)
+	{
+		pfd.fd = link_fd;
+		pfd.events = POLLIN | (out_off < out_len ? POLLOUT : 0);
+		pfd.revents = 0;
+
+		if (poll(&pfd, 1, 1000) < 0 && errno != EINTR)
+			fail("poll: %s", strerror(errno));
+
+		if (pfd.revents & (POLLIN | POLLHUP | POLLERR))
+			read_lines();
+		if (pfd.revents & POLLOUT)
+			write_lines();
+
+		if (mono_usec_double() > deadline)
+			fail("no answer from services in %d seconds", BENCH_TIMEOUT);
+	}
+}
+
+/*
+ * Reporting.
+ */
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void phase_begin(void)
+{
+	nmarks = marks_sent = update_next = 0;
+	lines_out = lines_in = 0;
+	phase_start = mono_usec_double();
+}
+
+/* waits for the final probe, then prints one result line */
+static void phase_end(const char *name, unsigned int items)
+{
+	double *lat, seconds;
+	unsigned int i, n = 0, failed = 0, last;
+	bool requests = false;
+
+	last = probe();
+	pump(last);
+	seconds = (marks[last].done - phase_start) / 1000000.0;
+
+	for (i = 0; i < nmarks; i++)
+		if (marks[i].request)
+			requests = true;
+
+	/* latency of the requests if there were any, else of the probes */
+	lat = smalloc((nmarks + 1) * sizeof *lat);
+	for (i = 0; i < nmarks; i++)
+	{
+		if (marks[i].request != requests)
+			continue;
+		if (marks[i].done == 0)
+		{
+			failed++;
+			continue;
+		}
+		lat[n++] = (marks[i].done - marks[i].sent) / 1000.0;
+	}
+	qsort(lat, n, sizeof *lat, cmp_double);
+
+	printf("{\"bench\":\"%s\",\"cycle\":%u,\"items\":%u,\"lines_out\":%lu,\"lines_in\":%lu,"
+			"\"seconds\":%.3f,\"items_per_sec\":%.1f,\"lines_per_sec\":%.1f,"
+			"\"latency_ms\":{\"samples\":%u,\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"max\":%.3f},\"failed\":%u}\n",
+			name, cycle, items, lines_out, lines_in,
+			seconds, seconds > 0 ? items / seconds : 0, seconds > 0 ? lines_out / seconds : 0,
+			n, n ? lat[n / 2] : 0, n ? lat[n * 9 / 10] : 0, n ? lat[n * 99 / 100] : 0, n ? lat[n - 1] : 0,
+			failed);
+	fflush(stdout);
+
+	free(lat);
+}
+
+/*
+ * Workloads.
+ */
+
+static void spawn_services(void)
+{
+	char conf[BUFSIZE], logpath[BUFSIZE], pid[BUFSIZE], db[BUFSIZE];
+	struct pollfd pfd;
+	struct stat st;
+	double start, deadline;
+	int fd, one = 1;
+
+	snprintf(conf, sizeof conf, "%s/services.conf", dir);
+	snprintf(logpath, sizeof logpath, "%s/services.log", dir);
+	snprintf(pid, sizeof pid, "%s/services.pid", dir);
+	snprintf(db, sizeof db, "%s/services.db", dir);
+
+	if (stat(db, &st) == -1)
+		fail("%s: %s", db, strerror(errno));
+
+	start = mono_usec_double();
+
+	services_pid = fork();
+	if (services_pid == -1)
+		fail("fork: %s", strerror(errno));
+	if (services_pid == 0)
+	{
+		if ((fd = open("/dev/null", O_RDWR)) != -1)
+		{
+			dup2(fd, 0);
+			dup2(fd, 1);
+			dup2(fd, 2);
+		}
+		close(listen_fd);
+		execl(opt.services, opt.services, "-n", "-c", conf, "-D", dir, "-l", logpath, "-p", pid, (char *)NULL);
+		_exit(127);
+	}
+
+	/* services links only once the database has been read */
+	deadline = start + BENCH_TIMEOUT * 1000000.0;
+	pfd.fd = listen_fd;
+	pfd.events = POLLIN;
+	for (;;)
+	{
+		if (waitpid(services_pid, NULL, WNOHANG) == services_pid)
+		{
+			services_pid = 0;
+			fail("services exited during startup; see %s", logpath);
+		}
+		if (poll(&pfd, 1, 100) > 0)
+			break;
+		if (mono_usec_double() > deadline)
+			fail("services did not link in %d seconds", BENCH_TIMEOUT);
+	}
+
+	if ((link_fd = accept(listen_fd, NULL, NULL)) == -1)
+		fail("accept: %s", strerror(errno));
+	setsockopt(link_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+	fcntl(link_fd, F_SETFL, fcntl(link_fd, F_GETFL) | O_NONBLOCK);
+
+	out_off = out_len = in_len = 0;
+
+	printf("{\"bench\":\"db_load\",\"cycle\":%u,\"db_bytes\":%lld,\"seconds\":%.3f}\n",
+			cycle, (long long)st.st_size, (mono_usec_double() - start) / 1000000.0);
+	fflush(stdout);
+}
+
+static void send_handshake(void)
+{
+	out_line("PASS " LINK_PASSWORD " TS 6 :" UPLINK_SID);
+	out_line("CAPAB :QS EX IE KLN UNKLN ENCAP TB SERVICES EUID EOPMOD MLOCK");
+	out_line("SERVER " UPLINK_NAME " 1 :servicesbench uplink");
+	out_line("SVINFO 6 3 0 :%lu", (unsigned long)now);
+}
+
+static void end_burst(void)
+{
+	out_line(":" UPLINK_SID " PONG " UPLINK_NAME " :" SERVICES_NAME);
+}
+
+static void introduce_oper(void)
+{
+	out_line(":" UPLINK_SID " EUID benchoper 1 %lu +o oper bench.example 10.255.255.255 " OPER_UID " * " OPER_ACCOUNT " :servicesbench oper",
+			(unsigned long)now);
+}
+
+static void bench_burst(void)
+{
+	unsigned int i, j, count = 0;
+	char buf[BUFSIZE];
+	size_t len;
+
+	phase_begin();
+	send_handshake();
+
+	for (i = 0; i < opt.users; i++)
+	{
+		/* every 50th user matches one of the akicks */
+		if (i % 50 == 49)
+			snprintf(buf, sizeof buf, "bad%u.example", i % opt.bans);
+		else
+			snprintf(buf, sizeof buf, "host%u.bench.example", i);
+
+		out_line(":" UPLINK_SID " EUID u%07u 1 %lu +i ~bench %s 10.%u.%u.%u %s * * :servicesbench user %u",
+				i, (unsigned long)now, buf, (i >> 16) & 255, (i >> 8) & 255, i & 255, uid_of(i), i);
+		maybe_probe(&count);
+	}
+	introduce_oper();
+
+	/* every user starts out on one registered channel */
+	for (i = 0; i < opt.channels; i++)
+	{
+		len = 0;
+		*buf = '\0';
+		for (j = i; j < opt.users; j += opt.channels)
+		{
+			len += snprintf(buf + len, sizeof buf - len, "%s%s", len ? " " : "", uid_of(j));
+			if ((j / opt.channels + 1) % SJOIN_CHUNK == 0)
+			{
+				out_line(":" UPLINK_SID " SJOIN %lu #c%u +nt :%s", (unsigned long)now - 86400, i, buf);
+				maybe_probe(&count);
+				len = 0;
+				*buf = '\0';
+			}
+		}
+		if (len > 0 || i >= opt.users)
+		{
+			out_line(":" UPLINK_SID " SJOIN %lu #c%u +nt :%s", (unsigned long)now - 86400, i, len > 0 ? buf : OPER_UID);
+			maybe_probe(&count);
+		}
+	}
+
+	/* and the ban channels start out with their ban lists */
+	for (i = 0; i < opt.ban_channels; i++)
+	{
+		out_line(":" UPLINK_SID " SJOIN %lu #ban%u +nt :" OPER_UID, (unsigned long)now - 86400, i);
+		len = 0;
+		for (j = 0; j < opt.bans; j++)
+		{
+			len += snprintf(buf + len, sizeof buf - len, "%s*!*@banned%u.example", len ? " " : "", j);
+			if (j % BMASK_CHUNK == BMASK_CHUNK - 1 || j == opt.bans - 1)
+			{
+				out_line(":" UPLINK_SID " BMASK %lu #ban%u b :%s", (unsigned long)now - 86400, i, buf);
+				maybe_probe(&count);
+				len = 0;
+			}
+		}
+	}
+
+	end_burst();
+	phase_end("burst", opt.users);
+}
+
+static void bench_join_storm(void)
+{
+	unsigned int i, j, count = 0;
+
+	phase_begin();
+
+	for (i = 0; i < opt.users; i++)
+		for (j = 0; j < opt.joins; j++)
+		{
+			out_line(":%s JOIN %lu #c%u +", uid_of(i), (unsigned long)now - 86400, (i * 7 + j * 13 + 1) % opt.channels);
+			maybe_probe(&count);
+		}
+
+	phase_end("join_storm", opt.users * opt.joins);
+}
+
+static void bench_identify_storm(void)
+{
+	unsigned int i, n = opt.identifies;
+
+	phase_begin();
+
+	for (i = 0; i < n; i++)
+	{
+		out_line(":%s PRIVMSG NickServ@" SERVICES_NAME " :IDENTIFY " USER_PASSWORD, uid_of(i));
+		uid_marks[i] = add_mark(true) + 1;
+	}
+
+	phase_end("identify_storm", n);
+
+	for (i = 0; i < n; i++)
+		uid_marks[i] = 0;
+}
+
+static void bench_ban_channels(void)
+{
+	unsigned int i, j, count = 0;
+
+	phase_begin();
+
+	for (i = 0; i < opt.users; i++)
+	{
+		out_line(":%s JOIN %lu #ban%u +", uid_of(i), (unsigned long)now - 86400, i % opt.ban_channels);
+		maybe_probe(&count);
+	}
+
+	for (i = 0; i < opt.ban_channels; i++)
+		for (j = 0; j < opt.bans; j++)
+		{
+			out_line(":" OPER_UID " TMODE %lu #ban%u +b *!*@churn%u.example", (unsigned long)now - 86400, i, j);
+			out_line(":" OPER_UID " TMODE %lu #ban%u -b *!*@churn%u.example", (unsigned long)now - 86400, i, j);
+			maybe_probe(&count);
+		}
+
+	phase_end("ban_channels", opt.users + opt.ban_channels * opt.bans * 2);
+}
+
+static void bench_db_save(void)
+{
+	unsigned int i, n;
+
+	phase_begin();
+
+	/* one at a time, so each measures a save on its own */
+	for (i = 0; i < opt.saves; i++)
+	{
+		out_line(":" OPER_UID " PRIVMSG OperServ@" SERVICES_NAME " :UPDATE");
+		n = add_mark(true);
+		pump(n);
+	}
+
+	phase_end("db_save", opt.saves);
+}
+
+static void bench_shutdown(void)
+{
+	double start = mono_usec_double();
+
+	kill(services_pid, SIGTERM);
+	waitpid(services_pid, NULL, 0);
+	services_pid = 0;
+
+	close(link_fd);
+	link_fd = -1;
+
+	printf("{\"bench\":\"shutdown\",\"cycle\":%u,\"seconds\":%.3f}\n", cycle, (mono_usec_double() - start) / 1000000.0);
+	fflush(stdout);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-s services] [-u users] [-c channels] [-j joins] [-i identifies]\n"
+			"       [-b ban channels] [-m bans] [-S saves] [-r cycles] [-k]\n", prog);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *tmpdir;
+	unsigned int port;
+	bool identifies_set = false;
+	int c;
+
+	while ((c = getopt(argc, argv, "s:u:c:j:i:b:m:S:r:k")) != -1)
+	{
+		switch (c)
+		{
+		case 's': opt.services = optarg; break;
+		case 'u': opt.users = strtoul(optarg, NULL, 10); break;
+		case 'c': opt.channels = strtoul(optarg, NULL, 10); break;
+		case 'j': opt.joins = strtoul(optarg, NULL, 10); break;
+		case 'i': opt.identifies = strtoul(optarg, NULL, 10); identifies_set = true; break;
+		case 'b': opt.ban_channels = strtoul(optarg, NULL, 10); break;
+		case 'm': opt.bans = strtoul(optarg, NULL, 10); break;
+		case 'S': opt.saves = strtoul(optarg, NULL, 10); break;
+		case 'r': opt.cycles = strtoul(optarg, NULL, 10); break;
+		case 'k': opt.keep = true; break;
+		default: usage(argv[0]);
+		}
+	}
+
+	/* half the users by default */
+	if (!identifies_set)
+		opt.identifies = opt.users / 2;
+	else if (opt.identifies > opt.users)
+		opt.identifies = opt.users;
+
+	if (optind != argc || opt.users == 0 || opt.channels == 0 || opt.ban_channels == 0 || opt.bans == 0 || opt.cycles == 0)
+		usage(argv[0]);
+	if (opt.users >= 1000000)
+		usage(argv[0]);
+
+	signal(SIGPIPE, SIG_IGN);
+	now = time(NULL);
+
+	if ((tmpdir = getenv("TMPDIR")) == NULL)
+		tmpdir = "/tmp";
+	snprintf(dir, sizeof dir, "%s/servicesbench.XXXXXX", tmpdir);
+	if (mkdtemp(dir) == NULL)
+	{
+		*dir = '\0';
+		fail("mkdtemp: %s", strerror(errno));
+	}
+
+	uid_marks = scalloc(sizeof *uid_marks, opt.users);
+
+	port = listen_local();
+	write_config(port);
+	write_database();
+
+	printf("{\"bench\":\"config\",\"users\":%u,\"channels\":%u,\"joins\":%u,\"identifies\":%u,"
+			"\"ban_channels\":%u,\"bans\":%u,\"saves\":%u,\"cycles\":%u}\n",
+			opt.users, opt.channels, opt.joins, opt.identifies,
+			opt.ban_channels, opt.bans, opt.saves, opt.cycles);
+
+	for (cycle = 1; cycle <= opt.cycles; cycle++)
+	{
+		spawn_services();
+
+		if (cycle == 1)
+		{
+			bench_burst();
+			bench_join_storm();
+			bench_identify_storm();
+			bench_ban_channels();
+		}
+		else
+		{
+			/* just enough of a burst for OperServ to know the oper */
+			phase_begin();
+			send_handshake();
+			introduce_oper();
+			end_burst();
+			pump(probe());
+		}
+
+		bench_db_save();
+		bench_shutdown();
+	}
+
+	cleanup();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,178 @@
+/*
+ * ChatServices: A collection of minimalist IRC services
+ * main.c: Benchmark for trigram indexed channel searches.
+ *
+ * Copyright (c) 2018 ChatLounge IRC Network Development Team
+ *     (http://www.chatlounge.net)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Builds a synthetic network of channels with topics, then times LIST
+ * style wildcard searches done by walking every channel against the
+ * same searches done through trigram indexes, and checks that both
+ * find the same channels.
+ *
+ * usage: trigrambench [channels [queries]]
+ */
+
+#include "atheme.h"
+
+#define DEFAULT_CHANNELS	200000
+#define DEFAULT_QUERIES		200
+
+static const char *const words[] = {
+	"linux", "debian", "gentoo", "python", "perl", "rust", "haskell", "chat",
+	"music", "anime", "games", "minecraft", "help", "support", "dev", "ops",
+	"lounge", "radio", "news", "sports", "football", "crypto", "security",
+	"freenode", "atheme", "services", "irc", "offtopic", "social", "random",
+};
+
+static const char *const queries[] = {
+	"*linux*", "#python*", "*help*", "*minecraft*dev*", "#chat-??", "*lounge",
+	"*radio*", "#ath*", "*ops", "*crypto*security*", "*-4242", "#rust*haskell-1??",
+};
+
+static const char *const topic_queries[] = {
+	"*welcome*", "*rules*", "*release*", "*meeting*", "*xyzzy*",
+};
+
+static const char *pick(const char *const *list, size_t count)
+{
+	return list[rand() % count];
+}
+
+struct search
+{
+	const char *mask;
+	unsigned int field;
+	unsigned long hits;
+};
+
+static void count_cb(const char *key, void *obj, void *privdata)
+{
+	const char **chan = obj;
+	struct search *search = privdata;
+
+	if (!match(search->mask, chan[search->field]))
+		search->hits++;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int nchans = DEFAULT_CHANNELS, nqueries = DEFAULT_QUERIES;
+	const char ***chans;
+	trigram_index_t *names, *topics;
+	double start;
+	unsigned long scanhits, mismatches = 0;
+	double scan_us = 0, index_us = 0;
+	struct search search;
+	unsigned int i, j, which;
+	const char *mask;
+	char buf[BUFSIZE];
+
+	if (argc > 1)
+		nchans = atoi(argv[1]);
+	if (argc > 2)
+		nqueries = atoi(argv[2]);
+
+	srand(1);
+
+	chans = smalloc(nchans * sizeof(const char **));
+	for (i = 0; i < nchans; i++)
+	{
+		chans[i] = smalloc(2 * sizeof(const char *));
+
+		snprintf(buf, sizeof buf, "#%s%s%s-%u", pick(words, ARRAY_SIZE(words)),
+				rand() % 2 ? "-" : "", pick(words, ARRAY_SIZE(words)), i);
+		chans[i][0] = sstrdup(buf);
+
+		snprintf(buf, sizeof buf, "Welcome to %s | %s talk | read the rules before asking | next %s meeting %d",
+				chans[i][0], pick(words, ARRAY_SIZE(words)), pick(words, ARRAY_SIZE(words)), rand() % 31);
+		chans[i][1] = sstrdup(buf);
+	}
+
+	start = mono_usec_double();
+	names = trigram_index_create();
+	topics = trigram_index_create();
+	for (i = 0; i < nchans; i++)
+	{
+		trigram_index_add(names, chans[i][0], chans[i], chans[i][0]);
+		trigram_index_add(topics, chans[i][0], chans[i], chans[i][1]);
+	}
+	printf("indexed %u channels in %.0f us\n", nchans, mono_usec_double() - start);
+
+	for (which = 0; which < 2; which++)
+	{
+		const char *const *list = which ? topic_queries : queries;
+		size_t count = which ? ARRAY_SIZE(topic_queries) : ARRAY_SIZE(queries);
+
+		for (j = 0; j < nqueries; j++)
+		{
+			mask = list[j % count];
+
+			scanhits = 0;
+			start = mono_usec_double();
+			for (i = 0; i < nchans; i++)
+				if (!match(mask, chans[i][which]))
+					scanhits++;
+			scan_us += mono_usec_double() - start;
+
+			search.mask = mask;
+			search.field = which;
+			search.hits = 0;
+			start = mono_usec_double();
+			if (!trigram_index_search(which ? topics : names, mask, count_cb, &search))
+			{
+				for (i = 0; i < nchans; i++)
+					if (!match(mask, chans[i][which]))
+						search.hits++;
+			}
+			index_us += mono_usec_double() - start;
+
+			if (scanhits != search.hits && mismatches++ < 10)
+				printf("disagreement: %s: %lu scanned vs %lu indexed\n", mask, scanhits, search.hits);
+		}
+
+		printf("%-7s %u queries: scan %10.0f us (%8.1f us/query)  index %10.0f us (%8.1f us/query)\n",
+				which ? "topics" : "names", nqueries, scan_us, scan_us / nqueries, index_us, index_us / nqueries);
+		scan_us = index_us = 0;
+	}
+
+	start = mono_usec_double();
+	for (i = 0; i < nchans; i += 2)
+	{
+		trigram_index_delete(names, chans[i][0]);
+		trigram_index_delete(topics, chans[i][0]);
+	}
+	printf("removed %u channels in %.0f us\n", (nchans + 1) / 2, mono_usec_double() - start);
+
+	trigram_index_destroy(names);
+	trigram_index_destroy(topics);
+
+	for (i = 0; i < nchans; i++)
+	{
+		free((char *)chans[i][0]);
+		free((char *)chans[i][1]);
+		free(chans[i]);
+	}
+	free(chans);
+
+	return mismatches != 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
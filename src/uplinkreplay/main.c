@@ -0,0 +1,803 @@
+/*
+ * ChatServices: A collection of minimalist IRC services
+ * main.c: Replays a captured uplink stream into services.
+ *
+ * Copyright (c) 2018 ChatLounge IRC Network Development Team
+ *     (http://www.chatlounge.net)
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Acts as the uplink for a services instance and feeds it the lines of
+ * a capture written with general::uplink_capture, either at the pace
+ * they were captured at, scaled by -x (2 for twice as fast), or with
+ * -x 0 as fast as services reads them.  It prints the throughput, the
+ * latency of a PING sent every PROBE_INTERVAL lines, and the lines and
+ * bytes of each protocol command.
+ *
+ * With -t, each line is instead followed by a PING and the next one is
+ * sent only once services answers, so the time each line took can be
+ * charged to its command.  The round trip of a PING on its own,
+ * measured at the end, is subtracted.
+ *
+ * The capture begins with the uplink's half of the link handshake, so
+ * services must be configured as they were when it was made: the same
+ * serverinfo, protocol module and uplink block, except that the uplink
+ * is 127.0.0.1 on the port given with -p.  To start on the same state,
+ * use a copy of the database from the time of the capture.  With -s and
+ * -c, the services binary is run with that configuration and stopped
+ * at the end; otherwise start it yourself once this is listening.
+ *
+ * usage: uplinkreplay [-x speed] [-t] [-p port] [-P probe]
+ *                     [-s services -c config [-D datadir]] capture
+ *
+ * Services are pinged with the source of the first PONG in the capture,
+ * as ":<uplink> PING p<N>", or "<uplink> G !p<N>" for P10; -P replaces
+ * everything before the p<N>.  Results are printed one JSON object per
+ * line.
+ */
+
+#include "atheme.h"
+#include "uplink.h"
+
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <signal.h>
+
+#define DEFAULT_PORT		6667
+
+/* lines between latency probes */
+#define PROBE_INTERVAL		500
+
+/* idle probes for the round trip subtracted with -t */
+#define BASELINE_PROBES		200
+
+/* unwritten bytes at which to stop queueing and wait for services */
+#define OUT_HIGHWATER		65536
+
+/* seconds to wait for services before giving up */
+#define REPLAY_TIMEOUT		600
+
+typedef struct {
+	char name[32];
+	unsigned long lines;
+	unsigned long long bytes;
+	histogram_t time;	/* -t only */
+} cmdstat_t;
+
+typedef struct {
+	uint64_t delay;		/* microseconds after the previous line */
+	size_t offset, len;	/* the line in capbuf */
+	unsigned int cmd;	/* index into cmds */
+} record_t;
+
+typedef struct {
+	size_t offset;		/* end of the line in the output buffer */
+	double sent, done;	/* microseconds, 0 until it happens */
+} mark_t;
+
+static struct {
+	double speed;
+	bool timed;
+	unsigned int port;
+	const char *probe;
+	const char *services, *config, *datadir;
+	const char *capture;
+} opt = { 1.0, false, DEFAULT_PORT, NULL, NULL, NULL, NULL, NULL };
+
+static int listen_fd = -1, link_fd = -1;
+static pid_t services_pid;
+
+static unsigned char *capbuf;
+static size_t caplen;
+static record_t *records;
+static unsigned int nrecords;
+static uint64_t capture_usec;
+static unsigned long long capture_bytes;
+
+static cmdstat_t *cmds;
+static unsigned int ncmds;
+
+static char probe_prefix[BUFSIZE];
+static bool p10;
+
+static char *outbuf;
+static size_t out_len, out_off, out_cap;
+
+static char inbuf[65536];
+static size_t in_len;
+
+static mark_t *marks;
+static unsigned int nmarks, marks_cap, marks_sent;
+
+static void cleanup(void)
+{
+	if (services_pid > 0)
+	{
+		kill(services_pid, SIGTERM);
+		waitpid(services_pid, NULL, 0);
+		services_pid = 0;
+	}
+}
+
+static void fail(const char *fmt, ...) PRINTFLIKE(1, 2);
+
+static void fail(const char *fmt, ...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	fprintf(stderr, "uplinkreplay: ");
+	vfprintf(stderr, fmt, args);
+	fprintf(stderr, "\n");
+	va_end(args);
+
+	cleanup();
+	exit(EXIT_FAILURE);
+}
+
+/*
+ * The capture.
+ */
+
+static bool get_varint(size_t *pos, uint64_t *v)
+{
+	unsigned int shift = 0;
+	unsigned char c;
+
+	*v = 0;
+	do
+	{
+		if (*pos >= caplen || shift > 63)
+			return false;
+		c = capbuf[(*pos)++];
+		*v |= (uint64_t)(c & 0x7f) << shift;
+		shift += 7;
+	} while (c & 0x80);
+
+	return true;
+}
+
+/* splits off the first two words of a line, without modifying it */
+static void first_words(const char *line, size_t len, char *w0, char *w1, size_t wsize)
+{
+	const char *p = line, *end = line + len;
+	char *w[2] = { w0, w1 };
+	size_t n;
+	int i;
+
+	for (i = 0; i < 2; i++)
+	{
+		while (p < end && *p == ' ')
+			p++;
+		for (n = 0; p < end && *p != ' '; p++)
+			if (n < wsize - 1)
+				w[i][n++] = *p;
+		w[i][n] = '\0';
+	}
+}
+
+static unsigned int find_cmd(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < ncmds; i++)
+		if (!strcmp(cmds[i].name, name))
+			return i;
+
+	cmds = srealloc(cmds, (ncmds + 1) * sizeof *cmds);
+	memset(&cmds[ncmds], 0, sizeof *cmds);
+	mowgli_strlcpy(cmds[ncmds].name, name, sizeof cmds[ncmds].name);
+
+	return ncmds++;
+}
+
+/* picks the probe from the uplink's first PONG */
+static void find_probe(void)
+{
+	char w0[64], w1[64];
+	unsigned int i;
+
+	for (i = 0; i < nrecords && *probe_prefix == '\0'; i++)
+	{
+		first_words((char *)capbuf + records[i].offset, records[i].len, w0, w1, sizeof w0);
+		if (*w0 == ':' && !strcmp(w1, "PONG"))
+			snprintf(probe_prefix, sizeof probe_prefix, "%s PING ", w0);
+		else if (*w0 != ':' && !strcmp(w1, "Z"))
+		{
+			snprintf(probe_prefix, sizeof probe_prefix, "%s G !", w0);
+			p10 = true;
+		}
+	}
+
+	if (opt.probe != NULL)
+	{
+		if (*probe_prefix == '\0')
+			p10 = *opt.probe != ':';
+		snprintf(probe_prefix, sizeof probe_prefix, "%s", opt.probe);
+	}
+
+	if (*probe_prefix == '\0')
+		fail("%s: no PONG from the uplink in the capture, use -P", opt.capture);
+}
+
+static void read_capture(void)
+{
+	char w0[64], w1[64];
+	const char *name;
+	unsigned int i, cap = 0;
+	size_t pos;
+	ssize_t l;
+	uint64_t delay, len;
+	int fd;
+
+	if ((fd = open(opt.capture, O_RDONLY)) == -1)
+		fail("%s: %s", opt.capture, strerror(errno));
+	for (;;)
+	{
+		if (caplen == cap)
+		{
+			cap = cap * 2 + 1048576;
+			capbuf = srealloc(capbuf, cap);
+		}
+		if ((l = read(fd, capbuf + caplen, cap - caplen)) <= 0)
+			break;
+		caplen += l;
+	}
+	if (l < 0)
+		fail("%s: %s", opt.capture, strerror(errno));
+	close(fd);
+
+	if (caplen < UPLINK_CAPTURE_MAGICLEN || memcmp(capbuf, UPLINK_CAPTURE_MAGIC, UPLINK_CAPTURE_MAGICLEN))
+		fail("%s: not an uplink capture", opt.capture);
+
+	pos = UPLINK_CAPTURE_MAGICLEN;
+	cap = 0;
+	while (pos < caplen)
+	{
+		if (!get_varint(&pos, &delay) || !get_varint(&pos, &len) || len >= BUFSIZE || len > caplen - pos)
+		{
+			/* a capture cut short by a crash ends in a partial record */
+			fprintf(stderr, "uplinkreplay: %s: truncated after %u lines\n", opt.capture, nrecords);
+			break;
+		}
+
+		if (nrecords == cap)
+		{
+			cap = cap * 2 + 65536;
+			records = srealloc(records, cap * sizeof *records);
+		}
+		records[nrecords].delay = delay;
+		records[nrecords].offset = pos;
+		records[nrecords].len = len;
+		nrecords++;
+
+		capture_usec += delay;
+		capture_bytes += len;
+		pos += len;
+	}
+
+	if (nrecords == 0)
+		fail("%s: no lines captured", opt.capture);
+
+	find_probe();
+
+	/* the command follows the source, which P10 gives without a colon */
+	for (i = 0; i < nrecords; i++)
+	{
+		first_words((char *)capbuf + records[i].offset, records[i].len, w0, w1, sizeof w0);
+		if (*w0 == ':' || (p10 && strcmp(w0, "PASS") && strcmp(w0, "SERVER") && strcmp(w0, "ERROR")))
+			name = w1;
+		else
+			name = w0;
+		records[i].cmd = find_cmd(*name != '\0' ? name : "(empty)");
+		cmds[records[i].cmd].lines++;
+		cmds[records[i].cmd].bytes += records[i].len;
+	}
+}
+
+/*
+ * Talking to services.
+ */
+
+static void out_raw(const char *line, size_t len)
+{
+	/* start over once everything has been written */
+	if (out_off == out_len && marks_sent == nmarks)
+		out_off = out_len = 0;
+
+	if (out_cap - out_len < len + 2)
+	{
+		out_cap = out_cap * 2 + len + 65536;
+		outbuf = srealloc(outbuf, out_cap);
+	}
+
+	memcpy(outbuf + out_len, line, len);
+	out_len += len;
+	outbuf[out_len++] = '\r';
+	outbuf[out_len++] = '\n';
+}
+
+static unsigned int probe(void)
+{
+	char buf[BUFSIZE];
+	mark_t *m;
+	int len;
+
+	len = snprintf(buf, sizeof buf, "%sp%u", probe_prefix, nmarks);
+	out_raw(buf, len >= (int)sizeof buf ? sizeof buf - 1 : (size_t)len);
+
+	if (nmarks == marks_cap)
+	{
+		marks_cap = marks_cap * 2 + 1024;
+		marks = srealloc(marks, marks_cap * sizeof *marks);
+	}
+
+	m = &marks[nmarks];
+	m->offset = out_len;
+	m->sent = m->done = 0;
+
+	return nmarks++;
+}
+
+static void handle_line(char *line)
+{
+	char *parv[16];
+	int parc = 0;
+	const char *last;
+
+	if (*line == ':')
+		line = strchr(line, ' ');
+	while (line != NULL && *line != '\0' && parc < 16)
+	{
+		while (*line == ' ')
+			line++;
+		if (*line == ':')
+		{
+			parv[parc++] = line + 1;
+			break;
+		}
+		parv[parc++] = line;
+		if ((line = strchr(line, ' ')) != NULL)
+			*line++ = '\0';
+	}
+	if (parc < 2)
+		return;
+
+	if (!strcmp(parv[0], "ERROR"))
+		fail("services dropped the link: %s", parv[parc - 1]);
+
+	/* ":services PONG name p<N>" or, for P10, "numeric Z numeric !p<N>" */
+	if (strcmp(parv[0], "PONG") && strcmp(parv[1], "Z"))
+		return;
+
+	last = parv[parc - 1];
+	if (*last == '!')
+		last++;
+	if (*last == 'p' && isdigit((unsigned char)last[1]))
+	{
+		unsigned int n = strtoul(last + 1, NULL, 10);
+
+		if (n < nmarks && marks[n].done == 0)
+			marks[n].done = mono_usec_double();
+	}
+}
+
+static void read_lines(void)
+{
+	char *p, *line;
+	ssize_t l;
+
+	l = recv(link_fd, inbuf + in_len, sizeof inbuf - in_len, 0);
+	if (l == 0)
+		fail("services closed the link");
+	if (l < 0)
+	{
+		if (errno == EAGAIN || errno == EINTR)
+			return;
+		fail("recv: %s", strerror(errno));
+	}
+	in_len += l;
+
+	line = inbuf;
+	while ((p = memchr(line, '\n', in_len - (line - inbuf))) != NULL)
+	{
+		*p = '\0';
+		if (p > line && p[-1] == '\r')
+			p[-1] = '\0';
+		handle_line(line);
+		line = p + 1;
+	}
+
+	in_len -= line - inbuf;
+	memmove(inbuf, line, in_len);
+
+	if (in_len == sizeof inbuf)
+		fail("line from services too long");
+}
+
+static void write_lines(void)
+{
+	ssize_t l;
+	double t;
+
+	l = send(link_fd, outbuf + out_off, out_len - out_off, 0);
+	if (l < 0)
+	{
+		if (errno == EAGAIN || errno == EINTR)
+			return;
+		fail("send: %s", strerror(errno));
+	}
+	out_off += l;
+
+	t = mono_usec_double();
+	while (marks_sent < nmarks && marks[marks_sent].offset <= out_off)
+		marks[marks_sent++].sent = t;
+}
+
+static void io_round(int timeout)
+{
+	struct pollfd pfd;
+
+	pfd.fd = link_fd;
+	pfd.events = POLLIN | (out_off < out_len ? POLLOUT : 0);
+	pfd.revents = 0;
+
+	if (poll(&pfd, 1, timeout) < 0 && errno != EINTR)
+		fail("poll: %s", strerror(errno));
+
+	if (pfd.revents & (POLLIN | POLLHUP | POLLERR))
+		read_lines();
+	if (pfd.revents & POLLOUT)
+		write_lines();
+}
+
+/* keeps the link going until the given time */
+static void io_until(double t)
+{
+	double left;
+
+	while ((left = t - mono_usec_double()) > 0)
+		io_round(left / 1000);
+}
+
+/* writes everything queued and reads until mark n has been answered */
+static void pump(unsigned int n)
+{
+	double deadline = mono_usec_double() + REPLAY_TIMEOUT * 1000000.0;
+
+	while (marks[n].done == 0)
+	{
+		io_round(1000);
+
+		if (mono_usec_double() > deadline)
+			fail("no answer from services in %d seconds", REPLAY_TIMEOUT);
+	}
+}
+
+/*
+ * Setup.
+ */
+
+static void listen_local(void)
+{
+	struct sockaddr_in sin;
+	int one = 1;
+
+	if ((listen_fd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+		fail("socket: %s", strerror(errno));
+	setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+
+	memset(&sin, 0, sizeof sin);
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sin.sin_port = htons(opt.port);
+	if (bind(listen_fd, (struct sockaddr *)&sin, sizeof sin) == -1 || listen(listen_fd, 1) == -1)
+		fail("bind to port %u: %s", opt.port, strerror(errno));
+}
+
+static void spawn_services(void)
+{
+	int fd;
+
+	services_pid = fork();
+	if (services_pid == -1)
+		fail("fork: %s", strerror(errno));
+	if (services_pid == 0)
+	{
+		if ((fd = open("/dev/null", O_RDWR)) != -1)
+		{
+			dup2(fd, 0);
+			dup2(fd, 1);
+			dup2(fd, 2);
+		}
+		close(listen_fd);
+		if (opt.datadir != NULL)
+			execl(opt.services, opt.services, "-n", "-c", opt.config, "-D", opt.datadir, (char *)NULL);
+		else
+			execl(opt.services, opt.services, "-n", "-c", opt.config, (char *)NULL);
+		_exit(127);
+	}
+}
+
+static void accept_link(void)
+{
+	struct pollfd pfd;
+	double deadline = mono_usec_double() + REPLAY_TIMEOUT * 1000000.0;
+	int one = 1;
+
+	if (services_pid == 0)
+		fprintf(stderr, "uplinkreplay: waiting for services on 127.0.0.1 port %u\n", opt.port);
+
+	pfd.fd = listen_fd;
+	pfd.events = POLLIN;
+	for (;;)
+	{
+		if (services_pid > 0 && waitpid(services_pid, NULL, WNOHANG) == services_pid)
+		{
+			services_pid = 0;
+			fail("services exited during startup");
+		}
+		if (poll(&pfd, 1, 100) > 0)
+			break;
+		if (mono_usec_double() > deadline)
+			fail("services did not link in %d seconds", REPLAY_TIMEOUT);
+	}
+
+	if ((link_fd = accept(listen_fd, NULL, NULL)) == -1)
+		fail("accept: %s", strerror(errno));
+	setsockopt(link_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+	fcntl(link_fd, F_SETFL, fcntl(link_fd, F_GETFL) | O_NONBLOCK);
+}
+
+/*
+ * Replaying.
+ */
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int cmp_cmd(const void *a, const void *b)
+{
+	const cmdstat_t *x = a, *y = b;
+
+	if (x->time.total != y->time.total)
+		return x->time.total > y->time.total ? -1 : 1;
+
+	return x->bytes > y->bytes ? -1 : x->bytes < y->bytes;
+}
+
+static bool is_server(const record_t *r)
+{
+	return !strcmp(cmds[r->cmd].name, "SERVER");
+}
+
+/* the median round trip of a PING on its own */
+static double baseline_rtt(void)
+{
+	double rtt[BASELINE_PROBES];
+	unsigned int i, n;
+
+	for (i = 0; i < BASELINE_PROBES; i++)
+	{
+		n = probe();
+		pump(n);
+		rtt[i] = marks[n].done - marks[n].sent;
+	}
+	qsort(rtt, BASELINE_PROBES, sizeof *rtt, cmp_double);
+
+	return rtt[BASELINE_PROBES / 2];
+}
+
+/*
+ * Each line is followed by a probe, and the next waits for its answer.
+ * Nothing can be probed until services know the uplink, so the lines
+ * up to and including SERVER are sent untimed.
+ */
+static double replay_timed(histogram_t *all)
+{
+	double *sample, start, base;
+	unsigned int i, n;
+	bool linked = false;
+
+	sample = smalloc(nrecords * sizeof *sample);
+	start = mono_usec_double();
+
+	for (i = 0; i < nrecords; i++)
+	{
+		out_raw((char *)capbuf + records[i].offset, records[i].len);
+		sample[i] = -1;
+
+		if (!linked)
+		{
+			linked = is_server(&records[i]);
+			continue;
+		}
+
+		n = probe();
+		pump(n);
+		sample[i] = marks[n].done - marks[n].sent;
+
+		/* the marks are not needed once answered */
+		if (out_off == out_len)
+			nmarks = marks_sent = 0;
+	}
+
+	pump(probe());
+	start = mono_usec_double() - start;
+
+	base = baseline_rtt();
+	for (i = 0; i < nrecords; i++)
+	{
+		unsigned int us;
+
+		if (sample[i] < 0)
+			continue;
+		us = sample[i] > base ? sample[i] - base : 0;
+		histogram_add(&cmds[records[i].cmd].time, us);
+		histogram_add(all, us);
+	}
+
+	printf("{\"replay\":\"baseline\",\"rtt_us\":%.1f}\n", base);
+	free(sample);
+
+	return start;
+}
+
+static double replay_paced(double *lat, unsigned int *nlat)
+{
+	double start, due;
+	unsigned int i, count = 0, last;
+	bool linked = false;
+
+	start = due = mono_usec_double();
+
+	for (i = 0; i < nrecords; i++)
+	{
+		if (opt.speed > 0)
+		{
+			due += records[i].delay / opt.speed;
+			io_until(due);
+		}
+
+		out_raw((char *)capbuf + records[i].offset, records[i].len);
+
+		if (!linked)
+			linked = is_server(&records[i]);
+		else if (++count % PROBE_INTERVAL == 0)
+			probe();
+
+		while (out_len - out_off > OUT_HIGHWATER)
+			io_round(1000);
+	}
+
+	last = probe();
+	pump(last);
+
+	*nlat = 0;
+	for (i = 0; i <= last; i++)
+		if (marks[i].done != 0)
+			lat[(*nlat)++] = (marks[i].done - marks[i].sent) / 1000.0;
+	qsort(lat, *nlat, sizeof *lat, cmp_double);
+
+	return marks[last].done - start;
+}
+
+static void report(double usec, const double *lat, unsigned int nlat, const histogram_t *all)
+{
+	double seconds = usec / 1000000.0;
+	unsigned int i;
+
+	printf("{\"replay\":\"summary\",\"lines\":%u,\"bytes\":%llu,\"capture_seconds\":%.3f,\"speed\":%.3f,\"timed\":%s,"
+			"\"seconds\":%.3f,\"lines_per_sec\":%.1f,\"bytes_per_sec\":%.1f",
+			nrecords, capture_bytes, capture_usec / 1000000.0,
+			opt.timed ? 0 : opt.speed, opt.timed ? "true" : "false",
+			seconds, seconds > 0 ? nrecords / seconds : 0,
+			seconds > 0 ? capture_bytes / seconds : 0);
+	if (opt.timed)
+		printf(",\"handling_us\":{\"lines\":%lu,\"total\":%llu,\"p50\":%u,\"p99\":%u,\"max\":%u}}\n",
+				all->count, (unsigned long long)all->total,
+				histogram_percentile(all, 50), histogram_percentile(all, 99), all->max);
+	else
+		printf(",\"latency_ms\":{\"samples\":%u,\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"max\":%.3f}}\n",
+				nlat, nlat ? lat[nlat / 2] : 0, nlat ? lat[nlat * 9 / 10] : 0,
+				nlat ? lat[nlat * 99 / 100] : 0, nlat ? lat[nlat - 1] : 0);
+
+	qsort(cmds, ncmds, sizeof *cmds, cmp_cmd);
+	for (i = 0; i < ncmds; i++)
+	{
+		const cmdstat_t *c = &cmds[i];
+
+		printf("{\"replay\":\"command\",\"command\":\"%s\",\"lines\":%lu,\"bytes\":%llu",
+				c->name, c->lines, c->bytes);
+		if (c->time.count != 0)
+			printf(",\"handling_us\":{\"lines\":%lu,\"total\":%llu,\"mean\":%.1f,\"p50\":%u,\"p99\":%u,\"max\":%u}",
+					c->time.count, (unsigned long long)c->time.total,
+					(double)c->time.total / c->time.count,
+					histogram_percentile(&c->time, 50), histogram_percentile(&c->time, 99), c->time.max);
+		printf("}\n");
+	}
+	fflush(stdout);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-x speed] [-t] [-p port] [-P probe]\n"
+			"       [-s services -c config [-D datadir]] capture\n", prog);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+	static histogram_t all;
+	double usec, *lat = NULL;
+	unsigned int nlat = 0;
+	int c;
+
+	while ((c = getopt(argc, argv, "x:tp:P:s:c:D:")) != -1)
+	{
+		switch (c)
+		{
+		case 'x': opt.speed = strtod(optarg, NULL); break;
+		case 't': opt.timed = true; break;
+		case 'p': opt.port = strtoul(optarg, NULL, 10); break;
+		case 'P': opt.probe = optarg; break;
+		case 's': opt.services = optarg; break;
+		case 'c': opt.config = optarg; break;
+		case 'D': opt.datadir = optarg; break;
+		default: usage(argv[0]);
+		}
+	}
+
+	if (optind != argc - 1 || opt.speed < 0 || opt.port == 0 || opt.port > 65535)
+		usage(argv[0]);
+	if ((opt.services == NULL) != (opt.config == NULL))
+		usage(argv[0]);
+	opt.capture = argv[optind];
+
+	signal(SIGPIPE, SIG_IGN);
+
+	read_capture();
+	listen_local();
+	if (opt.services != NULL)
+		spawn_services();
+	accept_link();
+
+	if (opt.timed)
+		usec = replay_timed(&all);
+	else
+	{
+		lat = smalloc((nrecords / PROBE_INTERVAL + 2) * sizeof *lat);
+		usec = replay_paced(lat, &nlat);
+	}
+
+	report(usec, lat, nlat, &all);
+
+	free(lat);
+	cleanup();
+
+	return EXIT_SUCCESS;
+}